@@ -3,10 +3,13 @@
 #include <GLFW/glfw3.h>
 #include <stdbool.h>
 #include "Vectors.h"
+#include "lod.h"
+#include "vertex_format.h"
 typedef struct {
     GLuint vao; // Vertex Array Object ID
     GLuint vbo; // Vertex Buffer Object ID
     GLuint ebo; // Element Buffer Object ID
+    VertexQuantization quantization; // Undoes the vertex buffer packing, see vertex_format.h
     Vector3 position; // Position of the cube
     Vector4 color;     // Color of the cube
 } Cube;
@@ -23,17 +26,20 @@ typedef struct {
     GLuint vao;
     GLuint vbo;
     GLuint ebo;
+    VertexQuantization quantization;
     Vector3 position;
     Vector4 color;
     SphereSettings settings;  
     int numVertices;
-    int numIndices;
+    int numIndices;  // Of the full tessellation, which comes first in the buffers
+    LodChain lod;    // Coarser tessellations follow it
 } Sphere;
 
 typedef struct {
     GLuint vao; 
     GLuint vbo; 
     GLuint ebo; 
+    VertexQuantization quantization;
     Vector3 position; 
     Vector4 color;    
 } Pyramid;
@@ -42,22 +48,31 @@ typedef struct {
     GLuint vao; // Vertex Array Object ID
     GLuint vbo; // Vertex Buffer Object ID
     GLuint ebo; // Element Buffer Object ID
+    VertexQuantization quantization;
     Vector3 position; // Position of the cube
     Vector4 color;     // Color of the cube
     float radius;
     float height;
     int sectorCount;
+    LodChain lod;
 } Cylinder;
 
 typedef struct {
     GLuint vao; // Vertex Array Object ID
     GLuint vbo; // Vertex Buffer Object ID
     GLuint ebo; // Element Buffer Object ID
+    VertexQuantization quantization;
     Vector3 position; // Position of the plane
     Vector4 color;    // Color of the plane
 } Plane;
 
 
+// Spheres and cylinders are tessellated once per LOD level, each level with
+// about half the triangles of the one before
+#define PRIMITIVE_LOD_SEGMENT_SCALE 0.7071f // Sphere sectors and stacks per level; triangles scale by its square
+#define CYLINDER_LOD_SEGMENT_SCALE 0.5f
+#define PRIMITIVE_MIN_SEGMENTS 6
+
 // Cube
 Cube createCube(Vector3 position, Vector4 color, float size);
 void drawCube(const Cube* cube, Matrix4x4 viewMatrix, Matrix4x4 projMatrix);
@@ -2,6 +2,8 @@
 #define MODELLOAD_H
 
 #include "Vectors.h"
+#include "lod.h"
+#include "vertex_format.h"
 #include <assimp/cimport.h>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -15,19 +17,62 @@ typedef struct {
     GLuint VBO;
     GLuint EBO;
     Vertex* vertices;
-    unsigned int* indices;
+    unsigned int* indices; // Every LOD level, level 0 first
     unsigned int numVertices;
-    unsigned int numIndices;
+    unsigned int numIndices; // Of level 0
+    GLenum indexType;        // Of the EBO: GL_UNSIGNED_SHORT when every vertex fits, else GL_UNSIGNED_INT
+    LodChain lod;
+    VertexQuantization quantization; // The VBO holds PackedVertex
+    Vector3 boundsMin; // Object-space AABB
+    Vector3 boundsMax;
 } Mesh;
 
+#define MODEL_PATH_LENGTH 256
+
+// The file's node hierarchy, flattened so parents come before their children
+typedef struct {
+    int parent;          // -1 for the root
+    Matrix4x4 local;     // Relative to the parent
+    Matrix4x4 transform; // Relative to the model root
+} ModelNode;
+
+// One node's use of a mesh. Meshes are uploaded once however many nodes use them.
+typedef struct {
+    unsigned int mesh;
+    unsigned int node;
+} MeshInstance;
+
 typedef struct {
     Mesh* meshes;
     unsigned int meshCount;
-    char path[256];
+    ModelNode* nodes;
+    unsigned int nodeCount;
+    MeshInstance* instances; // What is drawn: one item per instance
+    unsigned int instanceCount;
+    char path[MODEL_PATH_LENGTH];
+    Vector3 boundsMin; // Union of the instance bounds, in model space
+    Vector3 boundsMax;
 } Model;
 
-Mesh processMesh(struct aiMesh* mesh, const struct aiScene* scene);
-Model* loadModel(const char* path);
+// Loading is split in two: importModel() parses the file into CPU-side mesh
+// data and is safe on any thread; uploadModel() creates the GL buffers on the
+// main thread and consumes the import.
+typedef struct ModelImport ModelImport;
+
+ModelImport* importModel(const char* path);
+Model* uploadModel(ModelImport* import);
+void freeModelImport(ModelImport* import);
+Model* loadModel(const char* path); // Both phases on the calling thread
 void freeModel(Model* model);
 
+// Shared, refcounted models from the asset registry. Objects hold a copy of
+// the Model struct whose meshes point at the registry's single copy.
+Model* acquireModel(const char* path); // Loads on first use; the caller owns one reference
+// Acquires many at once: distinct paths that are not loaded yet are imported
+// concurrently on the job workers, then uploaded here. models[i] is NULL when
+// paths[i] is NULL or failed to load; every other entry owns one reference.
+void acquireModels(const char* const* paths, int count, Model** models);
+void retainModel(const Model* model);
+void releaseModel(const Model* model);
+
 #endif 
@@ -17,13 +17,20 @@ typedef struct {
 } ObjectManager;
 
 extern ObjectManager objectManager;
+extern unsigned int sceneGeneration; // Bumped whenever an object's GPU resources are released
 
 void initObjectManager();
-void addObjectToManager(SceneObject newObject);
+bool addObjectToManager(SceneObject newObject); // False when the scene is full
 void addObject(Camera* camera, ObjectType type, bool useTexture, int textureIndex, bool colorCreation, Model* model, PBRMaterial material, bool usePBR);
-void removeObject(int index);
+void removeObject(int index); // Its children move up to its parent
+int findObjectIndex(int id);  // -1 when no object has the ID
+bool setObjectParent(int index, int parentIndex); // -1 for none; false if it would make a cycle
+void retainObjectAssets(const SceneObject* obj);  // Each live object, undo entry and clipboard copy holds one reference
+void releaseObjectAssets(const SceneObject* obj);
 void cleanupObjects();
 void updateObjectInManager(SceneObject* updatedObject);
 void drawObject(const SceneObject* obj, const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix);
+Matrix4x4 computeModelMatrix(const SceneObject* obj);
+void getObjectLocalBounds(const SceneObject* obj, Vector3* center, float* radius);
 
 #endif 
\ No newline at end of file
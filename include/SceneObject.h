@@ -8,12 +8,13 @@
 
 typedef struct SceneObject {
     Object3D object;  // Base object
-    Vector3 position; // Position of the object
-    Vector3 rotation; // Rotation of the object
-    Vector3 scale;    // Scale of the object
+    Vector3 position; // Position of the object, relative to its parent
+    Vector3 rotation; // Rotation of the object, relative to its parent
+    Vector3 scale;    // Scale of the object, relative to its parent
     Vector4 color;    // Color of the object
     bool selected;    // Selection flag
     int id;           // Unique ID
+    int parentId;     // ID of the parent object, -1 for none
 } SceneObject;
 
 #endif 
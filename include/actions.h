@@ -1,40 +1,59 @@
 #ifndef ACTIONS_H
 #define ACTIONS_H
 
+#include <stddef.h>
 #include "SceneObject.h"
 
-#define MAX_ACTIONS 100
+// Undo history is a ring-buffered command log capped by bytes rather than
+// count; the oldest entries are dropped once it grows past the budget.
+// Entries store only the fields an action changed, and repeated edits to the
+// same object in quick succession (a drag) merge into one entry.
+#define ACTION_HISTORY_BUDGET (4 * 1024 * 1024)
+#define ACTION_COALESCE_SECONDS 0.5
+#define ACTION_OBJECT_POOL_SIZE 256 // Add/remove entries beyond this copy their object on the heap
 
 typedef enum {
     ACTION_ADD,
     ACTION_REMOVE,
     ACTION_TRANSFORM,
     ACTION_CHANGE_COLOR,
+    ACTION_SET_PARENT,
     ACTION_TOGGLE_OPTION
 } ActionType;
 
+typedef struct {
+    Vector3 position;
+    Vector3 rotation;
+    Vector3 scale;
+} ActionTransform;
+
 typedef struct {
     ActionType type;
-    SceneObject previousState;
-    SceneObject newState;
-    int objectIndex;
-    char description[256];
+    int objectId; // Stable across removals; a restored object gets a new ID and the log follows it
+    double time; // Of the latest edit merged into this entry
+    union {
+        SceneObject* object; // Add and remove: heap copy holding the object's asset references
+        struct { ActionTransform before, after; } transform;
+        struct { Vector4 before, after; } color;
+        struct { int before, after; } parent; // Parent IDs, -1 for none
+        struct { const char* name; bool value; } option; // Recorded for the history only
+    } data;
 } Action;
 
-extern Action actionHistory[MAX_ACTIONS];
-extern int historyCount;
-
-void pushUndoAction(Action action);
-Action popUndoAction();
-void pushRedoAction(Action action);
-Action popRedoAction();
-void addToHistory(Action action);
 void undo_last_action();
 void redo_last_action();
 void addObjectWithAction(ObjectType type, bool useTextures, int textureID, bool useColors, Model* model, PBRMaterial material, bool usePBR);
 void removeObjectWithAction(int index);
 void transformObjectWithAction(int index, Vector3 position, Vector3 rotation, Vector3 scale);
 void changeColorWithAction(int index, Vector4 color);
+void setParentWithAction(int index, int parentIndex); // -1 detaches the object
 void toggleOptionWithAction(const char* optionName, bool newValue);
+void clearActionHistory(); // Releases every entry, e.g. when the scene is replaced
+
+int getActionCount();        // Entries in the log, oldest first
+int getAppliedActionCount(); // Entries below this index can be undone, the rest redone
+const Action* getAction(int index);
+void describeAction(const Action* action, char* buffer, size_t size);
+size_t getActionHistoryBytes();
 
-#endif 
+#endif
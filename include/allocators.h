@@ -0,0 +1,52 @@
+#ifndef ALLOCATORS_H
+#define ALLOCATORS_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Engine heap allocations go through engineMalloc() and friends so they can be
+// counted; a steady-state frame should make none. Scratch that only lives for
+// a frame comes from the frame arena (jobFrameAlloc() in jobs.h, reset after
+// the buffer swap), and fixed-size objects that come and go with the scene
+// come from pools.
+
+typedef void (*AllocationHook)(size_t size, void* user); // Called on any thread
+
+typedef struct {
+    unsigned long long allocations;      // malloc, calloc and realloc calls
+    unsigned long long frees;
+    unsigned long long frameAllocations; // During the last drawn frame
+    unsigned long long liveBytes;        // Usable size of live blocks, including allocator rounding
+    unsigned long long peakBytes;
+} AllocationStats;
+
+void* engineMalloc(size_t size);
+void* engineCalloc(size_t count, size_t size);
+void* engineRealloc(void* block, size_t size);
+char* engineStrdup(const char* text);
+void engineFree(void* block); // Only for blocks from the functions above
+void setAllocationHook(AllocationHook hook, void* user); // NULL removes it
+void getAllocationStats(AllocationStats* stats);
+void endAllocationFrame(); // Once per drawn frame, after the swap
+
+// Fixed-size blocks with an intrusive free list. Storage for all blocks is
+// allocated on first use and kept until shutdownAllocators(); once a pool is
+// full, further blocks come from the heap. Main thread only.
+typedef struct Pool {
+    size_t blockSize;
+    int capacity;
+    const char* name;
+    unsigned char* storage;
+    void* freeList;
+    int used;
+    int overflow; // Live blocks that came from the heap
+    struct Pool* next;
+} Pool;
+
+#define POOL_INITIALIZER(type, count, poolName) { sizeof(type), (count), (poolName), NULL, NULL, 0, 0, NULL }
+
+void* poolAlloc(Pool* pool);
+void poolFree(Pool* pool, void* block);
+void shutdownAllocators(); // Releases the storage of every pool that was used
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef ASSET_REGISTRY_H
+#define ASSET_REGISTRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Central registry for shared assets. Every asset is keyed by an interned path
+// (or name) per type, so loading the same file twice returns the same asset.
+// Handles are refcounted; when the last reference is released the asset is
+// destroyed a few frames later, once no in-flight frame can still use it.
+// Main thread only.
+
+#define MAX_ASSETS 4096
+#define ASSET_DESTROY_DELAY_FRAMES 2
+
+typedef enum {
+    ASSET_MESH,
+    ASSET_MODEL,
+    ASSET_TEXTURE,
+    ASSET_MATERIAL,
+    ASSET_SHADER,
+    ASSET_TYPE_COUNT
+} AssetType;
+
+typedef uint32_t AssetHandle; // 0 is never a valid handle
+typedef void (*AssetDestroyFunction)(void* data);
+
+void initAssetRegistry();
+void shutdownAssetRegistry();                   // Destroys every remaining asset immediately
+void collectAssets();                           // Once per frame: destroys assets released long enough ago
+
+const char* internString(const char* text);     // Stable, deduplicated copy; equal strings share one pointer
+
+AssetHandle registerAsset(AssetType type, const char* key, void* data, AssetDestroyFunction destroy); // Starts with one reference
+AssetHandle findAsset(AssetType type, const char* key); // Does not add a reference
+bool addAssetAlias(AssetHandle handle, const char* alias); // Extra lookup key for the same asset
+AssetHandle acquireAsset(AssetHandle handle);
+void releaseAsset(AssetHandle handle);
+void* getAssetData(AssetHandle handle);
+const char* getAssetKey(AssetHandle handle);
+int getAssetRefCount(AssetHandle handle);
+int getAssetCount(AssetType type);
+
+#endif
@@ -9,6 +9,7 @@ extern Matrix4x4 projMatrix;  // If the projMatrix is globally accessible
 extern const char* backgroundNames[];
 extern const int backgroundCount;
 void initSkybox(int skyboxIndex);
+void cleanupSkybox();
 void drawSkybox(const Camera* camera, const Matrix4x4* projMatrix);
 GLuint loadCubemap(const char* faceFiles[6]);
 
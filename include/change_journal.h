@@ -0,0 +1,34 @@
+#ifndef CHANGE_JOURNAL_H
+#define CHANGE_JOURNAL_H
+
+#include <stdbool.h>
+
+// Append-only journal of scene edits for crash recovery. Edits are recorded
+// as small index-based records where the undo actions are pushed, buffered on
+// the main thread and appended to recovery.journal by a background job.
+// The journal starts from a checkpoint scene file; once it grows past
+// JOURNAL_COMPACT_BYTES a fresh checkpoint replaces both. On start-up an
+// existing journal means the editor did not exit cleanly, and replaying it on
+// top of its checkpoint restores the scene. CLUE_JOURNAL=0 disables it.
+
+#define JOURNAL_FILE_NAME "recovery.journal"
+#define JOURNAL_CHECKPOINT_PREFIX "recovery-" // recovery-<id>.cscene
+#define JOURNAL_FLUSH_INTERVAL 0.5            // Seconds between appends
+#define JOURNAL_FLUSH_BYTES (64 * 1024)       // Appends early once this much is buffered
+#define JOURNAL_COMPACT_BYTES (1024 * 1024)   // Journal size that triggers a new checkpoint
+
+void initChangeJournal();
+bool recoverChangeJournal();         // After resources are loaded; true if a scene was restored
+void shutdownChangeJournal();        // Clean exit: removes the recovery files
+void updateChangeJournal(double now); // Once per frame, between frames
+void resetChangeJournal();           // The whole scene was replaced (new or loaded project)
+
+// Main thread; call after the change has been applied
+void journalAddObject(int index);
+void journalRemoveObject(int index);
+void journalObjectTransform(int index);
+void journalObjectColor(int index);
+void journalObjectSurface(int index); // Texture, material and shading flags
+void journalObjectParent(int index);
+
+#endif
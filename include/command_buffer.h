@@ -0,0 +1,104 @@
+#ifndef COMMAND_BUFFER_H
+#define COMMAND_BUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <glad/glad.h>
+#include "jobs.h"
+
+// Engine-side render command format. Worker threads record draws into their
+// own CommandList; the lists are merged, sorted by key and replayed on the GL
+// thread, which only has to issue the calls and skip redundant state changes.
+
+typedef enum {
+    RENDER_CMD_BIND_PROGRAM,
+    RENDER_CMD_BIND_MATERIAL,
+    RENDER_CMD_SET_OBJECT_DATA,
+    RENDER_CMD_DRAW
+} RenderCommandType;
+
+typedef struct {
+    uint16_t type;
+    uint16_t size; // Including the header
+} RenderCommandHeader;
+
+typedef struct {
+    RenderCommandHeader header;
+    GLuint program;
+} BindProgramCommand;
+
+// PBR materials need no binds (their arrays are bound once per frame);
+// this only binds the object texture on unit 0
+typedef struct {
+    RenderCommandHeader header;
+    GLuint textureID;
+    uint8_t bindTexture;
+} BindMaterialCommand;
+
+typedef struct {
+    RenderCommandHeader header;
+    float model[16];
+    float color[4];
+    float positionScale[3]; // VertexQuantization of the mesh drawn next
+    float positionBias[3];
+    int16_t materialClass;
+    int16_t materialLayer;
+    uint8_t useTexture;
+    uint8_t usePBR;
+    uint8_t useColor;
+} SetObjectDataCommand;
+
+typedef struct {
+    RenderCommandHeader header;
+    GLuint vao;
+    GLuint firstIndex; // Into the bound element buffer, which holds every LOD level
+    GLsizei indexCount;
+    GLenum indexType;
+} DrawCommand;
+
+// One sortable group of commands (typically everything needed for one draw)
+typedef struct {
+    uint64_t key;
+    uint32_t sequence; // Tie-breaker so equal keys replay in recording order
+    uint32_t list;
+    uint32_t offset;
+    uint32_t size;
+} CommandRecord;
+
+typedef struct {
+    unsigned char* data;
+    size_t size;
+    size_t capacity;
+    CommandRecord* records;
+    int recordCount;
+    int recordCapacity;
+    int openRecord; // -1 when no record is being written
+} CommandList;
+
+typedef struct {
+    CommandList lists[MAX_JOB_WORKERS];
+    CommandRecord* sorted;
+    int sortedCount;
+    int sortedCapacity;
+} CommandBuffer;
+
+void resetCommandBuffer(CommandBuffer* buffer);
+void freeCommandBuffer(CommandBuffer* buffer);
+CommandList* getThreadCommandList(CommandBuffer* buffer);
+
+void beginCommandRecord(CommandList* list, uint64_t key, uint32_t sequence);
+void* pushRenderCommand(CommandList* list, RenderCommandType type, size_t size);
+void endCommandRecord(CommandList* list);
+
+void sortCommandBuffer(CommandBuffer* buffer);
+int findCommandRecord(const CommandBuffer* buffer, uint64_t key); // First sorted record with record.key >= key
+int replayCommandBuffer(const CommandBuffer* buffer, int first, int count); // Returns the number of draws issued
+
+#define RENDER_PASS_OPAQUE 0ULL
+#define RENDER_PASS_TRANSPARENT 1ULL
+#define RENDER_PASS_SHIFT 62
+
+uint64_t makeOpaqueSortKey(GLuint program, uint32_t materialKey, GLuint vao);
+uint64_t makeTransparentSortKey(float cameraDistance);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <stdbool.h>
+#include <glad/glad.h>
+
+// Dynamic resolution for the scene. The scene is drawn into an offscreen
+// target at a fraction of the window size, then upscaled to the backbuffer
+// with a sharpening pass; the GUI is drawn afterwards at native resolution.
+// GPU timer queries on the scene pass drive the scale towards a target frame
+// time (the monitor's refresh interval unless CLUE_TARGET_FRAME_MS is set).
+// CLUE_DYNAMIC_RESOLUTION=0 draws the scene straight to the backbuffer.
+
+#define RESOLUTION_MIN_SCALE 0.5f
+#define RESOLUTION_SCENE_BUDGET 0.8   // Share of the target frame time the scene may use
+#define RESOLUTION_RAISE_THRESHOLD 0.7 // Scale rises once the scene uses less than this share of its budget
+#define RESOLUTION_MAX_SHARPNESS 0.6f  // Sharpening at RESOLUTION_MIN_SCALE; none at full resolution
+#define RESOLUTION_QUERY_COUNT 4       // Timer queries in flight; results are read a few frames late
+
+typedef struct {
+    bool enabled;
+    float scale;             // Of each axis
+    int renderWidth, renderHeight;
+    double gpuMilliseconds;  // Smoothed scene pass time
+    double targetMilliseconds;
+} DynamicResolutionStats;
+
+void initDynamicResolution();     // After the GL context and refresh rate are known
+void shutdownDynamicResolution();
+void beginSceneRender();          // Binds the scaled scene target; call before the scene is drawn
+void endSceneRender();            // Upscales the scene into the backbuffer; the GUI is drawn after this
+void getDynamicResolutionStats(DynamicResolutionStats* stats);
+
+#endif
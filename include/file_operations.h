@@ -1,10 +1,12 @@
 #ifndef FILE_OPERATIONS_H
 #define FILE_OPERATIONS_H
 #include "cJSON/cJSON.h"
+#include "materials.h"
 #include "file_operations/tinyfiledialogs.h"
 void save_project();
 void load_project();
 void new_project();
+const char* getMaterialName(PBRMaterial* material); // "" when the material is not registered
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,80 @@
+#ifndef FRAME_PACKET_H
+#define FRAME_PACKET_H
+
+#include <stdbool.h>
+#include <glad/glad.h>
+#include "Vectors.h"
+#include "Camera.h"
+#include "materials.h"
+#include "lightshading.h"
+#include "command_buffer.h"
+#include "vertex_format.h"
+
+// Immutable snapshot of everything the GL thread needs to draw one frame.
+// Frame N+1 is built on a worker from the scene state while the GL thread
+// submits frame N; the two packets are double-buffered.
+
+typedef struct {
+    Matrix4x4 model;
+    Vector4 color;
+    GLuint vao;
+    GLuint firstIndex; // Start of the chosen LOD level
+    GLsizei indexCount;
+    GLenum indexType;
+    VertexQuantization quantization;
+    GLuint textureID;
+    PBRMaterial material;
+    bool useTexture;
+    bool usePBR;
+    bool useColor;
+    float cameraDistance;
+    int objectIndex; // Stable tie-breaker for sorting
+} RenderItem;
+
+typedef struct {
+    RenderItem* items; // Opaque items first, then transparent items
+    int opaqueCount;
+    int transparentCount;
+    int itemCapacity;
+    int culledCount;
+    int triangleCount; // Over the visible items, at their chosen LOD levels
+    int transformCount; // World matrices recomputed for this packet
+
+    CommandBuffer commands;   // Recorded from the items by the workers, replayed by the GL thread
+    int opaqueCommandCount;   // Sorted records before this index belong to the opaque pass
+
+    Camera camera;
+    Matrix4x4 view;
+    Matrix4x4 projection;
+
+    Light lights[MAX_LIGHTS];
+    int lightCount;
+
+    bool backgroundEnabled;
+    bool texturesEnabled;
+    bool colorsEnabled;
+    bool lightingEnabled;
+    bool usePBR;
+
+    unsigned int sceneGeneration;
+    unsigned long long frameNumber;
+} FramePacket;
+
+// What the last submitted packet drew
+typedef struct {
+    int drawCalls;    // Including the skybox
+    int visibleCount; // Render items that passed culling
+    int culledCount;
+    int triangleCount;
+    int transformCount;
+} FrameStats;
+
+void initFramePipeline();
+void shutdownFramePipeline();
+void kickFramePacketBuild();                // Start snapshotting the current scene on a worker
+void syncFramePacketBuild();                // Wait for the snapshot and publish it for the next frame
+const FramePacket* getRenderFramePacket();  // Latest published packet (rebuilt if scene resources changed)
+void submitFramePacket(const FramePacket* packet);
+void getFrameStats(FrameStats* stats);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef FRAME_STREAM_H
+#define FRAME_STREAM_H
+
+#include <stdbool.h>
+
+// Streams the presented frame as MJPEG from the engine's HTTP server, for
+// watching a headless or containerised instance without X forwarding.
+// CLUE_STREAM=1 turns it on (CLUE_HTTP_PORT must be set too); a browser or
+// player then opens /stream:
+//
+//     CLUE_HTTP_PORT=8080 CLUE_STREAM=1 ./ClueEngine &
+//     ffplay http://127.0.0.1:8080/stream
+//
+// Frames are only read back while a client is connected, at most
+// CLUE_STREAM_FPS times a second. Each capture is a glReadPixels into one of a
+// ring of pixel pack buffers followed by a fence; the buffer is handed to a
+// worker for JPEG encoding (CLUE_STREAM_QUALITY) once its fence has signalled,
+// so the main thread never waits on the GPU. A sender thread writes the newest
+// encoded frame to each client with non-blocking sockets. When the ring is full
+// or a client is slow, frames are dropped rather than waited for.
+
+#define FRAME_STREAM_PBO_COUNT 3      // Readbacks in flight or being encoded
+#define FRAME_STREAM_MAX_CLIENTS 8
+#define FRAME_STREAM_DEFAULT_FPS 15
+#define FRAME_STREAM_DEFAULT_QUALITY 75
+#define FRAME_STREAM_POLL_MS 100      // How often an idle sender thread checks for shutdown
+#define FRAME_STREAM_SEND_WAIT_MS 10  // Longest a busy sender waits on slow sockets before looking for new frames
+#define FRAME_STREAM_CLIENT_TIMEOUT 10.0 // Seconds a client may go without accepting any data
+
+typedef struct {
+    bool enabled;
+    int clients;
+    unsigned long long captured;  // Readbacks issued
+    unsigned long long encoded;
+    unsigned long long dropped;   // Captures skipped because every buffer was busy
+    int width, height;            // Of the last capture
+} FrameStreamStats;
+
+void initFrameStream();      // After the GL context and initHttpServer()
+void shutdownFrameStream();  // After shutdownHttpServer(), before shutdownJobSystem()
+void captureStreamFrame();   // Main thread, after the GUI is drawn and before the swap
+void getFrameStreamStats(FrameStreamStats* stats);
+
+#endif
@@ -21,6 +21,7 @@
 
 #define MAX_VERTEX_BUFFER 1024 * 1024
 #define MAX_ELEMENT_BUFFER 1024 * 1024
+#define DEBUG_MEMORY_OWNERS 8 // Largest owners listed in the debug window
 
 extern SceneObject scene_objects[MAX_OBJECTS];
 extern int num_scene_objects;
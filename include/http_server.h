@@ -0,0 +1,60 @@
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#ifdef _WIN32
+    #include <winsock2.h> // Before anything pulls in Windows.h
+    #include <ws2tcpip.h>
+    typedef SOCKET Socket;
+    #define INVALID_SOCKET_HANDLE INVALID_SOCKET
+    #define closeSocket closesocket
+    #define SEND_FLAGS 0
+#else
+    #include <sys/socket.h>
+    #include <sys/select.h>
+    #include <sys/time.h>
+    #include <netinet/in.h>
+    #include <arpa/inet.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    typedef int Socket;
+    #define INVALID_SOCKET_HANDLE (-1)
+    #define closeSocket close
+    #ifdef MSG_NOSIGNAL
+        #define SEND_FLAGS MSG_NOSIGNAL // A client hanging up must not raise SIGPIPE
+    #else
+        #define SEND_FLAGS 0
+    #endif
+#endif
+
+// The engine's one HTTP listener, shared by the metrics endpoint and the frame
+// stream so a container only has to expose one port. Off unless
+// CLUE_HTTP_PORT is set; listens on CLUE_HTTP_ADDRESS (127.0.0.1 by default,
+// 0.0.0.0 in a container).
+//
+// A thread of its own accepts connections and answers one request at a time,
+// with one deadline for reading the whole request and a timeout on every write. Subsystems register a handler per
+// path; GET and HEAD are the only methods accepted.
+
+#define HTTP_POLL_MS 200            // How often the server thread checks for shutdown
+#define HTTP_IO_TIMEOUT_MS 1000     // Whole request read, and each write; a stalled client cannot hold the thread
+#define HTTP_REQUEST_SIZE 2048
+#define HTTP_MAX_HANDLERS 16
+
+// Runs on the server thread. Returns true if it kept the socket (a long-lived
+// stream); otherwise the server closes it.
+typedef bool (*HttpHandler)(Socket client, bool head);
+
+void initHttpServer();   // Starts the server if CLUE_HTTP_PORT is set
+void shutdownHttpServer();
+bool isHttpServerRunning();
+void registerHttpHandler(const char* path, HttpHandler handler); // Main thread; path must outlive the server
+
+// For handlers. Sockets handed to a handler are blocking, with HTTP_IO_TIMEOUT_MS timeouts.
+bool httpSendAll(Socket handle, const char* data, size_t length);
+void httpRespond(Socket handle, const char* status, const char* contentType, const char* content, size_t length, bool includeBody);
+void setSocketBlocking(Socket handle, bool blocking);
+bool socketWouldBlock(); // After a failed send or recv on a non-blocking socket
+
+#endif
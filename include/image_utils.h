@@ -0,0 +1,21 @@
+#ifndef IMAGE_UTILS_H
+#define IMAGE_UTILS_H
+
+#include <stddef.h>
+
+// CPU-side helpers for tightly packed RGBA8 images, used by the texture
+// streamer and the material packer on worker threads.
+
+int imageMipCount(int width, int height);
+int imageMipDimension(int size, int level);
+size_t imageMipBytes(int width, int height, int level);
+
+void flipImageRows(unsigned char* pixels, int width, int height);
+// 2x2 box filter into the next mip level (dst is imageMipDimension(w, 1) x imageMipDimension(h, 1))
+void downsampleImage(const unsigned char* src, int width, int height, unsigned char* dst);
+// Bilinear resize to an arbitrary size
+void resampleImage(const unsigned char* src, int srcWidth, int srcHeight, unsigned char* dst, int dstWidth, int dstHeight);
+// Mip levels [firstLevel, last] packed back to back; NULL when out of memory
+unsigned char* buildMipChain(const unsigned char* base, int width, int height, int firstLevel, size_t* outBytes);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+// Engine-wide work-stealing job system. One deque per thread (the main thread
+// is worker 0); idle workers steal from the others. Every subsystem that needs
+// background or parallel work submits jobs here instead of creating threads.
+
+#define MAX_JOB_WORKERS 32
+#define JOB_QUEUE_CAPACITY 4096
+#define JOB_FRAME_ALLOCATOR_SIZE (4 * 1024 * 1024)
+#define MAX_PARALLEL_FOR_BATCHES 256
+
+typedef void (*JobFunction)(void* data);
+typedef void (*ParallelForFunction)(int start, int end, void* data);
+
+// Counts outstanding jobs. Zero-initialise, pass to runJob(), then wait on it.
+typedef struct {
+    atomic_int pending;
+} JobCounter;
+
+typedef struct {
+    JobFunction function;
+    void* data;
+    JobCounter* counter;
+} Job;
+
+void initJobSystem(int workerCount); // 0 = one worker per core minus the main thread
+void shutdownJobSystem();
+int getJobWorkerCount();             // Worker threads + the main thread
+int getCurrentJobWorker();           // -1 for threads not owned by the job system
+int getQueuedJobCount();             // Frame and background jobs not yet started
+
+void runJob(JobFunction function, void* data, JobCounter* counter);
+void runJobs(const Job* jobs, int count, JobCounter* counter);
+// Long-running work (saving, streaming). Only idle worker threads run these;
+// no thread picks one up inside waitForCounter(), so waiting on frame work
+// never ends up executing one.
+void runBackgroundJob(JobFunction function, void* data, JobCounter* counter);
+void waitForCounter(JobCounter* counter); // Executes other frame jobs while waiting
+int isCounterDone(JobCounter* counter);
+
+// Splits [0, count) into batches of at least batchSize and blocks until all are done
+void parallelFor(int count, int batchSize, ParallelForFunction function, void* data);
+
+// Scratch memory valid until resetJobFrameAllocator() at the end of the frame
+void* jobFrameAlloc(size_t size);
+void resetJobFrameAllocator();
+
+#endif
@@ -1,3 +1,6 @@
+#ifndef LIGHTSHADING_H
+#define LIGHTSHADING_H
+
 #define MAX_LIGHTS 10
 
 #include "Vectors.h"
@@ -26,8 +29,11 @@ extern int lightCount;
 
 void initLightingSystem();
 void updateShaderLights();
+void uploadShaderLights(const Light* lightList, int count);
 void addLight(Light newLight);
 void updateLight(int index, Light updatedLight);
 void removeLight(int index);
 Vector3 calculateLighting(Vector3 normal, Vector3 fragPos, Vector3 viewDir);
 void createLight(Vector3 position, Vector3 direction, Vector3 color, float intensity, LightType type);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <stdbool.h>
+#include "Vectors.h"
+
+// Level-of-detail chains. Every level of a mesh lives in the same vertex and
+// index buffers: level 0 is the full mesh at the start of the index buffer and
+// coarser levels follow it, so switching level only changes the index range
+// drawn. Each level records the geometric error it introduces, in object
+// units; the frame packet projects that error to pixels and draws the coarsest
+// level whose error stays under LOD_PIXEL_ERROR (CLUE_LOD_PIXEL_ERROR).
+// CLUE_LOD=0 always draws level 0.
+
+#define MAX_LOD_LEVELS 4
+#define LOD_PIXEL_ERROR 1.0f     // Largest acceptable error on screen, in pixels
+#define LOD_HYSTERESIS 0.2f      // Projected scale must change by this share before the level is chosen again
+#define LOD_REDUCTION 0.5f       // Each simplified level targets this share of the previous level's triangles
+#define LOD_MIN_TRIANGLES 64     // Meshes and levels smaller than this are not simplified further
+
+typedef struct {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    float error; // Object-space distance from the full mesh
+} LodLevel;
+
+typedef struct {
+    LodLevel levels[MAX_LOD_LEVELS];
+    int levelCount; // 0 for meshes without a chain: draw everything
+} LodChain;
+
+// The coarsest level whose error, at pixelsPerUnit screen pixels per object
+// unit, stays within maxPixelError; level 0 when none does
+int selectLodLevel(const LodChain* chain, float pixelsPerUnit, float maxPixelError);
+
+// Quadric error simplification. Writes at most indexCount indices into
+// destination (which may not alias indices) and returns how many it wrote,
+// stopping at targetIndexCount or when no collapse keeps the mesh valid.
+// On failure the indices are copied unchanged.
+// Only vertices of the input are referenced; vertices sharing a position are
+// treated as one. *resultError is the object-space error of the result.
+unsigned int simplifyMesh(unsigned int* destination, const unsigned int* indices, unsigned int indexCount,
+                          const Vector3* positions, unsigned int vertexCount, unsigned int targetIndexCount,
+                          float* resultError);
+
+// Appends simplified levels after level 0 (indices[0, indexCount)) until
+// MAX_LOD_LEVELS or simplification stops paying off. *indices is reallocated
+// with engineRealloc() to hold every level; returns the total index count.
+unsigned int buildLodChain(unsigned int** indices, unsigned int indexCount, const Vector3* positions,
+                           unsigned int vertexCount, LodChain* chain);
+
+#endif
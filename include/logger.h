@@ -0,0 +1,88 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// Asynchronous, levelled and category-filtered logging. A call site copies
+// its format pointer and raw arguments into a lock-free ring owned by the
+// calling thread; a logger thread merges the rings in time order, formats
+// the records and writes them out, so no thread blocks on console I/O.
+// Formats must be string literals: they are read after the call returns.
+//
+// Levels below LOG_COMPILE_LEVEL are compiled out. At runtime, CLUE_LOG sets
+// the level for every category ("debug") or per category ("scene=trace,render=warn").
+// Each call site is limited to LOG_RATE_LIMIT messages per second; the rest are
+// counted and reported with the next message that gets through.
+
+typedef enum {
+    LOG_LEVEL_TRACE,
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_NONE
+} LogLevel;
+
+typedef enum {
+    LOG_CORE,   // Start-up, jobs
+    LOG_SCENE,  // Objects, undo, saving and loading
+    LOG_RENDER, // Frame building and GL state
+    LOG_ASSETS, // Models, textures, materials, shaders, asset registry
+    LOG_GUI,
+    LOG_CATEGORY_COUNT
+} LogCategory;
+
+#ifndef LOG_COMPILE_LEVEL
+    #ifdef NDEBUG
+        #define LOG_COMPILE_LEVEL LOG_LEVEL_INFO
+    #else
+        #define LOG_COMPILE_LEVEL LOG_LEVEL_TRACE
+    #endif
+#endif
+
+#define LOG_DEFAULT_LEVEL LOG_LEVEL_INFO
+#define LOG_RING_SIZE (64 * 1024)  // Bytes per thread; records that do not fit are dropped
+#define LOG_MAX_THREADS 64
+#define LOG_MAX_RECORD 1024        // Arguments beyond this are cut off
+#define LOG_RATE_LIMIT 20          // Messages per call site per second
+#define LOG_FLUSH_INTERVAL_MS 10
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define LOG_PRINTF_FORMAT(formatIndex, firstArg) __attribute__((format(printf, formatIndex, firstArg)))
+#else
+    #define LOG_PRINTF_FORMAT(formatIndex, firstArg)
+#endif
+
+// Rate limit state; one static instance per call site
+typedef struct {
+    atomic_llong windowStart; // Milliseconds
+    atomic_int count;
+    atomic_int suppressed;
+} LogSite;
+
+extern atomic_int logCategoryLevels[LOG_CATEGORY_COUNT];
+
+void initLogger();     // First thing at start-up; also flushes at exit()
+void shutdownLogger(); // Writes everything still queued and stops the logger thread
+void setLogLevel(LogCategory category, LogLevel level);
+void logWrite(LogSite* site, LogLevel level, LogCategory category, const char* format, ...) LOG_PRINTF_FORMAT(4, 5);
+
+static inline bool logEnabled(LogLevel level, LogCategory category) {
+    return (int)level >= atomic_load_explicit(&logCategoryLevels[category], memory_order_relaxed);
+}
+
+#define LOG_AT(level, category, ...) do { \
+    if ((level) >= LOG_COMPILE_LEVEL && logEnabled((level), (category))) { \
+        static LogSite logSite; \
+        logWrite(&logSite, (level), (category), __VA_ARGS__); \
+    } \
+} while (0)
+
+#define LOG_TRACE(category, ...) LOG_AT(LOG_LEVEL_TRACE, category, __VA_ARGS__)
+#define LOG_DEBUG(category, ...) LOG_AT(LOG_LEVEL_DEBUG, category, __VA_ARGS__)
+#define LOG_INFO(category, ...) LOG_AT(LOG_LEVEL_INFO, category, __VA_ARGS__)
+#define LOG_WARN(category, ...) LOG_AT(LOG_LEVEL_WARN, category, __VA_ARGS__)
+#define LOG_ERROR(category, ...) LOG_AT(LOG_LEVEL_ERROR, category, __VA_ARGS__)
+
+#endif
@@ -1,28 +1,42 @@
 #ifndef MATERIALS_H
 #define MATERIALS_H
 
-#include <glad/glad.h>  
+#include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include <stdbool.h>
+
+// Materials are packed into one GL_TEXTURE_2D_ARRAY per resolution class.
+// Each material owns three consecutive layers: albedo, normal and ORM
+// (R = ambient occlusion, G = roughness, B = metallic). The arrays are bound
+// once per frame and objects select their layers through uniforms.
 typedef struct {
-    GLuint albedoMap;
-    GLuint normalMap;
-    GLuint metallicMap;
-    GLuint roughnessMap;
-    GLuint aoMap;
+    int materialClass; // Which array the layers live in
+    int layer;         // First of the material's three layers
 } PBRMaterial;
 
-#define MAX_MATERIALS 50  
+#define MAX_MATERIALS 50
+#define MATERIAL_CLASS_COUNT 4          // 256, 512, 1024 and 2048 pixels square
+#define MATERIAL_MIN_CLASS_SIZE 256
+#define MATERIAL_LAYERS 3
+#define MATERIAL_LAYER_ALBEDO 0
+#define MATERIAL_LAYER_NORMAL 1
+#define MATERIAL_LAYER_ORM 2
+#define MATERIAL_ARRAY_UNIT 1           // Texture unit of the first class array; unit 0 is the object texture
+#define MATERIAL_DEFAULT_ROUGHNESS 0.5f // Used when a material has no roughness map
 
-// Material storage 
+// Material storage
 extern PBRMaterial materials[MAX_MATERIALS];
 extern const char* materialNames[MAX_MATERIALS];
 extern int materialCount;
 
 
 PBRMaterial loadPBRMaterial(const char* albedo, const char* normal, const char* metallic, const char* roughness, const char* ao);
-void bindPBRMaterial(PBRMaterial material);
-void cleanupPBRMaterial(PBRMaterial* material);
+void bindMaterialArrays(GLuint program);  // Once per frame; sets the sampler units too
+void updateMaterialPacking();              // Uploads materials whose packing job finished (GL thread)
+void cleanupMaterialArrays();
+bool isSameMaterial(PBRMaterial a, PBRMaterial b);
+int getMaterialClassSize(int materialClass);
 void addMaterial(const char* name, PBRMaterial material);
 PBRMaterial* getMaterial(const char* name);
 
-#endif 
+#endif
@@ -0,0 +1,76 @@
+#ifndef MEMORY_ACCOUNTING_H
+#define MEMORY_ACCOUNTING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Tracks what GPU storage and long-lived heap blocks the engine holds, by
+// category and by owning asset (a model path, texture path, material name or
+// subsystem). Every glBufferData, glTexImage*, glTexStorage* and
+// glRenderbufferStorage call is followed by trackMemory() for the object it
+// filled, and every glDelete* of such an object is preceded by untrackMemory().
+// Sizes of GPU objects are what the engine asked for; drivers may pad them.
+// Main thread only.
+
+typedef enum {
+    MEMORY_VERTEX_BUFFERS,
+    MEMORY_INDEX_BUFFERS,
+    MEMORY_TEXTURES,
+    MEMORY_CUBEMAPS,
+    MEMORY_MATERIAL_ARRAYS,
+    MEMORY_RENDER_TARGETS,
+    MEMORY_STAGING_BUFFERS, // Pixel unpack and GUI streaming buffers
+    MEMORY_MESH_INDICES,    // First heap category: CPU copies kept by meshes
+    MEMORY_UNDO_HISTORY,
+    MEMORY_CATEGORY_COUNT
+} MemoryCategory;
+
+#define MEMORY_FIRST_HOST_CATEGORY MEMORY_MESH_INDICES
+
+// Which namespace an id belongs to; GL names are only unique per object type
+typedef enum {
+    TRACKED_BUFFER,
+    TRACKED_TEXTURE,
+    TRACKED_RENDERBUFFER,
+    TRACKED_HOST // id is the block's address
+} TrackedResource;
+
+typedef struct {
+    unsigned long long bytes;
+    unsigned long long peakBytes;
+    int count;
+} MemoryUsage;
+
+typedef struct {
+    MemoryUsage categories[MEMORY_CATEGORY_COUNT];
+    MemoryUsage gpu;       // Sum of the GPU categories
+    MemoryUsage host;      // Sum of the heap categories
+    unsigned long long heapBytes;     // Everything allocated through engineMalloc(), tagged or not
+    unsigned long long heapPeakBytes;
+} MemoryTotals;
+
+typedef struct {
+    const char* owner;
+    unsigned long long bytes;
+    unsigned long long categoryBytes[MEMORY_CATEGORY_COUNT];
+} MemoryOwnerUsage;
+
+// Sets the size of a resource, replacing what was recorded for it before.
+// owner is interned, so any string will do.
+void trackMemory(TrackedResource resource, uintptr_t id, MemoryCategory category, size_t bytes, const char* owner);
+void untrackMemory(TrackedResource resource, uintptr_t id);
+
+// Bytes for width x height x layers texels with the given number of mip levels
+size_t textureMemorySize(int width, int height, int layers, int levels, int bytesPerTexel);
+
+const char* getMemoryCategoryName(MemoryCategory category);
+void getMemoryTotals(MemoryTotals* totals);
+// Largest owners first; returns how many were written. The array stays valid
+// until the next call.
+int getMemoryOwners(const MemoryOwnerUsage** owners);
+bool writeMemoryReport(const char* path); // JSON: totals, categories and per-owner breakdown
+
+void shutdownMemoryAccounting(); // Writes CLUE_MEMORY_REPORT if set, then drops every record
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "Vectors.h"
+
+// Import-time reordering of indexed triangle meshes. Triangles are first put in
+// post-transform cache order (Tipsify), then whole clusters of that order are
+// sorted so outward-facing, outlying surfaces draw first and hide what is
+// behind them; finally vertices are renumbered in first-use order so fetches
+// walk the vertex buffer forwards. CLUE_MESH_OPTIMIZE=0 skips all of it.
+
+#define MESH_CACHE_SIZE 16             // Post-transform cache entries assumed when ordering and measuring
+#define MESH_OVERDRAW_THRESHOLD 1.05f  // Overdraw sorting may cost this much ACMR
+
+// Average cache misses per triangle for a FIFO cache of cacheSize entries:
+// 3 is a miss on every vertex, 0.5 the limit for a large regular grid
+float computeAcmr(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize);
+
+// Writes the triangles of indices to destination (which may not alias them) in
+// an order that reuses the last cacheSize transformed vertices
+bool optimizeVertexCache(unsigned int* destination, const unsigned int* indices, unsigned int indexCount,
+                         unsigned int vertexCount, unsigned int cacheSize);
+
+// Reorders clusters of cache-ordered triangles, front-facing outer ones first,
+// letting the ACMR grow by at most threshold. destination may not alias indices.
+bool optimizeOverdraw(unsigned int* destination, const unsigned int* indices, unsigned int indexCount,
+                      const Vector3* positions, unsigned int vertexCount, float threshold);
+
+// Renumbers vertices in order of first use, rewriting indices and filling
+// remap (vertexCount entries, old to new; UINT32_MAX for unreferenced ones).
+// Returns the new vertex count, or 0 on failure.
+unsigned int optimizeVertexFetch(unsigned int* remap, unsigned int* indices, unsigned int indexCount, unsigned int vertexCount);
+
+// Moves each vertexSize-byte vertex to its remapped slot, dropping unreferenced ones
+bool remapVertexBuffer(void* vertices, size_t vertexSize, unsigned int vertexCount, const unsigned int* remap);
+
+#endif
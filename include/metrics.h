@@ -0,0 +1,25 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "asset_registry.h"
+
+// Prometheus metrics on the engine's HTTP server (http_server.h), so headless
+// instances can be scraped without a debugger. GET /metrics returns the text
+// exposition format and GET /healthz returns "ok":
+//
+//     CLUE_HTTP_PORT=8080 ./ClueEngine &
+//     curl http://127.0.0.1:8080/metrics
+//
+// The main thread publishes a snapshot of its gauges once per loop; the
+// server thread formats that snapshot, so a scrape never touches engine state.
+
+#define METRICS_RESPONSE_SIZE (64 * 1024)
+#define METRICS_MAX_BUCKETS 16
+
+void initMetrics();     // After initHttpServer(); does nothing if the server is off
+void shutdownMetrics(); // After shutdownHttpServer()
+void updateMetrics();   // Main thread, once per loop
+void observeFrameTime(double seconds);                // One drawn frame, up to and including the swap
+void observeAssetLoad(AssetType type, double seconds); // Any thread
+
+#endif
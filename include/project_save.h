@@ -0,0 +1,32 @@
+#ifndef PROJECT_SAVE_H
+#define PROJECT_SAVE_H
+
+#include <stdbool.h>
+
+// Background project saving. A save request is captured into a SceneSnapshot
+// at the next frame boundary; a background job then serialises it to a
+// temporary file and renames it over the target, so the editor never waits on
+// disk and a crash mid-save never leaves a truncated project behind.
+// Autosaves go through the same path and are skipped when nothing changed.
+
+#define AUTOSAVE_DEFAULT_INTERVAL 120.0 // Seconds; CLUE_AUTOSAVE_SECONDS overrides, 0 disables
+#define AUTOSAVE_FILE_NAME "autosave.cscene" // Used until the project has been saved once
+#define SAVE_PATH_LENGTH 1024
+
+typedef struct {
+    bool saving;
+    bool autosave;          // The running save is an autosave
+    float progress;         // 0 to 1 for the running save
+    bool lastFailed;
+    double lastSaveTime;    // glfwGetTime() when the last save finished, 0 if none
+    char lastPath[SAVE_PATH_LENGTH];
+} ProjectSaveStatus;
+
+void initProjectSave();
+void shutdownProjectSave();                 // Waits for a running save to finish
+void requestProjectSave(const char* path);  // Main thread; starts at the next frame boundary
+void updateProjectSave(double now);         // Once per frame, after the frame packet is published
+void setAutosaveInterval(double seconds);   // 0 disables autosave
+ProjectSaveStatus getProjectSaveStatus();
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef REDRAW_H
+#define REDRAW_H
+
+#include <stdbool.h>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+// Event-driven redraws. The main loop only builds and presents a frame when
+// something changed: input, the camera, the scene, a running simulation,
+// streaming uploads or a finished background job. Otherwise it blocks in
+// glfwWaitEventsTimeout and the last presented frame stays on screen.
+// CLUE_IDLE_RENDERING=0 draws every frame as before.
+
+#define REDRAW_SETTLE_FRAMES 3   // Frames drawn after a change; the frame packet and Nuklear lag by one
+#define REDRAW_IDLE_TIMEOUT 0.5  // Seconds; idle loops still wake this often for background work
+
+void initRedraw(GLFWwindow* window); // After every other input callback is installed
+bool waitForRedraw();                // Main thread, once per loop; true if this loop should draw a frame
+void requestRedraw();                // Any thread; wakes a waiting main loop immediately
+void scheduleRedraw(double time);    // Draw again at glfwGetTime() == time, e.g. to expire a status label
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef SCENE_FORMAT_H
+#define SCENE_FORMAT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "Vectors.h"
+#include "Camera.h"
+#include "lightshading.h"
+#include "SceneObject.h"
+
+// Binary scene files (.cscene). A 16 byte file header is followed by chunks,
+// each a 32 byte header plus a payload aligned to 16 bytes:
+//   STRS  string table (model paths, material and texture names)
+//   OBJS  objects as columns: types, flags, string ids, then positions,
+//         rotations, scales and colors as packed float arrays
+//   HIER  parent of each object as a record index, -1 for none; only
+//         written when some object has a parent
+//   LITE  lights, CAMR camera, TOGL render toggles
+// Unknown chunks are skipped, so newer writers stay readable. Files are
+// little-endian and loaded through a memory map; uncompressed columns are
+// read in place. With zlib available, large chunks are deflated.
+
+#define SCENE_FILE_EXTENSION ".cscene"
+#define SCENE_FORMAT_VERSION 1
+#define SCENE_CHUNK_ALIGNMENT 16
+#define SCENE_COMPRESS_MIN_BYTES 4096 // Smaller chunks are always stored raw
+#define SCENE_PROGRESS_DONE 1000
+
+#define SCENE_OBJECT_USE_TEXTURE (1u << 0)
+#define SCENE_OBJECT_USE_COLOR (1u << 1)
+#define SCENE_OBJECT_USE_PBR (1u << 2)
+#define SCENE_OBJECT_USE_LIGHTING (1u << 3)
+
+#define SCENE_TOGGLE_RUNNING (1u << 0)
+#define SCENE_TOGGLE_TEXTURES (1u << 1)
+#define SCENE_TOGGLE_COLORS (1u << 2)
+#define SCENE_TOGGLE_LIGHTING (1u << 3)
+#define SCENE_TOGGLE_NO_SHADING (1u << 4)
+#define SCENE_TOGGLE_PBR (1u << 5)
+#define SCENE_TOGGLE_BACKGROUND (1u << 6)
+
+#define SCENE_WRITE_COMPRESS (1u << 0) // Ignored when built without zlib
+#define SCENE_WRITE_DURABLE (1u << 1)  // Flush to disk before returning, for rename-on-write
+
+// Strings are interned or static, so the writer can deduplicate them by pointer
+typedef struct {
+    const char* modelPath;    // NULL for primitives
+    const char* materialName; // NULL without a material
+    const char* textureName;  // NULL without a texture
+    Vector3 position;
+    Vector3 rotation;
+    Vector3 scale;
+    Vector4 color;
+    int32_t parent; // Index of the parent record, -1 for none
+    uint8_t type;
+    uint8_t flags;
+} SceneObjectRecord;
+
+// Copy of everything a scene file stores, detached from the live scene so it
+// can be written from any thread
+typedef struct {
+    SceneObjectRecord* objects;
+    int objectCount;
+    Light* lights;
+    int lightCount;
+    Camera camera;
+    uint32_t toggles;
+} SceneSnapshot;
+
+void makeSceneObjectRecord(const SceneObject* obj, SceneObjectRecord* record);
+bool addSceneObject(const SceneObjectRecord* record); // Appends to the scene; strings need not be interned
+bool captureSceneSnapshot(SceneSnapshot* snapshot); // Main thread
+void freeSceneSnapshot(SceneSnapshot* snapshot);
+uint64_t hashSceneSnapshot(const SceneSnapshot* snapshot); // Equal hashes mean nothing saved has changed
+// progress is optional and counts up to SCENE_PROGRESS_DONE while objects are written
+bool writeSceneFile(const SceneSnapshot* snapshot, const char* path, uint32_t writeFlags, atomic_int* progress);
+bool loadSceneFile(const char* path);               // Replaces the current scene; main thread
+bool isSceneFile(const char* path);                 // Checks the magic, not the extension
+
+// Durable writes: flush a file through to disk, then rename it over the target
+bool flushFileToDisk(FILE* file);
+bool replaceFile(const char* from, const char* to);
+
+#endif
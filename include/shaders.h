@@ -2,6 +2,8 @@
 #include <GLFW/glfw3.h>
 #include <stdbool.h>
 unsigned int loadShader(const char* vertexPath, const char* fragmentPath);
+unsigned int acquireShader(const char* vertexPath, const char* fragmentPath); // Shared program per source pair, refcounted
+void releaseShader(unsigned int program);
 bool checkCompileErrors(unsigned int shader, const char* type);
 char* readFile(const char* filePath);
 
@@ -0,0 +1,46 @@
+#ifndef TEXTURE_STREAMING_H
+#define TEXTURE_STREAMING_H
+
+#include <stddef.h>
+#include <glad/glad.h>
+
+// Streams textures in the background instead of loading them up front.
+// A request returns a stable texture name that holds a 1x1 placeholder until
+// the image has been decoded on a worker and uploaded through PBOs, smallest
+// mip first. Only the mips needed for the size objects cover on screen are
+// kept resident; under the VRAM budget the least recently used textures lose
+// their largest mips first.
+
+#define MAX_STREAMED_TEXTURES 1024
+#define DEFAULT_TEXTURE_VRAM_BUDGET (256 * 1024 * 1024)
+#define DEFAULT_TEXTURE_UPLOAD_BUDGET (4 * 1024 * 1024) // Bytes uploaded per frame
+#define MAX_STREAMING_DECODES 4
+#define STREAMING_MIN_RESIDENT_SIZE 32 // Mips this size and smaller are never evicted
+
+typedef enum {
+    TEXTURE_USAGE_COLOR,  // Grey placeholder
+    TEXTURE_USAGE_NORMAL  // Flat normal placeholder
+} TextureUsage;
+
+typedef struct {
+    int textureCount;
+    int pendingDecodes;
+    int pendingUploads;
+    size_t residentBytes;
+    size_t vramBudget;
+    size_t uploadedLastFrame;
+    int mipBias;
+} TextureStreamingStats;
+
+void initTextureStreaming(size_t vramBudget); // 0 = $CLUE_TEXTURE_BUDGET_MB or DEFAULT_TEXTURE_VRAM_BUDGET
+void shutdownTextureStreaming();
+void updateTextureStreaming();                // Once per frame on the GL thread, outside the frame packet build
+
+GLuint requestStreamedTexture(const char* path, TextureUsage usage);
+void noteTextureScreenSize(GLuint texture, float pixels); // Thread-safe; called while building the frame packet
+
+void setTextureStreamingBudget(size_t bytes);
+void setTextureUploadBudget(size_t bytesPerFrame);
+void getTextureStreamingStats(TextureStreamingStats* stats);
+
+#endif
@@ -13,5 +13,7 @@ GLuint loadTexture(const char* path);
 void loadAllTextures();
 void loadPBRTextures();
 GLuint getTexture(const char* name);
+const char* getTextureName(GLuint textureID); // NULL when it is not one of textureNames
+int findTextureIndex(const char* name);       // Index into textureNames, -1 when unknown
 
 #endif 
\ No newline at end of file
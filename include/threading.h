@@ -0,0 +1,188 @@
+#ifndef THREADING_H
+#define THREADING_H
+
+// Thin portable wrappers over the native thread primitives (Win32 / pthreads).
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+    #include <Windows.h>
+    #include <process.h>
+
+    typedef HANDLE Thread;
+    typedef CRITICAL_SECTION Mutex;
+    typedef CONDITION_VARIABLE CondVar;
+    #define THREAD_LOCAL __declspec(thread)
+#else
+    #include <pthread.h>
+    #include <sched.h>
+    #include <time.h>
+    #include <unistd.h>
+
+    typedef pthread_t Thread;
+    typedef pthread_mutex_t Mutex;
+    typedef pthread_cond_t CondVar;
+    #define THREAD_LOCAL _Thread_local
+#endif
+
+typedef void* (*ThreadFunction)(void* arg);
+
+#ifdef _WIN32
+typedef struct {
+    ThreadFunction function;
+    void* arg;
+} ThreadStart;
+
+static unsigned __stdcall threadTrampoline(void* param) {
+    ThreadStart start = *(ThreadStart*)param;
+    free(param);
+    start.function(start.arg);
+    return 0;
+}
+#endif
+
+static inline bool threadCreate(Thread* thread, ThreadFunction function, void* arg) {
+#ifdef _WIN32
+    ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+    if (!start) return false;
+    start->function = function;
+    start->arg = arg;
+    *thread = (HANDLE)_beginthreadex(NULL, 0, threadTrampoline, start, 0, NULL);
+    if (!*thread) {
+        free(start);
+        return false;
+    }
+    return true;
+#else
+    return pthread_create(thread, NULL, function, arg) == 0;
+#endif
+}
+
+static inline void threadJoin(Thread thread) {
+#ifdef _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, NULL);
+#endif
+}
+
+static inline void threadYield() {
+#ifdef _WIN32
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+static inline void threadSleepMs(unsigned int milliseconds) {
+#ifdef _WIN32
+    Sleep(milliseconds);
+#else
+    struct timespec ts = { milliseconds / 1000, (long)(milliseconds % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+#endif
+}
+
+static inline int getCpuCount() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
+
+static inline void mutexInit(Mutex* mutex) {
+#ifdef _WIN32
+    InitializeCriticalSection(mutex);
+#else
+    pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+static inline void mutexDestroy(Mutex* mutex) {
+#ifdef _WIN32
+    DeleteCriticalSection(mutex);
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+static inline void mutexLock(Mutex* mutex) {
+#ifdef _WIN32
+    EnterCriticalSection(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+static inline void mutexUnlock(Mutex* mutex) {
+#ifdef _WIN32
+    LeaveCriticalSection(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+static inline void condInit(CondVar* cond) {
+#ifdef _WIN32
+    InitializeConditionVariable(cond);
+#else
+    pthread_cond_init(cond, NULL);
+#endif
+}
+
+static inline void condDestroy(CondVar* cond) {
+#ifdef _WIN32
+    (void)cond;
+#else
+    pthread_cond_destroy(cond);
+#endif
+}
+
+static inline void condWait(CondVar* cond, Mutex* mutex) {
+#ifdef _WIN32
+    SleepConditionVariableCS(cond, mutex, INFINITE);
+#else
+    pthread_cond_wait(cond, mutex);
+#endif
+}
+
+// Returns false on timeout
+static inline bool condTimedWait(CondVar* cond, Mutex* mutex, unsigned int milliseconds) {
+#ifdef _WIN32
+    return SleepConditionVariableCS(cond, mutex, milliseconds) != 0;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += milliseconds / 1000;
+    ts.tv_nsec += (long)(milliseconds % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return pthread_cond_timedwait(cond, mutex, &ts) == 0;
+#endif
+}
+
+static inline void condSignal(CondVar* cond) {
+#ifdef _WIN32
+    WakeConditionVariable(cond);
+#else
+    pthread_cond_signal(cond);
+#endif
+}
+
+static inline void condBroadcast(CondVar* cond) {
+#ifdef _WIN32
+    WakeAllConditionVariable(cond);
+#else
+    pthread_cond_broadcast(cond);
+#endif
+}
+
+#endif
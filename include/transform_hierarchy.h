@@ -0,0 +1,27 @@
+#ifndef TRANSFORM_HIERARCHY_H
+#define TRANSFORM_HIERARCHY_H
+
+#include <stdbool.h>
+#include "Vectors.h"
+
+// World matrices for the scene's parent-child hierarchy. An object's position,
+// rotation and scale are relative to its parent (SceneObject.parentId). Local
+// and world matrices live in arrays sorted by depth, breadth first, so every
+// parent precedes its children and each parent's children are contiguous in
+// the next level. Edits only set dirty flags; the update walks the levels in
+// order, recomputing the marked objects and everything below them, with each
+// level's range split across the job system. Nothing dirty means no work.
+
+#define TRANSFORMS_PER_UPDATE_BATCH 256
+
+void markTransformDirty(int index); // The object's position, rotation or scale changed
+void markHierarchyChanged();        // Objects were added, removed or reparented; rebuilds the order
+
+// Main thread, once the scene is no longer mutated for the frame and before
+// the frame packet is built. Returns how many world matrices were recomputed.
+int updateTransformHierarchy();
+
+// Valid for every object after updateTransformHierarchy(), until the next edit
+const Matrix4x4* getWorldTransform(int index);
+
+#endif
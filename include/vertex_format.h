@@ -0,0 +1,43 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <stdint.h>
+#include <glad/glad.h>
+#include "Vectors.h"
+
+// Packed vertex layout shared by primitives and imported meshes: 16 bytes
+// against 32 for the float Vertex. Positions are 16-bit unsigned normalised
+// offsets into the mesh's bounding box, normals are octahedral-encoded in two
+// 16-bit signed normalised values, and texture coordinates are half floats.
+// The vertex shader turns positions back into object space with the mesh's
+// VertexQuantization, passed as the positionScale and positionBias uniforms.
+
+#define VERTEX_ATTRIB_POSITION 0
+#define VERTEX_ATTRIB_TEXCOORD 1
+#define VERTEX_ATTRIB_NORMAL 2
+
+typedef struct {
+    uint16_t position[4];  // x, y, z; w pads the attribute to 8 bytes
+    uint16_t texCoords[2]; // Half floats
+    int16_t normal[2];     // Octahedral
+} PackedVertex;
+
+// Object-space position = stored position (0 to 1) * scale + bias
+typedef struct {
+    Vector3 scale;
+    Vector3 bias;
+} VertexQuantization;
+
+// Packs count vertices read with a stride of stride floats. normals and
+// texCoords may be NULL; missing normals decode to +Z and missing texture
+// coordinates to 0. Returns what the shader needs to undo the quantisation.
+VertexQuantization packVertices(PackedVertex* destination, unsigned int count, const float* positions,
+                                const float* normals, const float* texCoords, unsigned int stride);
+
+// Describes PackedVertex to the bound VAO, reading from the bound GL_ARRAY_BUFFER
+void bindPackedVertexAttributes();
+
+// Sets positionScale and positionBias on the program in use
+void applyVertexQuantization(GLuint program, const VertexQuantization* quantization);
+
+#endif
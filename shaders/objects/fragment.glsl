@@ -23,11 +23,19 @@ uniform bool useColor;
 uniform bool noShading;
 uniform bool usePBR;
 
-uniform sampler2D albedoMap;
-uniform sampler2D normalMap;
-uniform sampler2D metallicMap;
-uniform sampler2D roughnessMap;
-uniform sampler2D aoMap;
+// One array per material resolution class; each material owns three layers
+// starting at materialLayer: albedo, normal, ORM (R = AO, G = roughness, B = metallic)
+uniform sampler2DArray materialArrays[4];
+uniform int materialClass;
+uniform int materialLayer;
+
+vec4 sampleMaterial(int offset) {
+    vec3 coord = vec3(TexCoord, float(materialLayer + offset));
+    if (materialClass == 0) return texture(materialArrays[0], coord);
+    if (materialClass == 1) return texture(materialArrays[1], coord);
+    if (materialClass == 2) return texture(materialArrays[2], coord);
+    return texture(materialArrays[3], coord);
+}
 
 vec3 calculateLighting(vec3 norm, vec3 viewDir, vec3 albedo, float metallic, float roughness, float ao) {
     vec3 ambient = 0.3 * albedo;
@@ -55,11 +63,12 @@ void main() {
     vec3 baseColor = vec3(1.0); // Start with default white color
 
     if (usePBR) {
-        baseColor = texture(albedoMap, TexCoord).rgb;
-        norm = normalize(texture(normalMap, TexCoord).rgb * 2.0 - 1.0);
-        float metallic = texture(metallicMap, TexCoord).r;
-        float roughness = texture(roughnessMap, TexCoord).r;
-        float ao = texture(aoMap, TexCoord).r;
+        baseColor = sampleMaterial(0).rgb;
+        norm = normalize(sampleMaterial(1).rgb * 2.0 - 1.0);
+        vec3 orm = sampleMaterial(2).rgb;
+        float ao = orm.r;
+        float roughness = orm.g;
+        float metallic = orm.b;
         baseColor *= ao; // Apply ambient occlusion directly to base color
     } else if (useTexture) {
         baseColor = texture(texture1, TexCoord).rgb;
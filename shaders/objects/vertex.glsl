@@ -1,8 +1,10 @@
 #version 330 core
 
+// Packed vertices (include/vertex_format.h): positions are unsigned normalised
+// offsets into the mesh bounds, normals are octahedral-encoded
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
-layout (location = 2) in vec3 aNormal;
+layout (location = 2) in vec2 aNormal;
 
 out vec3 FragPos;  
 out vec2 TexCoord;  
@@ -13,11 +15,22 @@ uniform mat4 model;
 uniform mat4 view;        
 uniform mat4 projection;  
 uniform vec4 inputColor;  
+uniform vec3 positionScale;
+uniform vec3 positionBias;
+
+vec3 decodeOctahedral(vec2 encoded) {
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-normal.z, 0.0);
+    normal.x += normal.x >= 0.0 ? -fold : fold;
+    normal.y += normal.y >= 0.0 ? -fold : fold;
+    return normalize(normal);
+}
 
 void main() {
-    vec4 worldPosition = model * vec4(aPos, 1.0);
+    vec3 position = aPos * positionScale + positionBias;
+    vec4 worldPosition = model * vec4(position, 1.0);
     FragPos = vec3(worldPosition);  
-    Normal = mat3(transpose(inverse(model))) * aNormal;  
+    Normal = mat3(transpose(inverse(model))) * decodeOctahedral(aNormal);  
     TexCoord = aTexCoord;
     vertexColor = inputColor;  
     gl_Position = projection * view * worldPosition;  
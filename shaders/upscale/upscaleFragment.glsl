@@ -0,0 +1,27 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D scene;
+uniform vec2 uvScale;    // Part of the texture the scene was drawn into
+uniform float sharpness; // 0 = plain bilinear upscale
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(scene, 0));
+    vec2 uv = TexCoords * uvScale;
+    vec2 lo = texel * 0.5;
+    vec2 hi = uvScale - texel * 0.5; // Stay inside the drawn area
+
+    vec3 center = texture(scene, clamp(uv, lo, hi)).rgb;
+    vec3 neighbours = texture(scene, clamp(uv + vec2(texel.x, 0.0), lo, hi)).rgb
+                    + texture(scene, clamp(uv - vec2(texel.x, 0.0), lo, hi)).rgb
+                    + texture(scene, clamp(uv + vec2(0.0, texel.y), lo, hi)).rgb
+                    + texture(scene, clamp(uv - vec2(0.0, texel.y), lo, hi)).rgb;
+
+    // Unsharp mask: push each pixel away from its neighbours' average to
+    // restore edges softened by the bilinear upscale
+    vec3 color = center + (center - neighbours * 0.25) * sharpness;
+    FragColor = vec4(clamp(color, 0.0, 1.0), 1.0);
+}
@@ -6,6 +6,10 @@
 #include <stdio.h>
 #include "Vectors.h"
 #include "Camera.h"
+#include "logger.h"
+#include "jobs.h"
+#include "memory_accounting.h"
+#include "vertex_format.h"
 
 #define PI 3.14159265358979323846
 
@@ -70,10 +74,12 @@ void generateCubeVertices(float* vertices, unsigned int* indices, float size) {
     }
 }
 
+// Vertex and index scratch comes from the frame arena; it only has to live
+// until glBufferData has copied it.
 Cube createCube(Vector3 position, Vector4 color, float size) {
     Cube cube;
-    float* vertices = (float*)malloc(6 * 4 * 5 * sizeof(float)); // 6 faces, 4 vertices each, 5 floats per vertex
-    unsigned int* indices = (unsigned int*)malloc(6 * 6 * sizeof(unsigned int)); // 6 faces, 6 indices each
+    float* vertices = (float*)jobFrameAlloc(6 * 4 * 5 * sizeof(float)); // 6 faces, 4 vertices each, 5 floats per vertex
+    unsigned int* indices = (unsigned int*)jobFrameAlloc(6 * 6 * sizeof(unsigned int)); // 6 faces, 6 indices each
 
     generateCubeVertices(vertices, indices, size);
 
@@ -82,24 +88,21 @@ Cube createCube(Vector3 position, Vector4 color, float size) {
 
     glGenBuffers(1, &cube.vbo);
     glBindBuffer(GL_ARRAY_BUFFER, cube.vbo);
-    glBufferData(GL_ARRAY_BUFFER, 6 * 4 * 5 * sizeof(float), vertices, GL_STATIC_DRAW);
+    PackedVertex* packed = (PackedVertex*)jobFrameAlloc(6 * 4 * sizeof(PackedVertex));
+    cube.quantization = packVertices(packed, 6 * 4, vertices, NULL, vertices + 3, 5);
+    glBufferData(GL_ARRAY_BUFFER, 6 * 4 * sizeof(PackedVertex), packed, GL_STATIC_DRAW);
+    trackMemory(TRACKED_BUFFER, cube.vbo, MEMORY_VERTEX_BUFFERS, 6 * 4 * sizeof(PackedVertex), "primitive:cube");
 
     glGenBuffers(1, &cube.ebo);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cube.ebo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, 6 * 6 * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+    trackMemory(TRACKED_BUFFER, cube.ebo, MEMORY_INDEX_BUFFERS, 6 * 6 * sizeof(unsigned int), "primitive:cube");
 
-    // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    // Texture coordinates attribute
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    bindPackedVertexAttributes();
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
-    free(vertices);
-    free(indices);
 
     cube.position = position;
     cube.color = color;
@@ -126,6 +129,7 @@ void drawCube(const Cube* cube, Matrix4x4 viewMatrix, Matrix4x4 projMatrix) {
 
 
 
+    applyVertexQuantization(shaderProgram, &cube->quantization);
     glBindVertexArray(cube->vao);
     glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
     glBindVertexArray(0);
@@ -135,13 +139,16 @@ void drawCube(const Cube* cube, Matrix4x4 viewMatrix, Matrix4x4 projMatrix) {
 
 void destroyCube(Cube* cube) {
     glDeleteVertexArrays(1, &cube->vao);
+    untrackMemory(TRACKED_BUFFER, cube->vbo);
     glDeleteBuffers(1, &cube->vbo);
+    untrackMemory(TRACKED_BUFFER, cube->ebo);
     glDeleteBuffers(1, &cube->ebo);
 }
 
 
 // CUBESPHERE (time to implement.: about 5 days :))
-void generateSphereVertices(float* vertices, unsigned int* indices, float radius, int sectorCount, int stackCount) {
+// Indices start at baseVertex, so several tessellations can share one buffer; returns the index count
+int generateSphereVertices(float* vertices, unsigned int* indices, float radius, int sectorCount, int stackCount, unsigned int baseVertex) {
     float x, y, z, xy;                              // vertex position
     float nx, ny, nz, lengthInv = 1.0f / radius;    // vertex normal
     float s, t;                                     // vertex texCoord
@@ -187,7 +194,7 @@ void generateSphereVertices(float* vertices, unsigned int* indices, float radius
 
     int k1, k2;
     for (int i = 0; i < stackCount; ++i) {
-        k1 = i * (sectorCount + 1);     // beginning of current stack
+        k1 = baseVertex + i * (sectorCount + 1); // beginning of current stack
         k2 = k1 + sectorCount + 1;      // beginning of next stack
 
         for (int j = 0; j < sectorCount; ++j, ++k1, ++k2) {
@@ -204,52 +211,78 @@ void generateSphereVertices(float* vertices, unsigned int* indices, float radius
             }
         }
     }
+    return index;
+}
+
+// Distance from the true surface to the chords of a circle cut into segments
+static float chordError(float radius, int segments) {
+    return radius * (1.0f - cosf((float)PI / segments));
 }
 
 Sphere createSphere(float radius, int sectorCount, int stackCount, Vector3 position, Vector4 color) {
     Sphere sphere;
-    int vertexCount = (stackCount + 1) * (sectorCount + 1);
+    int sectors[MAX_LOD_LEVELS], stacks[MAX_LOD_LEVELS];
+    int levelCount = 0;
+    int vertexCount = 0;
+    int indexCapacity = 0;
+    for (float scale = 1.0f; levelCount < MAX_LOD_LEVELS; scale *= PRIMITIVE_LOD_SEGMENT_SCALE) {
+        int levelSectors = (int)(sectorCount * scale + 0.5f);
+        int levelStacks = (int)(stackCount * scale + 0.5f);
+        if (levelCount > 0 && (levelSectors < PRIMITIVE_MIN_SEGMENTS || levelStacks < PRIMITIVE_MIN_SEGMENTS / 2)) break;
+        sectors[levelCount] = levelSectors;
+        stacks[levelCount] = levelStacks;
+        vertexCount += (levelStacks + 1) * (levelSectors + 1);
+        indexCapacity += levelStacks * levelSectors * 6;
+        levelCount++;
+    }
     // 3 for position, 3 for normal, 2 for texture
     int numVertices = vertexCount * 8;
-    int indexCount = stackCount * sectorCount * 6;
 
-    float* vertices = (float*)malloc(numVertices * sizeof(float));
-    unsigned int* indices = (unsigned int*)malloc(indexCount * sizeof(unsigned int));
+    float* vertices = (float*)jobFrameAlloc(numVertices * sizeof(float));
+    unsigned int* indices = (unsigned int*)jobFrameAlloc(indexCapacity * sizeof(unsigned int));
 
     if (!vertices || !indices) {
-        fprintf(stderr, "Failed to allocate memory for sphere.\n");
+        LOG_ERROR(LOG_ASSETS, "Failed to allocate memory for sphere.");
         exit(EXIT_FAILURE);
     }
 
-    // Call the function to generate the vertices and indices for the sphere
-    generateSphereVertices(vertices, indices, radius, sectorCount, stackCount);
+    // Every level goes into the same buffers, full tessellation first
+    int baseVertex = 0;
+    int indexCount = 0;
+    sphere.lod.levelCount = levelCount;
+    for (int level = 0; level < levelCount; level++) {
+        int written = generateSphereVertices(vertices + baseVertex * 8, indices + indexCount, radius,
+                                             sectors[level], stacks[level], baseVertex);
+        float error = fmaxf(chordError(radius, sectors[level]), chordError(radius, stacks[level] * 2));
+        sphere.lod.levels[level] = (LodLevel){ indexCount, written, level == 0 ? 0.0f : error };
+        baseVertex += (stacks[level] + 1) * (sectors[level] + 1);
+        indexCount += written;
+    }
+
     glGenVertexArrays(1, &sphere.vao);
     glBindVertexArray(sphere.vao);
 
     glGenBuffers(1, &sphere.vbo);
     glBindBuffer(GL_ARRAY_BUFFER, sphere.vbo);
-    glBufferData(GL_ARRAY_BUFFER, numVertices * sizeof(float), vertices, GL_STATIC_DRAW);
+    PackedVertex* packed = (PackedVertex*)jobFrameAlloc(vertexCount * sizeof(PackedVertex));
+    sphere.quantization = packVertices(packed, vertexCount, vertices, vertices + 3, vertices + 6, 8);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(PackedVertex), packed, GL_STATIC_DRAW);
+    trackMemory(TRACKED_BUFFER, sphere.vbo, MEMORY_VERTEX_BUFFERS, vertexCount * sizeof(PackedVertex), "primitive:sphere");
 
     glGenBuffers(1, &sphere.ebo);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphere.ebo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+    trackMemory(TRACKED_BUFFER, sphere.ebo, MEMORY_INDEX_BUFFERS, indexCount * sizeof(unsigned int), "primitive:sphere");
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+    bindPackedVertexAttributes();
 
     glBindVertexArray(0);
 
-    free(vertices);
-    free(indices);
 
     sphere.position = position;
     sphere.color = color;
-    sphere.numVertices = vertexCount;
-    sphere.numIndices = indexCount;
+    sphere.numVertices = (stacks[0] + 1) * (sectors[0] + 1);
+    sphere.numIndices = sphere.lod.levels[0].indexCount;
 
     return sphere;
 }
@@ -274,6 +307,7 @@ void drawSphere(const Sphere* sphere, Matrix4x4 viewMatrix, Matrix4x4 projMatrix
     GLint colorLoc = glGetUniformLocation(shaderProgram, "inputColor");
     glUniform4f(colorLoc, sphere->color.x, sphere->color.y, sphere->color.z, sphere->color.w);
 
+    applyVertexQuantization(shaderProgram, &sphere->quantization);
     glBindVertexArray(sphere->vao);
     glDrawElements(GL_TRIANGLES, sphere->numIndices, GL_UNSIGNED_INT, 0);
     glBindVertexArray(0);
@@ -281,7 +315,9 @@ void drawSphere(const Sphere* sphere, Matrix4x4 viewMatrix, Matrix4x4 projMatrix
 
 void destroySphere(Sphere* sphere) {
     glDeleteVertexArrays(1, &sphere->vao);
+    untrackMemory(TRACKED_BUFFER, sphere->vbo);
     glDeleteBuffers(1, &sphere->vbo);
+    untrackMemory(TRACKED_BUFFER, sphere->ebo);
     glDeleteBuffers(1, &sphere->ebo);
 }
 
@@ -335,8 +371,8 @@ void generatePyramidVertices(float* vertices, unsigned int* indices, float baseS
 
 Pyramid createPyramid(Vector3 position, Vector4 color, float baseSize, float height) {
     Pyramid pyramid;
-    float* vertices = (float*)malloc(5 * 5 * sizeof(float)); // 5 vertices, 5 floats per vertex
-    unsigned int* indices = (unsigned int*)malloc(18 * sizeof(unsigned int)); // 6 indices for base, 12 for sides
+    float* vertices = (float*)jobFrameAlloc(5 * 5 * sizeof(float)); // 5 vertices, 5 floats per vertex
+    unsigned int* indices = (unsigned int*)jobFrameAlloc(18 * sizeof(unsigned int)); // 6 indices for base, 12 for sides
 
     generatePyramidVertices(vertices, indices, baseSize, height);
 
@@ -345,24 +381,21 @@ Pyramid createPyramid(Vector3 position, Vector4 color, float baseSize, float hei
 
     glGenBuffers(1, &pyramid.vbo);
     glBindBuffer(GL_ARRAY_BUFFER, pyramid.vbo);
-    glBufferData(GL_ARRAY_BUFFER, 5 * 5 * sizeof(float), vertices, GL_STATIC_DRAW);
+    PackedVertex* packed = (PackedVertex*)jobFrameAlloc(5 * sizeof(PackedVertex));
+    pyramid.quantization = packVertices(packed, 5, vertices, NULL, vertices + 3, 5);
+    glBufferData(GL_ARRAY_BUFFER, 5 * sizeof(PackedVertex), packed, GL_STATIC_DRAW);
+    trackMemory(TRACKED_BUFFER, pyramid.vbo, MEMORY_VERTEX_BUFFERS, 5 * sizeof(PackedVertex), "primitive:pyramid");
 
     glGenBuffers(1, &pyramid.ebo);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pyramid.ebo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, 18 * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+    trackMemory(TRACKED_BUFFER, pyramid.ebo, MEMORY_INDEX_BUFFERS, 18 * sizeof(unsigned int), "primitive:pyramid");
 
-    // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    // Texture coordinates attribute
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    bindPackedVertexAttributes();
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
-    free(vertices);
-    free(indices);
 
     pyramid.position = position;
     pyramid.color = color;
@@ -393,6 +426,7 @@ void drawPyramid(const Pyramid* pyramid, Matrix4x4 viewMatrix, Matrix4x4 projMat
     GLint colorLoc = glGetUniformLocation(shaderProgram, "inputColor");
     glUniform4f(colorLoc, pyramid->color.x, pyramid->color.y, pyramid->color.z, pyramid->color.w);
 
+    applyVertexQuantization(shaderProgram, &pyramid->quantization);
     glBindVertexArray(pyramid->vao);
     glDrawElements(GL_TRIANGLES, 18, GL_UNSIGNED_INT, 0);
     glBindVertexArray(0);
@@ -401,13 +435,16 @@ void drawPyramid(const Pyramid* pyramid, Matrix4x4 viewMatrix, Matrix4x4 projMat
 
 void destroyPyramid(Pyramid* pyramid) {
     glDeleteVertexArrays(1, &pyramid->vao);
+    untrackMemory(TRACKED_BUFFER, pyramid->vbo);
     glDeleteBuffers(1, &pyramid->vbo);
+    untrackMemory(TRACKED_BUFFER, pyramid->ebo);
     glDeleteBuffers(1, &pyramid->ebo);
 
 }
 
 // CYLINDER
-void generateCylinderVertices(float* vertices, unsigned int* indices, float radius, float height, int sectorCount) {
+// Indices start at baseVertex, like the sphere's; writes sectorCount * 12 indices
+void generateCylinderVertices(float* vertices, unsigned int* indices, float radius, float height, int sectorCount, unsigned int baseVertex) {
     float angleStep = 2 * PI / sectorCount;
     float angle;
     int vertexIndex = 0, index = 0;
@@ -448,13 +485,13 @@ void generateCylinderVertices(float* vertices, unsigned int* indices, float radi
 
     // Indices for the top circle
     for (int i = 0; i < sectorCount; ++i) {
-        indices[index++] = i;
-        indices[index++] = i + 1;
-        indices[index++] = sectorCount;
+        indices[index++] = baseVertex + i;
+        indices[index++] = baseVertex + i + 1;
+        indices[index++] = baseVertex + sectorCount;
     }
 
     // Indices for the bottom circle
-    int bottomOffset = sectorCount + 1;
+    int bottomOffset = baseVertex + sectorCount + 1;
     for (int i = 0; i < sectorCount; ++i) {
         indices[index++] = bottomOffset + i;
         indices[index++] = bottomOffset + sectorCount;
@@ -463,8 +500,8 @@ void generateCylinderVertices(float* vertices, unsigned int* indices, float radi
 
     // Indices for the sides
     for (int i = 0; i < sectorCount; ++i) {
-        int currentTop = i;
-        int nextTop = i + 1;
+        int currentTop = baseVertex + i;
+        int nextTop = baseVertex + i + 1;
         int currentBottom = bottomOffset + i;
         int nextBottom = bottomOffset + i + 1;
 
@@ -482,41 +519,57 @@ void generateCylinderVertices(float* vertices, unsigned int* indices, float radi
 
 Cylinder createCylinder(float radius, float height, int sectorCount, Vector3 position, Vector4 color) {
     Cylinder cylinder;
-    int vertexCount = (sectorCount + 1) * 2 + 2; // +2 for center points of top and bottom circle
+    int sectors[MAX_LOD_LEVELS];
+    int levelCount = 0;
+    int vertexCount = 0;
+    int indexCount = 0;
+    for (float scale = 1.0f; levelCount < MAX_LOD_LEVELS; scale *= CYLINDER_LOD_SEGMENT_SCALE) {
+        int levelSectors = (int)(sectorCount * scale + 0.5f);
+        if (levelCount > 0 && levelSectors < PRIMITIVE_MIN_SEGMENTS) break;
+        sectors[levelCount++] = levelSectors;
+        vertexCount += (levelSectors + 1) * 2; // Top and bottom rings
+        indexCount += levelSectors * 12;       // 6 indices per sector for sides, top and bottom
+    }
     int numVertices = vertexCount * 6; // 3 for position, 3 for normal
-    int indexCount = sectorCount * 12; // 6 indices per sector for sides, top and bottom
 
-    float* vertices = (float*)malloc(numVertices * sizeof(float));
-    unsigned int* indices = (unsigned int*)malloc(indexCount * sizeof(unsigned int));
+    float* vertices = (float*)jobFrameAlloc(numVertices * sizeof(float));
+    unsigned int* indices = (unsigned int*)jobFrameAlloc(indexCount * sizeof(unsigned int));
 
     if (!vertices || !indices) {
-        fprintf(stderr, "Failed to allocate memory for cylinder.\n");
+        LOG_ERROR(LOG_ASSETS, "Failed to allocate memory for cylinder.");
         exit(EXIT_FAILURE);
     }
 
-    generateCylinderVertices(vertices, indices, radius, height, sectorCount);
+    int baseVertex = 0;
+    int firstIndex = 0;
+    cylinder.lod.levelCount = levelCount;
+    for (int level = 0; level < levelCount; level++) {
+        generateCylinderVertices(vertices + baseVertex * 6, indices + firstIndex, radius, height, sectors[level], baseVertex);
+        cylinder.lod.levels[level] = (LodLevel){ firstIndex, sectors[level] * 12, level == 0 ? 0.0f : chordError(radius, sectors[level]) };
+        baseVertex += (sectors[level] + 1) * 2;
+        firstIndex += sectors[level] * 12;
+    }
 
     glGenVertexArrays(1, &cylinder.vao);
     glBindVertexArray(cylinder.vao);
 
     glGenBuffers(1, &cylinder.vbo);
     glBindBuffer(GL_ARRAY_BUFFER, cylinder.vbo);
-    glBufferData(GL_ARRAY_BUFFER, numVertices * sizeof(float), vertices, GL_STATIC_DRAW);
+    PackedVertex* packed = (PackedVertex*)jobFrameAlloc(vertexCount * sizeof(PackedVertex));
+    cylinder.quantization = packVertices(packed, vertexCount, vertices, vertices + 3, NULL, 6);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(PackedVertex), packed, GL_STATIC_DRAW);
+    trackMemory(TRACKED_BUFFER, cylinder.vbo, MEMORY_VERTEX_BUFFERS, vertexCount * sizeof(PackedVertex), "primitive:cylinder");
 
     glGenBuffers(1, &cylinder.ebo);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cylinder.ebo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+    trackMemory(TRACKED_BUFFER, cylinder.ebo, MEMORY_INDEX_BUFFERS, indexCount * sizeof(unsigned int), "primitive:cylinder");
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+    bindPackedVertexAttributes();
 
     glBindVertexArray(0);
 
     // Cleanup
-    free(vertices);
-    free(indices);
 
     cylinder.position = position;
     cylinder.color = color;
@@ -544,6 +597,7 @@ void drawCylinder(const Cylinder* cylinder, Matrix4x4 viewMatrix, Matrix4x4 proj
     GLint colorLoc = glGetUniformLocation(shaderProgram, "inputColor");
     glUniform4f(colorLoc, cylinder->color.x, cylinder->color.y, cylinder->color.z, cylinder->color.w);
 
+    applyVertexQuantization(shaderProgram, &cylinder->quantization);
     glBindVertexArray(cylinder->vao);
     glDrawElements(GL_TRIANGLES, cylinder->sectorCount * 12, GL_UNSIGNED_INT, 0);
     glBindVertexArray(0);
@@ -551,7 +605,9 @@ void drawCylinder(const Cylinder* cylinder, Matrix4x4 viewMatrix, Matrix4x4 proj
 
 void destroyCylinder(Cylinder* cylinder) {
     glDeleteVertexArrays(1, &cylinder->vao);
+    untrackMemory(TRACKED_BUFFER, cylinder->vbo);
     glDeleteBuffers(1, &cylinder->vbo);
+    untrackMemory(TRACKED_BUFFER, cylinder->ebo);
     glDeleteBuffers(1, &cylinder->ebo);
 }
 
@@ -578,16 +634,17 @@ Plane createPlane(Vector3 position, Vector4 color) {
 
     glGenBuffers(1, &plane.vbo);
     glBindBuffer(GL_ARRAY_BUFFER, plane.vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    PackedVertex packed[4];
+    plane.quantization = packVertices(packed, 4, vertices, NULL, vertices + 3, 5);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(packed), packed, GL_STATIC_DRAW);
+    trackMemory(TRACKED_BUFFER, plane.vbo, MEMORY_VERTEX_BUFFERS, sizeof(packed), "primitive:plane");
 
     glGenBuffers(1, &plane.ebo);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, plane.ebo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    trackMemory(TRACKED_BUFFER, plane.ebo, MEMORY_INDEX_BUFFERS, sizeof(indices), "primitive:plane");
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    bindPackedVertexAttributes();
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
@@ -614,6 +671,7 @@ void drawPlane(const Plane* plane, Matrix4x4 viewMatrix, Matrix4x4 projMatrix) {
     GLint colorLoc = glGetUniformLocation(shaderProgram, "inputColor");
     glUniform4f(colorLoc, plane->color.x, plane->color.y, plane->color.z, plane->color.w);
 
+    applyVertexQuantization(shaderProgram, &plane->quantization);
     glBindVertexArray(plane->vao);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
     glBindVertexArray(0);
@@ -621,6 +679,8 @@ void drawPlane(const Plane* plane, Matrix4x4 viewMatrix, Matrix4x4 projMatrix) {
 
 void destroyPlane(Plane* plane) {
     glDeleteVertexArrays(1, &plane->vao);
+    untrackMemory(TRACKED_BUFFER, plane->vbo);
     glDeleteBuffers(1, &plane->vbo);
+    untrackMemory(TRACKED_BUFFER, plane->ebo);
     glDeleteBuffers(1, &plane->ebo);
 }
@@ -1,86 +1,451 @@
 #include "ModelLoad.h"
+#include "mesh_optimizer.h"
+#include "vertex_format.h"
+#include "asset_registry.h"
+#include "jobs.h"
+#include "logger.h"
+#include "allocators.h"
+#include "memory_accounting.h"
+#include "metrics.h"
+#include "Camera.h"
+#include <string.h>
+#include <stdint.h>
 
-Mesh processMesh(struct aiMesh* mesh, const struct aiScene* scene) {
-    Mesh newMesh = { 0 };
-    if (!mesh) return newMesh;
+typedef struct {
+    Vector3* positions;   // For simplification, optimisation and bounds
+    Vertex* vertices;     // Positions again, with normals and texture coordinates
+    PackedVertex* packed; // What is uploaded
+    VertexQuantization quantization;
+    bool hasNormals;
+    bool hasTexCoords;
+    unsigned int* indices;
+    unsigned short* shortIndices; // Copy of indices uploaded instead when every vertex fits in 16 bits
+    unsigned int numVertices;
+    unsigned int numIndices;   // Of level 0
+    unsigned int totalIndices; // Of every level
+    LodChain lod;
+    Vector3 boundsMin;
+    Vector3 boundsMax;
+    // Import optimisation report
+    unsigned int sourceVertices;
+    float acmrBefore; // Of level 0
+    float acmrAfter;
+} MeshImport;
 
-    glGenVertexArrays(1, &newMesh.VAO);
-    glGenBuffers(1, &newMesh.VBO);
-    glGenBuffers(1, &newMesh.EBO);
+// Models are created and destroyed as assets come and go; the struct itself is fixed size
+#define MODEL_POOL_SIZE 128
+static Pool modelPool = POOL_INITIALIZER(Model, MODEL_POOL_SIZE, "model");
 
-    glBindVertexArray(newMesh.VAO);
+struct ModelImport {
+    char path[MODEL_PATH_LENGTH];
+    MeshImport* meshes;
+    unsigned int meshCount;
+    ModelNode* nodes;
+    unsigned int nodeCount;
+    MeshInstance* instances;
+    unsigned int instanceCount;
+    Vector3 boundsMin;
+    Vector3 boundsMax;
+};
 
-    // Vertices
-    glBindBuffer(GL_ARRAY_BUFFER, newMesh.VBO);
-    glBufferData(GL_ARRAY_BUFFER, mesh->mNumVertices * sizeof(struct aiVector3D), mesh->mVertices, GL_STATIC_DRAW);
+typedef struct {
+    const char* path;
+    ModelImport* import;
+    Model* model;   // Set once uploaded; later duplicates of the path share it
+} ModelImportJob;
 
-    // Indices
-    newMesh.indices = malloc(mesh->mNumFaces * 3 * sizeof(unsigned int));
-    if (!newMesh.indices) {
-        fprintf(stderr, "Failed to allocate memory for indices.\n");
-        glDeleteVertexArrays(1, &newMesh.VAO);
-        glDeleteBuffers(1, &newMesh.VBO);
-        glDeleteBuffers(1, &newMesh.EBO);
-        return newMesh;
+// Cache order, then overdraw order when asked; the range is left as it was if a step fails
+static void reorderTriangles(MeshImport* out, unsigned int first, unsigned int count, bool overdraw) {
+    unsigned int* scratch = (unsigned int*)engineMalloc((count > 0 ? count : 1) * sizeof(unsigned int));
+    if (!scratch) return;
+    unsigned int* range = out->indices + first;
+    if (optimizeVertexCache(scratch, range, count, out->numVertices, MESH_CACHE_SIZE)) {
+        if (!overdraw || !optimizeOverdraw(range, scratch, count, out->positions, out->numVertices, MESH_OVERDRAW_THRESHOLD)) {
+            memcpy(range, scratch, count * sizeof(unsigned int));
+        }
     }
+    engineFree(scratch);
+}
+
+static void optimizeMesh(MeshImport* out) {
+    out->acmrBefore = computeAcmr(out->indices, out->numIndices, out->numVertices, MESH_CACHE_SIZE);
+    reorderTriangles(out, 0, out->numIndices, true);
+}
+
+static void* copyBuffer(const void* source, size_t size) {
+    void* copy = engineMalloc(size > 0 ? size : 1);
+    if (copy) memcpy(copy, source, size);
+    return copy;
+}
+
+// Fetch order works on copies and is committed only once both vertex streams
+// are remapped, so a failed step leaves the indices and vertices agreeing
+static void reorderVertices(MeshImport* out) {
+    unsigned int vertexCount = out->numVertices;
+    unsigned int* remap = (unsigned int*)engineMalloc((vertexCount > 0 ? vertexCount : 1) * sizeof(unsigned int));
+    unsigned int* indices = (unsigned int*)copyBuffer(out->indices, out->totalIndices * sizeof(unsigned int));
+    Vector3* positions = (Vector3*)copyBuffer(out->positions, vertexCount * sizeof(Vector3));
+    Vertex* vertices = (Vertex*)copyBuffer(out->vertices, vertexCount * sizeof(Vertex));
+
+    unsigned int remapped = remap && indices && positions && vertices ? optimizeVertexFetch(remap, indices, out->totalIndices, vertexCount) : 0;
+    if (remapped > 0 && remapVertexBuffer(positions, sizeof(Vector3), vertexCount, remap) &&
+        remapVertexBuffer(vertices, sizeof(Vertex), vertexCount, remap)) {
+        engineFree(out->indices);
+        engineFree(out->positions);
+        engineFree(out->vertices);
+        out->indices = indices;
+        out->positions = positions;
+        out->vertices = vertices;
+        out->numVertices = remapped;
+        indices = NULL;
+        positions = NULL;
+        vertices = NULL;
+    }
+    engineFree(remap);
+    engineFree(indices);
+    engineFree(positions);
+    engineFree(vertices);
+}
+
+// Simplified levels are only drawn small, so they get cache order but no overdraw sort.
+// Vertices are then renumbered across every level, which keeps level 0's first.
+static void optimizeMeshLevels(MeshImport* out) {
+    for (int level = 1; level < out->lod.levelCount; level++) {
+        reorderTriangles(out, out->lod.levels[level].firstIndex, out->lod.levels[level].indexCount, false);
+    }
+    reorderVertices(out);
+    out->acmrAfter = computeAcmr(out->indices, out->numIndices, out->numVertices, MESH_CACHE_SIZE);
+
+    // 0xFFFF is left out so it never collides with a primitive restart index
+    if (out->numVertices <= UINT16_MAX && out->totalIndices > 0) {
+        out->shortIndices = (unsigned short*)engineMalloc(out->totalIndices * sizeof(unsigned short));
+        for (unsigned int i = 0; out->shortIndices && i < out->totalIndices; i++) {
+            out->shortIndices[i] = (unsigned short)out->indices[i];
+        }
+    }
+}
+
+static bool importMesh(const struct aiMesh* mesh, MeshImport* out, bool optimize) {
+    out->positions = (Vector3*)engineMalloc((mesh->mNumVertices > 0 ? mesh->mNumVertices : 1) * sizeof(Vector3));
+    out->vertices = (Vertex*)engineCalloc(mesh->mNumVertices > 0 ? mesh->mNumVertices : 1, sizeof(Vertex));
+    out->indices = (unsigned int*)engineCalloc(mesh->mNumFaces > 0 ? mesh->mNumFaces * 3 : 1, sizeof(unsigned int));
+    if (!out->positions || !out->vertices || !out->indices) {
+        LOG_ERROR(LOG_ASSETS, "Failed to allocate memory for mesh data.");
+        return false;
+    }
+
+    for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+        out->positions[i] = (Vector3){ mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z };
+        Vertex* vertex = &out->vertices[i];
+        memcpy(vertex->position, &out->positions[i], sizeof(vertex->position));
+        if (mesh->mNormals) {
+            vertex->normal[0] = mesh->mNormals[i].x;
+            vertex->normal[1] = mesh->mNormals[i].y;
+            vertex->normal[2] = mesh->mNormals[i].z;
+        }
+        if (mesh->mTextureCoords[0]) {
+            vertex->texCoords[0] = mesh->mTextureCoords[0][i].x;
+            vertex->texCoords[1] = mesh->mTextureCoords[0][i].y;
+        }
+    }
+    out->hasNormals = mesh->mNormals != NULL;
+    out->hasTexCoords = mesh->mTextureCoords[0] != NULL;
     for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-        for (unsigned int j = 0; j < mesh->mFaces[i].mNumIndices; j++) {
-            newMesh.indices[i * mesh->mFaces[i].mNumIndices + j] = mesh->mFaces[i].mIndices[j];
+        for (unsigned int j = 0; j < mesh->mFaces[i].mNumIndices && j < 3; j++) {
+            out->indices[i * 3 + j] = mesh->mFaces[i].mIndices[j];
         }
     }
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, newMesh.EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh->mNumFaces * 3 * sizeof(unsigned int), newMesh.indices, GL_STATIC_DRAW);
+    out->numVertices = mesh->mNumVertices;
+    out->sourceVertices = mesh->mNumVertices;
+    out->numIndices = mesh->mNumFaces * 3;
+    if (optimize) {
+        optimizeMesh(out);
+    }
+    // Simplified levels are appended here, on the importing thread, so uploads stay cheap
+    out->totalIndices = buildLodChain(&out->indices, out->numIndices, out->positions, out->numVertices, &out->lod);
+    if (optimize) {
+        optimizeMeshLevels(out);
+    }
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(struct aiVector3D), (void*)0);
-    glEnableVertexAttribArray(0);
+    // Object-space bounds, used for culling
+    if (out->numVertices > 0) {
+        out->boundsMin = out->boundsMax = out->positions[0];
+    }
+    for (unsigned int i = 1; i < out->numVertices; i++) {
+        const Vector3* v = &out->positions[i];
+        out->boundsMin = (Vector3){ fminf(out->boundsMin.x, v->x), fminf(out->boundsMin.y, v->y), fminf(out->boundsMin.z, v->z) };
+        out->boundsMax = (Vector3){ fmaxf(out->boundsMax.x, v->x), fmaxf(out->boundsMax.y, v->y), fmaxf(out->boundsMax.z, v->z) };
+    }
 
-    glBindVertexArray(0);  // Unbind VAO
+    out->packed = (PackedVertex*)engineMalloc((out->numVertices > 0 ? out->numVertices : 1) * sizeof(PackedVertex));
+    if (!out->packed) {
+        LOG_ERROR(LOG_ASSETS, "Failed to allocate memory for mesh data.");
+        return false;
+    }
+    out->quantization = packVertices(out->packed, out->numVertices, out->vertices[0].position,
+                                     out->hasNormals ? out->vertices[0].normal : NULL,
+                                     out->hasTexCoords ? out->vertices[0].texCoords : NULL, sizeof(Vertex) / sizeof(float));
+    return true;
+}
 
-    newMesh.numVertices = mesh->mNumVertices;
-    newMesh.numIndices = mesh->mNumFaces * 3;
-    return newMesh;
+// assimp matrices are row-major; Matrix4x4 is indexed [column][row]
+static Matrix4x4 convertMatrix(const struct aiMatrix4x4* m) {
+    Matrix4x4 result = { {
+        { m->a1, m->b1, m->c1, m->d1 },
+        { m->a2, m->b2, m->c2, m->d2 },
+        { m->a3, m->b3, m->c3, m->d3 },
+        { m->a4, m->b4, m->c4, m->d4 }
+    } };
+    return result;
 }
 
+static unsigned int countNodes(const struct aiNode* node, unsigned int* meshReferences) {
+    unsigned int count = 1;
+    *meshReferences += node->mNumMeshes;
+    for (unsigned int i = 0; i < node->mNumChildren; i++) {
+        count += countNodes(node->mChildren[i], meshReferences);
+    }
+    return count;
+}
 
-Model* loadModel(const char* path) {
-    const struct aiScene* scene = aiImportFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+// Depth first, so every parent is stored before its children
+static void importNode(const struct aiNode* node, int parent, ModelImport* import) {
+    unsigned int index = import->nodeCount++;
+    ModelNode* out = &import->nodes[index];
+    out->parent = parent;
+    out->local = convertMatrix(&node->mTransformation);
+    // matrixMultiply(a, b) applies a first
+    out->transform = parent < 0 ? out->local : matrixMultiply(out->local, import->nodes[parent].transform);
+
+    for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+        if (node->mMeshes[i] >= import->meshCount) continue;
+        import->instances[import->instanceCount++] = (MeshInstance){ node->mMeshes[i], index };
+    }
+    for (unsigned int i = 0; i < node->mNumChildren; i++) {
+        importNode(node->mChildren[i], (int)index, import);
+    }
+}
+
+static Vector3 transformPoint(const Matrix4x4* m, Vector3 p) {
+    return (Vector3){
+        m->data[0][0] * p.x + m->data[1][0] * p.y + m->data[2][0] * p.z + m->data[3][0],
+        m->data[0][1] * p.x + m->data[1][1] * p.y + m->data[2][1] * p.z + m->data[3][1],
+        m->data[0][2] * p.x + m->data[1][2] * p.y + m->data[2][2] * p.z + m->data[3][2]
+    };
+}
+
+static bool importHierarchy(const struct aiScene* scene, ModelImport* import) {
+    unsigned int meshReferences = 0;
+    unsigned int nodeCount = scene->mRootNode ? countNodes(scene->mRootNode, &meshReferences) : 1;
+    // Files without node references still show every mesh, at the root
+    unsigned int instanceCapacity = meshReferences > 0 ? meshReferences : import->meshCount;
+    import->nodes = (ModelNode*)engineCalloc(nodeCount, sizeof(ModelNode));
+    import->instances = (MeshInstance*)engineCalloc(instanceCapacity, sizeof(MeshInstance));
+    if (!import->nodes || !import->instances) return false;
+
+    if (scene->mRootNode) {
+        importNode(scene->mRootNode, -1, import);
+    }
+    else {
+        import->nodes[0] = (ModelNode){ -1, identityMatrix(), identityMatrix() };
+        import->nodeCount = 1;
+    }
+    if (import->instanceCount == 0) {
+        for (unsigned int i = 0; i < import->meshCount; i++) {
+            import->instances[import->instanceCount++] = (MeshInstance){ i, 0 };
+        }
+    }
+
+    // Model bounds enclose each instance's mesh bounds in model space
+    for (unsigned int i = 0; i < import->instanceCount; i++) {
+        const MeshImport* mesh = &import->meshes[import->instances[i].mesh];
+        const Matrix4x4* transform = &import->nodes[import->instances[i].node].transform;
+        for (int corner = 0; corner < 8; corner++) {
+            Vector3 local = {
+                corner & 1 ? mesh->boundsMax.x : mesh->boundsMin.x,
+                corner & 2 ? mesh->boundsMax.y : mesh->boundsMin.y,
+                corner & 4 ? mesh->boundsMax.z : mesh->boundsMin.z
+            };
+            Vector3 p = transformPoint(transform, local);
+            if (i == 0 && corner == 0) {
+                import->boundsMin = import->boundsMax = p;
+                continue;
+            }
+            import->boundsMin = (Vector3){ fminf(import->boundsMin.x, p.x), fminf(import->boundsMin.y, p.y), fminf(import->boundsMin.z, p.z) };
+            import->boundsMax = (Vector3){ fmaxf(import->boundsMax.x, p.x), fmaxf(import->boundsMax.y, p.y), fmaxf(import->boundsMax.z, p.z) };
+        }
+    }
+    return true;
+}
+
+static void reportMeshOptimization(const ModelImport* import) {
+    double missesBefore = 0.0, missesAfter = 0.0;
+    unsigned long long triangles = 0, verticesBefore = 0, verticesAfter = 0;
+    unsigned int shortMeshes = 0;
+    for (unsigned int i = 0; i < import->meshCount; i++) {
+        const MeshImport* mesh = &import->meshes[i];
+        missesBefore += (double)mesh->acmrBefore * (mesh->numIndices / 3);
+        missesAfter += (double)mesh->acmrAfter * (mesh->numIndices / 3);
+        triangles += mesh->numIndices / 3;
+        verticesBefore += mesh->sourceVertices;
+        verticesAfter += mesh->numVertices;
+        if (mesh->shortIndices) shortMeshes++;
+    }
+    if (triangles == 0) return;
+    LOG_INFO(LOG_ASSETS, "Optimised %s: ACMR %.3f -> %.3f over %llu triangles, %llu -> %llu vertices, 16-bit indices in %u of %u meshes",
+             import->path, missesBefore / triangles, missesAfter / triangles, triangles, verticesBefore, verticesAfter,
+             shortMeshes, import->meshCount);
+}
+
+ModelImport* importModel(const char* path) {
+    double started = glfwGetTime();
+    // CLUE_MESH_OPTIMIZE=0 keeps the file's vertices and triangle order, for comparison
+    const char* optimizeSetting = getenv("CLUE_MESH_OPTIMIZE");
+    bool optimize = !(optimizeSetting && strcmp(optimizeSetting, "0") == 0);
+    unsigned int flags = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenSmoothNormals;
+    if (optimize) flags |= aiProcess_JoinIdenticalVertices;
+    const struct aiScene* scene = aiImportFile(path, flags);
     if (!scene) {
-        fprintf(stderr, "Failed to load model: %s\n", aiGetErrorString());
+        LOG_ERROR(LOG_ASSETS, "Failed to load model %s: %s", path, aiGetErrorString());
         return NULL;
     }
 
     if (scene->mNumMeshes == 0) {
-        fprintf(stderr, "No meshes found in the model.\n");
+        LOG_ERROR(LOG_ASSETS, "No meshes found in the model.");
         aiReleaseImport(scene);
         return NULL;
     }
 
-    Model* model = (Model*)malloc(sizeof(Model));
-    if (!model) {
-        fprintf(stderr, "Failed to allocate memory for the model.\n");
+    ModelImport* import = (ModelImport*)engineCalloc(1, sizeof(ModelImport));
+    if (import) {
+        import->meshes = (MeshImport*)engineCalloc(scene->mNumMeshes, sizeof(MeshImport));
+    }
+    if (!import || !import->meshes) {
+        LOG_ERROR(LOG_ASSETS, "Failed to allocate memory for the model.");
         aiReleaseImport(scene);
+        engineFree(import);
         return NULL;
     }
 
-    strncpy(model->path, path, sizeof(model->path) - 1);
-    model->path[sizeof(model->path) - 1] = '\0';
-    model->meshCount = scene->mNumMeshes;
-    model->meshes = (Mesh*)malloc(model->meshCount * sizeof(Mesh));
-    if (!model->meshes) {
-        fprintf(stderr, "Failed to allocate memory for meshes.\n");
+    strncpy(import->path, path, sizeof(import->path) - 1);
+    import->path[sizeof(import->path) - 1] = '\0';
+    import->meshCount = scene->mNumMeshes;
+    for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+        if (!importMesh(scene->mMeshes[i], &import->meshes[i], optimize)) {
+            aiReleaseImport(scene);
+            freeModelImport(import);
+            return NULL;
+        }
+    }
+    if (!importHierarchy(scene, import)) {
+        LOG_ERROR(LOG_ASSETS, "Failed to allocate memory for the node hierarchy of %s.", path);
         aiReleaseImport(scene);
-        free(model);
+        freeModelImport(import);
         return NULL;
     }
+    LOG_INFO(LOG_ASSETS, "Imported %s: %u meshes drawn as %u instances from %u nodes",
+             path, import->meshCount, import->instanceCount, import->nodeCount);
 
-    for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
-        model->meshes[i] = processMesh(scene->mMeshes[i], scene);
+    aiReleaseImport(scene);
+    if (optimize) {
+        reportMeshOptimization(import);
     }
+    observeAssetLoad(ASSET_MODEL, glfwGetTime() - started);
+    return import;
+}
 
-    aiReleaseImport(scene);
+void freeModelImport(ModelImport* import) {
+    if (!import) return;
+    for (unsigned int i = 0; i < import->meshCount; i++) {
+        engineFree(import->meshes[i].positions);
+        engineFree(import->meshes[i].vertices);
+        engineFree(import->meshes[i].packed);
+        engineFree(import->meshes[i].indices);
+        engineFree(import->meshes[i].shortIndices);
+    }
+    engineFree(import->meshes);
+    engineFree(import->nodes);
+    engineFree(import->instances);
+    engineFree(import);
+}
+
+static Mesh uploadMesh(MeshImport* meshImport, const char* owner) {
+    Mesh newMesh = { 0 };
+
+    glGenVertexArrays(1, &newMesh.VAO);
+    glGenBuffers(1, &newMesh.VBO);
+    glGenBuffers(1, &newMesh.EBO);
+
+    glBindVertexArray(newMesh.VAO);
+
+    // Vertices
+    glBindBuffer(GL_ARRAY_BUFFER, newMesh.VBO);
+    glBufferData(GL_ARRAY_BUFFER, meshImport->numVertices * sizeof(PackedVertex), meshImport->packed, GL_STATIC_DRAW);
+    trackMemory(TRACKED_BUFFER, newMesh.VBO, MEMORY_VERTEX_BUFFERS, meshImport->numVertices * sizeof(PackedVertex), owner);
+
+    // Indices
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, newMesh.EBO);
+    newMesh.indexType = meshImport->shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    size_t indexBytes = meshImport->totalIndices * (meshImport->shortIndices ? sizeof(unsigned short) : sizeof(unsigned int));
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes,
+                 meshImport->shortIndices ? (const void*)meshImport->shortIndices : (const void*)meshImport->indices, GL_STATIC_DRAW);
+    trackMemory(TRACKED_BUFFER, newMesh.EBO, MEMORY_INDEX_BUFFERS, indexBytes, owner);
+
+    bindPackedVertexAttributes();
+
+    glBindVertexArray(0);  // Unbind VAO
+
+    // The mesh keeps its indices; the import's copy moves over
+    newMesh.indices = meshImport->indices;
+    meshImport->indices = NULL;
+    if (newMesh.indices) {
+        trackMemory(TRACKED_HOST, (uintptr_t)newMesh.indices, MEMORY_MESH_INDICES, meshImport->totalIndices * sizeof(unsigned int), owner);
+    }
+    newMesh.numVertices = meshImport->numVertices;
+    newMesh.numIndices = meshImport->numIndices;
+    newMesh.lod = meshImport->lod;
+    newMesh.quantization = meshImport->quantization;
+    newMesh.boundsMin = meshImport->boundsMin;
+    newMesh.boundsMax = meshImport->boundsMax;
+    return newMesh;
+}
+
+Model* uploadModel(ModelImport* import) {
+    if (!import) return NULL;
+    Model* model = (Model*)poolAlloc(&modelPool);
+    Mesh* meshes = (Mesh*)engineMalloc(import->meshCount * sizeof(Mesh));
+    if (!model || !meshes) {
+        LOG_ERROR(LOG_ASSETS, "Failed to allocate memory for the model.");
+        poolFree(&modelPool, model);
+        engineFree(meshes);
+        freeModelImport(import);
+        return NULL;
+    }
+
+    memcpy(model->path, import->path, sizeof(model->path));
+    model->meshes = meshes;
+    model->meshCount = import->meshCount;
+    for (unsigned int i = 0; i < import->meshCount; i++) {
+        model->meshes[i] = uploadMesh(&import->meshes[i], import->path);
+    }
+    // The hierarchy moves over as it is
+    model->nodes = import->nodes;
+    model->nodeCount = import->nodeCount;
+    model->instances = import->instances;
+    model->instanceCount = import->instanceCount;
+    model->boundsMin = import->boundsMin;
+    model->boundsMax = import->boundsMax;
+    import->nodes = NULL;
+    import->instances = NULL;
+
+    freeModelImport(import);
     return model;
 }
 
+Model* loadModel(const char* path) {
+    return uploadModel(importModel(path));
+}
+
 
 void freeModel(Model* model) {
     if (!model) return;
@@ -93,22 +458,144 @@ void freeModel(Model* model) {
             mesh->VAO = 0;
         }
         if (mesh->VBO) {
+            untrackMemory(TRACKED_BUFFER, mesh->VBO);
             glDeleteBuffers(1, &mesh->VBO);
             mesh->VBO = 0;
         }
         if (mesh->EBO) {
+            untrackMemory(TRACKED_BUFFER, mesh->EBO);
             glDeleteBuffers(1, &mesh->EBO);
             mesh->EBO = 0;
         }
         if (mesh->indices) {
-            free(mesh->indices);
+            untrackMemory(TRACKED_HOST, (uintptr_t)mesh->indices);
+            engineFree(mesh->indices);
             mesh->indices = NULL;
         }
     }
 
     if (model->meshes) {
-        free(model->meshes);
+        engineFree(model->meshes);
         model->meshes = NULL;
     }
+    engineFree(model->nodes);
+    engineFree(model->instances);
+    model->nodes = NULL;
+    model->instances = NULL;
+    model->nodeCount = model->instanceCount = 0;
+}
+
+static void destroyModelAsset(void* data) {
+    Model* model = (Model*)data;
+    freeModel(model);
+    poolFree(&modelPool, model);
+}
+
+// Keyed by Model.path, which is what objects carry around
+static void modelKey(const char* path, char* key) {
+    strncpy(key, path, MODEL_PATH_LENGTH - 1);
+    key[MODEL_PATH_LENGTH - 1] = '\0';
+}
+
+static Model* findModel(const char* path) {
+    char key[MODEL_PATH_LENGTH];
+    modelKey(path, key);
+    AssetHandle handle = findAsset(ASSET_MODEL, key);
+    if (!handle) return NULL;
+    acquireAsset(handle);
+    return (Model*)getAssetData(handle);
+}
+
+static Model* registerModel(Model* model) {
+    if (!model) return NULL;
+    if (!registerAsset(ASSET_MODEL, model->path, model, destroyModelAsset)) {
+        destroyModelAsset(model);
+        return NULL;
+    }
+    return model;
+}
+
+static void importModelJob(void* data) {
+    ModelImportJob* job = (ModelImportJob*)data;
+    job->import = importModel(job->path);
+}
+
+Model* acquireModel(const char* path) {
+    Model* model = findModel(path);
+    return model ? model : registerModel(loadModel(path));
+}
+
+void acquireModels(const char* const* paths, int count, Model** models) {
+    if (count <= 0) return;
+    ModelImportJob* imports = (ModelImportJob*)engineCalloc(count, sizeof(ModelImportJob));
+    Job* jobs = (Job*)engineMalloc(count * sizeof(Job));
+    int* importIndex = (int*)engineMalloc(count * sizeof(int));
+    if (!imports || !jobs || !importIndex) {
+        // Fall back to resolving one at a time
+        for (int i = 0; i < count; i++) {
+            models[i] = paths[i] ? acquireModel(paths[i]) : NULL;
+        }
+        engineFree(imports);
+        engineFree(jobs);
+        engineFree(importIndex);
+        return;
+    }
+
+    // Phase one: every distinct path that is not loaded yet is imported on a worker
+    int importCount = 0;
+    for (int i = 0; i < count; i++) {
+        models[i] = NULL;
+        importIndex[i] = -1;
+        if (!paths[i]) continue;
+        models[i] = findModel(paths[i]);
+        if (models[i]) continue;
+
+        for (int j = 0; j < importCount; j++) {
+            if (strncmp(imports[j].path, paths[i], MODEL_PATH_LENGTH - 1) == 0) {
+                importIndex[i] = j;
+                break;
+            }
+        }
+        if (importIndex[i] < 0) {
+            imports[importCount].path = paths[i];
+            jobs[importCount] = (Job){ importModelJob, &imports[importCount], NULL };
+            importIndex[i] = importCount++;
+        }
+    }
+
+    if (importCount == 1) {
+        importModelJob(&imports[0]);
+    }
+    else if (importCount > 1) {
+        JobCounter counter = { 0 };
+        runJobs(jobs, importCount, &counter);
+        waitForCounter(&counter); // The main thread imports too while it waits
+    }
+
+    // Phase two: GL buffers are created here, once per distinct model
+    for (int i = 0; i < count; i++) {
+        if (importIndex[i] < 0) continue;
+        ModelImportJob* job = &imports[importIndex[i]];
+        if (job->import) {
+            job->model = registerModel(uploadModel(job->import));
+            job->import = NULL;
+            models[i] = job->model; // The registration's reference
+        }
+        else if (job->model) {
+            retainModel(job->model);
+            models[i] = job->model;
+        }
+    }
+
+    engineFree(imports);
+    engineFree(jobs);
+    engineFree(importIndex);
+}
+
+void retainModel(const Model* model) {
+    acquireAsset(findAsset(ASSET_MODEL, model->path));
 }
 
+void releaseModel(const Model* model) {
+    releaseAsset(findAsset(ASSET_MODEL, model->path));
+}
@@ -11,8 +11,14 @@
 #include "gui.h"
 #include "SceneObject.h"
 #include "Object3D.h"
+#include "asset_registry.h"
+#include "change_journal.h"
+#include "transform_hierarchy.h"
+#include "logger.h"
+#include "allocators.h"
 
 ObjectManager objectManager;
+unsigned int sceneGeneration = 0;
 
 void initObjectManager() {
     objectManager.count = 0;
@@ -22,11 +28,100 @@ void initObjectManager() {
     }
 }
 
-void addObjectToManager(SceneObject newObject) {
+bool addObjectToManager(SceneObject newObject) {
     static int currentID = 0; // Static variable to keep track of unique IDs
     if (objectManager.count < MAX_OBJECTS) {
         newObject.id = currentID++; // Assign a unique ID to the new object
         objectManager.objects[objectManager.count++] = newObject;
+        markHierarchyChanged();
+        return true;
+    }
+    return false;
+}
+
+static const char* primitiveKey(ObjectType type) {
+    switch (type) {
+    case OBJ_CUBE: return "primitive:cube";
+    case OBJ_SPHERE: return "primitive:sphere";
+    case OBJ_PYRAMID: return "primitive:pyramid";
+    case OBJ_CYLINDER: return "primitive:cylinder";
+    case OBJ_PLANE: return "primitive:plane";
+    default: return NULL;
+    }
+}
+
+static void destroyCubeAsset(void* data) { destroyCube((Cube*)data); engineFree(data); }
+static void destroySphereAsset(void* data) { destroySphere((Sphere*)data); engineFree(data); }
+static void destroyPyramidAsset(void* data) { destroyPyramid((Pyramid*)data); engineFree(data); }
+static void destroyCylinderAsset(void* data) { destroyCylinder((Cylinder*)data); engineFree(data); }
+static void destroyPlaneAsset(void* data) { destroyPlane((Plane*)data); engineFree(data); }
+
+// Every primitive of a type uses the same geometry, so they share one set of buffers
+static const void* acquirePrimitive(ObjectType type, Vector3 position, Vector4 color) {
+    const char* key = primitiveKey(type);
+    AssetHandle handle = findAsset(ASSET_MESH, key);
+    if (handle) {
+        acquireAsset(handle);
+        return getAssetData(handle);
+    }
+
+    void* data = NULL;
+    AssetDestroyFunction destroy = NULL;
+    switch (type) {
+    case OBJ_CUBE:
+        data = engineMalloc(sizeof(Cube));
+        if (data) *(Cube*)data = createCube(position, color, 1.0f);
+        destroy = destroyCubeAsset;
+        break;
+    case OBJ_SPHERE:
+        data = engineMalloc(sizeof(Sphere));
+        if (data) *(Sphere*)data = createSphere(1.0f, 20, 20, position, color);
+        destroy = destroySphereAsset;
+        break;
+    case OBJ_PYRAMID:
+        data = engineMalloc(sizeof(Pyramid));
+        if (data) *(Pyramid*)data = createPyramid(position, color, 1.0f, 1.0f);
+        destroy = destroyPyramidAsset;
+        break;
+    case OBJ_CYLINDER:
+        data = engineMalloc(sizeof(Cylinder));
+        if (data) *(Cylinder*)data = createCylinder(1.0f, 2.0f, 20, position, color);
+        destroy = destroyCylinderAsset;
+        break;
+    case OBJ_PLANE:
+        data = engineMalloc(sizeof(Plane));
+        if (data) *(Plane*)data = createPlane(position, color);
+        destroy = destroyPlaneAsset;
+        break;
+    default:
+        return NULL;
+    }
+    if (!data) {
+        LOG_ERROR(LOG_SCENE, "Failed to allocate primitive mesh.");
+        return NULL;
+    }
+    if (!registerAsset(ASSET_MESH, key, data, destroy)) {
+        destroy(data);
+        return NULL;
+    }
+    return data;
+}
+
+void retainObjectAssets(const SceneObject* obj) {
+    if (obj->object.type == OBJ_MODEL) {
+        retainModel(&obj->object.data.model);
+    }
+    else {
+        acquireAsset(findAsset(ASSET_MESH, primitiveKey(obj->object.type)));
+    }
+}
+
+void releaseObjectAssets(const SceneObject* obj) {
+    if (obj->object.type == OBJ_MODEL) {
+        releaseModel(&obj->object.data.model);
+    }
+    else {
+        releaseAsset(findAsset(ASSET_MESH, primitiveKey(obj->object.type)));
     }
 }
 
@@ -53,82 +148,75 @@ void addObject(Camera* camera, ObjectType type, bool useTexture, int textureInde
     newObject.scale = (Vector3){ 1.0f, 1.0f, 1.0f };
     newObject.color = (Vector4){ 1.0f, 1.0f, 1.0f, 1.0f }; // Default to white color
     newObject.selected = false;
+    newObject.parentId = -1;
 
-    switch (type) {
-    case OBJ_CUBE:
-        newObject.object.data.cube = createCube(newObject.position, newObject.color, 1.0f);
-        break;
-    case OBJ_SPHERE:
-        newObject.object.data.sphere = createSphere(1.0f, 20, 20, newObject.position, newObject.color);
-        break;
-    case OBJ_PYRAMID:
-        newObject.object.data.pyramid = createPyramid(newObject.position, newObject.color, 1.0f, 1.0f);
-        break;
-    case OBJ_CYLINDER:
-        newObject.object.data.cylinder = createCylinder(1.0f, 2.0f, 20, newObject.position, newObject.color);
-        break;
-    case OBJ_PLANE:
-        newObject.object.data.plane = createPlane(newObject.position, newObject.color);
-        break;
-    case OBJ_MODEL:
-        if (model) {
-            newObject.object.data.model = *model;
-            newObject.object.data.model.meshes = (Mesh*)malloc(model->meshCount * sizeof(Mesh));
-            for (unsigned int i = 0; i < model->meshCount; i++) {
-                newObject.object.data.model.meshes[i] = model->meshes[i];
-            }
-            newObject.object.data.model.meshCount = model->meshCount;
+    if (type == OBJ_MODEL) {
+        if (!model) return;
+        // The object references the shared meshes instead of copying them
+        newObject.object.data.model = *model;
+        retainModel(model);
+    }
+    else {
+        const void* primitive = acquirePrimitive(type, newObject.position, newObject.color);
+        if (!primitive) return;
+        switch (type) {
+        case OBJ_CUBE:
+            newObject.object.data.cube = *(const Cube*)primitive;
+            newObject.object.data.cube.position = newObject.position;
+            break;
+        case OBJ_SPHERE:
+            newObject.object.data.sphere = *(const Sphere*)primitive;
+            newObject.object.data.sphere.position = newObject.position;
+            break;
+        case OBJ_PYRAMID:
+            newObject.object.data.pyramid = *(const Pyramid*)primitive;
+            newObject.object.data.pyramid.position = newObject.position;
+            break;
+        case OBJ_CYLINDER:
+            newObject.object.data.cylinder = *(const Cylinder*)primitive;
+            newObject.object.data.cylinder.position = newObject.position;
+            break;
+        case OBJ_PLANE:
+            newObject.object.data.plane = *(const Plane*)primitive;
+            newObject.object.data.plane.position = newObject.position;
+            break;
+        default:
+            break;
         }
-        break;
     }
 
-    addObjectToManager(newObject);
+    if (!addObjectToManager(newObject)) {
+        releaseObjectAssets(&newObject);
+    }
 }
 
 void removeObject(int index) {
     if (index < 0 || index >= objectManager.count) {
-        printf("Invalid index: %d\n", index);
+        LOG_WARN(LOG_SCENE, "Invalid index: %d", index);
         return;
     }
 
-    printf("Removing object at index: %d\n", index);
+    LOG_DEBUG(LOG_SCENE, "Removing object at index: %d", index);
 
     SceneObject* obj = &objectManager.objects[index];
 
-    switch (obj->object.type) {
-    case OBJ_CUBE:
-        printf("Destroying cube at index: %d\n", index);
-        destroyCube(&obj->object.data.cube);
-        break;
-    case OBJ_SPHERE:
-        printf("Destroying sphere at index: %d\n", index);
-        destroySphere(&obj->object.data.sphere);
-        break;
-    case OBJ_PYRAMID:
-        printf("Destroying pyramid at index: %d\n", index);
-        destroyPyramid(&obj->object.data.pyramid);
-        break;
-    case OBJ_CYLINDER:
-        printf("Destroying cylinder at index: %d\n", index);
-        destroyCylinder(&obj->object.data.cylinder);
-        break;
-    case OBJ_PLANE:
-        printf("Destroying plane at index: %d\n", index);
-        destroyPlane(&obj->object.data.plane);
-        break;
-    case OBJ_MODEL:
-        printf("Freeing model at index: %d\n", index);
-        freeModel(&obj->object.data.model);
-        break;
-    default:
-        printf("Unknown object type at index: %d\n", index);
-        break;
+    // Shared meshes are destroyed by the registry once nothing references them
+    releaseObjectAssets(obj);
+
+    sceneGeneration++; // Snapshots still referencing the freed buffers are now stale
+
+    // Children keep their local transforms under the removed object's parent
+    for (int i = 0; i < objectManager.count; i++) {
+        if (objectManager.objects[i].parentId == obj->id) {
+            objectManager.objects[i].parentId = obj->parentId;
+        }
     }
+    markHierarchyChanged();
 
     // Shift objects down in the array to fill the gap
     for (int i = index; i < objectManager.count - 1; ++i) {
         objectManager.objects[i] = objectManager.objects[i + 1];
-        printf("Shifting object from index %d to %d\n", i + 1, i);
+        LOG_TRACE(LOG_SCENE, "Shifting object from index %d to %d", i + 1, i);
     }
 
     // Decrement the count of objects after shifting
@@ -136,28 +224,64 @@ void removeObject(int index) {
 
     // Clear the last object 
     objectManager.objects[objectManager.count].id = -1;
-    printf("Object count after removal: %d\n", objectManager.count);
+    LOG_DEBUG(LOG_SCENE, "Object count after removal: %d", objectManager.count);
 
     // Update selected object if necessary
     if (selected_object == obj) {
         selected_object = NULL;
-        printf("Selected object was removed. Clearing selection.\n");
+        LOG_DEBUG(LOG_SCENE, "Selected object was removed. Clearing selection.");
     }
 }
+
+// Objects are only ever appended and removals keep their order, so IDs increase with the index
+int findObjectIndex(int id) {
+    int low = 0, high = objectManager.count - 1;
+    while (low <= high) {
+        int middle = (low + high) / 2;
+        int middleId = objectManager.objects[middle].id;
+        if (middleId == id) return middle;
+        if (middleId < id) low = middle + 1;
+        else high = middle - 1;
+    }
+    return -1;
+}
+
+bool setObjectParent(int index, int parentIndex) {
+    if (index < 0 || index >= objectManager.count || parentIndex >= objectManager.count) return false;
+    SceneObject* obj = &objectManager.objects[index];
+    int parentId = parentIndex >= 0 ? objectManager.objects[parentIndex].id : -1;
+    if (obj->parentId == parentId) return true;
+
+    // The new parent may not be the object itself or one of its descendants
+    for (int ancestor = parentIndex; ancestor >= 0;) {
+        if (ancestor == index) {
+            LOG_WARN(LOG_SCENE, "Object %d cannot be parented to its own descendant.", obj->id);
+            return false;
+        }
+        int ancestorParent = objectManager.objects[ancestor].parentId;
+        ancestor = ancestorParent >= 0 ? findObjectIndex(ancestorParent) : -1;
+    }
+
+    obj->parentId = parentId;
+    markHierarchyChanged();
+    return true;
+}
+
 void cleanupObjects() {
-    for (int i = 0; i < objectManager.count; i++) {
-        removeObject(i);
+    while (objectManager.count > 0) {
+        removeObject(objectManager.count - 1);
     }
-    objectManager.count = 0;
 }
 
 void updateObjectInManager(SceneObject* updatedObject) {
     for (int i = 0; i < objectManager.count; i++) {
         if (objectManager.objects[i].id == updatedObject->id) {
             objectManager.objects[i] = *updatedObject;
+            markTransformDirty(i);
 
-
-            printf("Updated object in manager: ID=%d, Index=%d\n", updatedObject->id, i);
+            LOG_TRACE(LOG_SCENE, "Updated object in manager: ID=%d, Index=%d", updatedObject->id, i);
+            journalObjectSurface(i);
+            journalObjectColor(i);
 
             // Update the selected_object pointer if necessary
             if (selected_object && selected_object->id == updatedObject->id) {
@@ -168,6 +292,51 @@ void updateObjectInManager(SceneObject* updatedObject) {
     }
 }
 
+// Relative to the object's parent; world matrices come from the transform hierarchy
+Matrix4x4 computeModelMatrix(const SceneObject* obj) {
+    Matrix4x4 modelMatrix = translateMatrix(obj->position);
+    modelMatrix = matrixMultiply(modelMatrix, rotateMatrix(obj->rotation.x, (Vector3) { 1.0f, 0.0f, 0.0f }));
+    modelMatrix = matrixMultiply(modelMatrix, rotateMatrix(obj->rotation.y, (Vector3) { 0.0f, 1.0f, 0.0f }));
+    modelMatrix = matrixMultiply(modelMatrix, rotateMatrix(obj->rotation.z, (Vector3) { 0.0f, 0.0f, 1.0f }));
+    modelMatrix = matrixMultiply(modelMatrix, scaleMatrix(obj->scale));
+    return modelMatrix;
+}
+
+// Object-space bounding sphere matching the geometry built in addObject()
+void getObjectLocalBounds(const SceneObject* obj, Vector3* center, float* radius) {
+    *center = (Vector3){ 0.0f, 0.0f, 0.0f };
+    switch (obj->object.type) {
+    case OBJ_CUBE:
+        *radius = 0.8661f; // Unit cube
+        break;
+    case OBJ_SPHERE:
+        *radius = 1.0f;
+        break;
+    case OBJ_PYRAMID:
+        *center = (Vector3){ 0.0f, 0.5f, 0.0f };
+        *radius = 0.8661f;
+        break;
+    case OBJ_CYLINDER: {
+        const Cylinder* cylinder = &obj->object.data.cylinder;
+        float halfHeight = cylinder->height * 0.5f;
+        *radius = sqrtf(cylinder->radius * cylinder->radius + halfHeight * halfHeight);
+        break;
+    }
+    case OBJ_PLANE:
+        *radius = 212.14f; // 300 x 300 quad
+        break;
+    case OBJ_MODEL: {
+        const Model* model = &obj->object.data.model;
+        *center = vector_scale(vector_add(model->boundsMin, model->boundsMax), 0.5f);
+        *radius = vector_length(vector_sub(model->boundsMax, *center));
+        break;
+    }
+    default:
+        *radius = 1.0f;
+        break;
+    }
+}
+
 void drawObject(const SceneObject* obj, const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix) {
     glUseProgram(shaderProgram);
 
@@ -175,11 +344,7 @@ void drawObject(const SceneObject* obj, const Matrix4x4 viewMatrix, const Matrix
     int viewLoc = glGetUniformLocation(shaderProgram, "view");
     int projLoc = glGetUniformLocation(shaderProgram, "projection");
 
-    Matrix4x4 modelMatrix = translateMatrix(obj->position);
-    modelMatrix = matrixMultiply(modelMatrix, rotateMatrix(obj->rotation.x, (Vector3) { 1.0f, 0.0f, 0.0f }));
-    modelMatrix = matrixMultiply(modelMatrix, rotateMatrix(obj->rotation.y, (Vector3) { 0.0f, 1.0f, 0.0f }));
-    modelMatrix = matrixMultiply(modelMatrix, rotateMatrix(obj->rotation.z, (Vector3) { 0.0f, 0.0f, 1.0f }));
-    modelMatrix = matrixMultiply(modelMatrix, scaleMatrix(obj->scale));
+    Matrix4x4 modelMatrix = *getWorldTransform((int)(obj - objectManager.objects));
 
     glUniformMatrix4fv(modelLoc, 1, GL_FALSE, &modelMatrix.data[0][0]);
     glUniformMatrix4fv(viewLoc, 1, GL_FALSE, &viewMatrix.data[0][0]);
@@ -195,28 +360,36 @@ void drawObject(const SceneObject* obj, const Matrix4x4 viewMatrix, const Matrix
 
     switch (obj->object.type) {
     case OBJ_CUBE:
+        applyVertexQuantization(shaderProgram, &obj->object.data.cube.quantization);
         glBindVertexArray(obj->object.data.cube.vao);
         glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
         break;
     case OBJ_SPHERE:
+        applyVertexQuantization(shaderProgram, &obj->object.data.sphere.quantization);
         glBindVertexArray(obj->object.data.sphere.vao);
         glDrawElements(GL_TRIANGLES, obj->object.data.sphere.numIndices, GL_UNSIGNED_INT, 0);
         break;
     case OBJ_PYRAMID:
+        applyVertexQuantization(shaderProgram, &obj->object.data.pyramid.quantization);
         glBindVertexArray(obj->object.data.pyramid.vao);
         glDrawElements(GL_TRIANGLES, 18, GL_UNSIGNED_INT, 0);
         break;
     case OBJ_CYLINDER:
+        applyVertexQuantization(shaderProgram, &obj->object.data.cylinder.quantization);
         glBindVertexArray(obj->object.data.cylinder.vao);
         glDrawElements(GL_TRIANGLES, obj->object.data.cylinder.sectorCount * 12, GL_UNSIGNED_INT, 0);
         break;
     case OBJ_PLANE:
+        applyVertexQuantization(shaderProgram, &obj->object.data.plane.quantization);
         glBindVertexArray(obj->object.data.plane.vao);
         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
         break;
     case OBJ_MODEL:
-        for (unsigned int i = 0; i < obj->object.data.model.meshCount; i++) {
-            drawMesh(&obj->object.data.model.meshes[i]);
+        for (unsigned int i = 0; i < obj->object.data.model.instanceCount; i++) {
+            const MeshInstance* instance = &obj->object.data.model.instances[i];
+            Matrix4x4 instanceMatrix = matrixMultiply(obj->object.data.model.nodes[instance->node].transform, modelMatrix);
+            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, &instanceMatrix.data[0][0]);
+            drawMesh(&obj->object.data.model.meshes[instance->mesh]);
         }
         break;
     }
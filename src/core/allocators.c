@@ -0,0 +1,179 @@
+#include "allocators.h"
+#include "logger.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#if defined(_WIN32)
+    #include <malloc.h>
+    #define usableSize(block) _msize(block)
+#elif defined(__APPLE__)
+    #include <malloc/malloc.h>
+    #define usableSize(block) malloc_size(block)
+#else
+    #include <malloc.h>
+    #define usableSize(block) malloc_usable_size(block)
+#endif
+
+#define POOL_ALIGNMENT 16
+
+static atomic_ullong allocationCount = 0;
+static atomic_ullong freeCount = 0;
+static atomic_ullong liveBytes = 0;  // Usable size of every live block, so frees need no size
+static atomic_ullong peakBytes = 0;
+static unsigned long long frameStart = 0;
+static unsigned long long lastFrameAllocations = 0;
+static _Atomic(AllocationHook) allocationHook = NULL;
+static void* _Atomic hookUser = NULL;
+
+static Pool* pools = NULL; // Every pool that has storage, for shutdown
+
+static void countAllocation(size_t size) {
+    atomic_fetch_add_explicit(&allocationCount, 1, memory_order_relaxed);
+    AllocationHook hook = atomic_load_explicit(&allocationHook, memory_order_acquire);
+    if (hook) hook(size, atomic_load_explicit(&hookUser, memory_order_relaxed));
+}
+
+static void addLiveBytes(void* block) {
+    if (!block) return;
+    unsigned long long live = atomic_fetch_add_explicit(&liveBytes, usableSize(block), memory_order_relaxed) + usableSize(block);
+    unsigned long long peak = atomic_load_explicit(&peakBytes, memory_order_relaxed);
+    while (live > peak && !atomic_compare_exchange_weak_explicit(&peakBytes, &peak, live, memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+void* engineMalloc(size_t size) {
+    countAllocation(size);
+    void* block = malloc(size);
+    addLiveBytes(block);
+    return block;
+}
+
+void* engineCalloc(size_t count, size_t size) {
+    countAllocation(count * size);
+    void* block = calloc(count, size);
+    addLiveBytes(block);
+    return block;
+}
+
+void* engineRealloc(void* block, size_t size) {
+    countAllocation(size);
+    size_t oldSize = block ? usableSize(block) : 0;
+    void* resized = realloc(block, size);
+    if (resized) {
+        atomic_fetch_sub_explicit(&liveBytes, oldSize, memory_order_relaxed);
+        addLiveBytes(resized);
+    }
+    return resized;
+}
+
+char* engineStrdup(const char* text) {
+    size_t length = strlen(text) + 1;
+    char* copy = (char*)engineMalloc(length);
+    if (copy) memcpy(copy, text, length);
+    return copy;
+}
+
+void engineFree(void* block) {
+    if (!block) return;
+    atomic_fetch_add_explicit(&freeCount, 1, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&liveBytes, usableSize(block), memory_order_relaxed);
+    free(block);
+}
+
+void setAllocationHook(AllocationHook hook, void* user) {
+    atomic_store_explicit(&hookUser, user, memory_order_relaxed);
+    atomic_store_explicit(&allocationHook, hook, memory_order_release);
+}
+
+void getAllocationStats(AllocationStats* stats) {
+    stats->allocations = atomic_load(&allocationCount);
+    stats->frees = atomic_load(&freeCount);
+    stats->frameAllocations = lastFrameAllocations;
+    stats->liveBytes = atomic_load(&liveBytes);
+    stats->peakBytes = atomic_load(&peakBytes);
+}
+
+void endAllocationFrame() {
+    unsigned long long count = atomic_load(&allocationCount);
+    lastFrameAllocations = count - frameStart;
+    frameStart = count;
+    if (lastFrameAllocations > 0) {
+        LOG_DEBUG(LOG_CORE, "Frame made %llu heap allocations.", lastFrameAllocations);
+    }
+}
+
+static bool createPoolStorage(Pool* pool) {
+    size_t size = pool->blockSize < sizeof(void*) ? sizeof(void*) : pool->blockSize;
+    pool->blockSize = (size + POOL_ALIGNMENT - 1) & ~(size_t)(POOL_ALIGNMENT - 1);
+    pool->storage = (unsigned char*)engineMalloc(pool->blockSize * (size_t)pool->capacity);
+    if (!pool->storage) {
+        LOG_ERROR(LOG_CORE, "Failed to allocate the %s pool.", pool->name);
+        return false;
+    }
+
+    // Thread every block onto the free list, lowest address first
+    pool->freeList = NULL;
+    for (int i = pool->capacity - 1; i >= 0; i--) {
+        void* block = pool->storage + (size_t)i * pool->blockSize;
+        *(void**)block = pool->freeList;
+        pool->freeList = block;
+    }
+    pool->next = pools;
+    pools = pool;
+    return true;
+}
+
+static bool ownsBlock(const Pool* pool, const void* block) {
+    uintptr_t address = (uintptr_t)block;
+    uintptr_t start = (uintptr_t)pool->storage;
+    return pool->storage && address >= start && address < start + pool->blockSize * (size_t)pool->capacity;
+}
+
+void* poolAlloc(Pool* pool) {
+    if (!pool->storage && pool->capacity > 0) {
+        createPoolStorage(pool);
+    }
+    if (pool->freeList) {
+        void* block = pool->freeList;
+        pool->freeList = *(void**)block;
+        pool->used++;
+        return block;
+    }
+
+    void* block = engineMalloc(pool->blockSize);
+    if (block) {
+        if (pool->overflow == 0) {
+            LOG_WARN(LOG_CORE, "The %s pool is full (%d blocks); using the heap.", pool->name, pool->capacity);
+        }
+        pool->overflow++;
+    }
+    return block;
+}
+
+void poolFree(Pool* pool, void* block) {
+    if (!block) return;
+    if (!ownsBlock(pool, block)) {
+        engineFree(block);
+        pool->overflow--;
+        return;
+    }
+    *(void**)block = pool->freeList;
+    pool->freeList = block;
+    pool->used--;
+}
+
+void shutdownAllocators() {
+    while (pools) {
+        Pool* pool = pools;
+        pools = pool->next;
+        if (pool->used > 0 || pool->overflow > 0) {
+            LOG_WARN(LOG_CORE, "The %s pool still has %d blocks in use at shutdown.", pool->name, pool->used + pool->overflow);
+        }
+        engineFree(pool->storage);
+        pool->storage = NULL;
+        pool->freeList = NULL;
+        pool->used = 0;
+        pool->next = NULL;
+    }
+}
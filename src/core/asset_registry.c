@@ -0,0 +1,310 @@
+#include "asset_registry.h"
+#include "logger.h"
+#include "allocators.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ASSET_LOOKUP_SIZE 16384 // Power of two, room for every asset plus aliases
+#define INTERN_INITIAL_SIZE 1024
+
+typedef struct {
+    AssetType type;
+    const char* key;
+    void* data;
+    AssetDestroyFunction destroy;
+    int refCount;
+    uint16_t generation;
+    bool used;
+    bool pendingDestroy;
+    bool queued; // In pendingDestroys
+    unsigned long long releaseFrame;
+} AssetEntry;
+
+typedef struct {
+    const char* key; // Interned, so compared by pointer
+    int type;
+    int index;       // Entry index + 1; 0 = empty, -1 = removed
+} AssetLookup;
+
+static AssetEntry assets[MAX_ASSETS];
+static AssetLookup lookup[ASSET_LOOKUP_SIZE];
+static int freeSlots[MAX_ASSETS];
+static int freeSlotCount = 0;
+static int pendingDestroys[MAX_ASSETS];
+static int pendingCount = 0;
+static unsigned long long assetFrame = 0;
+static bool initialized = false;
+
+static char** internTable = NULL;
+static size_t internCapacity = 0;
+static size_t internCount = 0;
+
+static uint32_t hashString(const char* text) {
+    uint32_t hash = 2166136261u;
+    while (*text) {
+        hash ^= (unsigned char)*text++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t hashKey(AssetType type, const char* key) {
+    uintptr_t value = (uintptr_t)key;
+    uint32_t hash = (uint32_t)(value ^ (value >> 32)) * 2654435761u;
+    return hash ^ ((uint32_t)type * 0x9E3779B9u);
+}
+
+static const char* findInterned(const char* text) {
+    if (!internTable) return NULL;
+    size_t mask = internCapacity - 1;
+    for (size_t slot = hashString(text) & mask; internTable[slot]; slot = (slot + 1) & mask) {
+        if (strcmp(internTable[slot], text) == 0) return internTable[slot];
+    }
+    return NULL;
+}
+
+static bool growInternTable() {
+    size_t newCapacity = internCapacity ? internCapacity * 2 : INTERN_INITIAL_SIZE;
+    char** table = (char**)engineCalloc(newCapacity, sizeof(char*));
+    if (!table) return false;
+    for (size_t i = 0; i < internCapacity; i++) {
+        if (!internTable[i]) continue;
+        size_t slot = hashString(internTable[i]) & (newCapacity - 1);
+        while (table[slot]) slot = (slot + 1) & (newCapacity - 1);
+        table[slot] = internTable[i];
+    }
+    engineFree(internTable);
+    internTable = table;
+    internCapacity = newCapacity;
+    return true;
+}
+
+const char* internString(const char* text) {
+    if (!text) return NULL;
+    const char* existing = findInterned(text);
+    if (existing) return existing;
+
+    if ((internCount + 1) * 2 > internCapacity && !growInternTable()) {
+        LOG_ERROR(LOG_ASSETS, "Failed to grow the string intern table.");
+        return NULL;
+    }
+    char* copy = engineStrdup(text);
+    if (!copy) return NULL;
+    size_t slot = hashString(text) & (internCapacity - 1);
+    while (internTable[slot]) slot = (slot + 1) & (internCapacity - 1);
+    internTable[slot] = copy;
+    internCount++;
+    return copy;
+}
+
+static AssetEntry* resolve(AssetHandle handle) {
+    int index = (int)(handle & 0xFFFF) - 1;
+    if (index < 0 || index >= MAX_ASSETS) return NULL;
+    AssetEntry* entry = &assets[index];
+    if (!entry->used || entry->generation != (uint16_t)(handle >> 16)) return NULL;
+    return entry;
+}
+
+static AssetHandle makeHandle(int index) {
+    return ((AssetHandle)assets[index].generation << 16) | (AssetHandle)(index + 1);
+}
+
+static int findLookupSlot(AssetType type, const char* key) {
+    uint32_t slot = hashKey(type, key) & (ASSET_LOOKUP_SIZE - 1);
+    for (int probe = 0; probe < ASSET_LOOKUP_SIZE; probe++) {
+        if (lookup[slot].index == 0) return -1;
+        if (lookup[slot].index > 0 && lookup[slot].key == key && lookup[slot].type == (int)type) return (int)slot;
+        slot = (slot + 1) & (ASSET_LOOKUP_SIZE - 1);
+    }
+    return -1;
+}
+
+static bool insertLookup(AssetType type, const char* key, int index) {
+    uint32_t slot = hashKey(type, key) & (ASSET_LOOKUP_SIZE - 1);
+    for (int probe = 0; probe < ASSET_LOOKUP_SIZE; probe++) {
+        if (lookup[slot].index <= 0) {
+            lookup[slot].key = key;
+            lookup[slot].type = (int)type;
+            lookup[slot].index = index + 1;
+            return true;
+        }
+        slot = (slot + 1) & (ASSET_LOOKUP_SIZE - 1);
+    }
+    return false;
+}
+
+static void destroyEntry(int index) {
+    AssetEntry* entry = &assets[index];
+    if (entry->destroy) {
+        entry->destroy(entry->data);
+    }
+
+    // Drop the key and every alias
+    for (int i = 0; i < ASSET_LOOKUP_SIZE; i++) {
+        if (lookup[i].index == index + 1) {
+            lookup[i].index = -1;
+        }
+    }
+
+    entry->used = false;
+    entry->pendingDestroy = false;
+    entry->queued = false;
+    entry->data = NULL;
+    entry->generation++;
+    freeSlots[freeSlotCount++] = index;
+}
+
+void initAssetRegistry() {
+    if (initialized) return;
+    memset(assets, 0, sizeof(assets));
+    memset(lookup, 0, sizeof(lookup));
+    freeSlotCount = 0;
+    for (int i = MAX_ASSETS - 1; i >= 0; i--) {
+        assets[i].generation = 1;
+        freeSlots[freeSlotCount++] = i;
+    }
+    pendingCount = 0;
+    assetFrame = 0;
+    initialized = true;
+}
+
+void shutdownAssetRegistry() {
+    if (!initialized) return;
+    for (int i = 0; i < MAX_ASSETS; i++) {
+        if (assets[i].used) {
+            if (assets[i].refCount > 0) {
+                LOG_WARN(LOG_ASSETS, "Asset %s still has %d references at shutdown.", assets[i].key, assets[i].refCount);
+            }
+            destroyEntry(i);
+        }
+    }
+    pendingCount = 0;
+
+    for (size_t i = 0; i < internCapacity; i++) {
+        engineFree(internTable[i]);
+    }
+    engineFree(internTable);
+    internTable = NULL;
+    internCapacity = 0;
+    internCount = 0;
+    initialized = false;
+}
+
+AssetHandle registerAsset(AssetType type, const char* key, void* data, AssetDestroyFunction destroy) {
+    if (!initialized) initAssetRegistry();
+
+    const char* interned = internString(key);
+    if (!interned) return 0;
+    if (findLookupSlot(type, interned) >= 0) {
+        LOG_WARN(LOG_ASSETS, "Asset %s is already registered.", key);
+        return 0;
+    }
+    if (freeSlotCount == 0) {
+        LOG_ERROR(LOG_ASSETS, "Exceeded maximum asset limit of %d", MAX_ASSETS);
+        return 0;
+    }
+
+    int index = freeSlots[--freeSlotCount];
+    AssetEntry* entry = &assets[index];
+    entry->type = type;
+    entry->key = interned;
+    entry->data = data;
+    entry->destroy = destroy;
+    entry->refCount = 1;
+    entry->used = true;
+    entry->pendingDestroy = false;
+    if (!insertLookup(type, interned, index)) {
+        LOG_ERROR(LOG_ASSETS, "Asset lookup table is full.");
+        entry->used = false;
+        freeSlots[freeSlotCount++] = index;
+        return 0;
+    }
+    return makeHandle(index);
+}
+
+AssetHandle findAsset(AssetType type, const char* key) {
+    if (!initialized || !key) return 0;
+    const char* interned = findInterned(key);
+    if (!interned) return 0;
+    int slot = findLookupSlot(type, interned);
+    return slot >= 0 ? makeHandle(lookup[slot].index - 1) : 0;
+}
+
+bool addAssetAlias(AssetHandle handle, const char* alias) {
+    AssetEntry* entry = resolve(handle);
+    if (!entry) return false;
+    const char* interned = internString(alias);
+    if (!interned) return false;
+    int slot = findLookupSlot(entry->type, interned);
+    if (slot >= 0) {
+        return lookup[slot].index == (int)(handle & 0xFFFF);
+    }
+    return insertLookup(entry->type, interned, (int)(handle & 0xFFFF) - 1);
+}
+
+AssetHandle acquireAsset(AssetHandle handle) {
+    AssetEntry* entry = resolve(handle);
+    if (!entry) return 0;
+    entry->refCount++;
+    entry->pendingDestroy = false; // Picked up again before it was collected
+    return handle;
+}
+
+void releaseAsset(AssetHandle handle) {
+    AssetEntry* entry = resolve(handle);
+    if (!entry || entry->refCount <= 0) return;
+    if (--entry->refCount > 0) return;
+
+    // Frames already built or in flight may still draw with it
+    entry->pendingDestroy = true;
+    entry->releaseFrame = assetFrame;
+    if (!entry->queued) {
+        entry->queued = true;
+        pendingDestroys[pendingCount++] = (int)(handle & 0xFFFF) - 1;
+    }
+}
+
+void collectAssets() {
+    assetFrame++;
+    int kept = 0;
+    for (int i = 0; i < pendingCount; i++) {
+        int index = pendingDestroys[i];
+        AssetEntry* entry = &assets[index];
+        if (!entry->used) continue;
+        if (!entry->pendingDestroy) {
+            entry->queued = false;
+            continue;
+        }
+        if (assetFrame - entry->releaseFrame >= ASSET_DESTROY_DELAY_FRAMES) {
+            destroyEntry(index);
+        }
+        else {
+            pendingDestroys[kept++] = index;
+        }
+    }
+    pendingCount = kept;
+}
+
+void* getAssetData(AssetHandle handle) {
+    AssetEntry* entry = resolve(handle);
+    return entry ? entry->data : NULL;
+}
+
+const char* getAssetKey(AssetHandle handle) {
+    AssetEntry* entry = resolve(handle);
+    return entry ? entry->key : NULL;
+}
+
+int getAssetRefCount(AssetHandle handle) {
+    AssetEntry* entry = resolve(handle);
+    return entry ? entry->refCount : 0;
+}
+
+int getAssetCount(AssetType type) {
+    int count = 0;
+    for (int i = 0; i < MAX_ASSETS; i++) {
+        if (assets[i].used && assets[i].type == type) count++;
+    }
+    return count;
+}
@@ -4,6 +4,8 @@
 #include "textures.h"
 #include "Camera.h"
 #include "background.h"
+#include "logger.h"
+#include "memory_accounting.h"
 #include "SOIL2/SOIL2.h"
 #include <stdio.h>
 GLuint skyboxVAO, skyboxVBO, skyboxShader, skyboxTexture;
@@ -28,14 +30,16 @@ GLuint loadCubemap(const char* faceFiles[6]) {
     glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
     int width, height, channels;
+    size_t bytes = 0;
     for (int i = 0; i < 6; i++) {
         unsigned char* data = SOIL_load_image(faceFiles[i], &width, &height, &channels, SOIL_LOAD_RGB);
         if (data) {
             glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+            bytes += textureMemorySize(width, height, 1, 1, 4); // RGB8 is stored as RGBA8
             SOIL_free_image_data(data);
         }
         else {
-            fprintf(stderr, "Cubemap texture failed to load at path: %s\n", faceFiles[i]);
+            LOG_ERROR(LOG_ASSETS, "Cubemap texture failed to load at path: %s", faceFiles[i]);
         }
     }
 
@@ -45,6 +49,7 @@ GLuint loadCubemap(const char* faceFiles[6]) {
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
+    trackMemory(TRACKED_TEXTURE, textureID, MEMORY_CUBEMAPS, bytes, "skybox");
     return textureID;
 }
 
@@ -95,7 +100,7 @@ float skyboxVertices[] = {
 
 void initSkybox(int backgroundIndex) {
     if (backgroundIndex < 1 || backgroundIndex > backgroundCount) {
-        fprintf(stderr, "Background index out of range. Please choose from 1 to %d.\n", backgroundCount);
+        LOG_WARN(LOG_ASSETS, "Background index out of range. Please choose from 1 to %d.", backgroundCount);
         return;
     }
 
@@ -106,6 +111,7 @@ void initSkybox(int backgroundIndex) {
     glGenBuffers(1, &skyboxVBO);
     glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), skyboxVertices, GL_STATIC_DRAW);
+    trackMemory(TRACKED_BUFFER, skyboxVBO, MEMORY_VERTEX_BUFFERS, sizeof(skyboxVertices), "skybox");
 
     // Set up vertex attributes
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
@@ -124,15 +130,29 @@ void initSkybox(int backgroundIndex) {
     // Load textures and shaders
     skyboxTexture = loadCubemap(faces);
     if (skyboxTexture == 0) {
-        fprintf(stderr, "Failed to load skybox textures for background %d\n", backgroundIndex);
+        LOG_ERROR(LOG_ASSETS, "Failed to load skybox textures for background %d", backgroundIndex);
         return;
     }
 
-    skyboxShader = loadShader("shaders/skybox/skyboxVertex.glsl", "shaders/skybox/skyboxFragment.glsl");
-    if (skyboxShader == 0) {
-        fprintf(stderr, "Failed to load skybox shader\n");
+    // Switching backgrounds keeps the already compiled program
+    GLuint shader = acquireShader("shaders/skybox/skyboxVertex.glsl", "shaders/skybox/skyboxFragment.glsl");
+    if (shader == 0) {
+        LOG_ERROR(LOG_ASSETS, "Failed to load skybox shader");
         return;
     }
+    if (skyboxShader) releaseShader(skyboxShader);
+    skyboxShader = shader;
+}
+
+void cleanupSkybox() {
+    if (skyboxShader) releaseShader(skyboxShader);
+    skyboxShader = 0;
+    untrackMemory(TRACKED_TEXTURE, skyboxTexture);
+    untrackMemory(TRACKED_BUFFER, skyboxVBO);
+    glDeleteTextures(1, &skyboxTexture);
+    glDeleteBuffers(1, &skyboxVBO);
+    glDeleteVertexArrays(1, &skyboxVAO);
+    skyboxTexture = skyboxVBO = skyboxVAO = 0;
 }
 
 void drawSkybox(const Camera* camera, const Matrix4x4* projMatrix) {
@@ -0,0 +1,590 @@
+#include "change_journal.h"
+#include "project_save.h"
+#include "scene_format.h"
+#include "ObjectManager.h"
+#include "transform_hierarchy.h"
+#include "materials.h"
+#include "textures.h"
+#include "jobs.h"
+#include "logger.h"
+#include "allocators.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define JOURNAL_VERSION 1
+#define JOURNAL_PATH_LENGTH 64
+#define JOURNAL_MAX_STRING 1023
+#define JOURNAL_MAX_PAYLOAD 4096 // Fits an add record with three maximum-length strings
+#define JOURNAL_CACHE_SIZE 256   // Power of two
+
+typedef enum {
+    JOURNAL_ADD = 1,
+    JOURNAL_REMOVE,
+    JOURNAL_TRANSFORM,
+    JOURNAL_COLOR,
+    JOURNAL_SURFACE,
+    JOURNAL_PARENT
+} JournalRecordType;
+
+static const char journalMagic[4] = { 'C', 'L', 'J', 'R' };
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t checkpointId; // Records apply on top of recovery-<id>.cscene
+    uint32_t reserved;
+} JournalHeader;
+
+typedef struct {
+    uint16_t type;
+    uint16_t size;     // Payload bytes
+    uint32_t index;    // Object index at the time of the edit
+    uint32_t checksum; // Of the payload, so a torn append is detected
+} JournalRecordHeader;
+
+typedef struct {
+    unsigned char* data;
+    size_t size;
+    size_t capacity;
+} JournalBuffer;
+
+typedef struct {
+    unsigned char bytes[JOURNAL_MAX_PAYLOAD];
+    size_t size;
+} JournalPayload;
+
+typedef struct {
+    const unsigned char* data;
+    size_t size;
+    size_t offset;
+    bool ok;
+} JournalReader;
+
+typedef enum {
+    JOURNAL_JOB_FLUSH,
+    JOURNAL_JOB_CHECKPOINT
+} JournalJobType;
+
+typedef struct {
+    JournalJobType type;
+    JournalBuffer records;   // Flush: bytes to append
+    SceneSnapshot snapshot;  // Checkpoint: scene to write
+    uint32_t checkpointId;   // Checkpoint: id of the new checkpoint
+    uint32_t previousId;     // Checkpoint: removed once the journal no longer names it
+    bool ok;
+} JournalJob;
+
+static bool enabled = false;
+static JournalBuffer pending;
+static long lastRecordOffset = -1; // Start of the newest pending record, for coalescing
+static uint32_t recordCache[JOURNAL_CACHE_SIZE][2]; // (type, index) key + 1 and the payload last recorded
+
+// Only one flush or checkpoint runs at a time; edits keep collecting in pending
+static JournalJob journalJob;
+static JobCounter journalCounter;
+static bool jobRunning = false;
+static FILE* journalFile = NULL; // Owned by the job while one runs
+static size_t journalBytes = 0;
+static uint32_t checkpointId = 0; // 0 until a checkpoint has been written or recovered
+static bool needCheckpoint = true;
+static double lastFlush = 0.0;
+
+static uint32_t hashBytes(const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void checkpointPath(uint32_t id, char* path, size_t size) {
+    snprintf(path, size, JOURNAL_CHECKPOINT_PREFIX "%u" SCENE_FILE_EXTENSION, id);
+}
+
+static bool reserveBuffer(JournalBuffer* buffer, size_t extra) {
+    if (buffer->size + extra <= buffer->capacity) return true;
+    size_t capacity = buffer->capacity ? buffer->capacity * 2 : JOURNAL_FLUSH_BYTES;
+    while (capacity < buffer->size + extra) capacity *= 2;
+    unsigned char* data = (unsigned char*)engineRealloc(buffer->data, capacity);
+    if (!data) {
+        LOG_ERROR(LOG_SCENE, "Failed to grow the change journal buffer.");
+        return false;
+    }
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return true;
+}
+
+static void clearPending() {
+    pending.size = 0;
+    lastRecordOffset = -1;
+    memset(recordCache, 0, sizeof(recordCache));
+}
+
+// ---- Recording ----
+
+static void putBytes(JournalPayload* payload, const void* data, size_t size) {
+    memcpy(payload->bytes + payload->size, data, size);
+    payload->size += size;
+}
+
+static void putString(JournalPayload* payload, const char* text) {
+    size_t length = text ? strlen(text) : 0;
+    if (length > JOURNAL_MAX_STRING) length = JOURNAL_MAX_STRING;
+    uint16_t stored = (uint16_t)length;
+    putBytes(payload, &stored, sizeof(stored));
+    putBytes(payload, text, length);
+}
+
+static void appendRecord(JournalRecordType type, int index, const JournalPayload* payload) {
+    uint32_t checksum = hashBytes(payload->bytes, payload->size);
+
+    if (type == JOURNAL_ADD || type == JOURNAL_REMOVE) {
+        memset(recordCache, 0, sizeof(recordCache)); // Indices after this one have shifted
+    }
+    else {
+        // Pickers and the inspector report every frame whether or not anything changed
+        uint32_t key = (((uint32_t)type << 16) | (uint32_t)index) + 1;
+        uint32_t* cached = recordCache[(key * 2654435761u) >> 24];
+        if (cached[0] == key && cached[1] == checksum) return;
+        cached[0] = key;
+        cached[1] = checksum;
+
+        // A drag rewrites the same record every frame; only the newest value is kept
+        if (lastRecordOffset >= 0) {
+            JournalRecordHeader last;
+            memcpy(&last, pending.data + lastRecordOffset, sizeof(last));
+            if (last.type == type && last.index == (uint32_t)index && last.size == payload->size) {
+                last.checksum = checksum;
+                memcpy(pending.data + lastRecordOffset, &last, sizeof(last));
+                memcpy(pending.data + lastRecordOffset + sizeof(last), payload->bytes, payload->size);
+                return;
+            }
+        }
+    }
+
+    if (!reserveBuffer(&pending, sizeof(JournalRecordHeader) + payload->size)) return;
+    JournalRecordHeader header = { (uint16_t)type, (uint16_t)payload->size, (uint32_t)index, checksum };
+    lastRecordOffset = (long)pending.size;
+    memcpy(pending.data + pending.size, &header, sizeof(header));
+    memcpy(pending.data + pending.size + sizeof(header), payload->bytes, payload->size);
+    pending.size += sizeof(header) + payload->size;
+}
+
+static const SceneObject* journaledObject(int index) {
+    if (!enabled || index < 0 || index >= objectManager.count) return NULL;
+    return &objectManager.objects[index];
+}
+
+void journalAddObject(int index) {
+    const SceneObject* obj = journaledObject(index);
+    if (!obj) return;
+    SceneObjectRecord record;
+    makeSceneObjectRecord(obj, &record);
+
+    JournalPayload payload;
+    payload.size = 0;
+    putBytes(&payload, &record.type, sizeof(record.type));
+    putBytes(&payload, &record.flags, sizeof(record.flags));
+    putBytes(&payload, &record.position, sizeof(Vector3));
+    putBytes(&payload, &record.rotation, sizeof(Vector3));
+    putBytes(&payload, &record.scale, sizeof(Vector3));
+    putBytes(&payload, &record.color, sizeof(Vector4));
+    putString(&payload, record.textureName);
+    putString(&payload, record.materialName);
+    putString(&payload, record.modelPath);
+    appendRecord(JOURNAL_ADD, index, &payload);
+}
+
+void journalRemoveObject(int index) {
+    // Recorded after the removal, so the index no longer has to exist
+    if (!enabled || index < 0) return;
+    JournalPayload payload;
+    payload.size = 0;
+    appendRecord(JOURNAL_REMOVE, index, &payload);
+}
+
+void journalObjectTransform(int index) {
+    const SceneObject* obj = journaledObject(index);
+    if (!obj) return;
+    JournalPayload payload;
+    payload.size = 0;
+    putBytes(&payload, &obj->position, sizeof(Vector3));
+    putBytes(&payload, &obj->rotation, sizeof(Vector3));
+    putBytes(&payload, &obj->scale, sizeof(Vector3));
+    appendRecord(JOURNAL_TRANSFORM, index, &payload);
+}
+
+void journalObjectColor(int index) {
+    const SceneObject* obj = journaledObject(index);
+    if (!obj) return;
+    JournalPayload payload;
+    payload.size = 0;
+    putBytes(&payload, &obj->color, sizeof(Vector4));
+    appendRecord(JOURNAL_COLOR, index, &payload);
+}
+
+void journalObjectSurface(int index) {
+    const SceneObject* obj = journaledObject(index);
+    if (!obj) return;
+    SceneObjectRecord record;
+    makeSceneObjectRecord(obj, &record);
+
+    JournalPayload payload;
+    payload.size = 0;
+    putBytes(&payload, &record.flags, sizeof(record.flags));
+    putString(&payload, record.textureName);
+    putString(&payload, record.materialName);
+    appendRecord(JOURNAL_SURFACE, index, &payload);
+}
+
+void journalObjectParent(int index) {
+    const SceneObject* obj = journaledObject(index);
+    if (!obj) return;
+    int32_t parentIndex = obj->parentId >= 0 ? findObjectIndex(obj->parentId) : -1;
+    JournalPayload payload;
+    payload.size = 0;
+    putBytes(&payload, &parentIndex, sizeof(parentIndex));
+    appendRecord(JOURNAL_PARENT, index, &payload);
+}
+
+// ---- Replay ----
+
+static void readBytes(JournalReader* reader, void* out, size_t size) {
+    if (!reader->ok || reader->offset + size > reader->size) {
+        reader->ok = false;
+        memset(out, 0, size);
+        return;
+    }
+    memcpy(out, reader->data + reader->offset, size);
+    reader->offset += size;
+}
+
+// Returns NULL for an empty string
+static const char* readString(JournalReader* reader, char* out) {
+    uint16_t length = 0;
+    readBytes(reader, &length, sizeof(length));
+    if (length > JOURNAL_MAX_STRING) reader->ok = false;
+    if (!reader->ok || length == 0) return NULL;
+    readBytes(reader, out, length);
+    out[length] = '\0';
+    return reader->ok ? out : NULL;
+}
+
+static void applySurface(SceneObject* obj, uint8_t flags, const char* textureName, const char* materialName) {
+    obj->object.useTexture = (flags & SCENE_OBJECT_USE_TEXTURE) != 0;
+    obj->object.useColor = (flags & SCENE_OBJECT_USE_COLOR) != 0;
+    obj->object.usePBR = (flags & SCENE_OBJECT_USE_PBR) != 0;
+    obj->object.useLighting = (flags & SCENE_OBJECT_USE_LIGHTING) != 0;
+
+    int textureIndex = findTextureIndex(textureName);
+    if (textureIndex >= 0) obj->object.textureID = textures[textureIndex];
+    PBRMaterial* material = materialName ? getMaterial(materialName) : NULL;
+    if (material) obj->object.material = *material;
+}
+
+static bool replayRecord(const JournalRecordHeader* header, const unsigned char* data) {
+    JournalReader reader = { data, header->size, 0, true };
+    int index = (int)header->index;
+    SceneObject* obj = index < objectManager.count ? &objectManager.objects[index] : NULL;
+    char textureName[JOURNAL_MAX_STRING + 1];
+    char materialName[JOURNAL_MAX_STRING + 1];
+    char modelPath[JOURNAL_MAX_STRING + 1];
+
+    switch ((JournalRecordType)header->type) {
+    case JOURNAL_ADD: {
+        SceneObjectRecord record;
+        readBytes(&reader, &record.type, sizeof(record.type));
+        readBytes(&reader, &record.flags, sizeof(record.flags));
+        readBytes(&reader, &record.position, sizeof(Vector3));
+        readBytes(&reader, &record.rotation, sizeof(Vector3));
+        readBytes(&reader, &record.scale, sizeof(Vector3));
+        readBytes(&reader, &record.color, sizeof(Vector4));
+        record.textureName = readString(&reader, textureName);
+        record.materialName = readString(&reader, materialName);
+        record.modelPath = readString(&reader, modelPath);
+        // Objects are always appended, so the recorded index must be the next one
+        return reader.ok && index == objectManager.count && addSceneObject(&record);
+    }
+    case JOURNAL_REMOVE:
+        if (!obj) return false;
+        removeObject(index);
+        return true;
+    case JOURNAL_TRANSFORM: {
+        Vector3 position, rotation, scale;
+        readBytes(&reader, &position, sizeof(Vector3));
+        readBytes(&reader, &rotation, sizeof(Vector3));
+        readBytes(&reader, &scale, sizeof(Vector3));
+        if (!reader.ok || !obj) return false;
+        obj->position = position;
+        obj->rotation = rotation;
+        obj->scale = scale;
+        markTransformDirty(index);
+        return true;
+    }
+    case JOURNAL_COLOR: {
+        Vector4 color;
+        readBytes(&reader, &color, sizeof(Vector4));
+        if (!reader.ok || !obj) return false;
+        obj->color = color;
+        return true;
+    }
+    case JOURNAL_SURFACE: {
+        uint8_t flags;
+        readBytes(&reader, &flags, sizeof(flags));
+        const char* texture = readString(&reader, textureName);
+        const char* material = readString(&reader, materialName);
+        if (!reader.ok || !obj) return false;
+        applySurface(obj, flags, texture, material);
+        return true;
+    }
+    case JOURNAL_PARENT: {
+        int32_t parentIndex;
+        readBytes(&reader, &parentIndex, sizeof(parentIndex));
+        if (!reader.ok || !obj) return false;
+        return setObjectParent(index, parentIndex < 0 ? -1 : parentIndex);
+    }
+    default:
+        return true; // Written by a newer build; skipped
+    }
+}
+
+static unsigned char* readJournal(JournalHeader* header, size_t* size) {
+    FILE* file = fopen(JOURNAL_FILE_NAME, "rb");
+    if (!file) return NULL;
+
+    unsigned char* records = NULL;
+    long end = 0;
+    bool valid = fread(header, sizeof(JournalHeader), 1, file) == 1 &&
+                 memcmp(header->magic, journalMagic, sizeof(journalMagic)) == 0 &&
+                 header->version == JOURNAL_VERSION &&
+                 fseek(file, 0, SEEK_END) == 0 && (end = ftell(file)) >= (long)sizeof(JournalHeader) &&
+                 fseek(file, sizeof(JournalHeader), SEEK_SET) == 0;
+    if (valid) {
+        *size = (size_t)end - sizeof(JournalHeader);
+        records = (unsigned char*)engineMalloc(*size > 0 ? *size : 1);
+        valid = records && fread(records, 1, *size, file) == *size;
+    }
+    fclose(file);
+
+    if (!valid) {
+        LOG_WARN(LOG_SCENE, "Ignoring unreadable change journal %s.", JOURNAL_FILE_NAME);
+        engineFree(records);
+        return NULL;
+    }
+    return records;
+}
+
+bool recoverChangeJournal() {
+    if (!enabled) return false;
+    JournalHeader header;
+    size_t size = 0;
+    unsigned char* records = readJournal(&header, &size);
+    if (!records) return false;
+
+    char path[JOURNAL_PATH_LENGTH];
+    checkpointPath(header.checkpointId, path, sizeof(path));
+    LOG_INFO(LOG_SCENE, "The editor did not exit cleanly; recovering the scene from %s.", path);
+    if (!loadSceneFile(path)) {
+        LOG_ERROR(LOG_SCENE, "Failed to load recovery checkpoint %s.", path);
+        engineFree(records);
+        return false;
+    }
+
+    int replayed = 0;
+    size_t offset = 0;
+    while (offset + sizeof(JournalRecordHeader) <= size) {
+        JournalRecordHeader recordHeader;
+        memcpy(&recordHeader, records + offset, sizeof(recordHeader));
+        const unsigned char* data = records + offset + sizeof(recordHeader);
+        // A record cut short by the crash ends the journal
+        if (offset + sizeof(recordHeader) + recordHeader.size > size ||
+            hashBytes(data, recordHeader.size) != recordHeader.checksum) {
+            break;
+        }
+        if (!replayRecord(&recordHeader, data)) {
+            LOG_WARN(LOG_SCENE, "Change journal record %d does not match the scene; stopping replay.", replayed + 1);
+            break;
+        }
+        replayed++;
+        offset += sizeof(recordHeader) + recordHeader.size;
+    }
+    engineFree(records);
+    LOG_INFO(LOG_SCENE, "Recovered %d edits from %s.", replayed, JOURNAL_FILE_NAME);
+
+    // The recovered files stay until a new checkpoint supersedes them
+    checkpointId = header.checkpointId;
+    resetChangeJournal();
+    return true;
+}
+
+// ---- Background writes ----
+
+static bool writeJournalHeader(uint32_t id) {
+    const char* tempPath = JOURNAL_FILE_NAME ".tmp";
+    FILE* file = fopen(tempPath, "wb");
+    if (!file) return false;
+
+    JournalHeader header = { 0 };
+    memcpy(header.magic, journalMagic, sizeof(journalMagic));
+    header.version = JOURNAL_VERSION;
+    header.checkpointId = id;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && flushFileToDisk(file);
+    ok = fclose(file) == 0 && ok;
+    if (ok) ok = replaceFile(tempPath, JOURNAL_FILE_NAME);
+    if (!ok) remove(tempPath);
+    return ok;
+}
+
+static void checkpointJob(JournalJob* job) {
+    char path[JOURNAL_PATH_LENGTH];
+    char tempPath[JOURNAL_PATH_LENGTH + 8];
+    checkpointPath(job->checkpointId, path, sizeof(path));
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+    if (!writeSceneFile(&job->snapshot, tempPath, SCENE_WRITE_COMPRESS | SCENE_WRITE_DURABLE, NULL) ||
+        !replaceFile(tempPath, path)) {
+        remove(tempPath);
+        job->ok = false;
+        return;
+    }
+
+    // Until this rename the old journal and checkpoint remain a consistent pair
+    if (journalFile) {
+        fclose(journalFile);
+        journalFile = NULL;
+    }
+    if (!writeJournalHeader(job->checkpointId)) {
+        remove(path);
+        job->ok = false;
+        return;
+    }
+    journalFile = fopen(JOURNAL_FILE_NAME, "ab");
+    job->ok = journalFile != NULL;
+
+    if (job->previousId != 0 && job->previousId != job->checkpointId) {
+        checkpointPath(job->previousId, path, sizeof(path));
+        remove(path);
+    }
+}
+
+static void journalJobMain(void* data) {
+    JournalJob* job = (JournalJob*)data;
+    if (job->type == JOURNAL_JOB_CHECKPOINT) {
+        checkpointJob(job);
+        return;
+    }
+    job->ok = journalFile &&
+              fwrite(job->records.data, 1, job->records.size, journalFile) == job->records.size &&
+              flushFileToDisk(journalFile);
+}
+
+static void startCheckpoint() {
+    if (!captureSceneSnapshot(&journalJob.snapshot)) return; // Retried next frame
+    // Everything buffered so far is part of the snapshot
+    clearPending();
+    journalJob.type = JOURNAL_JOB_CHECKPOINT;
+    journalJob.previousId = checkpointId;
+    journalJob.checkpointId = checkpointId + 1;
+    journalJob.ok = false;
+    needCheckpoint = false;
+    jobRunning = true;
+    runBackgroundJob(journalJobMain, &journalJob, &journalCounter);
+}
+
+static void startFlush() {
+    // Swap buffers so new edits never wait for the write
+    JournalBuffer spare = journalJob.records;
+    journalJob.records = pending;
+    pending = spare;
+    pending.size = 0;
+    lastRecordOffset = -1;
+
+    journalJob.type = JOURNAL_JOB_FLUSH;
+    journalJob.ok = false;
+    jobRunning = true;
+    runBackgroundJob(journalJobMain, &journalJob, &journalCounter);
+}
+
+static void finishJournalJob() {
+    jobRunning = false;
+    if (journalJob.type == JOURNAL_JOB_CHECKPOINT) {
+        freeSceneSnapshot(&journalJob.snapshot);
+        if (journalJob.ok) {
+            checkpointId = journalJob.checkpointId;
+            journalBytes = sizeof(JournalHeader);
+        }
+    }
+    else if (journalJob.ok) {
+        journalBytes += journalJob.records.size;
+    }
+    journalJob.records.size = 0;
+
+    if (!journalJob.ok) {
+        LOG_ERROR(LOG_SCENE, "Failed to write the change journal; crash recovery is disabled.");
+        enabled = false;
+    }
+}
+
+void initChangeJournal() {
+    const char* setting = getenv("CLUE_JOURNAL");
+    enabled = !(setting && strcmp(setting, "0") == 0);
+    atomic_store(&journalCounter.pending, 0);
+    needCheckpoint = true;
+
+    // Full autosaves are redundant with the journal unless asked for explicitly
+    if (enabled && !getenv("CLUE_AUTOSAVE_SECONDS")) {
+        setAutosaveInterval(0.0);
+    }
+}
+
+void shutdownChangeJournal() {
+    if (jobRunning) {
+        waitForCounter(&journalCounter);
+        finishJournalJob();
+    }
+    if (journalFile) {
+        fclose(journalFile);
+        journalFile = NULL;
+    }
+
+    // A clean exit leaves nothing to recover
+    if (checkpointId != 0) {
+        char path[JOURNAL_PATH_LENGTH];
+        checkpointPath(checkpointId, path, sizeof(path));
+        remove(JOURNAL_FILE_NAME);
+        remove(path);
+    }
+
+    engineFree(pending.data);
+    engineFree(journalJob.records.data);
+    memset(&pending, 0, sizeof(pending));
+    memset(&journalJob.records, 0, sizeof(journalJob.records));
+    enabled = false;
+}
+
+void updateChangeJournal(double now) {
+    if (jobRunning) {
+        if (!isCounterDone(&journalCounter)) return;
+        finishJournalJob();
+    }
+    if (!enabled) return;
+
+    if (needCheckpoint || journalBytes + pending.size >= JOURNAL_COMPACT_BYTES) {
+        startCheckpoint();
+        lastFlush = now;
+    }
+    else if (pending.size > 0 && (pending.size >= JOURNAL_FLUSH_BYTES || now - lastFlush >= JOURNAL_FLUSH_INTERVAL)) {
+        startFlush();
+        lastFlush = now;
+    }
+}
+
+void resetChangeJournal() {
+    clearPending();
+    needCheckpoint = true;
+}
@@ -5,6 +5,12 @@
 #include "ObjectManager.h"
 #include "lightshading.h"
 #include "SceneObject.h"
+#include "scene_format.h"
+#include "project_save.h"
+#include "change_journal.h"
+#include "actions.h"
+#include "logger.h"
+#include "allocators.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -18,7 +24,7 @@ extern int lightCount;
 
 const char* getMaterialName(PBRMaterial* material) {
     for (int i = 0; i < materialCount; i++) {
-        if (&materials[i] == material) {
+        if (isSameMaterial(materials[i], *material)) {
             return materialNames[i];
         }
     }
@@ -47,21 +53,14 @@ ObjectType string_to_object_type(const char* type) {
     return OBJ_CUBE;  // Default type
 }
 
-void save_project() {
-    char const* filterPatterns[1] = { "*.json" };
-    char const* savePath = tinyfd_saveFileDialog(
-        "Save Project As",
-        "project.json",
-        1,
-        filterPatterns,
-        "JSON Files"
-    );
-
-    if (!savePath) {
-        fprintf(stderr, "Save operation cancelled or failed to get a valid path.\n");
-        return;
-    }
+static bool has_extension(const char* path, const char* extension) {
+    size_t pathLength = strlen(path);
+    size_t extensionLength = strlen(extension);
+    return pathLength >= extensionLength && strcmp(path + pathLength - extensionLength, extension) == 0;
+}
 
+// JSON is kept as an interchange format; the binary .cscene format is the default
+static void save_project_json(const char* savePath) {
     cJSON* root = cJSON_CreateObject();
 
     // Save Objects
@@ -168,40 +167,50 @@ void save_project() {
     }
 
     cJSON_Delete(root);
-    free(jsonString);
+    cJSON_free(jsonString);
 }
 
-void load_project() {
-    char const* filterPatterns[2] = { "*.json", "*.txt" };
-    char const* loadPath = tinyfd_openFileDialog(
-        "Open Project",
-        "",
+void save_project() {
+    char const* filterPatterns[2] = { "*" SCENE_FILE_EXTENSION, "*.json" };
+    char const* savePath = tinyfd_saveFileDialog(
+        "Save Project As",
+        "project" SCENE_FILE_EXTENSION,
         2,
         filterPatterns,
-        "Project Files",
-        0
+        "Project Files"
     );
 
-    if (!loadPath) {
-        fprintf(stderr, "Load operation cancelled or failed to get a valid path.\n");
+    if (!savePath) {
+        LOG_WARN(LOG_SCENE, "Save operation cancelled or failed to get a valid path.");
+        return;
+    }
+
+    if (has_extension(savePath, ".json")) {
+        save_project_json(savePath);
         return;
     }
 
+    // Captured at the frame boundary and written in the background
+    requestProjectSave(savePath);
+}
+
+// False when the file could not be read, in which case the scene is untouched
+static bool load_project_json(const char* loadPath) {
     FILE* file = fopen(loadPath, "r");
     if (!file) {
-        fprintf(stderr, "Failed to open file.\n");
-        return;
+        LOG_ERROR(LOG_SCENE, "Failed to open file.");
+        return false;
     }
 
     fseek(file, 0, SEEK_END);
     long length = ftell(file);
     fseek(file, 0, SEEK_SET);
 
-    char* jsonString = malloc(length + 1);
+    char* jsonString = engineMalloc(length + 1);
     if (!jsonString) {
-        fprintf(stderr, "Failed to allocate memory for JSON string.\n");
+        LOG_ERROR(LOG_SCENE, "Failed to allocate memory for JSON string.");
         fclose(file);
-        return;
+        return false;
     }
 
     fread(jsonString, 1, length, file);
@@ -210,9 +219,9 @@ void load_project() {
 
     cJSON* root = cJSON_Parse(jsonString);
     if (!root) {
-        fprintf(stderr, "Failed to parse JSON file.\n");
-        free(jsonString);
-        return;
+        LOG_ERROR(LOG_SCENE, "Failed to parse JSON file.");
+        engineFree(jsonString);
+        return false;
     }
 
     // Clear current objects and lights
@@ -223,6 +232,28 @@ void load_project() {
     cJSON* objectsArray = cJSON_GetObjectItem(root, "objects");
     if (objectsArray) {
         int arraySize = cJSON_GetArraySize(objectsArray);
+
+        // Load every referenced model first so distinct files import in parallel
+        const char** modelPaths = (const char**)engineCalloc(arraySize > 0 ? arraySize : 1, sizeof(const char*));
+        Model** models = (Model**)engineCalloc(arraySize > 0 ? arraySize : 1, sizeof(Model*));
+        if (!modelPaths || !models) {
+            LOG_ERROR(LOG_SCENE, "Failed to allocate memory for model lookups.");
+            engineFree(modelPaths);
+            engineFree(models);
+            modelPaths = NULL;
+            models = NULL;
+            arraySize = 0;
+        }
+        for (int i = 0; i < arraySize; i++) {
+            cJSON* jsonObject = cJSON_GetArrayItem(objectsArray, i);
+            if (string_to_object_type(cJSON_GetObjectItem(jsonObject, "type")->valuestring) == OBJ_MODEL) {
+                modelPaths[i] = cJSON_GetObjectItem(jsonObject, "modelPath")->valuestring;
+            }
+        }
+        if (arraySize > 0) {
+            acquireModels(modelPaths, arraySize, models);
+        }
+
         for (int i = 0; i < arraySize; i++) {
             cJSON* jsonObject = cJSON_GetArrayItem(objectsArray, i);
 
@@ -255,23 +286,24 @@ void load_project() {
 
             PBRMaterial* material = getMaterial(materialName);
             if (!material) {
-                printf("Warning: Material '%s' not found. Using default material 'peacockOre'.\n", materialName);
+                LOG_WARN(LOG_SCENE, "Material '%s' not found. Using default material 'peacockOre'.", materialName);
                 material = getMaterial("peacockOre");
             }
 
+            int previousCount = objectManager.count;
             if (type == OBJ_MODEL) {
-                const char* modelPath = cJSON_GetObjectItem(jsonObject, "modelPath")->valuestring;
-                Model* model = loadModel(modelPath);
-                if (model) {
-                    addObject(&camera, type, useTexture, textureID, true, model, *material, usePBR);
+                if (models[i]) {
+                    addObject(&camera, type, useTexture, textureID, true, models[i], *material, usePBR);
+                    releaseModel(models[i]); // The object holds its own reference
                 }
                 else {
-                    printf("Error: Failed to load model from path: %s\n", modelPath);
+                    LOG_ERROR(LOG_SCENE, "Failed to load model from path: %s", modelPaths[i]);
                 }
             }
             else {
                 addObject(&camera, type, useTexture, textureID, true, NULL, *material, usePBR);
             }
+            if (objectManager.count == previousCount) continue;
 
             SceneObject* newObj = &objectManager.objects[objectManager.count - 1];
             newObj->position = position;
@@ -279,6 +311,8 @@ void load_project() {
             newObj->scale = scale;
             newObj->color = color;
         }
+        engineFree(modelPaths);
+        engineFree(models);
     }
 
     // Load Lights
@@ -337,7 +371,30 @@ void load_project() {
     }
 
     cJSON_Delete(root);
-    free(jsonString);
+    engineFree(jsonString);
+    return true;
+}
+
+void load_project() {
+    char const* filterPatterns[3] = { "*" SCENE_FILE_EXTENSION, "*.json", "*.txt" };
+    char const* loadPath = tinyfd_openFileDialog(
+        "Open Project",
+        "",
+        3,
+        filterPatterns,
+        "Project Files",
+        0
+    );
+
+    if (!loadPath) {
+        LOG_WARN(LOG_SCENE, "Load operation cancelled or failed to get a valid path.");
+        return;
+    }
+
+    bool loaded = isSceneFile(loadPath) ? loadSceneFile(loadPath) : load_project_json(loadPath);
+    if (!loaded) return; // The current scene and its history are kept
+    clearActionHistory(); // Edits before the load no longer apply
+    resetChangeJournal();
 }
 
 
@@ -369,5 +426,7 @@ void new_project() {
     usePBR = true;
 
     reset_gui(); // Reset GUI to initial state
+    clearActionHistory();
+    resetChangeJournal();
 }
 
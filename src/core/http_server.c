@@ -0,0 +1,238 @@
+#include "http_server.h"
+#include "threading.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#ifndef _WIN32
+    #include <errno.h>
+    #include <time.h>
+#endif
+
+typedef struct {
+    const char* path;
+    size_t pathLength;
+    HttpHandler handler;
+} HttpRoute;
+
+static atomic_int serverRunning;
+static Thread serverThread;
+static Socket listener = INVALID_SOCKET_HANDLE;
+
+// Written by the main thread, then published by the count, so the server thread reads them without a lock
+static HttpRoute routes[HTTP_MAX_HANDLERS];
+static atomic_int routeCount;
+
+// Server thread only
+static char request[HTTP_REQUEST_SIZE];
+
+void setSocketBlocking(Socket handle, bool blocking) {
+#ifdef _WIN32
+    u_long mode = blocking ? 0 : 1;
+    ioctlsocket(handle, FIONBIO, &mode);
+#else
+    int flags = fcntl(handle, F_GETFL, 0);
+    fcntl(handle, F_SETFL, blocking ? flags & ~O_NONBLOCK : flags | O_NONBLOCK);
+#endif
+}
+
+bool socketWouldBlock() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+static void setSocketTimeouts(Socket handle) {
+#ifdef _WIN32
+    DWORD timeout = HTTP_IO_TIMEOUT_MS;
+#else
+    struct timeval timeout = { HTTP_IO_TIMEOUT_MS / 1000, (HTTP_IO_TIMEOUT_MS % 1000) * 1000 };
+#endif
+    setsockopt(handle, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+    setsockopt(handle, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+#ifdef SO_NOSIGPIPE
+    int noSigpipe = 1;
+    setsockopt(handle, SOL_SOCKET, SO_NOSIGPIPE, &noSigpipe, sizeof(noSigpipe));
+#endif
+}
+
+static long long httpClockMs() {
+#ifdef _WIN32
+    return (long long)GetTickCount64();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
+
+// Waits until the client has data or the deadline passes
+static bool waitReadable(Socket handle, long long deadline) {
+    long long remaining = deadline - httpClockMs();
+    if (remaining <= 0) return false;
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(handle, &readable);
+    struct timeval timeout = { (long)(remaining / 1000), (long)(remaining % 1000) * 1000 };
+    return select((int)handle + 1, &readable, NULL, NULL, &timeout) > 0;
+}
+
+bool httpSendAll(Socket handle, const char* data, size_t length) {
+    while (length > 0) {
+        int sent = send(handle, data, (int)length, SEND_FLAGS);
+        if (sent <= 0) return false;
+        data += sent;
+        length -= (size_t)sent;
+    }
+    return true;
+}
+
+void httpRespond(Socket handle, const char* status, const char* contentType, const char* content, size_t length, bool includeBody) {
+    char header[256];
+    int headerLength = snprintf(header, sizeof(header),
+                                "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                                status, contentType, length);
+    if (httpSendAll(handle, header, (size_t)headerLength) && includeBody) {
+        httpSendAll(handle, content, length);
+    }
+}
+
+void registerHttpHandler(const char* path, HttpHandler handler) {
+    int count = atomic_load_explicit(&routeCount, memory_order_relaxed);
+    if (count == HTTP_MAX_HANDLERS) {
+        LOG_ERROR(LOG_CORE, "Too many HTTP handlers; %s is not served.", path);
+        return;
+    }
+    routes[count] = (HttpRoute){ path, strlen(path), handler };
+    atomic_store_explicit(&routeCount, count + 1, memory_order_release);
+}
+
+// Returns true if a handler kept the socket
+static bool serveClient(Socket client) {
+    setSocketBlocking(client, true); // Accepted sockets inherit non-blocking mode on some platforms
+    setSocketTimeouts(client);
+
+    // One deadline for the whole request, so a client trickling bytes cannot hold the thread
+    long long deadline = httpClockMs() + HTTP_IO_TIMEOUT_MS;
+    size_t received = 0;
+    while (received < sizeof(request) - 1) {
+        if (!waitReadable(client, deadline)) return false;
+        int count = recv(client, request + received, (int)(sizeof(request) - 1 - received), 0);
+        if (count <= 0) return false;
+        received += (size_t)count;
+        request[received] = '\0';
+        if (strstr(request, "\r\n\r\n")) break;
+    }
+
+    bool head = strncmp(request, "HEAD ", 5) == 0;
+    if (!head && strncmp(request, "GET ", 4) != 0) {
+        static const char message[] = "Method not allowed\n";
+        httpRespond(client, "405 Method Not Allowed", "text/plain", message, sizeof(message) - 1, true);
+        return false;
+    }
+    const char* path = request + (head ? 5 : 4);
+    size_t pathLength = strcspn(path, " ?\r\n");
+
+    int count = atomic_load_explicit(&routeCount, memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        if (routes[i].pathLength == pathLength && strncmp(path, routes[i].path, pathLength) == 0) {
+            return routes[i].handler(client, head);
+        }
+    }
+    static const char message[] = "Not found\n";
+    httpRespond(client, "404 Not Found", "text/plain", message, sizeof(message) - 1, !head);
+    return false;
+}
+
+static void* httpServerMain(void* arg) {
+    (void)arg;
+    while (atomic_load(&serverRunning)) {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(listener, &readable);
+        struct timeval timeout = { 0, HTTP_POLL_MS * 1000 };
+        if (select((int)listener + 1, &readable, NULL, NULL, &timeout) <= 0) continue;
+
+        Socket client = accept(listener, NULL, NULL);
+        if (client == INVALID_SOCKET_HANDLE) continue;
+        if (!serveClient(client)) {
+            closeSocket(client);
+        }
+    }
+    return NULL;
+}
+
+static Socket openListener(const char* address, int port) {
+    struct sockaddr_in bindAddress;
+    memset(&bindAddress, 0, sizeof(bindAddress));
+    bindAddress.sin_family = AF_INET;
+    bindAddress.sin_port = htons((unsigned short)port);
+    if (inet_pton(AF_INET, address, &bindAddress.sin_addr) != 1) {
+        LOG_ERROR(LOG_CORE, "Invalid HTTP address %s.", address);
+        return INVALID_SOCKET_HANDLE;
+    }
+
+    Socket socketHandle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (socketHandle == INVALID_SOCKET_HANDLE) return INVALID_SOCKET_HANDLE;
+    int reuse = 1;
+    setsockopt(socketHandle, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+    if (bind(socketHandle, (struct sockaddr*)&bindAddress, sizeof(bindAddress)) != 0 || listen(socketHandle, 8) != 0) {
+        closeSocket(socketHandle);
+        return INVALID_SOCKET_HANDLE;
+    }
+    setSocketBlocking(socketHandle, false);
+    return socketHandle;
+}
+
+void initHttpServer() {
+    const char* portSetting = getenv("CLUE_HTTP_PORT");
+    int port = portSetting ? atoi(portSetting) : 0;
+    if (port <= 0 || port > 65535) return;
+    const char* address = getenv("CLUE_HTTP_ADDRESS");
+    if (!address || !*address) address = "127.0.0.1";
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        LOG_ERROR(LOG_CORE, "Failed to initialise Winsock; HTTP server disabled.");
+        return;
+    }
+#endif
+    listener = openListener(address, port);
+    if (listener == INVALID_SOCKET_HANDLE) {
+        LOG_ERROR(LOG_CORE, "Failed to listen on %s:%d; HTTP server disabled.", address, port);
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return;
+    }
+
+    atomic_store(&serverRunning, 1);
+    if (!threadCreate(&serverThread, httpServerMain, NULL)) {
+        LOG_ERROR(LOG_CORE, "Failed to start the HTTP server thread; HTTP server disabled.");
+        atomic_store(&serverRunning, 0);
+        closeSocket(listener);
+        listener = INVALID_SOCKET_HANDLE;
+        return;
+    }
+    LOG_INFO(LOG_CORE, "Serving HTTP on %s:%d", address, port);
+}
+
+bool isHttpServerRunning() {
+    return atomic_load_explicit(&serverRunning, memory_order_relaxed) != 0;
+}
+
+void shutdownHttpServer() {
+    if (!atomic_load(&serverRunning)) return;
+    atomic_store(&serverRunning, 0);
+    threadJoin(serverThread); // Returns within HTTP_POLL_MS, or the I/O timeout mid-request
+    closeSocket(listener);
+    listener = INVALID_SOCKET_HANDLE;
+    atomic_store(&routeCount, 0);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
@@ -0,0 +1,395 @@
+#include "jobs.h"
+#include "threading.h"
+#include "logger.h"
+#include "allocators.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+typedef struct {
+    Job jobs[JOB_QUEUE_CAPACITY];
+    int top;    // Thieves take from here (oldest)
+    int bottom; // Owner pushes and pops here (newest)
+    Mutex lock;
+} JobQueue;
+
+typedef struct FrameOverflowBlock {
+    struct FrameOverflowBlock* next;
+} FrameOverflowBlock;
+
+static JobQueue queues[MAX_JOB_WORKERS];
+static JobQueue backgroundQueue; // FIFO, drained by worker threads only
+static Thread workers[MAX_JOB_WORKERS];
+static int queueCount = 0;
+static bool initialized = false;
+
+static atomic_int running;
+static atomic_int queuedJobs;
+static atomic_int sleepingWorkers;
+static atomic_uint submitCursor;
+static Mutex sleepLock;
+static CondVar wakeCondition;
+
+static THREAD_LOCAL int currentWorker = -1;
+
+static unsigned char* frameMemory = NULL;
+static atomic_size_t frameOffset;
+static FrameOverflowBlock* frameOverflow = NULL;
+static Mutex frameOverflowLock;
+
+static bool pushJob(JobQueue* queue, Job job) {
+    mutexLock(&queue->lock);
+    if (queue->bottom - queue->top >= JOB_QUEUE_CAPACITY) {
+        mutexUnlock(&queue->lock);
+        return false;
+    }
+    queue->jobs[queue->bottom % JOB_QUEUE_CAPACITY] = job;
+    queue->bottom++;
+    mutexUnlock(&queue->lock);
+    return true;
+}
+
+static bool popJob(JobQueue* queue, Job* job) {
+    bool found = false;
+    mutexLock(&queue->lock);
+    if (queue->bottom > queue->top) {
+        queue->bottom--;
+        *job = queue->jobs[queue->bottom % JOB_QUEUE_CAPACITY];
+        found = true;
+        if (queue->bottom == queue->top) {
+            queue->bottom = queue->top = 0;
+        }
+    }
+    mutexUnlock(&queue->lock);
+    return found;
+}
+
+static bool stealJob(JobQueue* queue, Job* job) {
+    bool found = false;
+    mutexLock(&queue->lock);
+    if (queue->bottom > queue->top) {
+        *job = queue->jobs[queue->top % JOB_QUEUE_CAPACITY];
+        queue->top++;
+        found = true;
+        if (queue->bottom == queue->top) {
+            queue->bottom = queue->top = 0;
+        }
+    }
+    mutexUnlock(&queue->lock);
+    return found;
+}
+
+static void executeJob(Job* job) {
+    job->function(job->data);
+    if (job->counter) {
+        atomic_fetch_sub(&job->counter->pending, 1);
+    }
+}
+
+// Own queue first, then steal round-robin starting after ourselves. Background
+// jobs are only taken by an idle worker's loop, never inside a wait, so a
+// thread blocked on frame work cannot end up in a long save or decode.
+static bool findJob(int self, Job* job, bool takeBackground) {
+    if (self >= 0 && popJob(&queues[self], job)) {
+        atomic_fetch_sub(&queuedJobs, 1);
+        return true;
+    }
+    int start = self >= 0 ? self + 1 : 0;
+    for (int i = 0; i < queueCount; i++) {
+        int victim = (start + i) % queueCount;
+        if (victim == self) continue;
+        if (stealJob(&queues[victim], job)) {
+            atomic_fetch_sub(&queuedJobs, 1);
+            return true;
+        }
+    }
+    // Frame work first; background jobs only once nothing else is queued
+    if (takeBackground && self > 0 && stealJob(&backgroundQueue, job)) {
+        atomic_fetch_sub(&queuedJobs, 1);
+        return true;
+    }
+    return false;
+}
+
+static void* workerMain(void* arg) {
+    currentWorker = (int)(size_t)arg;
+    Job job;
+
+    while (atomic_load(&running)) {
+        if (findJob(currentWorker, &job, true)) {
+            executeJob(&job);
+            continue;
+        }
+
+        mutexLock(&sleepLock);
+        atomic_fetch_add(&sleepingWorkers, 1);
+        while (atomic_load(&running) && atomic_load(&queuedJobs) == 0) {
+            condWait(&wakeCondition, &sleepLock);
+        }
+        atomic_fetch_sub(&sleepingWorkers, 1);
+        mutexUnlock(&sleepLock);
+    }
+    return NULL;
+}
+
+static void wakeWorkers(int count) {
+    if (atomic_load(&sleepingWorkers) == 0) return;
+    mutexLock(&sleepLock);
+    if (count > 1) {
+        condBroadcast(&wakeCondition);
+    }
+    else {
+        condSignal(&wakeCondition);
+    }
+    mutexUnlock(&sleepLock);
+}
+
+void initJobSystem(int workerCount) {
+    if (initialized) return;
+
+    if (workerCount <= 0) {
+        workerCount = getCpuCount() - 1;
+    }
+    if (workerCount < 1) workerCount = 1;
+    if (workerCount > MAX_JOB_WORKERS - 1) workerCount = MAX_JOB_WORKERS - 1;
+
+    queueCount = workerCount + 1;
+    for (int i = 0; i < queueCount; i++) {
+        queues[i].top = 0;
+        queues[i].bottom = 0;
+        mutexInit(&queues[i].lock);
+    }
+    backgroundQueue.top = 0;
+    backgroundQueue.bottom = 0;
+    mutexInit(&backgroundQueue.lock);
+
+    mutexInit(&sleepLock);
+    condInit(&wakeCondition);
+    mutexInit(&frameOverflowLock);
+    atomic_store(&queuedJobs, 0);
+    atomic_store(&sleepingWorkers, 0);
+    atomic_store(&submitCursor, 0);
+    atomic_store(&frameOffset, 0);
+    atomic_store(&running, 1);
+
+    frameMemory = (unsigned char*)engineMalloc(JOB_FRAME_ALLOCATOR_SIZE);
+    if (!frameMemory) {
+        LOG_ERROR(LOG_CORE, "Failed to allocate job frame allocator.");
+    }
+
+    currentWorker = 0; // The initialising thread is the main thread
+    for (int i = 1; i < queueCount; i++) {
+        if (!threadCreate(&workers[i], workerMain, (void*)(size_t)i)) {
+            LOG_ERROR(LOG_CORE, "Failed to create job worker %d.", i);
+            queueCount = i;
+            break;
+        }
+    }
+
+    initialized = true;
+    LOG_INFO(LOG_CORE, "Job system started with %d worker threads.", queueCount - 1);
+}
+
+void shutdownJobSystem() {
+    if (!initialized) return;
+
+    // Drain whatever is still queued before stopping the workers
+    Job job;
+    while (findJob(currentWorker, &job, false)) {
+        executeJob(&job);
+    }
+    while (stealJob(&backgroundQueue, &job)) {
+        atomic_fetch_sub(&queuedJobs, 1);
+        executeJob(&job);
+    }
+
+    atomic_store(&running, 0);
+    mutexLock(&sleepLock);
+    condBroadcast(&wakeCondition);
+    mutexUnlock(&sleepLock);
+
+    for (int i = 1; i < queueCount; i++) {
+        threadJoin(workers[i]);
+    }
+    for (int i = 0; i < queueCount; i++) {
+        mutexDestroy(&queues[i].lock);
+    }
+    mutexDestroy(&backgroundQueue.lock);
+    mutexDestroy(&sleepLock);
+    condDestroy(&wakeCondition);
+
+    resetJobFrameAllocator();
+    mutexDestroy(&frameOverflowLock);
+    engineFree(frameMemory);
+    frameMemory = NULL;
+
+    queueCount = 0;
+    currentWorker = -1;
+    initialized = false;
+}
+
+int getJobWorkerCount() {
+    return queueCount;
+}
+
+int getCurrentJobWorker() {
+    return currentWorker;
+}
+
+int getQueuedJobCount() {
+    return atomic_load(&queuedJobs);
+}
+
+static void submitJob(Job job) {
+    if (!initialized) {
+        executeJob(&job);
+        return;
+    }
+
+    // Threads outside the pool spread their jobs over the worker queues
+    int target = currentWorker;
+    if (target < 0) {
+        target = (int)(atomic_fetch_add(&submitCursor, 1) % (unsigned int)queueCount);
+    }
+
+    atomic_fetch_add(&queuedJobs, 1);
+    if (!pushJob(&queues[target], job)) {
+        atomic_fetch_sub(&queuedJobs, 1);
+        executeJob(&job); // Queue full, run inline rather than drop it
+    }
+}
+
+void runJob(JobFunction function, void* data, JobCounter* counter) {
+    Job job = { function, data, counter };
+    if (counter) {
+        atomic_fetch_add(&counter->pending, 1);
+    }
+    submitJob(job);
+    wakeWorkers(1);
+}
+
+void runJobs(const Job* jobs, int count, JobCounter* counter) {
+    if (counter) {
+        atomic_fetch_add(&counter->pending, count);
+    }
+    for (int i = 0; i < count; i++) {
+        Job job = jobs[i];
+        job.counter = counter;
+        submitJob(job);
+    }
+    wakeWorkers(count);
+}
+
+void runBackgroundJob(JobFunction function, void* data, JobCounter* counter) {
+    Job job = { function, data, counter };
+    if (counter) {
+        atomic_fetch_add(&counter->pending, 1);
+    }
+    // Without worker threads there is nobody else to run it
+    if (!initialized || queueCount < 2) {
+        executeJob(&job);
+        return;
+    }
+
+    atomic_fetch_add(&queuedJobs, 1);
+    if (!pushJob(&backgroundQueue, job)) {
+        atomic_fetch_sub(&queuedJobs, 1);
+        executeJob(&job);
+        return;
+    }
+    wakeWorkers(1);
+}
+
+int isCounterDone(JobCounter* counter) {
+    return atomic_load(&counter->pending) <= 0;
+}
+
+void waitForCounter(JobCounter* counter) {
+    Job job;
+    while (atomic_load(&counter->pending) > 0) {
+        if (initialized && findJob(currentWorker, &job, false)) {
+            executeJob(&job);
+        }
+        else {
+            threadYield();
+        }
+    }
+}
+
+typedef struct {
+    ParallelForFunction function;
+    void* data;
+    int start;
+    int end;
+} ParallelForBatch;
+
+static void parallelForJob(void* data) {
+    ParallelForBatch* batch = (ParallelForBatch*)data;
+    batch->function(batch->start, batch->end, batch->data);
+}
+
+void parallelFor(int count, int batchSize, ParallelForFunction function, void* data) {
+    if (count <= 0) return;
+    if (batchSize < 1) batchSize = 1;
+
+    int batchCount = (count + batchSize - 1) / batchSize;
+    if (batchCount > MAX_PARALLEL_FOR_BATCHES) {
+        batchCount = MAX_PARALLEL_FOR_BATCHES;
+        batchSize = (count + batchCount - 1) / batchCount;
+    }
+
+    if (batchCount == 1 || !initialized) {
+        function(0, count, data);
+        return;
+    }
+
+    ParallelForBatch batches[MAX_PARALLEL_FOR_BATCHES];
+    Job jobs[MAX_PARALLEL_FOR_BATCHES];
+    int jobCount = 0;
+    for (int start = 0; start < count; start += batchSize) {
+        int end = start + batchSize < count ? start + batchSize : count;
+        batches[jobCount] = (ParallelForBatch){ function, data, start, end };
+        jobs[jobCount] = (Job){ parallelForJob, &batches[jobCount], NULL };
+        jobCount++;
+    }
+
+    JobCounter counter = { 0 };
+    runJobs(jobs, jobCount, &counter);
+    waitForCounter(&counter);
+}
+
+void* jobFrameAlloc(size_t size) {
+    size = (size + 15) & ~(size_t)15;
+
+    if (frameMemory) {
+        size_t offset = atomic_fetch_add(&frameOffset, size);
+        if (offset + size <= JOB_FRAME_ALLOCATOR_SIZE) {
+            return frameMemory + offset;
+        }
+    }
+
+    // Frame buffer exhausted: hand out a heap block that lives until the next reset
+    FrameOverflowBlock* block = (FrameOverflowBlock*)engineMalloc(sizeof(FrameOverflowBlock) + 16 + size);
+    if (!block) {
+        LOG_ERROR(LOG_CORE, "Job frame allocator out of memory.");
+        return NULL;
+    }
+    mutexLock(&frameOverflowLock);
+    block->next = frameOverflow;
+    frameOverflow = block;
+    mutexUnlock(&frameOverflowLock);
+    return (unsigned char*)block + 16;
+}
+
+void resetJobFrameAllocator() {
+    atomic_store(&frameOffset, 0);
+
+    mutexLock(&frameOverflowLock);
+    while (frameOverflow) {
+        FrameOverflowBlock* next = frameOverflow->next;
+        engineFree(frameOverflow);
+        frameOverflow = next;
+    }
+    mutexUnlock(&frameOverflowLock);
+}
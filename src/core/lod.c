@@ -0,0 +1,363 @@
+#include "lod.h"
+#include "allocators.h"
+#include "logger.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define BORDER_WEIGHT 10.0   // Border planes outweigh the faces, so open edges keep their outline
+#define MAX_SIMPLIFY_PASSES 64
+#define MIN_LEVEL_REDUCTION 0.8 // A level must drop at least a fifth of the previous level's triangles
+
+// Sum of weighted squared distances to a set of planes, as a symmetric 4x4 matrix
+typedef struct {
+    double a2, ab, ac, ad;
+    double b2, bc, bd;
+    double c2, cd;
+    double d2;
+    double weight;
+} Quadric;
+
+typedef struct {
+    float cost;
+    unsigned int from;
+    unsigned int to;
+} Collapse;
+
+static void addPlane(Quadric* q, double a, double b, double c, double d, double weight) {
+    q->a2 += a * a * weight; q->ab += a * b * weight; q->ac += a * c * weight; q->ad += a * d * weight;
+    q->b2 += b * b * weight; q->bc += b * c * weight; q->bd += b * d * weight;
+    q->c2 += c * c * weight; q->cd += c * d * weight;
+    q->d2 += d * d * weight;
+    q->weight += weight;
+}
+
+static void addQuadric(Quadric* q, const Quadric* other) {
+    q->a2 += other->a2; q->ab += other->ab; q->ac += other->ac; q->ad += other->ad;
+    q->b2 += other->b2; q->bc += other->bc; q->bd += other->bd;
+    q->c2 += other->c2; q->cd += other->cd;
+    q->d2 += other->d2;
+    q->weight += other->weight;
+}
+
+// Weighted mean squared distance from p to the planes
+static double quadricError(const Quadric* q, Vector3 p) {
+    double x = p.x, y = p.y, z = p.z;
+    double error = q->a2 * x * x + 2.0 * q->ab * x * y + 2.0 * q->ac * x * z + 2.0 * q->ad * x
+                 + q->b2 * y * y + 2.0 * q->bc * y * z + 2.0 * q->bd * y
+                 + q->c2 * z * z + 2.0 * q->cd * z
+                 + q->d2;
+    if (q->weight > 0.0) error /= q->weight;
+    return error > 0.0 ? error : 0.0;
+}
+
+static Vector3 triangleNormal(Vector3 a, Vector3 b, Vector3 c) {
+    return vector_cross(vector_sub(b, a), vector_sub(c, a));
+}
+
+static size_t hashKey(uint64_t key) {
+    key *= 0x9E3779B97F4A7C15ull;
+    return (size_t)(key ^ (key >> 31));
+}
+
+// Maps every vertex to the first one at the same position, so meshes split at UV or normal seams simplify as one surface
+static bool weldPositions(const Vector3* positions, unsigned int vertexCount, unsigned int* canonical) {
+    size_t capacity = 16;
+    while (capacity < (size_t)vertexCount * 2) capacity *= 2;
+    unsigned int* table = (unsigned int*)engineMalloc(capacity * sizeof(unsigned int));
+    if (!table) return false;
+    memset(table, 0xFF, capacity * sizeof(unsigned int));
+
+    for (unsigned int v = 0; v < vertexCount; v++) {
+        uint32_t bits[3];
+        memcpy(bits, &positions[v], sizeof(bits));
+        uint64_t key = ((uint64_t)bits[0] * 73856093u) ^ ((uint64_t)bits[1] * 19349663u) ^ ((uint64_t)bits[2] * 83492791u);
+        size_t slot = hashKey(key) & (capacity - 1);
+        while (table[slot] != UINT32_MAX && memcmp(&positions[table[slot]], &positions[v], sizeof(Vector3)) != 0) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        if (table[slot] == UINT32_MAX) table[slot] = v;
+        canonical[v] = table[slot];
+    }
+    engineFree(table);
+    return true;
+}
+
+// Open-addressed set of directed edges, to find the ones with no twin
+typedef struct {
+    uint64_t* keys;
+    size_t mask;
+} EdgeSet;
+
+static bool createEdgeSet(EdgeSet* set, unsigned int edgeCount) {
+    size_t capacity = 16;
+    while (capacity < (size_t)edgeCount * 2) capacity *= 2;
+    set->keys = (uint64_t*)engineMalloc(capacity * sizeof(uint64_t));
+    if (!set->keys) return false;
+    memset(set->keys, 0xFF, capacity * sizeof(uint64_t));
+    set->mask = capacity - 1;
+    return true;
+}
+
+static void insertEdge(EdgeSet* set, unsigned int from, unsigned int to) {
+    uint64_t key = (uint64_t)from << 32 | to;
+    size_t slot = hashKey(key) & set->mask;
+    while (set->keys[slot] != UINT64_MAX && set->keys[slot] != key) slot = (slot + 1) & set->mask;
+    set->keys[slot] = key;
+}
+
+static bool containsEdge(const EdgeSet* set, unsigned int from, unsigned int to) {
+    uint64_t key = (uint64_t)from << 32 | to;
+    for (size_t slot = hashKey(key) & set->mask; set->keys[slot] != UINT64_MAX; slot = (slot + 1) & set->mask) {
+        if (set->keys[slot] == key) return true;
+    }
+    return false;
+}
+
+// Face planes weighted by area, plus planes through every border edge at right angles to its face
+static bool buildQuadrics(const unsigned int* indices, unsigned int indexCount, const Vector3* positions,
+                          Quadric* quadrics, bool* border) {
+    EdgeSet edges;
+    if (!createEdgeSet(&edges, indexCount)) return false;
+    for (unsigned int i = 0; i < indexCount; i += 3) {
+        for (int e = 0; e < 3; e++) {
+            insertEdge(&edges, indices[i + e], indices[i + (e + 1) % 3]);
+        }
+    }
+
+    for (unsigned int i = 0; i < indexCount; i += 3) {
+        Vector3 p[3] = { positions[indices[i]], positions[indices[i + 1]], positions[indices[i + 2]] };
+        Vector3 normal = triangleNormal(p[0], p[1], p[2]);
+        float length = vector_length(normal);
+        if (length <= 0.0f) continue;
+        normal = vector_scale(normal, 1.0f / length);
+        double area = length * 0.5;
+        double d = -vector_dot(normal, p[0]);
+        for (int k = 0; k < 3; k++) {
+            addPlane(&quadrics[indices[i + k]], normal.x, normal.y, normal.z, d, area);
+        }
+
+        for (int e = 0; e < 3; e++) {
+            unsigned int a = indices[i + e], b = indices[i + (e + 1) % 3];
+            if (containsEdge(&edges, b, a)) continue;
+            Vector3 edge = vector_sub(p[(e + 1) % 3], p[e]);
+            Vector3 side = vector_cross(edge, normal);
+            float sideLength = vector_length(side);
+            if (sideLength <= 0.0f) continue;
+            side = vector_scale(side, 1.0f / sideLength);
+            double sideD = -vector_dot(side, p[e]);
+            double weight = vector_dot(edge, edge) * BORDER_WEIGHT;
+            addPlane(&quadrics[a], side.x, side.y, side.z, sideD, weight);
+            addPlane(&quadrics[b], side.x, side.y, side.z, sideD, weight);
+            border[a] = border[b] = true;
+        }
+    }
+    engineFree(edges.keys);
+    return true;
+}
+
+// Triangles around each vertex, as offsets into one list
+static void buildAdjacency(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount,
+                           unsigned int* offsets, unsigned int* triangles) {
+    memset(offsets, 0, (vertexCount + 1) * sizeof(unsigned int));
+    for (unsigned int i = 0; i < indexCount; i++) offsets[indices[i] + 1]++;
+    for (unsigned int v = 0; v < vertexCount; v++) offsets[v + 1] += offsets[v];
+    for (unsigned int i = 0; i < indexCount; i++) {
+        unsigned int v = indices[i];
+        triangles[offsets[v]++] = i / 3;
+    }
+    // offsets[v] now holds the end of v's run; shift back to starts
+    for (unsigned int v = vertexCount; v > 0; v--) offsets[v] = offsets[v - 1];
+    offsets[0] = 0;
+}
+
+// Moving from onto to must not turn any surviving triangle around from inside out
+static bool collapseFlips(const unsigned int* indices, const unsigned int* offsets, const unsigned int* triangles,
+                          const Vector3* positions, unsigned int from, unsigned int to) {
+    for (unsigned int t = offsets[from]; t < offsets[from + 1]; t++) {
+        const unsigned int* triangle = &indices[triangles[t] * 3];
+        if (triangle[0] == to || triangle[1] == to || triangle[2] == to) continue; // Collapses away
+        Vector3 before[3], after[3];
+        for (int k = 0; k < 3; k++) {
+            before[k] = positions[triangle[k]];
+            after[k] = triangle[k] == from ? positions[to] : before[k];
+        }
+        Vector3 oldNormal = triangleNormal(before[0], before[1], before[2]);
+        Vector3 newNormal = triangleNormal(after[0], after[1], after[2]);
+        if (vector_dot(oldNormal, newNormal) <= 0.0f) return true;
+    }
+    return false;
+}
+
+static int compareCollapses(const void* a, const void* b) {
+    float left = ((const Collapse*)a)->cost;
+    float right = ((const Collapse*)b)->cost;
+    return left < right ? -1 : left > right ? 1 : 0;
+}
+
+// Drops triangles that lost an edge, in place; returns the new index count
+static unsigned int removeDegenerates(unsigned int* indices, unsigned int indexCount) {
+    unsigned int written = 0;
+    for (unsigned int i = 0; i < indexCount; i += 3) {
+        unsigned int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        if (a == b || b == c || a == c) continue;
+        indices[written++] = a;
+        indices[written++] = b;
+        indices[written++] = c;
+    }
+    return written;
+}
+
+typedef struct {
+    unsigned int* canonical;
+    unsigned int* collapsed;   // Where each vertex moved this pass
+    unsigned int* offsets;
+    unsigned int* triangles;
+    Collapse* collapses;
+    Quadric* quadrics;
+    bool* border;
+    bool* locked;
+} SimplifyScratch;
+
+// destination holds the welded mesh; returns its index count once simplified
+static unsigned int collapseEdges(unsigned int* destination, unsigned int count, const Vector3* positions,
+                                  unsigned int vertexCount, unsigned int targetIndexCount, SimplifyScratch* scratch,
+                                  float* resultError) {
+    Quadric* quadrics = scratch->quadrics;
+    bool* border = scratch->border;
+    bool* locked = scratch->locked;
+
+    // Each pass collapses the cheapest edges whose neighbourhoods do not overlap, then compacts
+    double maxError = 0.0;
+    for (int pass = 0; pass < MAX_SIMPLIFY_PASSES && count > targetIndexCount; pass++) {
+        buildAdjacency(destination, count, vertexCount, scratch->offsets, scratch->triangles);
+
+        unsigned int candidateCount = 0;
+        for (unsigned int i = 0; i < count; i += 3) {
+            for (int e = 0; e < 3; e++) {
+                unsigned int a = destination[i + e], b = destination[i + (e + 1) % 3];
+                if (a > b && !border[a] && !border[b]) continue; // Interior edges appear twice; keep one
+                Quadric merged = quadrics[a];
+                addQuadric(&merged, &quadrics[b]);
+                // Border vertices may only slide along the border
+                double toB = !border[a] || border[b] ? quadricError(&merged, positions[b]) : -1.0;
+                double toA = !border[b] || border[a] ? quadricError(&merged, positions[a]) : -1.0;
+                if (toB < 0.0 && toA < 0.0) continue;
+                bool forward = toA < 0.0 || (toB >= 0.0 && toB <= toA);
+                scratch->collapses[candidateCount++] = forward
+                    ? (Collapse){ (float)toB, a, b }
+                    : (Collapse){ (float)toA, b, a };
+            }
+        }
+        qsort(scratch->collapses, candidateCount, sizeof(Collapse), compareCollapses);
+
+        // Each collapse removes about two triangles
+        unsigned int wanted = (count - targetIndexCount) / 6 + 1;
+        unsigned int performed = 0;
+        memset(locked, 0, vertexCount * sizeof(bool));
+        for (unsigned int v = 0; v < vertexCount; v++) scratch->collapsed[v] = v;
+
+        for (unsigned int c = 0; c < candidateCount && performed < wanted; c++) {
+            const Collapse* collapse = &scratch->collapses[c];
+            if (locked[collapse->from] || locked[collapse->to]) continue;
+            if (collapseFlips(destination, scratch->offsets, scratch->triangles, positions, collapse->from, collapse->to)) continue;
+
+            scratch->collapsed[collapse->from] = collapse->to;
+            addQuadric(&quadrics[collapse->to], &quadrics[collapse->from]);
+            if (collapse->cost > maxError) maxError = collapse->cost;
+            performed++;
+
+            // Nothing touching either end may change again this pass, so the adjacency stays valid
+            unsigned int ends[2] = { collapse->from, collapse->to };
+            for (int k = 0; k < 2; k++) {
+                for (unsigned int t = scratch->offsets[ends[k]]; t < scratch->offsets[ends[k] + 1]; t++) {
+                    const unsigned int* triangle = &destination[scratch->triangles[t] * 3];
+                    locked[triangle[0]] = locked[triangle[1]] = locked[triangle[2]] = true;
+                }
+            }
+        }
+        if (performed == 0) break;
+
+        for (unsigned int i = 0; i < count; i++) destination[i] = scratch->collapsed[destination[i]];
+        count = removeDegenerates(destination, count);
+    }
+    *resultError = (float)sqrt(maxError);
+    return count;
+}
+
+unsigned int simplifyMesh(unsigned int* destination, const unsigned int* indices, unsigned int indexCount,
+                          const Vector3* positions, unsigned int vertexCount, unsigned int targetIndexCount,
+                          float* resultError) {
+    *resultError = 0.0f;
+    size_t listSize = (indexCount > 0 ? indexCount : 1);
+    SimplifyScratch scratch;
+    scratch.canonical = (unsigned int*)engineMalloc(vertexCount * sizeof(unsigned int));
+    scratch.collapsed = (unsigned int*)engineMalloc(vertexCount * sizeof(unsigned int));
+    scratch.offsets = (unsigned int*)engineMalloc((vertexCount + 1) * sizeof(unsigned int));
+    scratch.triangles = (unsigned int*)engineMalloc(listSize * sizeof(unsigned int));
+    scratch.collapses = (Collapse*)engineMalloc(listSize * sizeof(Collapse));
+    scratch.quadrics = (Quadric*)engineCalloc(vertexCount, sizeof(Quadric));
+    scratch.border = (bool*)engineCalloc(vertexCount, sizeof(bool));
+    scratch.locked = (bool*)engineMalloc(vertexCount * sizeof(bool));
+
+    // A failure leaves the mesh as it was
+    unsigned int count = indexCount;
+    memcpy(destination, indices, indexCount * sizeof(unsigned int));
+    if (scratch.canonical && scratch.collapsed && scratch.offsets && scratch.triangles && scratch.collapses &&
+        scratch.quadrics && scratch.border && scratch.locked && weldPositions(positions, vertexCount, scratch.canonical)) {
+        for (unsigned int i = 0; i < indexCount; i++) destination[i] = scratch.canonical[indices[i]];
+        count = removeDegenerates(destination, indexCount);
+        if (buildQuadrics(destination, count, positions, scratch.quadrics, scratch.border)) {
+            count = collapseEdges(destination, count, positions, vertexCount, targetIndexCount, &scratch, resultError);
+        }
+    }
+    else {
+        LOG_ERROR(LOG_ASSETS, "Failed to allocate mesh simplification scratch.");
+    }
+
+    engineFree(scratch.canonical);
+    engineFree(scratch.collapsed);
+    engineFree(scratch.offsets);
+    engineFree(scratch.triangles);
+    engineFree(scratch.collapses);
+    engineFree(scratch.quadrics);
+    engineFree(scratch.border);
+    engineFree(scratch.locked);
+    return count;
+}
+
+unsigned int buildLodChain(unsigned int** indices, unsigned int indexCount, const Vector3* positions,
+                           unsigned int vertexCount, LodChain* chain) {
+    chain->levels[0] = (LodLevel){ 0, indexCount, 0.0f };
+    chain->levelCount = 1;
+    unsigned int total = indexCount;
+
+    while (chain->levelCount < MAX_LOD_LEVELS) {
+        LodLevel previous = chain->levels[chain->levelCount - 1];
+        if (previous.indexCount / 3 < LOD_MIN_TRIANGLES) break;
+
+        unsigned int* grown = (unsigned int*)engineRealloc(*indices, (total + previous.indexCount) * sizeof(unsigned int));
+        if (!grown) break;
+        *indices = grown;
+
+        unsigned int target = (unsigned int)(previous.indexCount / 3 * LOD_REDUCTION) * 3;
+        float error;
+        unsigned int count = simplifyMesh(*indices + total, *indices + previous.firstIndex, previous.indexCount,
+                                          positions, vertexCount, target, &error);
+        if (count == 0 || count > previous.indexCount * MIN_LEVEL_REDUCTION) break;
+
+        // Errors add up because each level is simplified from the one before
+        chain->levels[chain->levelCount++] = (LodLevel){ total, count, previous.error + error };
+        total += count;
+    }
+    return total;
+}
+
+int selectLodLevel(const LodChain* chain, float pixelsPerUnit, float maxPixelError) {
+    int level = 0;
+    for (int i = 1; i < chain->levelCount; i++) {
+        if (chain->levels[i].error * pixelsPerUnit > maxPixelError) break;
+        level = i;
+    }
+    return level;
+}
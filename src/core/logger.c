@@ -0,0 +1,524 @@
+#include "logger.h"
+#include "threading.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+
+atomic_int logCategoryLevels[LOG_CATEGORY_COUNT] = {
+    LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL
+};
+
+static const char* levelNames[] = { "trace", "debug", "info", "warn", "error", "none" };
+static const char* categoryNames[] = { "core", "scene", "render", "assets", "gui" };
+
+typedef struct {
+    uint32_t size;       // Header and arguments
+    uint8_t level;
+    uint8_t category;
+    uint16_t suppressed; // Messages from this call site dropped by the rate limit just before
+    double time;
+    const char* format;
+} LogRecord;
+
+// Single producer (the owning thread), single consumer (the logger thread).
+// Positions only grow; the byte offset is position % LOG_RING_SIZE.
+typedef struct {
+    _Alignas(64) atomic_size_t head;
+    _Alignas(64) atomic_size_t tail;
+    unsigned char data[LOG_RING_SIZE];
+} LogRing;
+
+static _Atomic(LogRing*) rings[LOG_MAX_THREADS];
+static atomic_int ringCount = 0;
+static THREAD_LOCAL LogRing* threadRing = NULL;
+static THREAD_LOCAL bool threadRingFailed = false;
+
+static atomic_bool running = false;
+static atomic_bool stopping = false;
+static atomic_uint droppedRecords = 0;
+static Thread loggerThread;
+static Mutex wakeMutex;
+static CondVar wakeCondition;
+static double startTime = 0.0;
+
+static double logClock() {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+// ---- Format parsing, shared by the call site and the logger thread ----
+
+typedef struct {
+    const char* end;         // One past the conversion character
+    const char* lengthStart; // Flags, width and precision end here
+    bool widthArg;           // '*'
+    bool precisionArg;
+    int precision;           // -1 if none was given
+    char length[3];          // "", "hh", "h", "l", "ll", "z", "j", "t" or "L"
+    char conversion;
+} LogSpec;
+
+// p points at the character after '%'
+static void parseSpec(const char* p, LogSpec* spec) {
+    memset(spec, 0, sizeof(*spec));
+    spec->precision = -1;
+    while (*p && strchr("-+ #0", *p)) p++;
+    if (*p == '*') {
+        spec->widthArg = true;
+        p++;
+    }
+    while (isdigit((unsigned char)*p)) p++;
+    if (*p == '.') {
+        p++;
+        spec->precision = 0;
+        if (*p == '*') {
+            spec->precisionArg = true;
+            p++;
+        }
+        while (isdigit((unsigned char)*p)) {
+            spec->precision = spec->precision * 10 + (*p - '0');
+            p++;
+        }
+    }
+    spec->lengthStart = p;
+    int n = 0;
+    while (*p && strchr("hlzjtL", *p) && n < 2) {
+        spec->length[n++] = *p++;
+    }
+    spec->conversion = *p;
+    spec->end = *p ? p + 1 : p;
+}
+
+static bool isSignedConversion(char c) { return c == 'd' || c == 'i'; }
+static bool isUnsignedConversion(char c) { return c == 'u' || c == 'o' || c == 'x' || c == 'X'; }
+static bool isFloatConversion(char c) { return c && strchr("fFeEgGaA", c) != NULL; }
+
+// ---- Capture ----
+
+typedef struct {
+    unsigned char* data;
+    size_t size;
+    size_t capacity;
+} ArgWriter;
+
+static void putBytes(ArgWriter* writer, const void* bytes, size_t size) {
+    if (writer->size + size > writer->capacity) {
+        size = writer->capacity > writer->size ? writer->capacity - writer->size : 0;
+    }
+    memcpy(writer->data + writer->size, bytes, size);
+    writer->size += size;
+}
+
+static void putInt(ArgWriter* writer, long long value) { putBytes(writer, &value, sizeof(value)); }
+
+static void putString(ArgWriter* writer, const char* text, int precision) {
+    if (!text) text = "(null)";
+    size_t room = writer->capacity > writer->size ? writer->capacity - writer->size : 0;
+    size_t length = 0;
+    size_t limit = precision >= 0 ? (size_t)precision : room;
+    while (length < limit && length + 1 < room && text[length]) length++; // Strings need not be terminated with a precision
+    putBytes(writer, text, length);
+    putBytes(writer, "", 1);
+}
+
+// Copies every argument the format consumes, widened to 64 bits
+static void captureArgs(ArgWriter* writer, const char* format, va_list args) {
+    for (const char* p = format; *p; p++) {
+        if (*p != '%') continue;
+        if (p[1] == '%') {
+            p++;
+            continue;
+        }
+        LogSpec spec;
+        parseSpec(p + 1, &spec);
+        if (spec.widthArg) putInt(writer, va_arg(args, int));
+        int precision = spec.precision;
+        if (spec.precisionArg) {
+            precision = va_arg(args, int);
+            putInt(writer, precision);
+        }
+
+        const char* length = spec.length;
+        if (isSignedConversion(spec.conversion)) {
+            long long value;
+            if (strcmp(length, "l") == 0) value = va_arg(args, long);
+            else if (strcmp(length, "ll") == 0) value = va_arg(args, long long);
+            else if (strcmp(length, "z") == 0) value = (long long)va_arg(args, size_t);
+            else if (strcmp(length, "j") == 0) value = (long long)va_arg(args, intmax_t);
+            else if (strcmp(length, "t") == 0) value = (long long)va_arg(args, ptrdiff_t);
+            else value = va_arg(args, int);
+            putInt(writer, value);
+        }
+        else if (isUnsignedConversion(spec.conversion)) {
+            unsigned long long value;
+            if (strcmp(length, "l") == 0) value = va_arg(args, unsigned long);
+            else if (strcmp(length, "ll") == 0) value = va_arg(args, unsigned long long);
+            else if (strcmp(length, "z") == 0) value = va_arg(args, size_t);
+            else if (strcmp(length, "j") == 0) value = (unsigned long long)va_arg(args, uintmax_t);
+            else if (strcmp(length, "t") == 0) value = (unsigned long long)va_arg(args, ptrdiff_t);
+            else value = va_arg(args, unsigned int);
+            putBytes(writer, &value, sizeof(value));
+        }
+        else if (spec.conversion == 'c') {
+            putInt(writer, va_arg(args, int));
+        }
+        else if (isFloatConversion(spec.conversion)) {
+            double value = strcmp(length, "L") == 0 ? (double)va_arg(args, long double) : va_arg(args, double);
+            putBytes(writer, &value, sizeof(value));
+        }
+        else if (spec.conversion == 's') {
+            putString(writer, va_arg(args, const char*), precision);
+        }
+        else if (spec.conversion == 'p' || spec.conversion == 'n') {
+            void* value = va_arg(args, void*);
+            putBytes(writer, &value, sizeof(value));
+        }
+        p = spec.end - 1;
+    }
+}
+
+// ---- Formatting ----
+
+typedef struct {
+    const unsigned char* data;
+    size_t size;
+    size_t offset;
+} ArgReader;
+
+static void getBytes(ArgReader* reader, void* bytes, size_t size) {
+    if (reader->offset + size > reader->size) {
+        memset(bytes, 0, size); // Cut off by LOG_MAX_RECORD
+        reader->offset = reader->size;
+        return;
+    }
+    memcpy(bytes, reader->data + reader->offset, size);
+    reader->offset += size;
+}
+
+static long long getInt(ArgReader* reader) {
+    long long value;
+    getBytes(reader, &value, sizeof(value));
+    return value;
+}
+
+static void appendText(char* out, size_t size, size_t* used, const char* text, size_t length) {
+    if (*used + 1 >= size) return;
+    if (length > size - *used - 1) length = size - *used - 1;
+    memcpy(out + *used, text, length);
+    *used += length;
+    out[*used] = '\0';
+}
+
+// Replays the format one conversion at a time against the captured arguments
+static void formatRecord(char* out, size_t size, const char* format, ArgReader* reader) {
+    size_t used = 0;
+    out[0] = '\0';
+    const char* p = format;
+    while (*p) {
+        const char* percent = strchr(p, '%');
+        if (!percent) {
+            appendText(out, size, &used, p, strlen(p));
+            break;
+        }
+        appendText(out, size, &used, p, (size_t)(percent - p));
+        if (percent[1] == '%') {
+            appendText(out, size, &used, "%", 1);
+            p = percent + 2;
+            continue;
+        }
+        LogSpec spec;
+        parseSpec(percent + 1, &spec);
+        p = spec.end;
+
+        // Rebuild the conversion with any '*' replaced by its captured value
+        char conversion[64];
+        size_t n = 0;
+        for (const char* c = percent; c < spec.lengthStart && n + 12 < sizeof(conversion); c++) {
+            if (*c == '*') n += (size_t)snprintf(conversion + n, sizeof(conversion) - n, "%d", (int)getInt(reader));
+            else conversion[n++] = *c;
+        }
+
+        char piece[LOG_MAX_RECORD];
+        piece[0] = '\0';
+        if (isSignedConversion(spec.conversion) || isUnsignedConversion(spec.conversion)) {
+            snprintf(conversion + n, sizeof(conversion) - n, "ll%c", spec.conversion);
+            long long value = getInt(reader);
+            if (isSignedConversion(spec.conversion)) snprintf(piece, sizeof(piece), conversion, value);
+            else snprintf(piece, sizeof(piece), conversion, (unsigned long long)value);
+        }
+        else if (spec.conversion == 'c') {
+            snprintf(conversion + n, sizeof(conversion) - n, "c");
+            snprintf(piece, sizeof(piece), conversion, (int)getInt(reader));
+        }
+        else if (isFloatConversion(spec.conversion)) {
+            snprintf(conversion + n, sizeof(conversion) - n, "%c", spec.conversion);
+            double value;
+            getBytes(reader, &value, sizeof(value));
+            snprintf(piece, sizeof(piece), conversion, value);
+        }
+        else if (spec.conversion == 's') {
+            snprintf(conversion + n, sizeof(conversion) - n, "s");
+            const char* text = (const char*)reader->data + reader->offset;
+            size_t remaining = reader->size - reader->offset;
+            const char* terminator = memchr(text, '\0', remaining);
+            size_t length = terminator ? (size_t)(terminator - text) : remaining;
+            reader->offset += terminator ? length + 1 : length;
+            char copy[LOG_MAX_RECORD];
+            memcpy(copy, text, length);
+            copy[length] = '\0';
+            snprintf(piece, sizeof(piece), conversion, copy);
+        }
+        else if (spec.conversion == 'p') {
+            snprintf(conversion + n, sizeof(conversion) - n, "p");
+            void* value;
+            getBytes(reader, &value, sizeof(value));
+            snprintf(piece, sizeof(piece), conversion, value);
+        }
+        else if (spec.conversion == 'n') {
+            void* ignored;
+            getBytes(reader, &ignored, sizeof(ignored));
+        }
+        appendText(out, size, &used, piece, strlen(piece));
+    }
+}
+
+static void writeLine(LogLevel level, LogCategory category, double time, bool timed, const char* message, int suppressed) {
+    FILE* stream = level >= LOG_LEVEL_WARN ? stderr : stdout;
+    if (timed) fprintf(stream, "[%9.3f] ", time - startTime);
+    fprintf(stream, "%s %s: %s", categoryNames[category], levelNames[level], message);
+    if (suppressed > 0) fprintf(stream, " (%d similar messages suppressed)", suppressed);
+    fputc('\n', stream);
+}
+
+// ---- Rings ----
+
+static LogRing* acquireThreadRing() {
+    if (threadRing || threadRingFailed) return threadRing;
+    int index = atomic_fetch_add(&ringCount, 1);
+    LogRing* ring = index < LOG_MAX_THREADS ? (LogRing*)calloc(1, sizeof(LogRing)) : NULL;
+    if (!ring) {
+        threadRingFailed = true; // This thread logs synchronously instead
+        return NULL;
+    }
+    atomic_store(&rings[index], ring);
+    threadRing = ring;
+    return ring;
+}
+
+static void ringCopyIn(LogRing* ring, size_t position, const void* bytes, size_t size) {
+    size_t offset = position % LOG_RING_SIZE;
+    size_t first = size < LOG_RING_SIZE - offset ? size : LOG_RING_SIZE - offset;
+    memcpy(ring->data + offset, bytes, first);
+    memcpy(ring->data, (const unsigned char*)bytes + first, size - first);
+}
+
+static void ringCopyOut(const LogRing* ring, size_t position, void* bytes, size_t size) {
+    size_t offset = position % LOG_RING_SIZE;
+    size_t first = size < LOG_RING_SIZE - offset ? size : LOG_RING_SIZE - offset;
+    memcpy(bytes, ring->data + offset, first);
+    memcpy((unsigned char*)bytes + first, ring->data, size - first);
+}
+
+static bool ringPush(LogRing* ring, const LogRecord* record, const void* args, size_t argSize) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (LOG_RING_SIZE - (head - tail) < record->size) {
+        return false;
+    }
+    ringCopyIn(ring, head, record, sizeof(LogRecord));
+    ringCopyIn(ring, head + sizeof(LogRecord), args, argSize);
+    atomic_store_explicit(&ring->head, head + record->size, memory_order_release);
+    return true;
+}
+
+// Writes every queued record, oldest first across all threads
+static void drainRings() {
+    int count = atomic_load(&ringCount);
+    if (count > LOG_MAX_THREADS) count = LOG_MAX_THREADS;
+    unsigned char args[LOG_MAX_RECORD];
+    char message[LOG_MAX_RECORD];
+
+    for (;;) {
+        LogRing* oldest = NULL;
+        LogRecord oldestRecord;
+        for (int i = 0; i < count; i++) {
+            LogRing* ring = atomic_load(&rings[i]);
+            if (!ring) continue;
+            size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+            size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+            if (tail == head) continue;
+            LogRecord record;
+            ringCopyOut(ring, tail, &record, sizeof(record));
+            if (!oldest || record.time < oldestRecord.time) {
+                oldest = ring;
+                oldestRecord = record;
+            }
+        }
+        if (!oldest) break;
+
+        size_t tail = atomic_load_explicit(&oldest->tail, memory_order_relaxed);
+        size_t argSize = oldestRecord.size - sizeof(LogRecord);
+        ringCopyOut(oldest, tail + sizeof(LogRecord), args, argSize);
+        atomic_store_explicit(&oldest->tail, tail + oldestRecord.size, memory_order_release);
+
+        ArgReader reader = { args, argSize, 0 };
+        formatRecord(message, sizeof(message), oldestRecord.format, &reader);
+        writeLine((LogLevel)oldestRecord.level, (LogCategory)oldestRecord.category, oldestRecord.time, true,
+                  message, oldestRecord.suppressed);
+    }
+
+    unsigned int dropped = atomic_exchange(&droppedRecords, 0);
+    if (dropped > 0) {
+        fprintf(stderr, "core warn: %u log messages were dropped; the log buffer was full\n", dropped);
+    }
+    fflush(stdout);
+    fflush(stderr);
+}
+
+static void* loggerMain(void* arg) {
+    (void)arg;
+    mutexLock(&wakeMutex);
+    while (!atomic_load(&stopping)) {
+        condTimedWait(&wakeCondition, &wakeMutex, LOG_FLUSH_INTERVAL_MS);
+        mutexUnlock(&wakeMutex);
+        drainRings();
+        mutexLock(&wakeMutex);
+    }
+    mutexUnlock(&wakeMutex);
+    drainRings();
+    return NULL;
+}
+
+// ---- Public API ----
+
+// -1 if the name is not a level
+static int parseLevel(const char* text, size_t length) {
+    for (int level = LOG_LEVEL_TRACE; level <= LOG_LEVEL_NONE; level++) {
+        if (strlen(levelNames[level]) == length && strncmp(text, levelNames[level], length) == 0) {
+            return level;
+        }
+    }
+    return -1;
+}
+
+// "info", or "scene=trace,render=warn"; entries are applied in order
+static void applyLogSetting(const char* setting) {
+    while (*setting) {
+        size_t length = strcspn(setting, ",");
+        const char* equals = memchr(setting, '=', length);
+        if (!equals) {
+            int level = parseLevel(setting, length);
+            for (int i = 0; i < LOG_CATEGORY_COUNT && level >= 0; i++) setLogLevel((LogCategory)i, (LogLevel)level);
+        }
+        else {
+            int level = parseLevel(equals + 1, length - (size_t)(equals - setting) - 1);
+            for (int i = 0; i < LOG_CATEGORY_COUNT; i++) {
+                size_t nameLength = (size_t)(equals - setting);
+                if (level >= 0 && strlen(categoryNames[i]) == nameLength && strncmp(setting, categoryNames[i], nameLength) == 0) {
+                    setLogLevel((LogCategory)i, (LogLevel)level);
+                }
+            }
+        }
+        setting += length;
+        if (*setting == ',') setting++;
+    }
+}
+
+void initLogger() {
+    if (atomic_load(&running)) return;
+    startTime = logClock();
+    const char* setting = getenv("CLUE_LOG");
+    if (setting) applyLogSetting(setting);
+
+    mutexInit(&wakeMutex);
+    condInit(&wakeCondition);
+    atomic_store(&stopping, false);
+    if (!threadCreate(&loggerThread, loggerMain, NULL)) {
+        fprintf(stderr, "Failed to start the logger thread; logging synchronously.\n");
+        return;
+    }
+    atomic_store(&running, true);
+    atexit(shutdownLogger); // exit() from anywhere still writes what is queued
+}
+
+void shutdownLogger() {
+    if (!atomic_exchange(&running, false)) return;
+    mutexLock(&wakeMutex);
+    atomic_store(&stopping, true);
+    condSignal(&wakeCondition);
+    mutexUnlock(&wakeMutex);
+    threadJoin(loggerThread);
+    drainRings(); // Anything pushed while the thread was finishing
+    // Rings stay allocated: threads keep their pointer, and log synchronously from now on
+    condDestroy(&wakeCondition);
+    mutexDestroy(&wakeMutex);
+}
+
+void setLogLevel(LogCategory category, LogLevel level) {
+    if ((int)category < 0 || category >= LOG_CATEGORY_COUNT) return;
+    atomic_store(&logCategoryLevels[category], (int)level);
+}
+
+static bool passRateLimit(LogSite* site, double now, int* suppressed) {
+    long long milliseconds = (long long)(now * 1000.0);
+    long long windowStart = atomic_load_explicit(&site->windowStart, memory_order_relaxed);
+    if (milliseconds - windowStart >= 1000 &&
+        atomic_compare_exchange_strong(&site->windowStart, &windowStart, milliseconds)) {
+        atomic_store(&site->count, 0);
+    }
+    if (atomic_fetch_add(&site->count, 1) >= LOG_RATE_LIMIT) {
+        atomic_fetch_add(&site->suppressed, 1);
+        return false;
+    }
+    *suppressed = atomic_exchange(&site->suppressed, 0);
+    return true;
+}
+
+void logWrite(LogSite* site, LogLevel level, LogCategory category, const char* format, ...) {
+    double now = logClock();
+    int suppressed = 0;
+    if (site && !passRateLimit(site, now, &suppressed)) {
+        return;
+    }
+
+    LogRing* ring = atomic_load(&running) ? acquireThreadRing() : NULL;
+    if (!ring) {
+        // Before start-up, after shutdown, or out of rings: format here
+        char message[LOG_MAX_RECORD];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(message, sizeof(message), format, args);
+        va_end(args);
+        writeLine(level, category, now, startTime > 0.0, message, suppressed);
+        return;
+    }
+
+    unsigned char argBuffer[LOG_MAX_RECORD - sizeof(LogRecord)];
+    ArgWriter writer = { argBuffer, 0, sizeof(argBuffer) };
+    va_list args;
+    va_start(args, format);
+    captureArgs(&writer, format, args);
+    va_end(args);
+
+    LogRecord record;
+    record.size = (uint32_t)(sizeof(LogRecord) + writer.size);
+    record.level = (uint8_t)level;
+    record.category = (uint8_t)category;
+    record.suppressed = (uint16_t)(suppressed > UINT16_MAX ? UINT16_MAX : suppressed);
+    record.time = now;
+    record.format = format;
+    if (!ringPush(ring, &record, argBuffer, writer.size)) {
+        atomic_fetch_add(&droppedRecords, 1); // Never block the caller on a slow console
+    }
+}
@@ -1,6 +1,17 @@
 #include "gui.h"
 #include "rendering.h"
 #include "globals.h"
+#include "jobs.h"
+#include "frame_packet.h"
+#include "texture_streaming.h"
+#include "materials.h"
+#include "asset_registry.h"
+#include "project_save.h"
+#include "change_journal.h"
+#include "redraw.h"
+#include "allocators.h"
+#include "metrics.h"
+#include "frame_stream.h"
 
 int main(void) {
     #ifdef _WIN32
@@ -14,26 +25,42 @@ int main(void) {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);  // Clear buffers to set initial background
     glfwSwapBuffers(screen.window);  // Display the initial cleared screen
     run_loading_screen(screen.window);  // Display and run the loading screen
+    recoverChangeJournal();  // Restore the scene if the last session crashed
     glfwSetKeyCallback(screen.window, key_callback);  // Set key callbacks for user input
     glfwSetFramebufferSizeCallback(screen.window, framebuffer_size_callback); // Handle window resizing
+    initRedraw(screen.window);  // Wraps the input callbacks to know when a frame needs drawing
 
     while (!glfwWindowShouldClose(screen.window)) {
-        glfwPollEvents();  // Handle GLFW events such as input and window actions
+        // Handle GLFW events; blocks while nothing on screen would change
+        if (waitForRedraw()) {
+            double frameStart = glfwGetTime();
+            generate_new_frame();
 
-        generate_new_frame();
+            if (isRunning) {
+                update(calculateDeltaTime());  // Update game logic only if the simulation is running
+            }
 
-        if (isRunning) {
-            update(calculateDeltaTime());  // Update game logic only if the simulation is running
-        }
-
-        handleMouseInput(screen.window, &camera);  // Manage mouse input for camera control
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);  // Clear the screen each frame
-        render();  // Render the scene, including the loaded model if any
+            handleMouseInput(screen.window, &camera);  // Manage mouse input for camera control
+            main_gui();  // Update the GUI elements; the scene is not mutated after this point
 
-        main_gui();  // Update the GUI elements
-        render_nuklear();  // Render the GUI to the screen
+            kickFramePacketBuild();  // Snapshot this frame's scene on a worker...
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);  // Clear the screen each frame
+            render();  // ...while the previous snapshot is submitted to GL
+            render_nuklear();  // Render the GUI to the screen
+            captureStreamFrame();  // Queues a readback of the finished frame if anyone is watching
 
-        glfwSwapBuffers(screen.window);  // Swap the front and back buffers
+            glfwSwapBuffers(screen.window);  // Swap the front and back buffers
+            syncFramePacketBuild();  // Publish the new snapshot before the next frame mutates the scene
+            endAllocationFrame();  // Counts heap allocations since the last drawn frame
+            observeFrameTime(glfwGetTime() - frameStart);
+        }
+        collectAssets();         // Destroy assets nothing has referenced for a couple of frames
+        updateProjectSave(glfwGetTime()); // Snapshots for saving are taken here, between frames
+        updateChangeJournal(glfwGetTime()); // Append buffered edits, or checkpoint the scene
+        updateTextureStreaming();  // Upload decoded mips and apply the residency budget
+        updateMaterialPacking();  // Copy finished materials into their texture array layers
+        resetJobFrameAllocator();  // Frame-scoped job memory is only valid until the swap
+        updateMetrics();  // Publishes gauges for the metrics endpoint, if it is running
     }
 
     teardown_nuklear();  // Clean up Nuklear GUI resources
@@ -0,0 +1,280 @@
+#include "memory_accounting.h"
+#include "asset_registry.h"
+#include "allocators.h"
+#include "logger.h"
+#include "cJSON/cJSON.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RECORD_INITIAL_SIZE 1024
+
+enum { RECORD_EMPTY, RECORD_USED, RECORD_REMOVED };
+
+typedef struct {
+    uintptr_t id;
+    const char* owner; // Interned, so owners are compared by pointer
+    size_t bytes;
+    unsigned char resource;
+    unsigned char category;
+    unsigned char state;
+} MemoryRecord;
+
+static const char* categoryNames[MEMORY_CATEGORY_COUNT] = {
+    "vertex buffers",
+    "index buffers",
+    "textures",
+    "cubemaps",
+    "material arrays",
+    "render targets",
+    "staging buffers",
+    "mesh indices",
+    "undo history"
+};
+
+static MemoryRecord* records = NULL;
+static size_t recordCapacity = 0; // Power of two
+static size_t recordCount = 0;
+static size_t removedCount = 0;
+static MemoryUsage usage[MEMORY_CATEGORY_COUNT];
+static MemoryUsage gpuUsage;
+static MemoryUsage hostUsage;
+
+static MemoryOwnerUsage* ownerUsage = NULL; // Scratch for getMemoryOwners()
+static int* ownerSlots = NULL;
+static size_t ownerCapacity = 0;
+
+static size_t hashRecord(TrackedResource resource, uintptr_t id) {
+    unsigned long long value = ((unsigned long long)id << 2 | (unsigned)resource) * 0x9E3779B97F4A7C15ull;
+    return (size_t)(value ^ (value >> 29));
+}
+
+static MemoryRecord* findRecord(TrackedResource resource, uintptr_t id) {
+    if (!records) return NULL;
+    size_t mask = recordCapacity - 1;
+    for (size_t slot = hashRecord(resource, id) & mask; records[slot].state != RECORD_EMPTY; slot = (slot + 1) & mask) {
+        MemoryRecord* record = &records[slot];
+        if (record->state == RECORD_USED && record->id == id && record->resource == (unsigned char)resource) {
+            return record;
+        }
+    }
+    return NULL;
+}
+
+// Also rebuilds in place when removed slots, rather than records, fill the table
+static bool growRecords() {
+    size_t newCapacity = recordCapacity ? recordCapacity : RECORD_INITIAL_SIZE;
+    if ((recordCount + 1) * 4 > newCapacity) newCapacity *= 2;
+    MemoryRecord* table = (MemoryRecord*)engineCalloc(newCapacity, sizeof(MemoryRecord));
+    if (!table) return false;
+    for (size_t i = 0; i < recordCapacity; i++) {
+        if (records[i].state != RECORD_USED) continue;
+        size_t slot = hashRecord((TrackedResource)records[i].resource, records[i].id) & (newCapacity - 1);
+        while (table[slot].state != RECORD_EMPTY) slot = (slot + 1) & (newCapacity - 1);
+        table[slot] = records[i];
+    }
+    engineFree(records);
+    records = table;
+    recordCapacity = newCapacity;
+    removedCount = 0;
+    return true;
+}
+
+static void addUsage(MemoryUsage* target, long long bytes, int count) {
+    target->bytes += bytes;
+    target->count += count;
+    if (target->bytes > target->peakBytes) target->peakBytes = target->bytes;
+}
+
+static void applyRecord(const MemoryRecord* record, int sign) {
+    long long bytes = sign * (long long)record->bytes;
+    addUsage(&usage[record->category], bytes, sign);
+    addUsage(record->category < MEMORY_FIRST_HOST_CATEGORY ? &gpuUsage : &hostUsage, bytes, sign);
+}
+
+void trackMemory(TrackedResource resource, uintptr_t id, MemoryCategory category, size_t bytes, const char* owner) {
+    if (bytes == 0) {
+        untrackMemory(resource, id);
+        return;
+    }
+    MemoryRecord* record = findRecord(resource, id);
+    if (record) {
+        applyRecord(record, -1);
+    }
+    else {
+        if ((recordCount + removedCount + 1) * 2 > recordCapacity && !growRecords()) {
+            LOG_ERROR(LOG_CORE, "Failed to grow the memory accounting table.");
+            return;
+        }
+        size_t slot = hashRecord(resource, id) & (recordCapacity - 1);
+        while (records[slot].state == RECORD_USED) slot = (slot + 1) & (recordCapacity - 1);
+        if (records[slot].state == RECORD_REMOVED) removedCount--;
+        record = &records[slot];
+        record->id = id;
+        record->resource = (unsigned char)resource;
+        record->state = RECORD_USED;
+        recordCount++;
+    }
+    record->category = (unsigned char)category;
+    record->bytes = bytes;
+    record->owner = internString(owner ? owner : "unknown");
+    applyRecord(record, 1);
+}
+
+void untrackMemory(TrackedResource resource, uintptr_t id) {
+    MemoryRecord* record = findRecord(resource, id);
+    if (!record) return;
+    applyRecord(record, -1);
+    record->state = RECORD_REMOVED;
+    recordCount--;
+    removedCount++;
+}
+
+size_t textureMemorySize(int width, int height, int layers, int levels, int bytesPerTexel) {
+    size_t bytes = 0;
+    for (int level = 0; level < levels; level++) {
+        bytes += (size_t)width * height;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return bytes * layers * bytesPerTexel;
+}
+
+const char* getMemoryCategoryName(MemoryCategory category) {
+    return category < MEMORY_CATEGORY_COUNT ? categoryNames[category] : "unknown";
+}
+
+void getMemoryTotals(MemoryTotals* totals) {
+    memcpy(totals->categories, usage, sizeof(usage));
+    totals->gpu = gpuUsage;
+    totals->host = hostUsage;
+
+    AllocationStats allocations;
+    getAllocationStats(&allocations);
+    totals->heapBytes = allocations.liveBytes;
+    totals->heapPeakBytes = allocations.peakBytes;
+}
+
+static int compareOwners(const void* a, const void* b) {
+    unsigned long long left = ((const MemoryOwnerUsage*)a)->bytes;
+    unsigned long long right = ((const MemoryOwnerUsage*)b)->bytes;
+    return left < right ? 1 : left > right ? -1 : 0;
+}
+
+int getMemoryOwners(const MemoryOwnerUsage** owners) {
+    *owners = ownerUsage;
+    if (recordCount == 0) return 0;
+
+    // Owners are grouped through a table of indices keyed by the interned pointer
+    size_t slots = ownerCapacity ? ownerCapacity : 64;
+    while (slots < recordCount * 2) slots *= 2;
+    if (slots != ownerCapacity) {
+        MemoryOwnerUsage* usageArray = (MemoryOwnerUsage*)engineRealloc(ownerUsage, slots / 2 * sizeof(MemoryOwnerUsage));
+        if (usageArray) ownerUsage = usageArray;
+        int* slotArray = (int*)engineRealloc(ownerSlots, slots * sizeof(int));
+        if (slotArray) ownerSlots = slotArray;
+        if (!usageArray || !slotArray) {
+            *owners = ownerUsage;
+            return 0;
+        }
+        ownerCapacity = slots;
+    }
+    memset(ownerSlots, 0xFF, ownerCapacity * sizeof(int));
+
+    int count = 0;
+    for (size_t i = 0; i < recordCapacity; i++) {
+        const MemoryRecord* record = &records[i];
+        if (record->state != RECORD_USED) continue;
+        uintptr_t key = (uintptr_t)record->owner;
+        size_t slot = (size_t)((key >> 4) * 2654435761u) & (ownerCapacity - 1);
+        while (ownerSlots[slot] >= 0 && ownerUsage[ownerSlots[slot]].owner != record->owner) {
+            slot = (slot + 1) & (ownerCapacity - 1);
+        }
+        if (ownerSlots[slot] < 0) {
+            ownerSlots[slot] = count;
+            memset(&ownerUsage[count], 0, sizeof(MemoryOwnerUsage));
+            ownerUsage[count++].owner = record->owner;
+        }
+        MemoryOwnerUsage* owner = &ownerUsage[ownerSlots[slot]];
+        owner->bytes += record->bytes;
+        owner->categoryBytes[record->category] += record->bytes;
+    }
+    qsort(ownerUsage, count, sizeof(MemoryOwnerUsage), compareOwners);
+    *owners = ownerUsage;
+    return count;
+}
+
+static cJSON* usageToJson(const MemoryUsage* memoryUsage) {
+    cJSON* json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "bytes", (double)memoryUsage->bytes);
+    cJSON_AddNumberToObject(json, "peakBytes", (double)memoryUsage->peakBytes);
+    cJSON_AddNumberToObject(json, "count", memoryUsage->count);
+    return json;
+}
+
+bool writeMemoryReport(const char* path) {
+    MemoryTotals totals;
+    getMemoryTotals(&totals);
+
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddItemToObject(root, "gpu", usageToJson(&totals.gpu));
+    cJSON_AddItemToObject(root, "host", usageToJson(&totals.host));
+    cJSON* heap = cJSON_AddObjectToObject(root, "heap");
+    cJSON_AddNumberToObject(heap, "bytes", (double)totals.heapBytes);
+    cJSON_AddNumberToObject(heap, "peakBytes", (double)totals.heapPeakBytes);
+
+    cJSON* categories = cJSON_AddObjectToObject(root, "categories");
+    for (int c = 0; c < MEMORY_CATEGORY_COUNT; c++) {
+        cJSON* category = usageToJson(&totals.categories[c]);
+        cJSON_AddBoolToObject(category, "gpu", c < MEMORY_FIRST_HOST_CATEGORY);
+        cJSON_AddItemToObject(categories, categoryNames[c], category);
+    }
+
+    const MemoryOwnerUsage* owners;
+    int ownerCount = getMemoryOwners(&owners);
+    cJSON* ownerArray = cJSON_AddArrayToObject(root, "owners");
+    for (int i = 0; i < ownerCount; i++) {
+        cJSON* owner = cJSON_CreateObject();
+        cJSON_AddStringToObject(owner, "owner", owners[i].owner);
+        cJSON_AddNumberToObject(owner, "bytes", (double)owners[i].bytes);
+        cJSON* breakdown = cJSON_AddObjectToObject(owner, "categories");
+        for (int c = 0; c < MEMORY_CATEGORY_COUNT; c++) {
+            if (owners[i].categoryBytes[c]) {
+                cJSON_AddNumberToObject(breakdown, categoryNames[c], (double)owners[i].categoryBytes[c]);
+            }
+        }
+        cJSON_AddItemToArray(ownerArray, owner);
+    }
+
+    char* text = cJSON_Print(root);
+    cJSON_Delete(root);
+    if (!text) return false;
+
+    FILE* file = fopen(path, "w");
+    bool written = file && fputs(text, file) >= 0;
+    if (file && fclose(file) != 0) written = false;
+    cJSON_free(text);
+    if (!written) {
+        LOG_ERROR(LOG_CORE, "Failed to write the memory report to %s.", path);
+        return false;
+    }
+    LOG_INFO(LOG_CORE, "Wrote the memory report to %s.", path);
+    return true;
+}
+
+void shutdownMemoryAccounting() {
+    const char* path = getenv("CLUE_MEMORY_REPORT");
+    if (path && *path) {
+        writeMemoryReport(path);
+    }
+    engineFree(records);
+    engineFree(ownerUsage);
+    engineFree(ownerSlots);
+    records = NULL;
+    ownerUsage = NULL;
+    ownerSlots = NULL;
+    recordCapacity = recordCount = removedCount = ownerCapacity = 0;
+    memset(usage, 0, sizeof(usage));
+    memset(&gpuUsage, 0, sizeof(gpuUsage));
+    memset(&hostUsage, 0, sizeof(hostUsage));
+}
@@ -0,0 +1,323 @@
+#include "mesh_optimizer.h"
+#include "allocators.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+// A vertex is in a FIFO cache if it was inserted within the last cacheSize
+// insertions, so one timestamp per vertex simulates the whole cache. Advancing
+// the clock by more than cacheSize empties it.
+typedef struct {
+    unsigned int* timestamps;
+    unsigned int time;
+    unsigned int size;
+} CacheModel;
+
+static bool createCacheModel(CacheModel* cache, unsigned int vertexCount, unsigned int cacheSize) {
+    cache->timestamps = (unsigned int*)engineCalloc(vertexCount > 0 ? vertexCount : 1, sizeof(unsigned int));
+    cache->time = cacheSize + 1;
+    cache->size = cacheSize;
+    return cache->timestamps != NULL;
+}
+
+static void flushCache(CacheModel* cache) {
+    cache->time += cache->size + 1;
+}
+
+// Returns how many of the triangle's vertices missed
+static unsigned int touchTriangle(CacheModel* cache, const unsigned int* triangle) {
+    unsigned int misses = 0;
+    for (int k = 0; k < 3; k++) {
+        unsigned int v = triangle[k];
+        if (cache->time - cache->timestamps[v] > cache->size) {
+            cache->timestamps[v] = cache->time++;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+static bool indicesInRange(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount) {
+    for (unsigned int i = 0; i < indexCount; i++) {
+        if (indices[i] >= vertexCount) return false;
+    }
+    return true;
+}
+
+float computeAcmr(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize) {
+    if (indexCount < 3 || !indicesInRange(indices, indexCount, vertexCount)) return 0.0f;
+    CacheModel cache;
+    if (!createCacheModel(&cache, vertexCount, cacheSize)) return 0.0f;
+
+    unsigned long long misses = 0;
+    for (unsigned int i = 0; i + 2 < indexCount; i += 3) {
+        misses += touchTriangle(&cache, &indices[i]);
+    }
+    engineFree(cache.timestamps);
+    return (float)((double)misses / (indexCount / 3));
+}
+
+// Triangles around each vertex, as offsets into one shared list
+typedef struct {
+    unsigned int* offsets;   // vertexCount + 1
+    unsigned int* triangles;
+    unsigned int* live;      // Triangles around the vertex not emitted yet
+} VertexTriangles;
+
+static bool buildVertexTriangles(VertexTriangles* adjacency, const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount) {
+    adjacency->offsets = (unsigned int*)engineCalloc(vertexCount + 1, sizeof(unsigned int));
+    adjacency->triangles = (unsigned int*)engineMalloc((indexCount > 0 ? indexCount : 1) * sizeof(unsigned int));
+    adjacency->live = (unsigned int*)engineCalloc(vertexCount > 0 ? vertexCount : 1, sizeof(unsigned int));
+    if (!adjacency->offsets || !adjacency->triangles || !adjacency->live) return false;
+
+    for (unsigned int i = 0; i < indexCount; i++) {
+        adjacency->live[indices[i]]++;
+    }
+    for (unsigned int v = 0; v < vertexCount; v++) {
+        adjacency->offsets[v + 1] = adjacency->offsets[v] + adjacency->live[v];
+    }
+    unsigned int* fill = (unsigned int*)engineMalloc((vertexCount > 0 ? vertexCount : 1) * sizeof(unsigned int));
+    if (!fill) return false;
+    memcpy(fill, adjacency->offsets, vertexCount * sizeof(unsigned int));
+    for (unsigned int i = 0; i < indexCount; i++) {
+        adjacency->triangles[fill[indices[i]]++] = i / 3;
+    }
+    engineFree(fill);
+    return true;
+}
+
+static void freeVertexTriangles(VertexTriangles* adjacency) {
+    engineFree(adjacency->offsets);
+    engineFree(adjacency->triangles);
+    engineFree(adjacency->live);
+}
+
+// Tipsify (Sander, Nehab and Barczak, 2007): emit every remaining triangle
+// around a fanning vertex, then fan next around the candidate that will still
+// be cached after its own triangles are emitted, or the most recent dead end
+bool optimizeVertexCache(unsigned int* destination, const unsigned int* indices, unsigned int indexCount,
+                         unsigned int vertexCount, unsigned int cacheSize) {
+    unsigned int triangleCount = indexCount / 3;
+    if (triangleCount == 0 || !indicesInRange(indices, triangleCount * 3, vertexCount)) return false;
+
+    VertexTriangles adjacency = { 0 };
+    CacheModel cache = { 0 };
+    unsigned char* emitted = (unsigned char*)engineCalloc(triangleCount, 1);
+    unsigned int* deadEnds = (unsigned int*)engineMalloc(triangleCount * 3 * sizeof(unsigned int));
+    unsigned int* candidates = (unsigned int*)engineMalloc(triangleCount * 3 * sizeof(unsigned int));
+    bool ready = emitted && deadEnds && candidates &&
+                 buildVertexTriangles(&adjacency, indices, triangleCount * 3, vertexCount) &&
+                 createCacheModel(&cache, vertexCount, cacheSize);
+
+    if (ready) {
+        unsigned int written = 0;
+        unsigned int deadEndCount = 0;
+        unsigned int scanCursor = 0; // Vertices before it have no triangles left
+        while (scanCursor < vertexCount && adjacency.live[scanCursor] == 0) scanCursor++;
+        unsigned int fan = scanCursor < vertexCount ? scanCursor : UINT32_MAX;
+
+        while (fan != UINT32_MAX) {
+            unsigned int candidateCount = 0;
+            for (unsigned int a = adjacency.offsets[fan]; a < adjacency.offsets[fan + 1]; a++) {
+                unsigned int t = adjacency.triangles[a];
+                if (emitted[t]) continue;
+                emitted[t] = 1;
+                for (int k = 0; k < 3; k++) {
+                    unsigned int v = indices[t * 3 + k];
+                    destination[written++] = v;
+                    deadEnds[deadEndCount++] = v;
+                    candidates[candidateCount++] = v;
+                    adjacency.live[v]--;
+                    if (cache.time - cache.timestamps[v] > cache.size) {
+                        cache.timestamps[v] = cache.time++;
+                    }
+                }
+            }
+
+            // Prefer the oldest candidate that stays cached through its own fan
+            fan = UINT32_MAX;
+            int bestPriority = -1;
+            for (unsigned int c = 0; c < candidateCount; c++) {
+                unsigned int v = candidates[c];
+                if (adjacency.live[v] == 0) continue;
+                unsigned int age = cache.time - cache.timestamps[v];
+                int priority = age + 2 * adjacency.live[v] <= cache.size ? (int)age : 0;
+                if (priority > bestPriority) {
+                    bestPriority = priority;
+                    fan = v;
+                }
+            }
+            while (fan == UINT32_MAX && deadEndCount > 0) {
+                unsigned int v = deadEnds[--deadEndCount];
+                if (adjacency.live[v] > 0) fan = v;
+            }
+            while (fan == UINT32_MAX && scanCursor < vertexCount) {
+                if (adjacency.live[scanCursor] > 0) fan = scanCursor;
+                else scanCursor++;
+            }
+        }
+    }
+
+    engineFree(emitted);
+    engineFree(deadEnds);
+    engineFree(candidates);
+    engineFree(cache.timestamps);
+    freeVertexTriangles(&adjacency);
+    return ready;
+}
+
+typedef struct {
+    float key;
+    unsigned int first; // Triangle
+    unsigned int count;
+} TriangleCluster;
+
+static int compareClusters(const void* a, const void* b) {
+    const TriangleCluster* x = (const TriangleCluster*)a;
+    const TriangleCluster* y = (const TriangleCluster*)b;
+    if (x->key != y->key) return x->key > y->key ? -1 : 1;
+    return x->first < y->first ? -1 : (x->first > y->first ? 1 : 0);
+}
+
+// Splits the cache order into clusters: a triangle whose vertices all missed
+// the cache starts one, and long clusters are cut again wherever their ACMR so
+// far is within threshold of the whole cluster's
+static unsigned int findClusters(const unsigned int* indices, unsigned int triangleCount, CacheModel* cache,
+                                 float threshold, TriangleCluster* clusters) {
+    unsigned int hardCount = 0;
+    for (unsigned int t = 0; t < triangleCount; t++) {
+        if (touchTriangle(cache, &indices[t * 3]) == 3 || t == 0) {
+            clusters[hardCount++].first = t;
+        }
+    }
+    for (unsigned int c = 0; c < hardCount; c++) {
+        clusters[c].count = (c + 1 < hardCount ? clusters[c + 1].first : triangleCount) - clusters[c].first;
+    }
+
+    unsigned int* boundaries = (unsigned int*)engineMalloc(triangleCount * sizeof(unsigned int));
+    if (!boundaries) return hardCount;
+    unsigned int boundaryCount = 0;
+    for (unsigned int c = 0; c < hardCount; c++) {
+        unsigned int start = clusters[c].first, end = start + clusters[c].count;
+        flushCache(cache);
+        unsigned int clusterMisses = 0;
+        for (unsigned int t = start; t < end; t++) clusterMisses += touchTriangle(cache, &indices[t * 3]);
+        float clusterThreshold = threshold * clusterMisses / (end - start);
+
+        unsigned int clusterBoundaries = 0;
+        unsigned int runningMisses = 0, runningTriangles = 0;
+        boundaries[boundaryCount + clusterBoundaries++] = start;
+        flushCache(cache);
+        for (unsigned int t = start; t < end; t++) {
+            runningMisses += touchTriangle(cache, &indices[t * 3]);
+            runningTriangles++;
+            if ((float)runningMisses / runningTriangles <= clusterThreshold && t + 1 < end) {
+                boundaries[boundaryCount + clusterBoundaries++] = t + 1;
+                runningMisses = runningTriangles = 0;
+                flushCache(cache);
+            }
+        }
+        // The tail rarely reaches the threshold on its own; fold it into the cluster before it
+        if (runningTriangles > 0 && clusterBoundaries > 1) clusterBoundaries--;
+        boundaryCount += clusterBoundaries;
+    }
+
+    for (unsigned int c = 0; c < boundaryCount; c++) {
+        clusters[c].first = boundaries[c];
+        clusters[c].count = (c + 1 < boundaryCount ? boundaries[c + 1] : triangleCount) - boundaries[c];
+    }
+    engineFree(boundaries);
+    return boundaryCount;
+}
+
+// Overdraw ordering after Sander et al. (2007), as simplified in meshoptimizer:
+// clusters whose surface faces away from the mesh centre draw first
+bool optimizeOverdraw(unsigned int* destination, const unsigned int* indices, unsigned int indexCount,
+                      const Vector3* positions, unsigned int vertexCount, float threshold) {
+    unsigned int triangleCount = indexCount / 3;
+    if (triangleCount == 0 || !indicesInRange(indices, triangleCount * 3, vertexCount)) return false;
+
+    CacheModel cache;
+    TriangleCluster* clusters = (TriangleCluster*)engineMalloc(triangleCount * sizeof(TriangleCluster));
+    if (!clusters || !createCacheModel(&cache, vertexCount, MESH_CACHE_SIZE)) {
+        engineFree(clusters);
+        return false;
+    }
+    unsigned int clusterCount = findClusters(indices, triangleCount, &cache, threshold, clusters);
+    engineFree(cache.timestamps);
+
+    // Area-weighted centroid of the mesh, then of each cluster with its summed normal
+    double meshCenter[3] = { 0.0, 0.0, 0.0 };
+    double meshArea = 0.0;
+    for (unsigned int t = 0; t < triangleCount; t++) {
+        Vector3 a = positions[indices[t * 3]], b = positions[indices[t * 3 + 1]], c = positions[indices[t * 3 + 2]];
+        double area = vector_length(vector_cross(vector_sub(b, a), vector_sub(c, a)));
+        meshCenter[0] += area * (a.x + b.x + c.x);
+        meshCenter[1] += area * (a.y + b.y + c.y);
+        meshCenter[2] += area * (a.z + b.z + c.z);
+        meshArea += area;
+    }
+    Vector3 center = { 0.0f, 0.0f, 0.0f };
+    if (meshArea > 0.0) {
+        center = (Vector3){ (float)(meshCenter[0] / (meshArea * 3.0)), (float)(meshCenter[1] / (meshArea * 3.0)),
+                            (float)(meshCenter[2] / (meshArea * 3.0)) };
+    }
+
+    for (unsigned int c = 0; c < clusterCount; c++) {
+        Vector3 normal = { 0.0f, 0.0f, 0.0f };
+        Vector3 weighted = { 0.0f, 0.0f, 0.0f };
+        float area = 0.0f;
+        for (unsigned int t = clusters[c].first; t < clusters[c].first + clusters[c].count; t++) {
+            Vector3 a = positions[indices[t * 3]], b = positions[indices[t * 3 + 1]], p = positions[indices[t * 3 + 2]];
+            Vector3 cross = vector_cross(vector_sub(b, a), vector_sub(p, a));
+            float triangleArea = vector_length(cross);
+            normal = vector_add(normal, cross);
+            weighted = vector_add(weighted, vector_scale(vector_add(vector_add(a, b), p), triangleArea / 3.0f));
+            area += triangleArea;
+        }
+        float normalLength = vector_length(normal);
+        if (area <= 0.0f || normalLength <= 0.0f) {
+            clusters[c].key = 0.0f;
+            continue;
+        }
+        Vector3 offset = vector_sub(vector_scale(weighted, 1.0f / area), center);
+        clusters[c].key = vector_dot(offset, normal) / normalLength;
+    }
+    qsort(clusters, clusterCount, sizeof(TriangleCluster), compareClusters);
+
+    unsigned int written = 0;
+    for (unsigned int c = 0; c < clusterCount; c++) {
+        memcpy(&destination[written], &indices[clusters[c].first * 3], clusters[c].count * 3 * sizeof(unsigned int));
+        written += clusters[c].count * 3;
+    }
+    engineFree(clusters);
+    return true;
+}
+
+unsigned int optimizeVertexFetch(unsigned int* remap, unsigned int* indices, unsigned int indexCount, unsigned int vertexCount) {
+    if (!indicesInRange(indices, indexCount, vertexCount)) return 0;
+    memset(remap, 0xFF, vertexCount * sizeof(unsigned int));
+
+    unsigned int next = 0;
+    for (unsigned int i = 0; i < indexCount; i++) {
+        unsigned int v = indices[i];
+        if (remap[v] == UINT32_MAX) remap[v] = next++;
+        indices[i] = remap[v];
+    }
+    return next;
+}
+
+bool remapVertexBuffer(void* vertices, size_t vertexSize, unsigned int vertexCount, const unsigned int* remap) {
+    unsigned char* reordered = (unsigned char*)engineMalloc((vertexCount > 0 ? vertexCount : 1) * vertexSize);
+    if (!reordered) return false;
+    unsigned int count = 0;
+    for (unsigned int v = 0; v < vertexCount; v++) {
+        if (remap[v] == UINT32_MAX) continue;
+        memcpy(reordered + (size_t)remap[v] * vertexSize, (unsigned char*)vertices + (size_t)v * vertexSize, vertexSize);
+        count++;
+    }
+    memcpy(vertices, reordered, (size_t)count * vertexSize);
+    engineFree(reordered);
+    return true;
+}
@@ -0,0 +1,218 @@
+#include "metrics.h"
+#include "http_server.h" // Before threading.h, which pulls in Windows.h
+#include "threading.h"
+#include "ObjectManager.h"
+#include "frame_packet.h"
+#include "memory_accounting.h"
+#include "allocators.h"
+#include "jobs.h"
+#include "texture_streaming.h"
+#include "dynamic_resolution.h"
+#include "frame_stream.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+
+// Buckets are counted individually and made cumulative when formatted
+typedef struct {
+    const double* bounds;
+    int boundCount;
+    atomic_ullong buckets[METRICS_MAX_BUCKETS + 1]; // The last one is +Inf
+    atomic_ullong count;
+    atomic_ullong sumNanoseconds;
+} Histogram;
+
+// Gauges sampled on the main thread for the next scrape
+typedef struct {
+    FrameStats frame;
+    MemoryTotals memory;
+    AllocationStats allocations;
+    TextureStreamingStats textures;
+    DynamicResolutionStats resolution;
+    FrameStreamStats stream;
+    int queuedJobs;
+    int sceneObjects;
+} MetricsSnapshot;
+
+static const double frameTimeBounds[] = { 0.004, 0.008, 0.0167, 0.025, 0.0333, 0.05, 0.1, 0.25, 0.5, 1.0 };
+static const double assetLoadBounds[] = { 0.001, 0.005, 0.01, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0 };
+static const char* assetTypeNames[ASSET_TYPE_COUNT] = { "mesh", "model", "texture", "material", "shader" };
+
+#define BOUND_COUNT(bounds) ((int)(sizeof(bounds) / sizeof((bounds)[0])))
+
+#define ASSET_LOAD_HISTOGRAM { .bounds = assetLoadBounds, .boundCount = BOUND_COUNT(assetLoadBounds) }
+
+static Histogram frameTimes = { .bounds = frameTimeBounds, .boundCount = BOUND_COUNT(frameTimeBounds) };
+static Histogram assetLoads[ASSET_TYPE_COUNT] = {
+    ASSET_LOAD_HISTOGRAM, ASSET_LOAD_HISTOGRAM, ASSET_LOAD_HISTOGRAM, ASSET_LOAD_HISTOGRAM, ASSET_LOAD_HISTOGRAM
+};
+
+static bool metricsEnabled;
+static Mutex snapshotLock;
+static MetricsSnapshot published;
+
+// Server thread only
+static MetricsSnapshot scraped;
+static char body[METRICS_RESPONSE_SIZE];
+static size_t bodyLength;
+
+static void observe(Histogram* histogram, double seconds) {
+    int bucket = 0;
+    while (bucket < histogram->boundCount && seconds > histogram->bounds[bucket]) bucket++;
+    atomic_fetch_add_explicit(&histogram->buckets[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->sumNanoseconds, (unsigned long long)(seconds * 1.0e9), memory_order_relaxed);
+}
+
+void observeFrameTime(double seconds) {
+    observe(&frameTimes, seconds);
+}
+
+void observeAssetLoad(AssetType type, double seconds) {
+    if (type < 0 || type >= ASSET_TYPE_COUNT) return;
+    observe(&assetLoads[type], seconds);
+}
+
+void updateMetrics() {
+    if (!metricsEnabled) return;
+
+    MetricsSnapshot snapshot;
+    getFrameStats(&snapshot.frame);
+    getMemoryTotals(&snapshot.memory);
+    getAllocationStats(&snapshot.allocations);
+    getTextureStreamingStats(&snapshot.textures);
+    getDynamicResolutionStats(&snapshot.resolution);
+    getFrameStreamStats(&snapshot.stream);
+    snapshot.queuedJobs = getQueuedJobCount();
+    snapshot.sceneObjects = objectManager.count;
+
+    mutexLock(&snapshotLock);
+    published = snapshot;
+    mutexUnlock(&snapshotLock);
+}
+
+// ---- Text exposition format, built on the server thread ----
+
+static void append(const char* format, ...) {
+    if (bodyLength >= sizeof(body)) return;
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(body + bodyLength, sizeof(body) - bodyLength, format, args);
+    va_end(args);
+    if (written > 0) {
+        bodyLength += (size_t)written;
+        if (bodyLength > sizeof(body)) bodyLength = sizeof(body); // Truncated; METRICS_RESPONSE_SIZE is too small
+    }
+}
+
+static void appendGauge(const char* name, const char* help, double value) {
+    append("# HELP %s %s\n# TYPE %s gauge\n%s %.9g\n", name, help, name, name, value);
+}
+
+static void appendHistogramSeries(const char* name, const char* labels, Histogram* histogram) {
+    const char* separator = labels[0] ? "," : "";
+    unsigned long long cumulative = 0;
+    for (int i = 0; i <= histogram->boundCount; i++) {
+        cumulative += atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+        if (i < histogram->boundCount) {
+            append("%s_bucket{%s%sle=\"%g\"} %llu\n", name, labels, separator, histogram->bounds[i], cumulative);
+        }
+        else {
+            append("%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, separator, cumulative);
+        }
+    }
+    // Count and sum are read after the buckets, so a concurrent observation can make them run ahead by one
+    double sum = atomic_load_explicit(&histogram->sumNanoseconds, memory_order_relaxed) / 1.0e9;
+    unsigned long long count = atomic_load_explicit(&histogram->count, memory_order_relaxed);
+    if (labels[0]) {
+        append("%s_sum{%s} %.9f\n%s_count{%s} %llu\n", name, labels, sum, name, labels, count);
+    }
+    else {
+        append("%s_sum %.9f\n%s_count %llu\n", name, sum, name, count);
+    }
+}
+
+static void buildMetricsBody() {
+    mutexLock(&snapshotLock);
+    scraped = published;
+    mutexUnlock(&snapshotLock);
+    const MetricsSnapshot* s = &scraped;
+    bodyLength = 0;
+
+    append("# HELP clue_frame_time_seconds Time from the start of a drawn frame to after its buffer swap.\n# TYPE clue_frame_time_seconds histogram\n");
+    appendHistogramSeries("clue_frame_time_seconds", "", &frameTimes);
+    appendGauge("clue_gpu_scene_time_seconds", "Smoothed GPU time of the scene pass.", s->resolution.gpuMilliseconds / 1000.0);
+    appendGauge("clue_render_scale", "Dynamic resolution scale per axis.", s->resolution.scale);
+    appendGauge("clue_draw_calls", "Draw calls in the last submitted frame.", s->frame.drawCalls);
+    appendGauge("clue_objects_visible", "Render items that passed culling in the last frame.", s->frame.visibleCount);
+    appendGauge("clue_objects_culled", "Objects culled in the last frame.", s->frame.culledCount);
+    appendGauge("clue_triangles", "Triangles drawn in the last frame, at the chosen LOD levels.", s->frame.triangleCount);
+    appendGauge("clue_transforms_updated", "World matrices recomputed for the last frame.", s->frame.transformCount);
+    appendGauge("clue_scene_objects", "Objects in the scene.", s->sceneObjects);
+
+    append("# HELP clue_memory_bytes Tracked memory by category.\n# TYPE clue_memory_bytes gauge\n");
+    for (int c = 0; c < MEMORY_CATEGORY_COUNT; c++) {
+        append("clue_memory_bytes{category=\"%s\",kind=\"%s\"} %llu\n", getMemoryCategoryName((MemoryCategory)c),
+               c < MEMORY_FIRST_HOST_CATEGORY ? "gpu" : "host", s->memory.categories[c].bytes);
+    }
+    append("# HELP clue_memory_peak_bytes High-water mark of tracked memory by category.\n# TYPE clue_memory_peak_bytes gauge\n");
+    for (int c = 0; c < MEMORY_CATEGORY_COUNT; c++) {
+        append("clue_memory_peak_bytes{category=\"%s\",kind=\"%s\"} %llu\n", getMemoryCategoryName((MemoryCategory)c),
+               c < MEMORY_FIRST_HOST_CATEGORY ? "gpu" : "host", s->memory.categories[c].peakBytes);
+    }
+    appendGauge("clue_heap_bytes", "Live engine heap, tagged or not.", (double)s->memory.heapBytes);
+    appendGauge("clue_heap_peak_bytes", "High-water mark of the engine heap.", (double)s->memory.heapPeakBytes);
+    append("# HELP clue_heap_allocations_total Engine heap allocations.\n# TYPE clue_heap_allocations_total counter\nclue_heap_allocations_total %llu\n",
+           s->allocations.allocations);
+    appendGauge("clue_texture_resident_bytes", "Streamed texture mips resident in VRAM.", (double)s->textures.residentBytes);
+
+    append("# HELP clue_asset_load_seconds Time to load an asset, by type.\n# TYPE clue_asset_load_seconds histogram\n");
+    for (int t = 0; t < ASSET_TYPE_COUNT; t++) {
+        char labels[32];
+        snprintf(labels, sizeof(labels), "type=\"%s\"", assetTypeNames[t]);
+        appendHistogramSeries("clue_asset_load_seconds", labels, &assetLoads[t]);
+    }
+
+    appendGauge("clue_job_queue_depth", "Jobs queued and not yet started.", s->queuedJobs);
+    appendGauge("clue_texture_decodes_pending", "Texture decodes queued or running.", s->textures.pendingDecodes);
+    appendGauge("clue_texture_uploads_pending", "Decoded textures waiting for upload.", s->textures.pendingUploads);
+
+    if (s->stream.enabled) {
+        appendGauge("clue_stream_clients", "Clients connected to /stream.", s->stream.clients);
+        append("# HELP clue_stream_frames_total Stream frames by outcome.\n# TYPE clue_stream_frames_total counter\n");
+        append("clue_stream_frames_total{outcome=\"captured\"} %llu\n", s->stream.captured);
+        append("clue_stream_frames_total{outcome=\"encoded\"} %llu\n", s->stream.encoded);
+        append("clue_stream_frames_total{outcome=\"dropped\"} %llu\n", s->stream.dropped);
+    }
+}
+
+// ---- Handlers, on the HTTP server thread ----
+
+static bool serveMetrics(Socket client, bool head) {
+    buildMetricsBody();
+    httpRespond(client, "200 OK", "text/plain; version=0.0.4; charset=utf-8", body, bodyLength, !head);
+    return false;
+}
+
+static bool serveHealth(Socket client, bool head) {
+    httpRespond(client, "200 OK", "text/plain", "ok\n", 3, !head);
+    return false;
+}
+
+void initMetrics() {
+    if (!isHttpServerRunning()) return;
+    mutexInit(&snapshotLock);
+    memset(&published, 0, sizeof(published));
+    metricsEnabled = true;
+    registerHttpHandler("/metrics", serveMetrics);
+    registerHttpHandler("/healthz", serveHealth);
+}
+
+void shutdownMetrics() {
+    if (!metricsEnabled) return;
+    metricsEnabled = false;
+    mutexDestroy(&snapshotLock); // The HTTP server has stopped, so no scrape holds it
+}
@@ -0,0 +1,190 @@
+#include "project_save.h"
+#include "scene_format.h"
+#include "jobs.h"
+#include "redraw.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+typedef enum {
+    SAVE_RESULT_WRITTEN,
+    SAVE_RESULT_UNCHANGED,
+    SAVE_RESULT_FAILED
+} SaveResult;
+
+typedef struct {
+    SceneSnapshot snapshot;
+    char path[SAVE_PATH_LENGTH];
+    bool autosave;
+    uint64_t previousHash; // Hash of the last written scene, for skipping autosaves
+    uint64_t hash;         // Written by the job
+    atomic_int progress;
+    SaveResult result;
+} SaveJob;
+
+// Only one save runs at a time; a newer request waits for it
+static SaveJob saveJob;
+static JobCounter saveCounter;
+static bool saveRunning = false;
+
+static char pendingPath[SAVE_PATH_LENGTH];
+static bool savePending = false;
+
+static char projectPath[SAVE_PATH_LENGTH]; // Last explicitly saved project
+static uint64_t lastSavedHash = 0;
+static double autosaveInterval = AUTOSAVE_DEFAULT_INTERVAL;
+static double nextAutosave = 0.0;
+static double lastSaveTime = 0.0;
+static bool lastFailed = false;
+
+static void saveProjectFile(SaveJob* job) {
+    job->hash = hashSceneSnapshot(&job->snapshot);
+    if (job->autosave && job->hash == job->previousHash) {
+        job->result = SAVE_RESULT_UNCHANGED;
+        return;
+    }
+
+    // Write next to the target so the rename stays on one filesystem
+    char tempPath[SAVE_PATH_LENGTH + 8];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", job->path);
+    if (!writeSceneFile(&job->snapshot, tempPath, SCENE_WRITE_COMPRESS | SCENE_WRITE_DURABLE, &job->progress)) {
+        remove(tempPath);
+        job->result = SAVE_RESULT_FAILED;
+        return;
+    }
+    if (!replaceFile(tempPath, job->path)) {
+        LOG_ERROR(LOG_SCENE, "Failed to replace %s with the new save.", job->path);
+        remove(tempPath);
+        job->result = SAVE_RESULT_FAILED;
+        return;
+    }
+    job->result = SAVE_RESULT_WRITTEN;
+}
+
+static void saveProjectJob(void* data) {
+    saveProjectFile((SaveJob*)data);
+    requestRedraw(); // The menu bar shows the result
+}
+
+static void autosavePath(char* path, size_t size) {
+    if (!projectPath[0]) {
+        snprintf(path, size, "%s", AUTOSAVE_FILE_NAME);
+        return;
+    }
+    // project.cscene -> project.autosave.cscene
+    const char* dot = strrchr(projectPath, '.');
+    const char* slash = strrchr(projectPath, '/');
+    const char* backslash = strrchr(projectPath, '\\');
+    if (backslash > slash) slash = backslash;
+    int stem = (dot && dot > slash) ? (int)(dot - projectPath) : (int)strlen(projectPath);
+    snprintf(path, size, "%.*s.%s", stem, projectPath, AUTOSAVE_FILE_NAME);
+}
+
+static void startSave(const char* path, bool autosave) {
+    if (!captureSceneSnapshot(&saveJob.snapshot)) {
+        lastFailed = true;
+        return;
+    }
+    snprintf(saveJob.path, sizeof(saveJob.path), "%s", path);
+    saveJob.autosave = autosave;
+    saveJob.previousHash = lastSavedHash;
+    saveJob.result = SAVE_RESULT_FAILED;
+    atomic_store(&saveJob.progress, 0);
+    saveRunning = true;
+    runBackgroundJob(saveProjectJob, &saveJob, &saveCounter);
+}
+
+static void finishSave(double now) {
+    freeSceneSnapshot(&saveJob.snapshot);
+    saveRunning = false;
+
+    switch (saveJob.result) {
+    case SAVE_RESULT_WRITTEN:
+        lastSavedHash = saveJob.hash;
+        lastSaveTime = now;
+        lastFailed = false;
+        LOG_INFO(LOG_SCENE, "%s saved to %s.", saveJob.autosave ? "Autosave" : "Project", saveJob.path);
+        break;
+    case SAVE_RESULT_UNCHANGED:
+        break;
+    case SAVE_RESULT_FAILED:
+        lastFailed = true;
+        LOG_ERROR(LOG_SCENE, "Failed to save %s.", saveJob.path);
+        break;
+    }
+}
+
+void initProjectSave() {
+    const char* interval = getenv("CLUE_AUTOSAVE_SECONDS");
+    if (interval) {
+        autosaveInterval = atof(interval);
+    }
+    atomic_store(&saveCounter.pending, 0);
+    nextAutosave = 0.0;
+}
+
+void shutdownProjectSave() {
+    if (saveRunning) {
+        waitForCounter(&saveCounter);
+        finishSave(lastSaveTime);
+    }
+}
+
+void requestProjectSave(const char* path) {
+    if (!path || !path[0]) return;
+    snprintf(pendingPath, sizeof(pendingPath), "%s", path);
+    snprintf(projectPath, sizeof(projectPath), "%s", path);
+    savePending = true;
+}
+
+void updateProjectSave(double now) {
+    if (saveRunning) {
+        if (!isCounterDone(&saveCounter)) return;
+        finishSave(now);
+    }
+
+    if (nextAutosave == 0.0) {
+        nextAutosave = now + autosaveInterval;
+        // The scene as first seen does not need an autosave
+        if (lastSavedHash == 0) {
+            SceneSnapshot baseline;
+            if (captureSceneSnapshot(&baseline)) {
+                lastSavedHash = hashSceneSnapshot(&baseline);
+                freeSceneSnapshot(&baseline);
+            }
+        }
+    }
+
+    if (savePending) {
+        savePending = false;
+        startSave(pendingPath, false);
+        nextAutosave = now + autosaveInterval;
+    }
+    else if (autosaveInterval > 0.0 && now >= nextAutosave) {
+        char path[SAVE_PATH_LENGTH];
+        autosavePath(path, sizeof(path));
+        startSave(path, true);
+        nextAutosave = now + autosaveInterval;
+    }
+}
+
+void setAutosaveInterval(double seconds) {
+    autosaveInterval = seconds > 0.0 ? seconds : 0.0;
+    nextAutosave = 0.0;
+}
+
+ProjectSaveStatus getProjectSaveStatus() {
+    ProjectSaveStatus status = { 0 };
+    // Autosaves that find nothing to write stay invisible
+    int progress = saveRunning ? atomic_load(&saveJob.progress) : 0;
+    status.saving = savePending || (saveRunning && (!saveJob.autosave || progress > 0));
+    status.autosave = saveRunning && saveJob.autosave;
+    status.progress = (float)progress / SCENE_PROGRESS_DONE;
+    status.lastFailed = lastFailed;
+    status.lastSaveTime = lastSaveTime;
+    snprintf(status.lastPath, sizeof(status.lastPath), "%s", projectPath);
+    return status;
+}
@@ -0,0 +1,174 @@
+#include "redraw.h"
+#include "globals.h"
+#include "ObjectManager.h"
+#include "lightshading.h"
+#include "texture_streaming.h"
+#include "project_save.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+static bool enabled = true;
+static atomic_bool initialized = false;
+static atomic_bool requested = false;
+static int framesLeft = REDRAW_SETTLE_FRAMES;
+static double scheduledTime = 0.0; // 0 = nothing scheduled
+
+// What the last drawn frame showed, compared every loop
+static Camera lastCamera;
+static int lastObjectCount = -1;
+static unsigned int lastGeneration = 0;
+static int lastLightCount = -1;
+
+static GLFWkeyfun previousKey;
+static GLFWcharfun previousChar;
+static GLFWmousebuttonfun previousMouseButton;
+static GLFWcursorposfun previousCursorPos;
+static GLFWscrollfun previousScroll;
+static GLFWframebuffersizefun previousFramebufferSize;
+
+// Input callbacks run on the main thread inside glfwPollEvents/glfwWaitEvents
+static void markInput() {
+    framesLeft = REDRAW_SETTLE_FRAMES;
+}
+
+static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    markInput();
+    if (previousKey) previousKey(window, key, scancode, action, mods);
+}
+
+static void charCallback(GLFWwindow* window, unsigned int codepoint) {
+    markInput();
+    if (previousChar) previousChar(window, codepoint);
+}
+
+static void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
+    markInput();
+    if (previousMouseButton) previousMouseButton(window, button, action, mods);
+}
+
+static void cursorPosCallback(GLFWwindow* window, double x, double y) {
+    markInput();
+    if (previousCursorPos) previousCursorPos(window, x, y);
+}
+
+static void scrollCallback(GLFWwindow* window, double x, double y) {
+    markInput();
+    if (previousScroll) previousScroll(window, x, y);
+}
+
+static void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
+    markInput();
+    if (previousFramebufferSize) previousFramebufferSize(window, width, height);
+}
+
+static void windowRefreshCallback(GLFWwindow* window) {
+    (void)window;
+    markInput(); // Uncovered or restored; the old frame may be gone
+}
+
+static void windowFocusCallback(GLFWwindow* window, int focused) {
+    (void)window;
+    (void)focused;
+    markInput();
+}
+
+static void cursorEnterCallback(GLFWwindow* window, int entered) {
+    (void)window;
+    (void)entered;
+    markInput(); // Hover highlights change when the cursor leaves
+}
+
+void initRedraw(GLFWwindow* window) {
+    const char* setting = getenv("CLUE_IDLE_RENDERING");
+    enabled = !(setting && strcmp(setting, "0") == 0);
+
+    // Chained, so the engine's and Nuklear's callbacks keep working
+    previousKey = glfwSetKeyCallback(window, keyCallback);
+    previousChar = glfwSetCharCallback(window, charCallback);
+    previousMouseButton = glfwSetMouseButtonCallback(window, mouseButtonCallback);
+    previousCursorPos = glfwSetCursorPosCallback(window, cursorPosCallback);
+    previousScroll = glfwSetScrollCallback(window, scrollCallback);
+    previousFramebufferSize = glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
+    glfwSetWindowRefreshCallback(window, windowRefreshCallback);
+    glfwSetWindowFocusCallback(window, windowFocusCallback);
+    glfwSetCursorEnterCallback(window, cursorEnterCallback);
+
+    framesLeft = REDRAW_SETTLE_FRAMES;
+    atomic_store(&initialized, true);
+}
+
+// Changes that do not arrive as input events
+static bool sceneChanged(double now) {
+    bool changed = isRunning; // The simulation moves things every frame
+    if (memcmp(&lastCamera, &camera, sizeof(Camera)) != 0) {
+        lastCamera = camera;
+        changed = true;
+    }
+    if (objectManager.count != lastObjectCount || sceneGeneration != lastGeneration || lightCount != lastLightCount) {
+        lastObjectCount = objectManager.count;
+        lastGeneration = sceneGeneration;
+        lastLightCount = lightCount;
+        changed = true;
+    }
+
+    // Streaming only advances while frames report which textures are on screen
+    TextureStreamingStats stats;
+    getTextureStreamingStats(&stats);
+    if (stats.pendingDecodes > 0 || stats.pendingUploads > 0 || stats.uploadedLastFrame > 0) {
+        changed = true;
+    }
+    if (getProjectSaveStatus().saving) {
+        changed = true; // Progress is shown in the menu bar
+    }
+    if (scheduledTime > 0.0 && now >= scheduledTime) {
+        scheduledTime = 0.0;
+        changed = true;
+    }
+    return changed;
+}
+
+bool waitForRedraw() {
+    if (!enabled) {
+        glfwPollEvents();
+        return true;
+    }
+
+    double now = glfwGetTime();
+    if (sceneChanged(now)) {
+        framesLeft = REDRAW_SETTLE_FRAMES;
+    }
+
+    if (framesLeft > 0 || atomic_load(&requested)) {
+        glfwPollEvents();
+    }
+    else {
+        double timeout = REDRAW_IDLE_TIMEOUT;
+        if (scheduledTime > 0.0 && scheduledTime - now < timeout) {
+            timeout = scheduledTime > now ? scheduledTime - now : 0.0;
+        }
+        glfwWaitEventsTimeout(timeout);
+    }
+
+    if (atomic_exchange(&requested, false)) {
+        framesLeft = REDRAW_SETTLE_FRAMES;
+    }
+    if (framesLeft > 0) {
+        framesLeft--;
+        return true;
+    }
+    return false;
+}
+
+void requestRedraw() {
+    atomic_store(&requested, true);
+    if (atomic_load(&initialized)) {
+        glfwPostEmptyEvent();
+    }
+}
+
+void scheduleRedraw(double time) {
+    if (scheduledTime == 0.0 || time < scheduledTime) {
+        scheduledTime = time;
+    }
+}
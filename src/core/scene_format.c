@@ -0,0 +1,989 @@
+#include "scene_format.h"
+#include "ObjectManager.h"
+#include "ModelLoad.h"
+#include "materials.h"
+#include "textures.h"
+#include "globals.h"
+#include "asset_registry.h"
+#include "file_operations.h"
+#include "logger.h"
+#include "allocators.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef CLUE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#define SCENE_IO_BLOCK (64 * 1024)
+#define SCENE_STAGING_ELEMENTS 1024
+#define SCENE_CHUNK_COMPRESSED (1u << 0)
+#define SCENE_NO_STRING 0xFFFFFFFFu
+
+static const char sceneMagic[4] = { 'C', 'L', 'S', 'C' };
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t chunkCount;
+    uint32_t flags;
+} SceneFileHeader;
+
+typedef struct {
+    char id[4];
+    uint32_t flags;
+    uint64_t size;    // Bytes stored in the file
+    uint64_t rawSize; // Bytes after decompression
+    uint64_t reserved;
+} SceneChunkHeader;
+
+typedef struct {
+    uint32_t count;
+    uint32_t reserved[3];
+} SceneBlockHeader;
+
+typedef struct {
+    uint32_t type;
+    float position[3];
+    float direction[3];
+    float color[3];
+    float intensity;
+    float constant;
+    float linear;
+    float quadratic;
+    float cutOff;
+    float outerCutOff;
+} SceneLightRecord;
+
+typedef struct {
+    float position[3];
+    float front[3];
+    float up[3];
+    float right[3];
+    float worldUp[3];
+    float yaw;
+    float pitch;
+    float movementSpeed;
+    float mouseSensitivity;
+    float zoom;
+    uint32_t invertY;
+    uint32_t mode;
+} SceneCameraRecord;
+
+_Static_assert(sizeof(SceneFileHeader) == 16, "scene file header must stay 16 bytes");
+_Static_assert(sizeof(SceneChunkHeader) == 32, "scene chunk header must stay 32 bytes");
+
+// OBJS column order; each column starts on a 16 byte boundary
+typedef enum {
+    COLUMN_TYPE,
+    COLUMN_FLAGS,
+    COLUMN_TEXTURE,
+    COLUMN_MATERIAL,
+    COLUMN_MODEL,
+    COLUMN_POSITION,
+    COLUMN_ROTATION,
+    COLUMN_SCALE,
+    COLUMN_COLOR,
+    COLUMN_COUNT
+} SceneColumn;
+
+static const size_t columnElementSize[COLUMN_COUNT] = {
+    sizeof(uint8_t), sizeof(uint8_t), sizeof(uint32_t), sizeof(uint32_t), sizeof(uint32_t),
+    3 * sizeof(float), 3 * sizeof(float), 3 * sizeof(float), 4 * sizeof(float)
+};
+
+static size_t alignScene(size_t value) {
+    return (value + SCENE_CHUNK_ALIGNMENT - 1) & ~(size_t)(SCENE_CHUNK_ALIGNMENT - 1);
+}
+
+static size_t objectColumnOffset(uint32_t count, SceneColumn column) {
+    size_t offset = sizeof(SceneBlockHeader);
+    for (int i = 0; i < (int)column; i++) {
+        offset += alignScene(columnElementSize[i] * count);
+    }
+    return offset;
+}
+
+static SceneLightRecord makeLightRecord(const Light* light) {
+    SceneLightRecord record = {
+        (uint32_t)light->type,
+        { light->position.x, light->position.y, light->position.z },
+        { light->direction.x, light->direction.y, light->direction.z },
+        { light->color.x, light->color.y, light->color.z },
+        light->intensity, light->constant, light->linear, light->quadratic, light->cutOff, light->outerCutOff
+    };
+    return record;
+}
+
+static SceneCameraRecord makeCameraRecord(const Camera* cam) {
+    SceneCameraRecord record = {
+        { cam->Position.x, cam->Position.y, cam->Position.z },
+        { cam->Front.x, cam->Front.y, cam->Front.z },
+        { cam->Up.x, cam->Up.y, cam->Up.z },
+        { cam->Right.x, cam->Right.y, cam->Right.z },
+        { cam->WorldUp.x, cam->WorldUp.y, cam->WorldUp.z },
+        cam->Yaw, cam->Pitch, cam->MovementSpeed, cam->MouseSensitivity, cam->Zoom,
+        cam->invertY ? 1u : 0u, (uint32_t)cam->mode
+    };
+    return record;
+}
+
+// ---- Snapshot ----
+
+void makeSceneObjectRecord(const SceneObject* obj, SceneObjectRecord* record) {
+    const char* materialName = getMaterialName((PBRMaterial*)&obj->object.material);
+
+    record->modelPath = obj->object.type == OBJ_MODEL ? internString(obj->object.data.model.path) : NULL;
+    record->materialName = materialName[0] ? materialName : NULL;
+    record->textureName = obj->object.useTexture ? getTextureName(obj->object.textureID) : NULL;
+    record->position = obj->position;
+    record->rotation = obj->rotation;
+    record->scale = obj->scale;
+    record->color = obj->color;
+    record->parent = obj->parentId >= 0 ? findObjectIndex(obj->parentId) : -1;
+    record->type = (uint8_t)obj->object.type;
+    record->flags = (obj->object.useTexture ? SCENE_OBJECT_USE_TEXTURE : 0) |
+                    (obj->object.useColor ? SCENE_OBJECT_USE_COLOR : 0) |
+                    (obj->object.usePBR ? SCENE_OBJECT_USE_PBR : 0) |
+                    (obj->object.useLighting ? SCENE_OBJECT_USE_LIGHTING : 0);
+}
+
+bool captureSceneSnapshot(SceneSnapshot* snapshot) {
+    memset(snapshot, 0, sizeof(SceneSnapshot));
+    // Zeroed so record padding hashes the same every time
+    snapshot->objects = (SceneObjectRecord*)engineCalloc(objectManager.count > 0 ? objectManager.count : 1, sizeof(SceneObjectRecord));
+    snapshot->lights = (Light*)engineMalloc((lightCount > 0 ? lightCount : 1) * sizeof(Light));
+    if (!snapshot->objects || !snapshot->lights) {
+        LOG_ERROR(LOG_SCENE, "Failed to allocate scene snapshot.");
+        freeSceneSnapshot(snapshot);
+        return false;
+    }
+
+    for (int i = 0; i < objectManager.count; i++) {
+        makeSceneObjectRecord(&objectManager.objects[i], &snapshot->objects[i]);
+    }
+    snapshot->objectCount = objectManager.count;
+
+    memcpy(snapshot->lights, lights, lightCount * sizeof(Light));
+    snapshot->lightCount = lightCount;
+    snapshot->camera = camera;
+    snapshot->toggles = (isRunning ? SCENE_TOGGLE_RUNNING : 0) |
+                        (texturesEnabled ? SCENE_TOGGLE_TEXTURES : 0) |
+                        (colorsEnabled ? SCENE_TOGGLE_COLORS : 0) |
+                        (lightingEnabled ? SCENE_TOGGLE_LIGHTING : 0) |
+                        (noShading ? SCENE_TOGGLE_NO_SHADING : 0) |
+                        (usePBR ? SCENE_TOGGLE_PBR : 0) |
+                        (backgroundEnabled ? SCENE_TOGGLE_BACKGROUND : 0);
+    return true;
+}
+
+void freeSceneSnapshot(SceneSnapshot* snapshot) {
+    engineFree(snapshot->objects);
+    engineFree(snapshot->lights);
+    memset(snapshot, 0, sizeof(SceneSnapshot));
+}
+
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t hashSceneSnapshot(const SceneSnapshot* snapshot) {
+    uint64_t hash = 14695981039346656037ull;
+    // Strings are interned, so hashing the pointers is enough
+    hash = hashBytes(hash, snapshot->objects, (size_t)snapshot->objectCount * sizeof(SceneObjectRecord));
+    for (int i = 0; i < snapshot->lightCount; i++) {
+        SceneLightRecord light = makeLightRecord(&snapshot->lights[i]);
+        hash = hashBytes(hash, &light, sizeof(light));
+    }
+    SceneCameraRecord cameraRecord = makeCameraRecord(&snapshot->camera);
+    hash = hashBytes(hash, &cameraRecord, sizeof(cameraRecord));
+    hash = hashBytes(hash, &snapshot->toggles, sizeof(snapshot->toggles));
+    return hash;
+}
+
+// ---- Writing ----
+
+typedef struct {
+    FILE* file;
+    long headerOffset;
+    SceneChunkHeader header;
+    bool compress;
+    bool ok;
+#ifdef CLUE_HAVE_ZLIB
+    z_stream stream;
+    unsigned char out[SCENE_IO_BLOCK];
+#endif
+} ChunkWriter;
+
+static void writeBytes(ChunkWriter* writer, const void* data, size_t size) {
+    if (!writer->ok || size == 0) return;
+    if (fwrite(data, 1, size, writer->file) != size) {
+        writer->ok = false;
+    }
+}
+
+static void padFile(ChunkWriter* writer) {
+    static const unsigned char zeros[SCENE_CHUNK_ALIGNMENT] = { 0 };
+    long position = ftell(writer->file);
+    if (position < 0) {
+        writer->ok = false;
+        return;
+    }
+    writeBytes(writer, zeros, alignScene((size_t)position) - (size_t)position);
+}
+
+static void beginChunk(ChunkWriter* writer, const char id[4], size_t expectedRawSize, uint32_t writeFlags) {
+    padFile(writer);
+    writer->headerOffset = ftell(writer->file);
+    memset(&writer->header, 0, sizeof(SceneChunkHeader));
+    memcpy(writer->header.id, id, 4);
+    writeBytes(writer, &writer->header, sizeof(SceneChunkHeader));
+
+    writer->compress = false;
+#ifdef CLUE_HAVE_ZLIB
+    if ((writeFlags & SCENE_WRITE_COMPRESS) && expectedRawSize >= SCENE_COMPRESS_MIN_BYTES) {
+        memset(&writer->stream, 0, sizeof(z_stream));
+        writer->compress = deflateInit(&writer->stream, Z_BEST_SPEED) == Z_OK;
+    }
+#else
+    (void)expectedRawSize;
+    (void)writeFlags;
+#endif
+    if (writer->compress) writer->header.flags |= SCENE_CHUNK_COMPRESSED;
+}
+
+#ifdef CLUE_HAVE_ZLIB
+static void deflateChunk(ChunkWriter* writer, const void* data, size_t size, int flush) {
+    writer->stream.next_in = (Bytef*)data;
+    writer->stream.avail_in = (uInt)size;
+    do {
+        writer->stream.next_out = writer->out;
+        writer->stream.avail_out = sizeof(writer->out);
+        if (deflate(&writer->stream, flush) == Z_STREAM_ERROR) {
+            writer->ok = false;
+            return;
+        }
+        size_t produced = sizeof(writer->out) - writer->stream.avail_out;
+        writeBytes(writer, writer->out, produced);
+        writer->header.size += produced;
+    } while (writer->stream.avail_out == 0 && writer->ok);
+}
+#endif
+
+static void chunkWrite(ChunkWriter* writer, const void* data, size_t size) {
+    if (!writer->ok || size == 0) return;
+    writer->header.rawSize += size;
+#ifdef CLUE_HAVE_ZLIB
+    if (writer->compress) {
+        deflateChunk(writer, data, size, Z_NO_FLUSH);
+        return;
+    }
+#endif
+    writeBytes(writer, data, size);
+    writer->header.size += size;
+}
+
+static void chunkAlign(ChunkWriter* writer) {
+    static const unsigned char zeros[SCENE_CHUNK_ALIGNMENT] = { 0 };
+    size_t raw = (size_t)writer->header.rawSize;
+    chunkWrite(writer, zeros, alignScene(raw) - raw);
+}
+
+static void endChunk(ChunkWriter* writer, uint32_t* chunkCount) {
+#ifdef CLUE_HAVE_ZLIB
+    if (writer->compress) {
+        deflateChunk(writer, NULL, 0, Z_FINISH);
+        deflateEnd(&writer->stream);
+    }
+#endif
+    if (!writer->ok) return;
+    // Sizes are only known now, so the header is patched in place
+    if (fseek(writer->file, writer->headerOffset, SEEK_SET) != 0) {
+        writer->ok = false;
+        return;
+    }
+    writeBytes(writer, &writer->header, sizeof(SceneChunkHeader));
+    if (fseek(writer->file, 0, SEEK_END) != 0) writer->ok = false;
+    (*chunkCount)++;
+}
+
+typedef struct {
+    const char** keys;     // Open addressing by pointer
+    uint32_t* ids;
+    uint32_t mask;
+    const char** strings;  // Unique strings in id order
+    uint32_t count;
+} SceneStringTable;
+
+static bool initStringTable(SceneStringTable* table, int objectCount) {
+    uint32_t capacity = 64;
+    while (capacity < (uint32_t)objectCount * 6 + 8) capacity *= 2; // Up to three strings per object, half full
+    table->keys = (const char**)engineCalloc(capacity, sizeof(const char*));
+    table->ids = (uint32_t*)engineMalloc(capacity * sizeof(uint32_t));
+    table->strings = (const char**)engineMalloc((size_t)(objectCount * 3 + 1) * sizeof(const char*));
+    table->mask = capacity - 1;
+    table->count = 0;
+    return table->keys && table->ids && table->strings;
+}
+
+static void freeStringTable(SceneStringTable* table) {
+    engineFree(table->keys);
+    engineFree(table->ids);
+    engineFree(table->strings);
+}
+
+static uint32_t stringId(SceneStringTable* table, const char* text) {
+    if (!text) return SCENE_NO_STRING;
+    uintptr_t value = (uintptr_t)text;
+    uint32_t slot = (uint32_t)((value >> 3) * 2654435761u) & table->mask;
+    while (table->keys[slot]) {
+        if (table->keys[slot] == text) return table->ids[slot];
+        slot = (slot + 1) & table->mask;
+    }
+    table->keys[slot] = text;
+    table->ids[slot] = table->count;
+    table->strings[table->count] = text;
+    return table->count++;
+}
+
+static void writeStringChunk(ChunkWriter* writer, const SceneStringTable* table, uint32_t writeFlags, uint32_t* chunkCount) {
+    size_t bytes = 0;
+    for (uint32_t i = 0; i < table->count; i++) {
+        bytes += strlen(table->strings[i]) + 1;
+    }
+
+    beginChunk(writer, "STRS", sizeof(SceneBlockHeader) + table->count * sizeof(uint32_t) + bytes, writeFlags);
+    SceneBlockHeader block = { table->count, { 0 } };
+    chunkWrite(writer, &block, sizeof(block));
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < table->count; i++) {
+        chunkWrite(writer, &offset, sizeof(offset));
+        offset += (uint32_t)strlen(table->strings[i]) + 1;
+    }
+    chunkAlign(writer);
+    for (uint32_t i = 0; i < table->count; i++) {
+        chunkWrite(writer, table->strings[i], strlen(table->strings[i]) + 1);
+    }
+    endChunk(writer, chunkCount);
+}
+
+static void writeObjectChunk(ChunkWriter* writer, const SceneSnapshot* snapshot, const uint32_t* stringIds,
+                             uint32_t writeFlags, uint32_t* chunkCount, atomic_int* progress) {
+    uint32_t count = (uint32_t)snapshot->objectCount;
+    beginChunk(writer, "OBJS", objectColumnOffset(count, COLUMN_COUNT), writeFlags);
+    SceneBlockHeader block = { count, { 0 } };
+    chunkWrite(writer, &block, sizeof(block));
+
+    // Columns are transposed from the records through a small staging buffer
+    float staging[SCENE_STAGING_ELEMENTS * 4];
+    for (int column = 0; column < COLUMN_COUNT; column++) {
+        for (uint32_t first = 0; first < count; first += SCENE_STAGING_ELEMENTS) {
+            uint32_t batch = count - first < SCENE_STAGING_ELEMENTS ? count - first : SCENE_STAGING_ELEMENTS;
+            unsigned char* bytes = (unsigned char*)staging;
+            uint32_t* ids = (uint32_t*)staging;
+            for (uint32_t i = 0; i < batch; i++) {
+                const SceneObjectRecord* record = &snapshot->objects[first + i];
+                switch ((SceneColumn)column) {
+                case COLUMN_TYPE: bytes[i] = record->type; break;
+                case COLUMN_FLAGS: bytes[i] = record->flags; break;
+                case COLUMN_TEXTURE: ids[i] = stringIds[(first + i) * 3 + 0]; break;
+                case COLUMN_MATERIAL: ids[i] = stringIds[(first + i) * 3 + 1]; break;
+                case COLUMN_MODEL: ids[i] = stringIds[(first + i) * 3 + 2]; break;
+                case COLUMN_POSITION: memcpy(&staging[i * 3], &record->position, sizeof(Vector3)); break;
+                case COLUMN_ROTATION: memcpy(&staging[i * 3], &record->rotation, sizeof(Vector3)); break;
+                case COLUMN_SCALE: memcpy(&staging[i * 3], &record->scale, sizeof(Vector3)); break;
+                case COLUMN_COLOR: memcpy(&staging[i * 4], &record->color, sizeof(Vector4)); break;
+                default: break;
+                }
+            }
+            chunkWrite(writer, staging, batch * columnElementSize[column]);
+        }
+        chunkAlign(writer);
+        if (progress) {
+            atomic_store(progress, (column + 1) * (SCENE_PROGRESS_DONE - 1) / COLUMN_COUNT);
+        }
+    }
+    endChunk(writer, chunkCount);
+}
+
+static void writeHierarchyChunk(ChunkWriter* writer, const SceneSnapshot* snapshot, uint32_t* chunkCount) {
+    bool hasParents = false;
+    for (int i = 0; i < snapshot->objectCount && !hasParents; i++) {
+        hasParents = snapshot->objects[i].parent >= 0;
+    }
+    if (!hasParents) return;
+
+    beginChunk(writer, "HIER", 0, 0);
+    SceneBlockHeader block = { (uint32_t)snapshot->objectCount, { 0 } };
+    chunkWrite(writer, &block, sizeof(block));
+    for (int i = 0; i < snapshot->objectCount; i++) {
+        chunkWrite(writer, &snapshot->objects[i].parent, sizeof(int32_t));
+    }
+    endChunk(writer, chunkCount);
+}
+
+static void writeLightChunk(ChunkWriter* writer, const SceneSnapshot* snapshot, uint32_t* chunkCount) {
+    beginChunk(writer, "LITE", 0, 0);
+    SceneBlockHeader block = { (uint32_t)snapshot->lightCount, { 0 } };
+    chunkWrite(writer, &block, sizeof(block));
+    for (int i = 0; i < snapshot->lightCount; i++) {
+        SceneLightRecord record = makeLightRecord(&snapshot->lights[i]);
+        chunkWrite(writer, &record, sizeof(record));
+    }
+    endChunk(writer, chunkCount);
+}
+
+static void writeCameraChunk(ChunkWriter* writer, const Camera* cam, uint32_t* chunkCount) {
+    SceneCameraRecord record = makeCameraRecord(cam);
+    beginChunk(writer, "CAMR", 0, 0);
+    chunkWrite(writer, &record, sizeof(record));
+    endChunk(writer, chunkCount);
+}
+
+bool flushFileToDisk(FILE* file) {
+    if (fflush(file) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+bool replaceFile(const char* from, const char* to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+bool writeSceneFile(const SceneSnapshot* snapshot, const char* path, uint32_t writeFlags, atomic_int* progress) {
+    SceneStringTable table = { 0 };
+    uint32_t* stringIds = (uint32_t*)engineMalloc((size_t)(snapshot->objectCount * 3 + 1) * sizeof(uint32_t));
+    if (!stringIds || !initStringTable(&table, snapshot->objectCount)) {
+        LOG_ERROR(LOG_SCENE, "Failed to allocate the scene string table.");
+        engineFree(stringIds);
+        freeStringTable(&table);
+        return false;
+    }
+    for (int i = 0; i < snapshot->objectCount; i++) {
+        stringIds[i * 3 + 0] = stringId(&table, snapshot->objects[i].textureName);
+        stringIds[i * 3 + 1] = stringId(&table, snapshot->objects[i].materialName);
+        stringIds[i * 3 + 2] = stringId(&table, snapshot->objects[i].modelPath);
+    }
+
+    ChunkWriter* writer = (ChunkWriter*)engineCalloc(1, sizeof(ChunkWriter));
+    FILE* file = fopen(path, "wb");
+    if (!writer || !file) {
+        LOG_ERROR(LOG_SCENE, "Failed to open %s for writing.", path);
+        if (file) fclose(file);
+        engineFree(writer);
+        engineFree(stringIds);
+        freeStringTable(&table);
+        return false;
+    }
+    setvbuf(file, NULL, _IOFBF, SCENE_IO_BLOCK * 4);
+    writer->file = file;
+    writer->ok = true;
+
+    SceneFileHeader header = { { 0 }, SCENE_FORMAT_VERSION, 0, 0 };
+    memcpy(header.magic, sceneMagic, 4);
+    writeBytes(writer, &header, sizeof(header));
+
+    writeStringChunk(writer, &table, writeFlags, &header.chunkCount);
+    writeObjectChunk(writer, snapshot, stringIds, writeFlags, &header.chunkCount, progress);
+    writeHierarchyChunk(writer, snapshot, &header.chunkCount);
+    writeLightChunk(writer, snapshot, &header.chunkCount);
+    writeCameraChunk(writer, &snapshot->camera, &header.chunkCount);
+
+    uint32_t toggles[4] = { snapshot->toggles, 0, 0, 0 };
+    beginChunk(writer, "TOGL", 0, 0);
+    chunkWrite(writer, toggles, sizeof(toggles));
+    endChunk(writer, &header.chunkCount);
+
+    if (writer->ok && fseek(file, 0, SEEK_SET) == 0) {
+        writeBytes(writer, &header, sizeof(header));
+    }
+    bool ok = writer->ok;
+    if (ok && (writeFlags & SCENE_WRITE_DURABLE) && !flushFileToDisk(file)) ok = false;
+    if (fclose(file) != 0) ok = false;
+    if (ok && progress) atomic_store(progress, SCENE_PROGRESS_DONE);
+    if (!ok) LOG_ERROR(LOG_SCENE, "Failed to write scene file %s.", path);
+
+    engineFree(writer);
+    engineFree(stringIds);
+    freeStringTable(&table);
+    return ok;
+}
+
+// ---- Loading ----
+
+typedef struct {
+    const unsigned char* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+} MappedFile;
+
+static bool mapFile(const char* path, MappedFile* mapped) {
+    memset(mapped, 0, sizeof(MappedFile));
+#ifdef _WIN32
+    mapped->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (mapped->file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(mapped->file, &size) || size.QuadPart == 0) {
+        CloseHandle(mapped->file);
+        return false;
+    }
+    mapped->size = (size_t)size.QuadPart;
+    mapped->mapping = CreateFileMappingA(mapped->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapped->mapping) {
+        CloseHandle(mapped->file);
+        return false;
+    }
+    mapped->data = (const unsigned char*)MapViewOfFile(mapped->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!mapped->data) {
+        CloseHandle(mapped->mapping);
+        CloseHandle(mapped->file);
+        return false;
+    }
+    return true;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    mapped->size = (size_t)info.st_size;
+    void* data = mmap(NULL, mapped->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file alive
+    if (data == MAP_FAILED) return false;
+    madvise(data, mapped->size, MADV_SEQUENTIAL);
+    mapped->data = (const unsigned char*)data;
+    return true;
+#endif
+}
+
+static void unmapFile(MappedFile* mapped) {
+    if (!mapped->data) return;
+#ifdef _WIN32
+    UnmapViewOfFile(mapped->data);
+    CloseHandle(mapped->mapping);
+    CloseHandle(mapped->file);
+#else
+    munmap((void*)mapped->data, mapped->size);
+#endif
+    mapped->data = NULL;
+}
+
+bool isSceneFile(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+    char magic[4] = { 0 };
+    size_t read = fread(magic, 1, sizeof(magic), file);
+    fclose(file);
+    return read == sizeof(magic) && memcmp(magic, sceneMagic, 4) == 0;
+}
+
+typedef struct {
+    const unsigned char* data; // Points into the mapping, or at inflated
+    size_t size;
+    unsigned char* inflated;   // Owned copy for compressed chunks
+} ScenePayload;
+
+static bool readChunkPayload(const SceneChunkHeader* header, const unsigned char* stored, ScenePayload* payload) {
+    if (!(header->flags & SCENE_CHUNK_COMPRESSED)) {
+        payload->data = stored;
+        payload->size = (size_t)header->size;
+        return true;
+    }
+#ifdef CLUE_HAVE_ZLIB
+    uLongf rawSize = (uLongf)header->rawSize;
+    payload->inflated = (unsigned char*)engineMalloc(rawSize > 0 ? rawSize : 1);
+    if (!payload->inflated) return false;
+    if (uncompress(payload->inflated, &rawSize, stored, (uLong)header->size) != Z_OK || rawSize != header->rawSize) {
+        engineFree(payload->inflated);
+        payload->inflated = NULL;
+        return false;
+    }
+    payload->data = payload->inflated;
+    payload->size = (size_t)rawSize;
+    return true;
+#else
+    LOG_ERROR(LOG_SCENE, "Scene chunk %.4s is compressed, but this build has no zlib.", header->id);
+    return false;
+#endif
+}
+
+typedef struct {
+    uint32_t count;
+    const uint32_t* offsets;
+    const char* bytes;
+    size_t byteCount;
+} SceneStrings;
+
+static const char* sceneString(const SceneStrings* strings, uint32_t id) {
+    if (id == SCENE_NO_STRING || id >= strings->count || strings->offsets[id] >= strings->byteCount) return NULL;
+    return strings->bytes + strings->offsets[id];
+}
+
+static bool parseStrings(const ScenePayload* payload, SceneStrings* strings) {
+    if (payload->size < sizeof(SceneBlockHeader)) return false;
+    uint32_t count = ((const SceneBlockHeader*)payload->data)->count;
+    size_t bytesOffset = alignScene(sizeof(SceneBlockHeader) + (size_t)count * sizeof(uint32_t));
+    if (bytesOffset > payload->size) return false;
+    strings->count = count;
+    strings->offsets = (const uint32_t*)(payload->data + sizeof(SceneBlockHeader));
+    strings->bytes = (const char*)payload->data + bytesOffset;
+    strings->byteCount = payload->size - bytesOffset;
+    // Every lookup stays terminated if the table ends on a terminator
+    return strings->byteCount == 0 ? count == 0 : strings->bytes[strings->byteCount - 1] == '\0';
+}
+
+static bool placeObject(ObjectType type, uint8_t flags, int textureIndex, const PBRMaterial* material, Model* model,
+                        Vector3 position, Vector3 rotation, Vector3 scale, Vector4 color) {
+    int previousCount = objectManager.count;
+    addObject(&camera, type, textureIndex >= 0, textureIndex, (flags & SCENE_OBJECT_USE_COLOR) != 0,
+              model, *material, (flags & SCENE_OBJECT_USE_PBR) != 0);
+    if (objectManager.count == previousCount) return false;
+
+    SceneObject* obj = &objectManager.objects[objectManager.count - 1];
+    obj->position = position;
+    obj->rotation = rotation;
+    obj->scale = scale;
+    obj->color = color;
+    obj->object.useLighting = (flags & SCENE_OBJECT_USE_LIGHTING) != 0;
+    return true;
+}
+
+bool addSceneObject(const SceneObjectRecord* record) {
+    ObjectType type = (ObjectType)record->type;
+    if (type > OBJ_MODEL) return false;
+
+    PBRMaterial defaultMaterial = { 0 };
+    PBRMaterial* material = getMaterial(record->materialName ? record->materialName : "peacockOre");
+    if (!material) material = &defaultMaterial;
+    int textureIndex = (record->flags & SCENE_OBJECT_USE_TEXTURE) ? findTextureIndex(record->textureName) : -1;
+
+    Model* model = NULL;
+    if (type == OBJ_MODEL) {
+        model = record->modelPath ? acquireModel(record->modelPath) : NULL;
+        if (!model) {
+            LOG_ERROR(LOG_SCENE, "Failed to load model from path: %s", record->modelPath ? record->modelPath : "(invalid)");
+            return false;
+        }
+    }
+
+    bool added = placeObject(type, record->flags, textureIndex, material, model,
+                             record->position, record->rotation, record->scale, record->color);
+    if (model) releaseModel(model); // The object holds its own reference
+    return added;
+}
+
+// Every distinct model path is loaded up front, concurrently, so opening a
+// scene costs the slowest model rather than the sum of them
+static void resolveSceneModels(uint32_t count, const uint8_t* types, const uint32_t* modelIds,
+                               const SceneStrings* strings, Model** models) {
+    const char** paths = (const char**)engineCalloc(strings->count > 0 ? strings->count : 1, sizeof(const char*));
+    if (!paths) return;
+    uint32_t loadable = (uint32_t)(MAX_OBJECTS - objectManager.count);
+    for (uint32_t i = 0; i < count && i < loadable; i++) {
+        if (types[i] == OBJ_MODEL && modelIds[i] < strings->count) {
+            paths[modelIds[i]] = sceneString(strings, modelIds[i]);
+        }
+    }
+
+    acquireModels(paths, (int)strings->count, models);
+    for (uint32_t i = 0; i < strings->count; i++) {
+        if (paths[i] && !models[i]) {
+            LOG_ERROR(LOG_SCENE, "Failed to load model from path: %s", paths[i]);
+        }
+    }
+    engineFree(paths);
+}
+
+// Fills placed[i] with the scene index record i was loaded at, or -1, when placed is not NULL
+// The payload passed validateObjects()
+static void applyObjects(const ScenePayload* payload, const SceneStrings* strings, int* placed, uint32_t placedCount) {
+    uint32_t count = ((const SceneBlockHeader*)payload->data)->count;
+
+    // Columns are read in place from the mapping
+    const uint8_t* types = payload->data + objectColumnOffset(count, COLUMN_TYPE);
+    const uint8_t* flags = payload->data + objectColumnOffset(count, COLUMN_FLAGS);
+    const uint32_t* textureIds = (const uint32_t*)(payload->data + objectColumnOffset(count, COLUMN_TEXTURE));
+    const uint32_t* materialIds = (const uint32_t*)(payload->data + objectColumnOffset(count, COLUMN_MATERIAL));
+    const uint32_t* modelIds = (const uint32_t*)(payload->data + objectColumnOffset(count, COLUMN_MODEL));
+    const Vector3* positions = (const Vector3*)(payload->data + objectColumnOffset(count, COLUMN_POSITION));
+    const Vector3* rotations = (const Vector3*)(payload->data + objectColumnOffset(count, COLUMN_ROTATION));
+    const Vector3* scales = (const Vector3*)(payload->data + objectColumnOffset(count, COLUMN_SCALE));
+    const Vector4* colors = (const Vector4*)(payload->data + objectColumnOffset(count, COLUMN_COLOR));
+
+    // Each distinct string is resolved once, not once per object
+    size_t lookupCount = strings->count > 0 ? strings->count : 1;
+    Model** models = (Model**)engineCalloc(lookupCount, sizeof(Model*));
+    PBRMaterial** resolvedMaterials = (PBRMaterial**)engineCalloc(lookupCount, sizeof(PBRMaterial*));
+    int* textureIndices = (int*)engineMalloc(lookupCount * sizeof(int));
+    if (!models || !resolvedMaterials || !textureIndices) {
+        LOG_ERROR(LOG_SCENE, "Failed to allocate scene lookup tables.");
+        engineFree(models);
+        engineFree(resolvedMaterials);
+        engineFree(textureIndices);
+        return;
+    }
+    for (size_t i = 0; i < lookupCount; i++) textureIndices[i] = -2; // Not resolved yet
+    resolveSceneModels(count, types, modelIds, strings, models);
+
+    PBRMaterial defaultMaterial = { 0 };
+    PBRMaterial* fallbackMaterial = getMaterial("peacockOre");
+    if (!fallbackMaterial) fallbackMaterial = &defaultMaterial;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (objectManager.count >= MAX_OBJECTS) {
+            LOG_WARN(LOG_SCENE, "Scene has %u objects; only the first %d were loaded.", count, MAX_OBJECTS);
+            break;
+        }
+
+        ObjectType type = (ObjectType)types[i];
+        if (type > OBJ_MODEL) continue;
+
+        PBRMaterial* material = fallbackMaterial;
+        uint32_t materialId = materialIds[i];
+        if (materialId < strings->count) {
+            if (!resolvedMaterials[materialId]) {
+                const char* name = sceneString(strings, materialId);
+                resolvedMaterials[materialId] = name ? getMaterial(name) : NULL;
+                if (!resolvedMaterials[materialId]) resolvedMaterials[materialId] = fallbackMaterial;
+            }
+            material = resolvedMaterials[materialId];
+        }
+
+        int textureIndex = -1;
+        uint32_t textureId = textureIds[i];
+        if ((flags[i] & SCENE_OBJECT_USE_TEXTURE) && textureId < strings->count) {
+            if (textureIndices[textureId] == -2) {
+                textureIndices[textureId] = findTextureIndex(sceneString(strings, textureId));
+            }
+            textureIndex = textureIndices[textureId];
+        }
+
+        Model* model = NULL;
+        if (type == OBJ_MODEL) {
+            if (modelIds[i] >= strings->count || !models[modelIds[i]]) continue;
+            model = models[modelIds[i]];
+        }
+
+        if (placeObject(type, flags[i], textureIndex, material, model, positions[i], rotations[i], scales[i], colors[i]) &&
+            placed && i < placedCount) {
+            placed[i] = objectManager.count - 1;
+        }
+    }
+
+    // The objects hold their own references now
+    for (size_t i = 0; i < lookupCount; i++) {
+        if (models[i]) releaseModel(models[i]);
+    }
+    engineFree(models);
+    engineFree(resolvedMaterials);
+    engineFree(textureIndices);
+}
+
+static uint32_t sceneObjectCount(const ScenePayload* payload) {
+    return payload->size < sizeof(SceneBlockHeader) ? 0 : ((const SceneBlockHeader*)payload->data)->count;
+}
+
+static bool validString(const SceneStrings* strings, uint32_t id) {
+    return id == SCENE_NO_STRING || sceneString(strings, id) != NULL;
+}
+
+// Every column fits the payload and every string id names a string in the table
+static bool validateObjects(const ScenePayload* payload, const SceneStrings* strings) {
+    if (payload->size < sizeof(SceneBlockHeader)) return false;
+    uint32_t count = sceneObjectCount(payload);
+    if (objectColumnOffset(count, COLUMN_COUNT) > payload->size) return false;
+    const uint32_t* textureIds = (const uint32_t*)(payload->data + objectColumnOffset(count, COLUMN_TEXTURE));
+    const uint32_t* materialIds = (const uint32_t*)(payload->data + objectColumnOffset(count, COLUMN_MATERIAL));
+    const uint32_t* modelIds = (const uint32_t*)(payload->data + objectColumnOffset(count, COLUMN_MODEL));
+    for (uint32_t i = 0; i < count; i++) {
+        if (!validString(strings, textureIds[i]) || !validString(strings, materialIds[i]) || !validString(strings, modelIds[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool validateBlock(const ScenePayload* payload, size_t recordSize) {
+    return payload->size >= sizeof(SceneBlockHeader) &&
+           sizeof(SceneBlockHeader) + (size_t)sceneObjectCount(payload) * recordSize <= payload->size;
+}
+
+// Links are resolved through placed, so objects that failed to load leave their children at the root
+static void applyHierarchy(const ScenePayload* payload, const int* placed, uint32_t placedCount) {
+    uint32_t count = sceneObjectCount(payload);
+    const int32_t* parents = (const int32_t*)(payload->data + sizeof(SceneBlockHeader));
+    for (uint32_t i = 0; i < count && i < placedCount; i++) {
+        int32_t parent = parents[i];
+        if (placed[i] < 0 || parent < 0 || (uint32_t)parent >= placedCount || placed[parent] < 0) continue;
+        setObjectParent(placed[i], placed[parent]);
+    }
+}
+
+static void applyLights(const ScenePayload* payload) {
+    uint32_t count = ((const SceneBlockHeader*)payload->data)->count;
+    const SceneLightRecord* records = (const SceneLightRecord*)(payload->data + sizeof(SceneBlockHeader));
+    for (uint32_t i = 0; i < count; i++) {
+        const SceneLightRecord* record = &records[i];
+        Light light = {
+            .type = (LightType)record->type,
+            .position = { record->position[0], record->position[1], record->position[2] },
+            .direction = { record->direction[0], record->direction[1], record->direction[2] },
+            .color = { record->color[0], record->color[1], record->color[2] },
+            .intensity = record->intensity,
+            .constant = record->constant,
+            .linear = record->linear,
+            .quadratic = record->quadratic,
+            .cutOff = record->cutOff,
+            .outerCutOff = record->outerCutOff
+        };
+        addLight(light);
+    }
+}
+
+static void applyCamera(const ScenePayload* payload) {
+    const SceneCameraRecord* record = (const SceneCameraRecord*)payload->data;
+    camera.Position = (Vector3){ record->position[0], record->position[1], record->position[2] };
+    camera.Front = (Vector3){ record->front[0], record->front[1], record->front[2] };
+    camera.Up = (Vector3){ record->up[0], record->up[1], record->up[2] };
+    camera.Right = (Vector3){ record->right[0], record->right[1], record->right[2] };
+    camera.WorldUp = (Vector3){ record->worldUp[0], record->worldUp[1], record->worldUp[2] };
+    camera.Yaw = record->yaw;
+    camera.Pitch = record->pitch;
+    camera.MovementSpeed = record->movementSpeed;
+    camera.MouseSensitivity = record->mouseSensitivity;
+    camera.Zoom = record->zoom;
+    camera.invertY = record->invertY != 0;
+    camera.mode = (CameraMode)record->mode;
+}
+
+static void applyToggles(const ScenePayload* payload) {
+    uint32_t toggles = *(const uint32_t*)payload->data;
+    isRunning = (toggles & SCENE_TOGGLE_RUNNING) != 0;
+    texturesEnabled = (toggles & SCENE_TOGGLE_TEXTURES) != 0;
+    colorsEnabled = (toggles & SCENE_TOGGLE_COLORS) != 0;
+    lightingEnabled = (toggles & SCENE_TOGGLE_LIGHTING) != 0;
+    noShading = (toggles & SCENE_TOGGLE_NO_SHADING) != 0;
+    usePBR = (toggles & SCENE_TOGGLE_PBR) != 0;
+    backgroundEnabled = (toggles & SCENE_TOGGLE_BACKGROUND) != 0;
+}
+
+enum { CHUNK_STRS, CHUNK_OBJS, CHUNK_HIER, CHUNK_LITE, CHUNK_CAMR, CHUNK_TOGL, KNOWN_CHUNK_COUNT };
+static const char knownChunks[KNOWN_CHUNK_COUNT][4] = {
+    { 'S', 'T', 'R', 'S' }, { 'O', 'B', 'J', 'S' }, { 'H', 'I', 'E', 'R' }, { 'L', 'I', 'T', 'E' }, { 'C', 'A', 'M', 'R' },
+    { 'T', 'O', 'G', 'L' }
+};
+
+bool loadSceneFile(const char* path) {
+    MappedFile mapped;
+    if (!mapFile(path, &mapped)) {
+        LOG_ERROR(LOG_SCENE, "Failed to open scene file %s.", path);
+        return false;
+    }
+
+    SceneFileHeader header;
+    if (mapped.size < sizeof(header)) {
+        LOG_ERROR(LOG_SCENE, "%s is not a scene file.", path);
+        unmapFile(&mapped);
+        return false;
+    }
+    memcpy(&header, mapped.data, sizeof(header));
+    if (memcmp(header.magic, sceneMagic, 4) != 0 || header.version == 0 || header.version > SCENE_FORMAT_VERSION) {
+        LOG_ERROR(LOG_SCENE, "%s is not a supported scene file (version %u).", path, header.version);
+        unmapFile(&mapped);
+        return false;
+    }
+
+    // Locate every chunk before touching the scene, so a damaged file leaves it intact
+    ScenePayload payloads[KNOWN_CHUNK_COUNT];
+    memset(payloads, 0, sizeof(payloads));
+    bool ok = true;
+    size_t offset = sizeof(header);
+    for (uint32_t c = 0; c < header.chunkCount && ok; c++) {
+        offset = alignScene(offset);
+        if (offset + sizeof(SceneChunkHeader) > mapped.size) {
+            ok = false;
+            break;
+        }
+        SceneChunkHeader chunk;
+        memcpy(&chunk, mapped.data + offset, sizeof(chunk));
+        offset += sizeof(SceneChunkHeader);
+        if (chunk.size > mapped.size - offset) {
+            ok = false;
+            break;
+        }
+        for (int k = 0; k < KNOWN_CHUNK_COUNT; k++) {
+            if (memcmp(chunk.id, knownChunks[k], 4) == 0 && !payloads[k].data) {
+                ok = readChunkPayload(&chunk, mapped.data + offset, &payloads[k]);
+                break;
+            }
+        }
+        offset += (size_t)chunk.size;
+    }
+
+    SceneStrings strings = { 0 };
+    if (ok && payloads[CHUNK_STRS].data) {
+        ok = parseStrings(&payloads[CHUNK_STRS], &strings);
+    }
+    // The apply steps below trust these sizes
+    if (ok && payloads[CHUNK_OBJS].data) ok = validateObjects(&payloads[CHUNK_OBJS], &strings);
+    if (ok && payloads[CHUNK_HIER].data) ok = validateBlock(&payloads[CHUNK_HIER], sizeof(int32_t));
+    if (ok && payloads[CHUNK_LITE].data) ok = validateBlock(&payloads[CHUNK_LITE], sizeof(SceneLightRecord));
+    if (ok && payloads[CHUNK_CAMR].data) ok = payloads[CHUNK_CAMR].size >= sizeof(SceneCameraRecord);
+    if (ok && payloads[CHUNK_TOGL].data) ok = payloads[CHUNK_TOGL].size >= sizeof(uint32_t);
+
+    if (ok) {
+        cleanupObjects();
+        lightCount = 0;
+        selected_object = NULL;
+        if (payloads[CHUNK_OBJS].data) {
+            // Parent links name records, which only map to scene indices once loaded
+            uint32_t recordCount = payloads[CHUNK_HIER].data ? sceneObjectCount(&payloads[CHUNK_OBJS]) : 0;
+            int* placed = recordCount > 0 ? (int*)engineMalloc(recordCount * sizeof(int)) : NULL;
+            for (uint32_t i = 0; placed && i < recordCount; i++) placed[i] = -1;
+            applyObjects(&payloads[CHUNK_OBJS], &strings, placed, placed ? recordCount : 0);
+            if (placed) applyHierarchy(&payloads[CHUNK_HIER], placed, recordCount);
+            engineFree(placed);
+        }
+        if (payloads[CHUNK_LITE].data) applyLights(&payloads[CHUNK_LITE]);
+        if (payloads[CHUNK_CAMR].data) applyCamera(&payloads[CHUNK_CAMR]);
+        if (payloads[CHUNK_TOGL].data) applyToggles(&payloads[CHUNK_TOGL]);
+    }
+    else {
+        LOG_ERROR(LOG_SCENE, "Scene file %s is damaged.", path);
+    }
+
+    for (int k = 0; k < KNOWN_CHUNK_COUNT; k++) {
+        engineFree(payloads[k].inflated);
+    }
+    unmapFile(&mapped);
+    return ok;
+}
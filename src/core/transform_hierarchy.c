@@ -0,0 +1,193 @@
+#include "transform_hierarchy.h"
+#include "ObjectManager.h"
+#include "SceneObject.h"
+#include "jobs.h"
+#include "logger.h"
+#include <stdatomic.h>
+#include <string.h>
+
+// Indices here are slots in depth order unless named after objects
+static int order[MAX_OBJECTS];          // Slot -> object index
+static int slotOf[MAX_OBJECTS];         // Object index -> slot
+static int parentSlot[MAX_OBJECTS];     // -1 for roots
+static int firstChild[MAX_OBJECTS];     // Where the slot's children start in the next level
+static int childCount[MAX_OBJECTS];
+static int levelOf[MAX_OBJECTS];
+static Matrix4x4 local[MAX_OBJECTS];
+static Matrix4x4 world[MAX_OBJECTS];
+static unsigned char dirty[MAX_OBJECTS];   // The slot's own transform changed
+static unsigned int updatedPass[MAX_OBJECTS]; // Pass that last recomputed the slot's world matrix
+
+// Marked slots of each level, as a half-open range; empty when low >= high
+static int levelStart[MAX_OBJECTS + 1];
+static int dirtyLow[MAX_OBJECTS];
+static int dirtyHigh[MAX_OBJECTS];
+static int levelCount = 0;
+static int slotCount = 0;
+
+static bool structureChanged = true;
+static bool anyDirty = false;
+static unsigned int pass = 0;
+
+typedef struct {
+    int first; // Slot the parallel range starts at
+    atomic_int updated;
+} UpdateContext;
+
+void markTransformDirty(int index) {
+    if (structureChanged || index < 0 || index >= slotCount) return; // The rebuild recomputes everything
+    int slot = slotOf[index];
+    int level = levelOf[slot];
+    dirty[slot] = 1;
+    if (dirtyLow[level] >= dirtyHigh[level]) {
+        dirtyLow[level] = slot;
+        dirtyHigh[level] = slot + 1;
+    }
+    else {
+        if (slot < dirtyLow[level]) dirtyLow[level] = slot;
+        if (slot >= dirtyHigh[level]) dirtyHigh[level] = slot + 1;
+    }
+    anyDirty = true;
+}
+
+void markHierarchyChanged() {
+    structureChanged = true;
+}
+
+// Parent indices for every object; links into a cycle are dropped so the
+// breadth-first walk reaches every object
+static void resolveParents(int count, int* parents) {
+    for (int i = 0; i < count; i++) {
+        parents[i] = objectManager.objects[i].parentId >= 0 ? findObjectIndex(objectManager.objects[i].parentId) : -1;
+    }
+    for (int i = 0; i < count; i++) {
+        // A chain longer than the scene has entered a loop, so its last object is on it
+        int p = parents[i];
+        for (int steps = 0; p >= 0 && steps < count; steps++) p = parents[p];
+        if (p >= 0) {
+            LOG_WARN(LOG_SCENE, "Object %d is its own ancestor; detaching it.", objectManager.objects[p].id);
+            objectManager.objects[p].parentId = -1;
+            parents[p] = -1;
+        }
+    }
+}
+
+// Breadth-first from the roots in object order. Children are appended while
+// their parent is visited, so each parent's children end up contiguous and in
+// the same order as their parents.
+static void rebuildOrder() {
+    static int parents[MAX_OBJECTS];
+    static int childOffsets[MAX_OBJECTS + 1];
+    static int children[MAX_OBJECTS];
+    static int cursor[MAX_OBJECTS];
+    int count = objectManager.count;
+    if (count < 0) count = 0;
+    if (count > MAX_OBJECTS) count = MAX_OBJECTS; // The manager never holds more; keeps every size below in bounds
+    resolveParents(count, parents);
+
+    memset(childOffsets, 0, (size_t)(count + 1) * sizeof(int));
+    for (int i = 0; i < count; i++) {
+        if (parents[i] >= 0) childOffsets[parents[i] + 1]++;
+    }
+    for (int i = 0; i < count; i++) childOffsets[i + 1] += childOffsets[i];
+    memcpy(cursor, childOffsets, (size_t)count * sizeof(int));
+    for (int i = 0; i < count; i++) {
+        if (parents[i] >= 0) children[cursor[parents[i]]++] = i;
+    }
+
+    int tail = 0;
+    for (int i = 0; i < count; i++) {
+        if (parents[i] < 0) {
+            parentSlot[tail] = -1;
+            levelOf[tail] = 0;
+            order[tail++] = i;
+        }
+    }
+    for (int slot = 0; slot < tail; slot++) {
+        int object = order[slot];
+        slotOf[object] = slot;
+        firstChild[slot] = tail;
+        childCount[slot] = childOffsets[object + 1] - childOffsets[object];
+        for (int c = childOffsets[object]; c < childOffsets[object + 1]; c++) {
+            parentSlot[tail] = slot;
+            levelOf[tail] = levelOf[slot] + 1;
+            order[tail++] = children[c];
+        }
+    }
+
+    slotCount = count;
+    levelCount = 0;
+    for (int slot = 0; slot < count; slot++) {
+        while (levelCount <= levelOf[slot]) levelStart[levelCount++] = slot;
+    }
+    levelStart[levelCount] = count;
+
+    // Every local matrix is recomputed after a rebuild
+    for (int level = 0; level < levelCount; level++) {
+        dirtyLow[level] = levelStart[level];
+        dirtyHigh[level] = levelStart[level + 1];
+    }
+    memset(dirty, 1, (size_t)slotCount);
+    anyDirty = count > 0;
+    structureChanged = false;
+}
+
+static void updateSlotRange(int start, int end, void* data) {
+    UpdateContext* context = (UpdateContext*)data;
+    int updated = 0;
+    for (int slot = context->first + start; slot < context->first + end; slot++) {
+        int parent = parentSlot[slot];
+        bool parentMoved = parent >= 0 && updatedPass[parent] == pass;
+        if (!dirty[slot] && !parentMoved) continue;
+
+        if (dirty[slot]) {
+            local[slot] = computeModelMatrix(&objectManager.objects[order[slot]]);
+            dirty[slot] = 0;
+        }
+        // The local transform applies first, then the parent's world transform
+        world[slot] = parent >= 0 ? matrixMultiply(local[slot], world[parent]) : local[slot];
+        updatedPass[slot] = pass;
+        updated++;
+    }
+    atomic_fetch_add(&context->updated, updated);
+}
+
+int updateTransformHierarchy() {
+    if (structureChanged) rebuildOrder();
+    if (!anyDirty) return 0;
+    pass++;
+
+    UpdateContext context;
+    atomic_init(&context.updated, 0);
+    int low = 0, high = 0; // Range of the previous level that was walked
+    for (int level = 0; level < levelCount; level++) {
+        // Children of the walked range are contiguous in this level
+        int childLow = 0, childHigh = 0;
+        if (low < high) {
+            childLow = firstChild[low];
+            childHigh = firstChild[high - 1] + childCount[high - 1];
+        }
+        int rangeLow = dirtyLow[level], rangeHigh = dirtyHigh[level];
+        if (rangeLow >= rangeHigh) {
+            rangeLow = childLow;
+            rangeHigh = childHigh;
+        }
+        else if (childLow < childHigh) {
+            if (childLow < rangeLow) rangeLow = childLow;
+            if (childHigh > rangeHigh) rangeHigh = childHigh;
+        }
+        dirtyLow[level] = dirtyHigh[level] = 0;
+
+        low = rangeLow;
+        high = rangeHigh;
+        if (low >= high) continue;
+        context.first = low;
+        parallelFor(high - low, TRANSFORMS_PER_UPDATE_BATCH, updateSlotRange, &context);
+    }
+    anyDirty = false;
+    return atomic_load(&context.updated);
+}
+
+const Matrix4x4* getWorldTransform(int index) {
+    return &world[slotOf[index]];
+}
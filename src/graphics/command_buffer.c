@@ -0,0 +1,282 @@
+#include "command_buffer.h"
+#include "logger.h"
+#include "allocators.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COMMAND_LIST_INITIAL_BYTES (64 * 1024)
+#define COMMAND_LIST_INITIAL_RECORDS 1024
+#define MAX_REPLAY_PROGRAMS 8
+
+typedef struct {
+    GLuint program;
+    GLint model;
+    GLint inputColor;
+    GLint useTexture;
+    GLint usePBR;
+    GLint useColor;
+    GLint materialClass;
+    GLint materialLayer;
+    GLint positionScale;
+    GLint positionBias;
+} ProgramUniforms;
+
+// Only touched by the GL thread during replay
+static ProgramUniforms programUniforms[MAX_REPLAY_PROGRAMS];
+static int programUniformCount = 0;
+
+static const ProgramUniforms* getProgramUniforms(GLuint program) {
+    for (int i = 0; i < programUniformCount; i++) {
+        if (programUniforms[i].program == program) return &programUniforms[i];
+    }
+
+    int slot = programUniformCount < MAX_REPLAY_PROGRAMS ? programUniformCount++ : MAX_REPLAY_PROGRAMS - 1;
+    ProgramUniforms* entry = &programUniforms[slot];
+    entry->program = program;
+    entry->model = glGetUniformLocation(program, "model");
+    entry->inputColor = glGetUniformLocation(program, "inputColor");
+    entry->useTexture = glGetUniformLocation(program, "useTexture");
+    entry->usePBR = glGetUniformLocation(program, "usePBR");
+    entry->useColor = glGetUniformLocation(program, "useColor");
+    entry->materialClass = glGetUniformLocation(program, "materialClass");
+    entry->materialLayer = glGetUniformLocation(program, "materialLayer");
+    entry->positionScale = glGetUniformLocation(program, "positionScale");
+    entry->positionBias = glGetUniformLocation(program, "positionBias");
+    return entry;
+}
+
+void resetCommandBuffer(CommandBuffer* buffer) {
+    for (int i = 0; i < MAX_JOB_WORKERS; i++) {
+        buffer->lists[i].size = 0;
+        buffer->lists[i].recordCount = 0;
+        buffer->lists[i].openRecord = -1;
+    }
+    buffer->sortedCount = 0;
+}
+
+void freeCommandBuffer(CommandBuffer* buffer) {
+    for (int i = 0; i < MAX_JOB_WORKERS; i++) {
+        engineFree(buffer->lists[i].data);
+        engineFree(buffer->lists[i].records);
+    }
+    engineFree(buffer->sorted);
+    memset(buffer, 0, sizeof(CommandBuffer));
+}
+
+CommandList* getThreadCommandList(CommandBuffer* buffer) {
+    int worker = getCurrentJobWorker();
+    if (worker < 0 || worker >= MAX_JOB_WORKERS) worker = 0;
+    return &buffer->lists[worker];
+}
+
+void beginCommandRecord(CommandList* list, uint64_t key, uint32_t sequence) {
+    if (list->recordCount >= list->recordCapacity) {
+        int newCapacity = list->recordCapacity > 0 ? list->recordCapacity * 2 : COMMAND_LIST_INITIAL_RECORDS;
+        CommandRecord* grown = (CommandRecord*)engineRealloc(list->records, newCapacity * sizeof(CommandRecord));
+        if (!grown) {
+            LOG_ERROR(LOG_RENDER, "Failed to grow command list to %d records.", newCapacity);
+            list->openRecord = -1;
+            return;
+        }
+        list->records = grown;
+        list->recordCapacity = newCapacity;
+    }
+
+    CommandRecord* record = &list->records[list->recordCount];
+    record->key = key;
+    record->sequence = sequence;
+    record->list = 0; // Filled in when the lists are merged
+    record->offset = (uint32_t)list->size;
+    record->size = 0;
+    list->openRecord = list->recordCount;
+}
+
+void* pushRenderCommand(CommandList* list, RenderCommandType type, size_t size) {
+    if (list->openRecord < 0) return NULL;
+
+    size_t aligned = (size + 7) & ~(size_t)7;
+    if (list->size + aligned > list->capacity) {
+        size_t newCapacity = list->capacity > 0 ? list->capacity : COMMAND_LIST_INITIAL_BYTES;
+        while (newCapacity < list->size + aligned) newCapacity *= 2;
+        unsigned char* grown = (unsigned char*)engineRealloc(list->data, newCapacity);
+        if (!grown) {
+            LOG_ERROR(LOG_RENDER, "Failed to grow command list to %zu bytes.", newCapacity);
+            list->openRecord = -1;
+            return NULL;
+        }
+        list->data = grown;
+        list->capacity = newCapacity;
+    }
+
+    RenderCommandHeader* header = (RenderCommandHeader*)(list->data + list->size);
+    header->type = (uint16_t)type;
+    header->size = (uint16_t)aligned;
+    list->size += aligned;
+    return header;
+}
+
+void endCommandRecord(CommandList* list) {
+    if (list->openRecord < 0) return;
+    CommandRecord* record = &list->records[list->openRecord];
+    record->size = (uint32_t)(list->size - record->offset);
+    list->recordCount++;
+    list->openRecord = -1;
+}
+
+static int compareCommandRecords(const void* a, const void* b) {
+    const CommandRecord* recordA = (const CommandRecord*)a;
+    const CommandRecord* recordB = (const CommandRecord*)b;
+    if (recordA->key != recordB->key) {
+        return recordA->key < recordB->key ? -1 : 1;
+    }
+    if (recordA->sequence != recordB->sequence) {
+        return recordA->sequence < recordB->sequence ? -1 : 1;
+    }
+    return 0;
+}
+
+void sortCommandBuffer(CommandBuffer* buffer) {
+    int total = 0;
+    for (int i = 0; i < MAX_JOB_WORKERS; i++) {
+        total += buffer->lists[i].recordCount;
+    }
+
+    if (total > buffer->sortedCapacity) {
+        CommandRecord* grown = (CommandRecord*)engineRealloc(buffer->sorted, total * sizeof(CommandRecord));
+        if (!grown) {
+            LOG_ERROR(LOG_RENDER, "Failed to allocate %d sorted command records.", total);
+            buffer->sortedCount = 0;
+            return;
+        }
+        buffer->sorted = grown;
+        buffer->sortedCapacity = total;
+    }
+
+    int cursor = 0;
+    for (int i = 0; i < MAX_JOB_WORKERS; i++) {
+        const CommandList* list = &buffer->lists[i];
+        for (int r = 0; r < list->recordCount; r++) {
+            buffer->sorted[cursor] = list->records[r];
+            buffer->sorted[cursor].list = (uint32_t)i;
+            cursor++;
+        }
+    }
+    buffer->sortedCount = cursor;
+    qsort(buffer->sorted, buffer->sortedCount, sizeof(CommandRecord), compareCommandRecords);
+}
+
+int findCommandRecord(const CommandBuffer* buffer, uint64_t key) {
+    int low = 0, high = buffer->sortedCount;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (buffer->sorted[mid].key < key) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+typedef struct {
+    GLuint program;
+    const ProgramUniforms* uniforms;
+    const BindMaterialCommand* material;
+    GLuint vao;
+    int drawCount;
+} ReplayState;
+
+static void executeCommand(ReplayState* state, const RenderCommandHeader* header) {
+    switch ((RenderCommandType)header->type) {
+    case RENDER_CMD_BIND_PROGRAM: {
+        const BindProgramCommand* command = (const BindProgramCommand*)header;
+        if (state->program != command->program) {
+            glUseProgram(command->program);
+            state->program = command->program;
+            state->uniforms = getProgramUniforms(command->program);
+            state->material = NULL;
+        }
+        break;
+    }
+    case RENDER_CMD_BIND_MATERIAL: {
+        const BindMaterialCommand* command = (const BindMaterialCommand*)header;
+        const BindMaterialCommand* current = state->material;
+        if (current && current->textureID == command->textureID && current->bindTexture == command->bindTexture) {
+            break;
+        }
+        if (command->bindTexture) {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, command->textureID);
+        }
+        state->material = command;
+        break;
+    }
+    case RENDER_CMD_SET_OBJECT_DATA: {
+        const SetObjectDataCommand* command = (const SetObjectDataCommand*)header;
+        if (!state->uniforms) break;
+        glUniform1i(state->uniforms->useTexture, command->useTexture);
+        glUniform1i(state->uniforms->usePBR, command->usePBR);
+        glUniform1i(state->uniforms->useColor, command->useColor);
+        if (command->usePBR) {
+            glUniform1i(state->uniforms->materialClass, command->materialClass);
+            glUniform1i(state->uniforms->materialLayer, command->materialLayer);
+        }
+        glUniform4fv(state->uniforms->inputColor, 1, command->color);
+        glUniformMatrix4fv(state->uniforms->model, 1, GL_FALSE, command->model);
+        glUniform3fv(state->uniforms->positionScale, 1, command->positionScale);
+        glUniform3fv(state->uniforms->positionBias, 1, command->positionBias);
+        break;
+    }
+    case RENDER_CMD_DRAW: {
+        const DrawCommand* command = (const DrawCommand*)header;
+        if (state->vao != command->vao) {
+            glBindVertexArray(command->vao);
+            state->vao = command->vao;
+        }
+        size_t indexSize = command->indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+        glDrawElements(GL_TRIANGLES, command->indexCount, command->indexType, (const void*)(command->firstIndex * indexSize));
+        state->drawCount++;
+        break;
+    }
+    default:
+        LOG_ERROR(LOG_RENDER, "Unknown render command %u.", header->type);
+        break;
+    }
+}
+
+int replayCommandBuffer(const CommandBuffer* buffer, int first, int count) {
+    // Bindings made outside the replay are unknown, so the first command of each kind always applies
+    ReplayState state = { 0 };
+    GLint currentProgram = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
+    state.program = (GLuint)currentProgram;
+    state.uniforms = currentProgram ? getProgramUniforms((GLuint)currentProgram) : NULL;
+    state.vao = (GLuint)-1;
+
+    int end = first + count < buffer->sortedCount ? first + count : buffer->sortedCount;
+    for (int i = first; i < end; i++) {
+        const CommandRecord* record = &buffer->sorted[i];
+        const unsigned char* cursor = buffer->lists[record->list].data + record->offset;
+        const unsigned char* recordEnd = cursor + record->size;
+        while (cursor < recordEnd) {
+            const RenderCommandHeader* header = (const RenderCommandHeader*)cursor;
+            executeCommand(&state, header);
+            cursor += header->size;
+        }
+    }
+    return state.drawCount;
+}
+
+uint64_t makeOpaqueSortKey(GLuint program, uint32_t materialKey, GLuint vao) {
+    // pass:2 | program:10 | material:24 | vao:28, so state changes are grouped from most to least expensive
+    return (RENDER_PASS_OPAQUE << RENDER_PASS_SHIFT) |
+           ((uint64_t)(program & 0x3FF) << 52) |
+           ((uint64_t)(materialKey & 0xFFFFFF) << 28) |
+           (uint64_t)(vao & 0xFFFFFFF);
+}
+
+uint64_t makeTransparentSortKey(float cameraDistance) {
+    // Non-negative floats order like their bit patterns; invert so the farthest draws first
+    if (!(cameraDistance > 0.0f)) cameraDistance = 0.0f;
+    uint32_t bits;
+    memcpy(&bits, &cameraDistance, sizeof(bits));
+    return (RENDER_PASS_TRANSPARENT << RENDER_PASS_SHIFT) | ((uint64_t)(0xFFFFFFFFu - bits) << 28);
+}
@@ -0,0 +1,221 @@
+#include "dynamic_resolution.h"
+#include "globals.h"
+#include "shaders.h"
+#include "logger.h"
+#include "memory_accounting.h"
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static bool enabled = false;
+static GLuint sceneFBO, sceneColor, sceneDepth;
+static GLuint upscaleShader, upscaleVAO;
+static int targetWidth, targetHeight;   // Allocated size: the full framebuffer
+static int renderWidth, renderHeight;   // Part of the target drawn this frame
+static int displayWidth, displayHeight;
+
+static float scale = 1.0f;
+static double targetMilliseconds = 1000.0 / 60.0;
+static double gpuMilliseconds = 0.0;
+
+static GLuint queries[RESOLUTION_QUERY_COUNT];
+static bool queryPending[RESOLUTION_QUERY_COUNT];
+static int nextQuery = 0;
+static int activeQuery = -1;
+
+static void releaseTarget() {
+    untrackMemory(TRACKED_TEXTURE, sceneColor);
+    untrackMemory(TRACKED_RENDERBUFFER, sceneDepth);
+    if (sceneFBO) glDeleteFramebuffers(1, &sceneFBO);
+    if (sceneColor) glDeleteTextures(1, &sceneColor);
+    if (sceneDepth) glDeleteRenderbuffers(1, &sceneDepth);
+    sceneFBO = sceneColor = sceneDepth = 0;
+    targetWidth = targetHeight = 0;
+}
+
+static bool resizeTarget(int width, int height) {
+    if (sceneFBO && width == targetWidth && height == targetHeight) {
+        return true;
+    }
+    if (!sceneFBO) {
+        glGenFramebuffers(1, &sceneFBO);
+        glGenTextures(1, &sceneColor);
+        glGenRenderbuffers(1, &sceneDepth);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, sceneColor);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, sceneDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    trackMemory(TRACKED_TEXTURE, sceneColor, MEMORY_RENDER_TARGETS, textureMemorySize(width, height, 1, 1, 4), "scene target");
+    trackMemory(TRACKED_RENDERBUFFER, sceneDepth, MEMORY_RENDER_TARGETS, textureMemorySize(width, height, 1, 1, 4), "scene target");
+
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneColor, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, sceneDepth);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        LOG_WARN(LOG_RENDER, "Scene render target is incomplete; dynamic resolution disabled");
+        releaseTarget();
+        return false;
+    }
+
+    targetWidth = width;
+    targetHeight = height;
+    return true;
+}
+
+void initDynamicResolution() {
+    const char* setting = getenv("CLUE_DYNAMIC_RESOLUTION");
+    enabled = !(setting && strcmp(setting, "0") == 0);
+    scale = 1.0f;
+    gpuMilliseconds = 0.0;
+
+    const char* target = getenv("CLUE_TARGET_FRAME_MS");
+    const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    if (target && atof(target) > 0.0) {
+        targetMilliseconds = atof(target);
+    }
+    else if (mode && mode->refreshRate > 0) {
+        targetMilliseconds = 1000.0 / mode->refreshRate;
+    }
+    if (!enabled) return;
+
+    upscaleShader = acquireShader("shaders/upscale/upscaleVertex.glsl", "shaders/upscale/upscaleFragment.glsl");
+    if (!upscaleShader) {
+        LOG_WARN(LOG_RENDER, "Failed to load the upscale shader; dynamic resolution disabled");
+        enabled = false;
+        return;
+    }
+    glGenVertexArrays(1, &upscaleVAO); // Empty; the shader generates a fullscreen triangle
+    glGenQueries(RESOLUTION_QUERY_COUNT, queries);
+    memset(queryPending, 0, sizeof(queryPending));
+    nextQuery = 0;
+    activeQuery = -1;
+}
+
+void shutdownDynamicResolution() {
+    releaseTarget();
+    if (upscaleVAO) glDeleteVertexArrays(1, &upscaleVAO);
+    if (upscaleShader) releaseShader(upscaleShader);
+    if (queries[0]) glDeleteQueries(RESOLUTION_QUERY_COUNT, queries);
+    upscaleVAO = upscaleShader = 0;
+    memset(queries, 0, sizeof(queries));
+    enabled = false;
+}
+
+// GPU time is roughly proportional to the pixel count, i.e. to scale squared
+static void updateScale(double milliseconds) {
+    gpuMilliseconds = gpuMilliseconds > 0.0 ? gpuMilliseconds + (milliseconds - gpuMilliseconds) * 0.2 : milliseconds;
+
+    double budget = targetMilliseconds * RESOLUTION_SCENE_BUDGET;
+    if (gpuMilliseconds <= budget && gpuMilliseconds >= budget * RESOLUTION_RAISE_THRESHOLD) {
+        return; // Inside the dead zone; avoids oscillating around the budget
+    }
+    float wanted = scale * (float)sqrt(budget / fmax(gpuMilliseconds, 0.01));
+    float step = wanted - scale;
+    // Drop quickly to catch a heavy frame, recover slowly; results arrive a few frames late
+    if (step < -0.05f) step = -0.05f;
+    if (step > 0.02f) step = 0.02f;
+    scale += step;
+    if (scale < RESOLUTION_MIN_SCALE) scale = RESOLUTION_MIN_SCALE;
+    if (scale > 1.0f) scale = 1.0f;
+}
+
+// Reads finished queries without waiting on the GPU
+static void collectQueries() {
+    for (int i = 0; i < RESOLUTION_QUERY_COUNT; i++) {
+        if (!queryPending[i]) continue;
+        GLint available = 0;
+        glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue;
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &nanoseconds);
+        queryPending[i] = false;
+        updateScale(nanoseconds / 1.0e6);
+    }
+}
+
+void beginSceneRender() {
+    glfwGetFramebufferSize(screen.window, &displayWidth, &displayHeight);
+    if (!enabled) return;
+    if (displayWidth <= 0 || displayHeight <= 0) return; // Minimised
+    if (!resizeTarget(displayWidth, displayHeight)) {
+        enabled = false;
+        return;
+    }
+
+    collectQueries();
+    renderWidth = (int)(displayWidth * scale + 0.5f);
+    renderHeight = (int)(displayHeight * scale + 0.5f);
+    if (renderWidth < 1) renderWidth = 1;
+    if (renderHeight < 1) renderHeight = 1;
+
+    // Skip timing this frame rather than reuse a query the GPU has not finished
+    activeQuery = queryPending[nextQuery] ? -1 : nextQuery;
+    if (activeQuery >= 0) {
+        glBeginQuery(GL_TIME_ELAPSED, queries[activeQuery]);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+    glViewport(0, 0, renderWidth, renderHeight);
+}
+
+void endSceneRender() {
+    if (!enabled || !targetWidth || displayWidth <= 0 || displayHeight <= 0) return;
+
+    if (activeQuery >= 0) {
+        glEndQuery(GL_TIME_ELAPSED);
+        queryPending[activeQuery] = true;
+        nextQuery = (activeQuery + 1) % RESOLUTION_QUERY_COUNT;
+        activeQuery = -1;
+    }
+
+    if (renderWidth == displayWidth && renderHeight == displayHeight) {
+        // Full resolution: a copy is enough
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, displayWidth, displayHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, displayWidth, displayHeight);
+        return;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, displayWidth, displayHeight);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+
+    float sharpness = RESOLUTION_MAX_SHARPNESS * (1.0f - scale) / (1.0f - RESOLUTION_MIN_SCALE);
+    glUseProgram(upscaleShader);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, sceneColor);
+    glUniform1i(glGetUniformLocation(upscaleShader, "scene"), 0);
+    glUniform2f(glGetUniformLocation(upscaleShader, "uvScale"),
+                (float)renderWidth / targetWidth, (float)renderHeight / targetHeight);
+    glUniform1f(glGetUniformLocation(upscaleShader, "sharpness"), sharpness);
+    glBindVertexArray(upscaleVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glEnable(GL_DEPTH_TEST);
+}
+
+void getDynamicResolutionStats(DynamicResolutionStats* stats) {
+    stats->enabled = enabled;
+    stats->scale = enabled ? scale : 1.0f;
+    stats->renderWidth = enabled ? renderWidth : displayWidth;
+    stats->renderHeight = enabled ? renderHeight : displayHeight;
+    stats->gpuMilliseconds = gpuMilliseconds;
+    stats->targetMilliseconds = targetMilliseconds;
+}
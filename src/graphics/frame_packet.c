@@ -0,0 +1,529 @@
+#include "frame_packet.h"
+#include "ObjectManager.h"
+#include "SceneObject.h"
+#include "background.h"
+#include "globals.h"
+#include "jobs.h"
+#include "texture_streaming.h"
+#include "transform_hierarchy.h"
+#include "logger.h"
+#include "allocators.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+
+#define OBJECTS_PER_BUILD_BATCH 64
+#define ITEMS_PER_RECORD_BATCH 256
+
+typedef struct {
+    GLint viewPos;
+    GLint lightPos;
+    GLint lightColor;
+    GLint lightIntensity;
+    GLint useLighting;
+    GLint noShading;
+} FrameUniforms;
+
+typedef struct {
+    FramePacket* packet;
+    Vector4 frustum[6];
+    Vector3 cameraPosition;
+    float pixelsPerUnit; // Screen pixels covered by one world unit at distance one
+} BuildContext;
+
+// The projected scale each object's LOD levels were last chosen at. Levels are
+// only chosen again once the scale leaves a band around it, so objects sitting
+// near a threshold do not flip between levels every frame.
+typedef struct {
+    int id; // Of the object the slot last held, -1 for none
+    float pixelsPerUnit;
+} ObjectLod;
+
+static FramePacket packets[2];
+static int publishedPacket = -1;
+static int buildingPacket = -1;
+static JobCounter buildCounter;
+static unsigned long long frameCounter = 0;
+static FrameUniforms uniforms;
+static FrameStats frameStats;
+
+// Scratch owned by the single in-flight build
+static RenderItem* stagingItems = NULL;
+static int* objectItemOffsets = NULL;
+static unsigned char* objectVisible = NULL;
+static ObjectLod* objectLods = NULL;
+static int stagingCapacity = 0;
+
+static bool lodEnabled = true;
+static float lodPixelError = LOD_PIXEL_ERROR;
+
+void initFramePipeline() {
+    memset(packets, 0, sizeof(packets));
+    publishedPacket = -1;
+    buildingPacket = -1;
+    atomic_store(&buildCounter.pending, 0);
+
+    objectItemOffsets = (int*)engineMalloc((MAX_OBJECTS + 1) * sizeof(int));
+    objectVisible = (unsigned char*)engineMalloc(MAX_OBJECTS);
+    objectLods = (ObjectLod*)engineMalloc(MAX_OBJECTS * sizeof(ObjectLod));
+    if (!objectItemOffsets || !objectVisible || !objectLods) {
+        LOG_ERROR(LOG_RENDER, "Failed to allocate frame packet scratch.");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < MAX_OBJECTS; i++) {
+        objectLods[i].id = -1;
+    }
+
+    const char* lodSetting = getenv("CLUE_LOD");
+    lodEnabled = !(lodSetting && strcmp(lodSetting, "0") == 0);
+    const char* errorSetting = getenv("CLUE_LOD_PIXEL_ERROR");
+    if (errorSetting && atof(errorSetting) > 0.0) {
+        lodPixelError = (float)atof(errorSetting);
+    }
+
+    uniforms.viewPos = glGetUniformLocation(shaderProgram, "viewPos");
+    uniforms.lightPos = glGetUniformLocation(shaderProgram, "lightPos");
+    uniforms.lightColor = glGetUniformLocation(shaderProgram, "lightColor");
+    uniforms.lightIntensity = glGetUniformLocation(shaderProgram, "lightIntensity");
+    uniforms.useLighting = glGetUniformLocation(shaderProgram, "useLighting");
+    uniforms.noShading = glGetUniformLocation(shaderProgram, "noShading");
+}
+
+void shutdownFramePipeline() {
+    if (buildingPacket >= 0) {
+        waitForCounter(&buildCounter);
+        buildingPacket = -1;
+    }
+    for (int i = 0; i < 2; i++) {
+        engineFree(packets[i].items);
+        packets[i].items = NULL;
+        packets[i].itemCapacity = 0;
+        freeCommandBuffer(&packets[i].commands);
+    }
+    engineFree(stagingItems);
+    engineFree(objectItemOffsets);
+    engineFree(objectVisible);
+    engineFree(objectLods);
+    stagingItems = NULL;
+    objectItemOffsets = NULL;
+    objectVisible = NULL;
+    objectLods = NULL;
+    stagingCapacity = 0;
+    publishedPacket = -1;
+}
+
+static bool reserveItems(RenderItem** items, int* capacity, int count) {
+    if (count <= *capacity) return true;
+    int newCapacity = *capacity > 0 ? *capacity : 256;
+    while (newCapacity < count) newCapacity *= 2;
+    RenderItem* grown = (RenderItem*)engineRealloc(*items, newCapacity * sizeof(RenderItem));
+    if (!grown) {
+        LOG_ERROR(LOG_RENDER, "Failed to grow frame packet to %d items.", newCapacity);
+        return false;
+    }
+    *items = grown;
+    *capacity = newCapacity;
+    return true;
+}
+
+// Row i of the combined matrix (matrices are stored column-major)
+static Vector4 matrixRow(const Matrix4x4* m, int row) {
+    return (Vector4){ m->data[0][row], m->data[1][row], m->data[2][row], m->data[3][row] };
+}
+
+static Vector4 normalizePlane(Vector4 plane) {
+    float length = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+    if (length <= 0.0f) return plane;
+    return (Vector4){ plane.x / length, plane.y / length, plane.z / length, plane.w / length };
+}
+
+static void extractFrustum(const Matrix4x4* projection, const Matrix4x4* view, Vector4 planes[6]) {
+    // clip = projection * view, evaluated the way the vertex shader applies them
+    Matrix4x4 clip = { 0 };
+    for (int c = 0; c < 4; c++) {
+        for (int r = 0; r < 4; r++) {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; k++) {
+                sum += projection->data[k][r] * view->data[c][k];
+            }
+            clip.data[c][r] = sum;
+        }
+    }
+
+    Vector4 x = matrixRow(&clip, 0), y = matrixRow(&clip, 1), z = matrixRow(&clip, 2), w = matrixRow(&clip, 3);
+    planes[0] = normalizePlane((Vector4){ w.x + x.x, w.y + x.y, w.z + x.z, w.w + x.w });
+    planes[1] = normalizePlane((Vector4){ w.x - x.x, w.y - x.y, w.z - x.z, w.w - x.w });
+    planes[2] = normalizePlane((Vector4){ w.x + y.x, w.y + y.y, w.z + y.z, w.w + y.w });
+    planes[3] = normalizePlane((Vector4){ w.x - y.x, w.y - y.y, w.z - y.z, w.w - y.w });
+    planes[4] = normalizePlane((Vector4){ w.x + z.x, w.y + z.y, w.z + z.z, w.w + z.w });
+    planes[5] = normalizePlane((Vector4){ w.x - z.x, w.y - z.y, w.z - z.z, w.w - z.w });
+}
+
+static bool sphereInFrustum(const Vector4 planes[6], Vector3 center, float radius) {
+    for (int i = 0; i < 6; i++) {
+        float distance = planes[i].x * center.x + planes[i].y * center.y + planes[i].z * center.z + planes[i].w;
+        if (distance < -radius) return false;
+    }
+    return true;
+}
+
+static int objectItemCount(const SceneObject* obj) {
+    return obj->object.type == OBJ_MODEL ? (int)obj->object.data.model.instanceCount : 1;
+}
+
+// Largest length of the matrix's basis vectors
+static float maxAxisScale(const Matrix4x4* m) {
+    float maxScale = 0.0f;
+    for (int c = 0; c < 3; c++) {
+        float axis = sqrtf(m->data[c][0] * m->data[c][0] + m->data[c][1] * m->data[c][1] + m->data[c][2] * m->data[c][2]);
+        if (axis > maxScale) maxScale = axis;
+    }
+    return maxScale;
+}
+
+// Screen pixels per object unit for choosing LOD levels, held steady within the hysteresis band
+static float objectLodScale(int index, const SceneObject* obj, float pixelsPerUnit) {
+    ObjectLod* state = &objectLods[index];
+    if (state->id != obj->id ||
+        pixelsPerUnit > state->pixelsPerUnit * (1.0f + LOD_HYSTERESIS) ||
+        pixelsPerUnit < state->pixelsPerUnit * (1.0f - LOD_HYSTERESIS)) {
+        state->id = obj->id;
+        state->pixelsPerUnit = pixelsPerUnit;
+    }
+    return state->pixelsPerUnit;
+}
+
+static void selectItemLevel(RenderItem* item, const LodChain* chain, GLsizei fullIndexCount, float lodScale) {
+    if (chain->levelCount == 0) {
+        item->firstIndex = 0;
+        item->indexCount = fullIndexCount;
+        return;
+    }
+    const LodLevel* level = &chain->levels[selectLodLevel(chain, lodScale, lodPixelError)];
+    item->firstIndex = level->firstIndex;
+    item->indexCount = (GLsizei)level->indexCount;
+}
+
+static void fillItem(RenderItem* item, const SceneObject* obj, const Matrix4x4* model, float distance, int index) {
+    item->model = *model;
+    item->color = obj->color;
+    item->textureID = obj->object.textureID;
+    item->material = obj->object.material;
+    item->useTexture = obj->object.useTexture;
+    item->usePBR = obj->object.usePBR;
+    item->useColor = obj->object.useColor;
+    item->cameraDistance = distance;
+    item->objectIndex = index;
+    item->firstIndex = 0;
+    item->indexType = GL_UNSIGNED_INT;
+}
+
+static void buildObjectRange(int start, int end, void* data) {
+    BuildContext* context = (BuildContext*)data;
+
+    for (int i = start; i < end; i++) {
+        const SceneObject* obj = &objectManager.objects[i];
+        Matrix4x4 model = *getWorldTransform(i);
+
+        // Bounding sphere in world space: transform the centre, scale the radius by the largest axis
+        Vector3 localCenter;
+        float radius;
+        getObjectLocalBounds(obj, &localCenter, &radius);
+        Vector3 center = {
+            model.data[0][0] * localCenter.x + model.data[1][0] * localCenter.y + model.data[2][0] * localCenter.z + model.data[3][0],
+            model.data[0][1] * localCenter.x + model.data[1][1] * localCenter.y + model.data[2][1] * localCenter.z + model.data[3][1],
+            model.data[0][2] * localCenter.x + model.data[1][2] * localCenter.y + model.data[2][2] * localCenter.z + model.data[3][2]
+        };
+        float maxScale = maxAxisScale(&model);
+
+        objectVisible[i] = sphereInFrustum(context->frustum, center, radius * maxScale);
+        if (!objectVisible[i]) continue;
+
+        Vector3 origin = { model.data[3][0], model.data[3][1], model.data[3][2] };
+        float distance = vector_length(vector_sub(context->cameraPosition, origin));
+        RenderItem* items = &stagingItems[objectItemOffsets[i]];
+
+        // Projected diameter drives which mips the texture streamer keeps resident
+        float centerDistance = vector_length(vector_sub(context->cameraPosition, center));
+        float worldRadius = radius * maxScale;
+        float screenSize = centerDistance > worldRadius
+            ? 2.0f * worldRadius / centerDistance * context->pixelsPerUnit
+            : (float)screen.height;
+        if (obj->object.useTexture) {
+            noteTextureScreenSize(obj->object.textureID, screenSize);
+        }
+
+        // Pixels per object unit at the nearest point of the bounds; inside them nothing is simplified
+        float lodScale = FLT_MAX;
+        if (lodEnabled && centerDistance > worldRadius) {
+            lodScale = objectLodScale(i, obj, maxScale * context->pixelsPerUnit / (centerDistance - worldRadius));
+        }
+
+        switch (obj->object.type) {
+        case OBJ_CUBE:
+            fillItem(&items[0], obj, &model, distance, i);
+            items[0].vao = obj->object.data.cube.vao;
+            items[0].quantization = obj->object.data.cube.quantization;
+            items[0].indexCount = 36;
+            break;
+        case OBJ_SPHERE:
+            fillItem(&items[0], obj, &model, distance, i);
+            items[0].vao = obj->object.data.sphere.vao;
+            items[0].quantization = obj->object.data.sphere.quantization;
+            selectItemLevel(&items[0], &obj->object.data.sphere.lod, obj->object.data.sphere.numIndices, lodScale);
+            break;
+        case OBJ_PYRAMID:
+            fillItem(&items[0], obj, &model, distance, i);
+            items[0].vao = obj->object.data.pyramid.vao;
+            items[0].quantization = obj->object.data.pyramid.quantization;
+            items[0].indexCount = 18;
+            break;
+        case OBJ_CYLINDER:
+            fillItem(&items[0], obj, &model, distance, i);
+            items[0].vao = obj->object.data.cylinder.vao;
+            items[0].quantization = obj->object.data.cylinder.quantization;
+            selectItemLevel(&items[0], &obj->object.data.cylinder.lod, obj->object.data.cylinder.sectorCount * 12, lodScale);
+            break;
+        case OBJ_PLANE:
+            fillItem(&items[0], obj, &model, distance, i);
+            items[0].vao = obj->object.data.plane.vao;
+            items[0].quantization = obj->object.data.plane.quantization;
+            items[0].indexCount = 6;
+            break;
+        case OBJ_MODEL: {
+            const Model* source = &obj->object.data.model;
+            for (unsigned int n = 0; n < source->instanceCount; n++) {
+                const MeshInstance* instance = &source->instances[n];
+                const Matrix4x4* nodeTransform = &source->nodes[instance->node].transform;
+                const Mesh* mesh = &source->meshes[instance->mesh];
+                // matrixMultiply(a, b) applies a first: the node places the mesh inside the model
+                Matrix4x4 instanceModel = matrixMultiply(*nodeTransform, model);
+                fillItem(&items[n], obj, &instanceModel, distance, i);
+                items[n].vao = mesh->VAO;
+                items[n].indexType = mesh->indexType;
+                items[n].quantization = mesh->quantization;
+                float instanceScale = lodScale == FLT_MAX ? FLT_MAX : lodScale * maxAxisScale(nodeTransform);
+                selectItemLevel(&items[n], &mesh->lod, (GLsizei)mesh->numIndices, instanceScale);
+            }
+            break;
+        }
+        }
+    }
+}
+
+static uint32_t hashMaterial(const BindMaterialCommand* command) {
+    // FNV-1a over the bindings; collisions only cost a redundant bind at replay
+    const GLuint values[] = { command->textureID, (GLuint)command->bindTexture };
+    uint32_t hash = 2166136261u;
+    const unsigned char* bytes = (const unsigned char*)values;
+    for (size_t i = 0; i < sizeof(values); i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void recordItemRange(int start, int end, void* data) {
+    FramePacket* packet = (FramePacket*)data;
+    CommandList* list = getThreadCommandList(&packet->commands);
+
+    for (int i = start; i < end; i++) {
+        const RenderItem* item = &packet->items[i];
+        bool pbr = packet->usePBR && item->usePBR;
+
+        BindMaterialCommand material;
+        memset(&material, 0, sizeof(material));
+        material.textureID = item->textureID;
+        material.bindTexture = item->useTexture && !pbr;
+
+        uint64_t key = i < packet->opaqueCount
+            ? makeOpaqueSortKey(shaderProgram, hashMaterial(&material), item->vao)
+            : makeTransparentSortKey(item->cameraDistance);
+        beginCommandRecord(list, key, (uint32_t)i);
+
+        BindProgramCommand* program = (BindProgramCommand*)pushRenderCommand(list, RENDER_CMD_BIND_PROGRAM, sizeof(BindProgramCommand));
+        if (program) program->program = shaderProgram;
+
+        BindMaterialCommand* bind = (BindMaterialCommand*)pushRenderCommand(list, RENDER_CMD_BIND_MATERIAL, sizeof(BindMaterialCommand));
+        if (bind) {
+            material.header = bind->header;
+            *bind = material;
+        }
+
+        SetObjectDataCommand* object = (SetObjectDataCommand*)pushRenderCommand(list, RENDER_CMD_SET_OBJECT_DATA, sizeof(SetObjectDataCommand));
+        if (object) {
+            memcpy(object->model, &item->model.data[0][0], sizeof(object->model));
+            memcpy(object->color, &item->color, sizeof(object->color));
+            memcpy(object->positionScale, &item->quantization.scale, sizeof(object->positionScale));
+            memcpy(object->positionBias, &item->quantization.bias, sizeof(object->positionBias));
+            object->materialClass = (int16_t)item->material.materialClass;
+            object->materialLayer = (int16_t)item->material.layer;
+            object->useTexture = packet->texturesEnabled && item->useTexture && !item->usePBR;
+            object->usePBR = pbr;
+            object->useColor = packet->colorsEnabled && item->useColor;
+        }
+
+        DrawCommand* draw = (DrawCommand*)pushRenderCommand(list, RENDER_CMD_DRAW, sizeof(DrawCommand));
+        if (draw) {
+            draw->vao = item->vao;
+            draw->firstIndex = item->firstIndex;
+            draw->indexCount = item->indexCount;
+            draw->indexType = item->indexType;
+        }
+
+        endCommandRecord(list);
+    }
+}
+
+static void buildFramePacket(FramePacket* packet) {
+    packet->camera = camera;
+    packet->projection = getProjectionMatrix(45.0f, (float)screen.width / screen.height, 0.1f, 100.0f);
+    packet->view = getViewMatrix(&camera);
+    packet->lightCount = lightCount;
+    memcpy(packet->lights, lights, sizeof(Light) * lightCount);
+    packet->backgroundEnabled = backgroundEnabled;
+    packet->texturesEnabled = texturesEnabled;
+    packet->colorsEnabled = colorsEnabled;
+    packet->lightingEnabled = lightingEnabled;
+    packet->usePBR = usePBR;
+    packet->sceneGeneration = sceneGeneration;
+    packet->frameNumber = frameCounter++;
+    packet->opaqueCount = 0;
+    packet->transparentCount = 0;
+    packet->culledCount = 0;
+    packet->triangleCount = 0;
+    packet->opaqueCommandCount = 0;
+    resetCommandBuffer(&packet->commands);
+
+    int objectCount = objectManager.count;
+    int totalItems = 0;
+    for (int i = 0; i < objectCount; i++) {
+        objectItemOffsets[i] = totalItems;
+        totalItems += objectItemCount(&objectManager.objects[i]);
+    }
+    objectItemOffsets[objectCount] = totalItems;
+
+    if (!reserveItems(&stagingItems, &stagingCapacity, totalItems) ||
+        !reserveItems(&packet->items, &packet->itemCapacity, totalItems)) {
+        return;
+    }
+
+    BuildContext context;
+    context.packet = packet;
+    context.cameraPosition = camera.Position;
+    context.pixelsPerUnit = packet->projection.data[1][1] * screen.height * 0.5f;
+    extractFrustum(&packet->projection, &packet->view, context.frustum);
+    parallelFor(objectCount, OBJECTS_PER_BUILD_BATCH, buildObjectRange, &context);
+
+    // Compact the visible set: opaque items first, transparent ones after
+    int opaqueItems = 0;
+    for (int i = 0; i < objectCount; i++) {
+        if (objectVisible[i] && objectManager.objects[i].color.w >= 1.0f) {
+            opaqueItems += objectItemOffsets[i + 1] - objectItemOffsets[i];
+        }
+    }
+
+    int opaqueCursor = 0;
+    int transparentCursor = opaqueItems;
+    for (int i = 0; i < objectCount; i++) {
+        int count = objectItemOffsets[i + 1] - objectItemOffsets[i];
+        if (!objectVisible[i]) {
+            packet->culledCount++;
+            continue;
+        }
+        int* cursor = objectManager.objects[i].color.w < 1.0f ? &transparentCursor : &opaqueCursor;
+        memcpy(&packet->items[*cursor], &stagingItems[objectItemOffsets[i]], count * sizeof(RenderItem));
+        *cursor += count;
+    }
+
+    packet->opaqueCount = opaqueCursor;
+    packet->transparentCount = transparentCursor - opaqueItems;
+    for (int i = 0; i < transparentCursor; i++) {
+        packet->triangleCount += packet->items[i].indexCount / 3;
+    }
+
+    // Each worker records its chunk into its own list; the merged records are
+    // sorted by key so opaque draws group by state and transparent ones go back to front
+    parallelFor(packet->opaqueCount + packet->transparentCount, ITEMS_PER_RECORD_BATCH, recordItemRange, packet);
+    sortCommandBuffer(&packet->commands);
+    packet->opaqueCommandCount = findCommandRecord(&packet->commands, RENDER_PASS_TRANSPARENT << RENDER_PASS_SHIFT);
+}
+
+static void buildFramePacketJob(void* data) {
+    buildFramePacket((FramePacket*)data);
+}
+
+void kickFramePacketBuild() {
+    if (buildingPacket >= 0) return;
+    buildingPacket = publishedPacket == 0 ? 1 : 0;
+    // World matrices are brought up to date here, while nothing else touches the scene
+    packets[buildingPacket].transformCount = updateTransformHierarchy();
+    runJob(buildFramePacketJob, &packets[buildingPacket], &buildCounter);
+}
+
+void syncFramePacketBuild() {
+    if (buildingPacket < 0) return;
+    waitForCounter(&buildCounter);
+    publishedPacket = buildingPacket;
+    buildingPacket = -1;
+}
+
+const FramePacket* getRenderFramePacket() {
+    // A packet built before objects were destroyed may reference deleted buffers,
+    // so fall back to the snapshot that is being built for this frame.
+    bool stale = publishedPacket < 0 || packets[publishedPacket].sceneGeneration != sceneGeneration;
+    if (stale) {
+        if (buildingPacket < 0) {
+            kickFramePacketBuild();
+        }
+        syncFramePacketBuild();
+    }
+    return &packets[publishedPacket];
+}
+
+void submitFramePacket(const FramePacket* packet) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    frameStats.drawCalls = 0;
+    frameStats.visibleCount = packet->opaqueCount + packet->transparentCount;
+    frameStats.culledCount = packet->culledCount;
+    frameStats.triangleCount = packet->triangleCount;
+    frameStats.transformCount = packet->transformCount;
+
+    // Draw skybox first if background is enabled
+    if (packet->backgroundEnabled) {
+        frameStats.drawCalls++;
+        glDepthFunc(GL_LEQUAL);
+        drawSkybox(&packet->camera, &packet->projection);
+        glDepthFunc(GL_LESS);
+    }
+
+    glUseProgram(shaderProgram);
+    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, &packet->view.data[0][0]);
+    glUniformMatrix4fv(projLoc, 1, GL_FALSE, &packet->projection.data[0][0]);
+    bindMaterialArrays(shaderProgram);
+    uploadShaderLights(packet->lights, packet->lightCount);
+    glUniform3fv(uniforms.viewPos, 1, (const GLfloat*)&packet->camera.Position);
+    glUniform3fv(uniforms.lightPos, 1, (const GLfloat*)&packet->lights[0].position);
+    glUniform3fv(uniforms.lightColor, 1, (const GLfloat*)&packet->lights[0].color);
+    glUniform1f(uniforms.lightIntensity, packet->lights[0].intensity);
+    glUniform1i(uniforms.useLighting, packet->lightingEnabled);
+    glUniform1i(uniforms.noShading, !packet->lightingEnabled);
+
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+
+    frameStats.drawCalls += replayCommandBuffer(&packet->commands, 0, packet->opaqueCommandCount);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    frameStats.drawCalls += replayCommandBuffer(&packet->commands, packet->opaqueCommandCount,
+                                                packet->commands.sortedCount - packet->opaqueCommandCount);
+    glDisable(GL_BLEND);
+    glBindVertexArray(0);
+}
+
+void getFrameStats(FrameStats* stats) {
+    *stats = frameStats;
+}
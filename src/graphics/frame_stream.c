@@ -0,0 +1,480 @@
+#include "frame_stream.h"
+#include "http_server.h" // Before threading.h, which pulls in Windows.h
+#include "threading.h"
+#include "globals.h"
+#include "jobs.h"
+#include "redraw.h"
+#include "allocators.h"
+#include "memory_accounting.h"
+#include "logger.h"
+#include "SOIL2/stb_image_write.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#define STREAM_BOUNDARY "clueframe"
+
+enum { CAPTURE_FREE, CAPTURE_READING, CAPTURE_ENCODING };
+
+// One pixel pack buffer of the readback ring
+typedef struct {
+    GLuint buffer;
+    GLsync fence;
+    size_t capacity;
+    const unsigned char* mapped;  // Persistent and coherent, so workers read it once the fence has signalled
+    int width, height;
+    unsigned long long sequence;
+    atomic_int state;             // Main thread owns FREE and READING slots, the encode job ENCODING ones
+    unsigned char* pixels;        // Top-down copy for the encoder
+    size_t pixelCapacity;
+} CaptureSlot;
+
+// Shared by every client sending it; freed with the last reference
+typedef struct {
+    atomic_int references;
+    unsigned long long sequence;
+    size_t size;
+    size_t capacity;
+    unsigned char data[];
+} EncodedFrame;
+
+typedef struct {
+    Socket socket;
+    EncodedFrame* frame;          // Being sent, or NULL between frames
+    size_t offset;                // Into the part header, then the JPEG, then the trailing CRLF
+    char header[128];
+    size_t headerLength;
+    unsigned long long sequence;  // Of the last frame started
+    double lastProgress;
+} StreamClient;
+
+static bool enabled;
+static double captureInterval;
+static int quality;
+
+// Main thread only
+static CaptureSlot slots[FRAME_STREAM_PBO_COUNT];
+static JobCounter encodeJobs;
+static double nextCapture;
+static unsigned long long captureSequence;
+static unsigned long long capturedCount;
+static unsigned long long droppedCount;
+static int lastWidth, lastHeight;
+
+static atomic_ullong encodedCount;
+static atomic_int clientCount;  // Pending and sending; read by the main thread to skip readbacks
+static atomic_int senderRunning;
+static Thread senderThread;
+
+static Mutex streamLock;        // Guards everything down to pendingCount
+static CondVar streamWake;      // A frame was published or a client connected
+static EncodedFrame* latestFrame;
+static bool accepting;
+static Socket pendingClients[FRAME_STREAM_MAX_CLIENTS];
+static int pendingCount;
+
+// Sender thread only
+static StreamClient clients[FRAME_STREAM_MAX_CLIENTS];
+static int activeCount;
+
+static void releaseFrame(EncodedFrame* frame) {
+    if (frame && atomic_fetch_sub(&frame->references, 1) == 1) {
+        engineFree(frame);
+    }
+}
+
+// ---- Encoding, on worker threads ----
+
+static void appendJpegBytes(void* context, void* data, int size) {
+    EncodedFrame** target = (EncodedFrame**)context;
+    EncodedFrame* frame = *target;
+    if (!frame) return; // An earlier append failed
+    if (frame->size + (size_t)size > frame->capacity) {
+        size_t capacity = frame->capacity * 2;
+        if (capacity < frame->size + (size_t)size) capacity = frame->size + (size_t)size;
+        EncodedFrame* grown = (EncodedFrame*)engineRealloc(frame, sizeof(EncodedFrame) + capacity);
+        if (!grown) {
+            engineFree(frame);
+            *target = NULL;
+            return;
+        }
+        frame = *target = grown;
+        frame->capacity = capacity;
+    }
+    memcpy(frame->data + frame->size, data, (size_t)size);
+    frame->size += (size_t)size;
+}
+
+static void publishFrame(EncodedFrame* frame) {
+    EncodedFrame* replaced = frame;
+    mutexLock(&streamLock);
+    // Jobs can finish out of order; never replace a newer frame with an older one
+    if (!latestFrame || frame->sequence > latestFrame->sequence) {
+        replaced = latestFrame;
+        latestFrame = frame;
+        condSignal(&streamWake);
+    }
+    mutexUnlock(&streamLock);
+    releaseFrame(replaced);
+}
+
+static void encodeFrameJob(void* data) {
+    CaptureSlot* slot = (CaptureSlot*)data;
+    size_t rowBytes = (size_t)slot->width * 4;
+    size_t bytes = rowBytes * slot->height;
+    if (slot->pixelCapacity < bytes) {
+        engineFree(slot->pixels);
+        slot->pixels = (unsigned char*)engineMalloc(bytes);
+        slot->pixelCapacity = slot->pixels ? bytes : 0;
+    }
+
+    EncodedFrame* frame = NULL;
+    if (slot->pixels) {
+        // GL rows start at the bottom
+        for (int y = 0; y < slot->height; y++) {
+            memcpy(slot->pixels + (size_t)y * rowBytes, slot->mapped + (size_t)(slot->height - 1 - y) * rowBytes, rowBytes);
+        }
+        size_t capacity = bytes / 8; // Usually enough for one JPEG at the default quality
+        frame = (EncodedFrame*)engineMalloc(sizeof(EncodedFrame) + capacity);
+        if (frame) {
+            atomic_init(&frame->references, 1);
+            frame->sequence = slot->sequence;
+            frame->size = 0;
+            frame->capacity = capacity;
+            if (!stbi_write_jpg_to_func(appendJpegBytes, &frame, slot->width, slot->height, 4, slot->pixels, quality)) {
+                releaseFrame(frame);
+                frame = NULL;
+            }
+        }
+    }
+    atomic_store(&slot->state, CAPTURE_FREE);
+
+    if (!frame) {
+        LOG_WARN(LOG_RENDER, "Failed to encode a stream frame.");
+        return;
+    }
+    atomic_fetch_add_explicit(&encodedCount, 1, memory_order_relaxed);
+    publishFrame(frame);
+}
+
+// ---- Sending, on the sender thread ----
+
+static void closeClient(int index) {
+    closeSocket(clients[index].socket);
+    releaseFrame(clients[index].frame);
+    clients[index] = clients[--activeCount];
+    atomic_fetch_sub(&clientCount, 1);
+}
+
+// Caller holds streamLock
+static void adoptPendingClients() {
+    for (int i = 0; i < pendingCount; i++) {
+        StreamClient* client = &clients[activeCount++];
+        memset(client, 0, sizeof(StreamClient));
+        client->socket = pendingClients[i];
+        client->lastProgress = glfwGetTime();
+        setSocketBlocking(client->socket, false);
+    }
+    pendingCount = 0;
+}
+
+// Caller holds streamLock. Clients between frames skip straight to the newest one.
+static bool startNewestFrames() {
+    bool sending = false;
+    for (int i = 0; i < activeCount; i++) {
+        StreamClient* client = &clients[i];
+        if (!client->frame && latestFrame && latestFrame->sequence > client->sequence) {
+            atomic_fetch_add(&latestFrame->references, 1);
+            client->frame = latestFrame;
+            client->sequence = latestFrame->sequence;
+            client->offset = 0;
+            client->headerLength = (size_t)snprintf(client->header, sizeof(client->header),
+                                                    "--" STREAM_BOUNDARY "\r\nContent-Type: image/jpeg\r\nContent-Length: %zu\r\n\r\n",
+                                                    latestFrame->size);
+        }
+        sending = sending || client->frame;
+    }
+    return sending;
+}
+
+// Writes what the socket will take; false if the client has gone
+static bool sendToClient(StreamClient* client, double now) {
+    const EncodedFrame* frame = client->frame;
+    size_t total = client->headerLength + frame->size + 2;
+    while (client->offset < total) {
+        const char* data;
+        size_t length;
+        if (client->offset < client->headerLength) {
+            data = client->header + client->offset;
+            length = client->headerLength - client->offset;
+        }
+        else if (client->offset < client->headerLength + frame->size) {
+            data = (const char*)frame->data + (client->offset - client->headerLength);
+            length = client->headerLength + frame->size - client->offset;
+        }
+        else {
+            data = "\r\n" + (client->offset - client->headerLength - frame->size);
+            length = total - client->offset;
+        }
+
+        int sent = send(client->socket, data, (int)length, SEND_FLAGS);
+        if (sent <= 0) {
+            return sent < 0 && socketWouldBlock() && now - client->lastProgress < FRAME_STREAM_CLIENT_TIMEOUT;
+        }
+        client->offset += (size_t)sent;
+        client->lastProgress = now;
+    }
+    releaseFrame(client->frame);
+    client->frame = NULL;
+    return true;
+}
+
+static void* streamSenderMain(void* arg) {
+    (void)arg;
+    while (atomic_load(&senderRunning)) {
+        mutexLock(&streamLock);
+        adoptPendingClients();
+        bool sending = startNewestFrames();
+        if (!sending) {
+            condTimedWait(&streamWake, &streamLock, FRAME_STREAM_POLL_MS);
+            adoptPendingClients();
+            sending = startNewestFrames();
+        }
+        mutexUnlock(&streamLock);
+        if (!sending) continue;
+
+        fd_set writable;
+        FD_ZERO(&writable);
+        Socket highest = 0;
+        for (int i = 0; i < activeCount; i++) {
+            if (!clients[i].frame) continue;
+            FD_SET(clients[i].socket, &writable);
+            if (clients[i].socket > highest) highest = clients[i].socket;
+        }
+        struct timeval timeout = { 0, FRAME_STREAM_SEND_WAIT_MS * 1000 };
+        select((int)highest + 1, NULL, &writable, NULL, &timeout);
+
+        double now = glfwGetTime();
+        for (int i = activeCount - 1; i >= 0; i--) {
+            StreamClient* client = &clients[i];
+            if (!client->frame) continue;
+            bool alive = FD_ISSET(client->socket, &writable)
+                ? sendToClient(client, now)
+                : now - client->lastProgress < FRAME_STREAM_CLIENT_TIMEOUT;
+            if (!alive) {
+                LOG_INFO(LOG_RENDER, "Stream client disconnected.");
+                closeClient(i);
+            }
+        }
+    }
+
+    while (activeCount > 0) {
+        closeClient(activeCount - 1);
+    }
+    return NULL;
+}
+
+// ---- HTTP handler, on the server thread ----
+
+static bool serveStream(Socket client, bool head) {
+    static const char header[] = "HTTP/1.1 200 OK\r\nContent-Type: multipart/x-mixed-replace; boundary=" STREAM_BOUNDARY
+                                 "\r\nCache-Control: no-cache\r\nConnection: close\r\n\r\n";
+    if (head) {
+        httpSendAll(client, header, sizeof(header) - 1);
+        return false;
+    }
+
+    // Only this thread adds clients, so the count cannot grow between the check and the hand-off
+    if (atomic_load(&clientCount) >= FRAME_STREAM_MAX_CLIENTS) {
+        static const char message[] = "Too many stream clients\n";
+        httpRespond(client, "503 Service Unavailable", "text/plain", message, sizeof(message) - 1, true);
+        return false;
+    }
+    if (!httpSendAll(client, header, sizeof(header) - 1)) return false;
+
+    mutexLock(&streamLock);
+    bool accepted = accepting;
+    if (accepted) {
+        pendingClients[pendingCount++] = client;
+        atomic_fetch_add(&clientCount, 1);
+        condSignal(&streamWake);
+    }
+    mutexUnlock(&streamLock);
+    if (accepted) {
+        LOG_INFO(LOG_RENDER, "Stream client connected.");
+        requestRedraw(); // An idle main loop draws nothing to capture
+    }
+    return accepted;
+}
+
+// ---- Readback, on the main thread ----
+
+static bool prepareSlot(CaptureSlot* slot, int width, int height) {
+    size_t bytes = (size_t)width * height * 4;
+    if (slot->buffer && slot->capacity >= bytes) {
+        slot->width = width;
+        slot->height = height;
+        return true;
+    }
+
+    // Immutable storage, so a larger framebuffer needs a new buffer
+    if (slot->buffer) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        untrackMemory(TRACKED_BUFFER, slot->buffer);
+        glDeleteBuffers(1, &slot->buffer);
+        slot->buffer = 0;
+        slot->mapped = NULL;
+    }
+    GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &slot->buffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
+    glBufferStorage(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)bytes, NULL, flags);
+    slot->mapped = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)bytes, flags);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (!slot->mapped) {
+        LOG_ERROR(LOG_RENDER, "Failed to map a stream readback buffer.");
+        glDeleteBuffers(1, &slot->buffer);
+        slot->buffer = 0;
+        return false;
+    }
+    trackMemory(TRACKED_BUFFER, slot->buffer, MEMORY_STAGING_BUFFERS, bytes, "frame stream");
+    slot->capacity = bytes;
+    slot->width = width;
+    slot->height = height;
+    return true;
+}
+
+// Hands every finished readback to an encode job; never waits
+static void collectReadbacks() {
+    for (int i = 0; i < FRAME_STREAM_PBO_COUNT; i++) {
+        CaptureSlot* slot = &slots[i];
+        if (atomic_load(&slot->state) != CAPTURE_READING) continue;
+        GLenum status = glClientWaitSync(slot->fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) continue;
+        glDeleteSync(slot->fence);
+        slot->fence = 0;
+        if (status == GL_WAIT_FAILED) {
+            atomic_store(&slot->state, CAPTURE_FREE);
+            continue;
+        }
+        atomic_store(&slot->state, CAPTURE_ENCODING);
+        runBackgroundJob(encodeFrameJob, slot, &encodeJobs);
+    }
+}
+
+void captureStreamFrame() {
+    if (!enabled) return;
+    collectReadbacks();
+    if (atomic_load(&clientCount) == 0) return;
+
+    double now = glfwGetTime();
+    if (now < nextCapture) return;
+    // Keep a steady cadence unless the loop fell more than a frame behind
+    nextCapture = now - nextCapture < captureInterval ? nextCapture + captureInterval : now + captureInterval;
+    scheduleRedraw(nextCapture); // Idle rendering would otherwise stop drawing frames to stream
+
+    int width, height;
+    glfwGetFramebufferSize(screen.window, &width, &height);
+    if (width <= 0 || height <= 0) return; // Minimised
+
+    CaptureSlot* slot = NULL;
+    for (int i = 0; i < FRAME_STREAM_PBO_COUNT && !slot; i++) {
+        if (atomic_load(&slots[i].state) == CAPTURE_FREE) slot = &slots[i];
+    }
+    if (!slot) {
+        droppedCount++; // Every buffer is still being read back or encoded
+        return;
+    }
+    if (!prepareSlot(slot, width, height)) return;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glReadBuffer(GL_BACK);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot->sequence = ++captureSequence;
+    atomic_store(&slot->state, CAPTURE_READING);
+    capturedCount++;
+    lastWidth = width;
+    lastHeight = height;
+}
+
+void getFrameStreamStats(FrameStreamStats* stats) {
+    stats->enabled = enabled;
+    stats->clients = atomic_load(&clientCount);
+    stats->captured = capturedCount;
+    stats->encoded = atomic_load(&encodedCount);
+    stats->dropped = droppedCount;
+    stats->width = lastWidth;
+    stats->height = lastHeight;
+}
+
+void initFrameStream() {
+    const char* setting = getenv("CLUE_STREAM");
+    if (!setting || strcmp(setting, "1") != 0) return;
+    if (!isHttpServerRunning()) {
+        LOG_WARN(LOG_RENDER, "CLUE_STREAM needs CLUE_HTTP_PORT; streaming disabled.");
+        return;
+    }
+
+    const char* fps = getenv("CLUE_STREAM_FPS");
+    captureInterval = 1.0 / (fps && atof(fps) > 0.0 ? atof(fps) : FRAME_STREAM_DEFAULT_FPS);
+    const char* qualitySetting = getenv("CLUE_STREAM_QUALITY");
+    quality = qualitySetting ? atoi(qualitySetting) : FRAME_STREAM_DEFAULT_QUALITY;
+    if (quality < 1 || quality > 100) quality = FRAME_STREAM_DEFAULT_QUALITY;
+
+    mutexInit(&streamLock);
+    condInit(&streamWake);
+    accepting = true;
+    atomic_store(&senderRunning, 1);
+    if (!threadCreate(&senderThread, streamSenderMain, NULL)) {
+        LOG_ERROR(LOG_RENDER, "Failed to start the stream sender thread; streaming disabled.");
+        atomic_store(&senderRunning, 0);
+        condDestroy(&streamWake);
+        mutexDestroy(&streamLock);
+        return;
+    }
+    enabled = true;
+    registerHttpHandler("/stream", serveStream);
+    LOG_INFO(LOG_RENDER, "Streaming frames at /stream (%.0f fps, quality %d)", 1.0 / captureInterval, quality);
+}
+
+void shutdownFrameStream() {
+    if (!enabled) return;
+    enabled = false;
+
+    // The HTTP server has stopped, so serveStream cannot run against the lock destroyed below
+    mutexLock(&streamLock);
+    accepting = false;
+    condSignal(&streamWake);
+    mutexUnlock(&streamLock);
+    atomic_store(&senderRunning, 0);
+    threadJoin(senderThread); // Closes the clients it was sending to
+    for (int i = 0; i < pendingCount; i++) {
+        closeSocket(pendingClients[i]);
+    }
+    pendingCount = 0;
+    atomic_store(&clientCount, 0);
+
+    waitForCounter(&encodeJobs);
+    for (int i = 0; i < FRAME_STREAM_PBO_COUNT; i++) {
+        CaptureSlot* slot = &slots[i];
+        if (slot->fence) glDeleteSync(slot->fence);
+        if (slot->buffer) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            untrackMemory(TRACKED_BUFFER, slot->buffer);
+            glDeleteBuffers(1, &slot->buffer);
+        }
+        engineFree(slot->pixels);
+        memset(slot, 0, sizeof(CaptureSlot));
+    }
+    releaseFrame(latestFrame);
+    latestFrame = NULL;
+    condDestroy(&streamWake);
+    mutexDestroy(&streamLock);
+}
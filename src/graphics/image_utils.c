@@ -0,0 +1,119 @@
+#include "image_utils.h"
+#include "allocators.h"
+#include <stdlib.h>
+#include <string.h>
+
+int imageMipCount(int width, int height) {
+    int size = width > height ? width : height;
+    int levels = 1;
+    while (size > 1) {
+        size >>= 1;
+        levels++;
+    }
+    return levels;
+}
+
+int imageMipDimension(int size, int level) {
+    int dimension = size >> level;
+    return dimension > 0 ? dimension : 1;
+}
+
+size_t imageMipBytes(int width, int height, int level) {
+    return (size_t)imageMipDimension(width, level) * imageMipDimension(height, level) * 4;
+}
+
+void flipImageRows(unsigned char* pixels, int width, int height) {
+    size_t rowBytes = (size_t)width * 4;
+    unsigned char* row = (unsigned char*)engineMalloc(rowBytes);
+    if (!row) return;
+    for (int y = 0; y < height / 2; y++) {
+        unsigned char* top = pixels + (size_t)y * rowBytes;
+        unsigned char* bottom = pixels + (size_t)(height - 1 - y) * rowBytes;
+        memcpy(row, top, rowBytes);
+        memcpy(top, bottom, rowBytes);
+        memcpy(bottom, row, rowBytes);
+    }
+    engineFree(row);
+}
+
+void downsampleImage(const unsigned char* src, int width, int height, unsigned char* dst) {
+    int nw = imageMipDimension(width, 1), nh = imageMipDimension(height, 1);
+    for (int y = 0; y < nh; y++) {
+        int y0 = y * 2 < height ? y * 2 : height - 1, y1 = y * 2 + 1 < height ? y * 2 + 1 : height - 1;
+        for (int x = 0; x < nw; x++) {
+            int x0 = x * 2 < width ? x * 2 : width - 1, x1 = x * 2 + 1 < width ? x * 2 + 1 : width - 1;
+            for (int c = 0; c < 4; c++) {
+                int sum = src[((size_t)y0 * width + x0) * 4 + c] + src[((size_t)y0 * width + x1) * 4 + c] +
+                          src[((size_t)y1 * width + x0) * 4 + c] + src[((size_t)y1 * width + x1) * 4 + c];
+                dst[((size_t)y * nw + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+void resampleImage(const unsigned char* src, int srcWidth, int srcHeight, unsigned char* dst, int dstWidth, int dstHeight) {
+    if (srcWidth == dstWidth && srcHeight == dstHeight) {
+        memcpy(dst, src, (size_t)dstWidth * dstHeight * 4);
+        return;
+    }
+    float scaleX = (float)srcWidth / dstWidth;
+    float scaleY = (float)srcHeight / dstHeight;
+    for (int y = 0; y < dstHeight; y++) {
+        float sy = (y + 0.5f) * scaleY - 0.5f;
+        if (sy < 0.0f) sy = 0.0f;
+        int y0 = (int)sy;
+        int y1 = y0 + 1 < srcHeight ? y0 + 1 : srcHeight - 1;
+        float fy = sy - y0;
+        for (int x = 0; x < dstWidth; x++) {
+            float sx = (x + 0.5f) * scaleX - 0.5f;
+            if (sx < 0.0f) sx = 0.0f;
+            int x0 = (int)sx;
+            int x1 = x0 + 1 < srcWidth ? x0 + 1 : srcWidth - 1;
+            float fx = sx - x0;
+            for (int c = 0; c < 4; c++) {
+                float top = src[((size_t)y0 * srcWidth + x0) * 4 + c] * (1.0f - fx) + src[((size_t)y0 * srcWidth + x1) * 4 + c] * fx;
+                float bottom = src[((size_t)y1 * srcWidth + x0) * 4 + c] * (1.0f - fx) + src[((size_t)y1 * srcWidth + x1) * 4 + c] * fx;
+                dst[((size_t)y * dstWidth + x) * 4 + c] = (unsigned char)(top * (1.0f - fy) + bottom * fy + 0.5f);
+            }
+        }
+    }
+}
+
+unsigned char* buildMipChain(const unsigned char* base, int width, int height, int firstLevel, size_t* outBytes) {
+    int levels = imageMipCount(width, height);
+    if (firstLevel >= levels) firstLevel = levels - 1;
+
+    size_t total = 0;
+    for (int l = firstLevel; l < levels; l++) {
+        total += imageMipBytes(width, height, l);
+    }
+    unsigned char* chain = (unsigned char*)engineMalloc(total);
+    if (!chain) return NULL;
+
+    const unsigned char* source = base;
+    unsigned char* scratch = NULL;
+    unsigned char* out = chain;
+    for (int l = 0; l < levels; l++) {
+        int w = imageMipDimension(width, l), h = imageMipDimension(height, l);
+        if (l >= firstLevel) {
+            memcpy(out, source, (size_t)w * h * 4);
+            out += (size_t)w * h * 4;
+        }
+        if (l == levels - 1) break;
+
+        unsigned char* next = (unsigned char*)engineMalloc(imageMipBytes(width, height, l + 1));
+        if (!next) {
+            engineFree(scratch);
+            engineFree(chain);
+            return NULL;
+        }
+        downsampleImage(source, w, h, next);
+        engineFree(scratch);
+        scratch = next;
+        source = next;
+    }
+    engineFree(scratch);
+
+    if (outBytes) *outBytes = total;
+    return chain;
+}
@@ -1,4 +1,5 @@
 #include "lightshading.h"
+#include "logger.h"
 #include <glad/glad.h>  
 #include <GLFW/glfw3.h>
 #include <stdlib.h>
@@ -16,29 +17,33 @@ float clamp(float x, float lower, float upper) {
 }
 
 void updateShaderLights() {
+    uploadShaderLights(lights, lightCount);
+}
+
+void uploadShaderLights(const Light* lightList, int count) {
     char uniformBuffer[128];
     GLint lightCountLoc = glGetUniformLocation(shaderProgram, "lightCount");
-    glUniform1i(lightCountLoc, lightCount);
+    glUniform1i(lightCountLoc, count);
 
-    for (int i = 0; i < lightCount; i++) {
+    for (int i = 0; i < count; i++) {
         sprintf(uniformBuffer, "lights[%d].position", i);
-        glUniform3fv(glGetUniformLocation(shaderProgram, uniformBuffer), 1, (const GLfloat*)&lights[i].position);
+        glUniform3fv(glGetUniformLocation(shaderProgram, uniformBuffer), 1, (const GLfloat*)&lightList[i].position);
 
         sprintf(uniformBuffer, "lights[%d].color", i);
-        glUniform3fv(glGetUniformLocation(shaderProgram, uniformBuffer), 1, (const GLfloat*)&lights[i].color);
+        glUniform3fv(glGetUniformLocation(shaderProgram, uniformBuffer), 1, (const GLfloat*)&lightList[i].color);
 
         sprintf(uniformBuffer, "lights[%d].intensity", i);
-        glUniform1f(glGetUniformLocation(shaderProgram, uniformBuffer), lights[i].intensity);
+        glUniform1f(glGetUniformLocation(shaderProgram, uniformBuffer), lightList[i].intensity);
 
-        if (lights[i].type == LIGHT_DIRECTIONAL) {
+        if (lightList[i].type == LIGHT_DIRECTIONAL) {
             sprintf(uniformBuffer, "lights[%d].direction", i);
-            glUniform3fv(glGetUniformLocation(shaderProgram, uniformBuffer), 1, (const GLfloat*)&lights[i].direction);
+            glUniform3fv(glGetUniformLocation(shaderProgram, uniformBuffer), 1, (const GLfloat*)&lightList[i].direction);
         }
-        else if (lights[i].type == LIGHT_SPOT) {
+        else if (lightList[i].type == LIGHT_SPOT) {
             sprintf(uniformBuffer, "lights[%d].cutOff", i);
-            glUniform1f(glGetUniformLocation(shaderProgram, uniformBuffer), lights[i].cutOff);
+            glUniform1f(glGetUniformLocation(shaderProgram, uniformBuffer), lightList[i].cutOff);
             sprintf(uniformBuffer, "lights[%d].outerCutOff", i);
-            glUniform1f(glGetUniformLocation(shaderProgram, uniformBuffer), lights[i].outerCutOff);
+            glUniform1f(glGetUniformLocation(shaderProgram, uniformBuffer), lightList[i].outerCutOff);
         }
     }
 }
@@ -50,7 +55,7 @@ void initLightingSystem() {
 
 void createLight(Vector3 position, Vector3 direction, Vector3 color, float intensity, LightType type) {
     if (lightCount >= MAX_LIGHTS) {
-        printf("Failed to create light: Maximum number of lights reached.\n");
+        LOG_WARN(LOG_SCENE, "Failed to create light: Maximum number of lights reached.");
         return;
     }
 
@@ -72,7 +77,7 @@ void createLight(Vector3 position, Vector3 direction, Vector3 color, float inten
     }
 
     lights[lightCount++] = newLight;
-    printf("Light created at [%f, %f, %f] with intensity %f\n", position.x, position.y, position.z, intensity);
+    LOG_DEBUG(LOG_SCENE, "Light created at [%f, %f, %f] with intensity %f", position.x, position.y, position.z, intensity);
 }
 
 
@@ -1,7 +1,19 @@
 #include "materials.h"
+#include "redraw.h"
 #include "textures.h"  
+#include "image_utils.h"
+#include "jobs.h"
+#include "asset_registry.h"
+#include "logger.h"
+#include "allocators.h"
+#include "memory_accounting.h"
+#include "metrics.h"
+#include "SOIL2/SOIL2.h"
+#include "SOIL2/stb_image.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <stdatomic.h>
 
 PBRMaterial materials[MAX_MATERIALS];
 const char* materialNames[MAX_MATERIALS] = { 
@@ -11,47 +23,349 @@ const char* materialNames[MAX_MATERIALS] = {
     "stainlessSteel", };
 int materialCount = 0;
 
-// Load textures and create a PBR material
+typedef enum {
+    MAP_ALBEDO,
+    MAP_NORMAL,
+    MAP_METALLIC,
+    MAP_ROUGHNESS,
+    MAP_AO,
+    MAP_COUNT
+} MaterialMap;
+
+typedef struct {
+    GLuint texture;
+    int size;
+    int levels;
+    int layerCount;
+    int layerCapacity;
+} MaterialArray;
+
+// Decodes and packs one material on a worker; the GL thread uploads the result
+typedef struct {
+    char* paths[MAP_COUNT];
+    PBRMaterial target;
+    int size;
+    unsigned char* layers[MATERIAL_LAYERS]; // Full mip chains
+    atomic_int done;
+    bool active;
+} PackJob;
+
+// A material waiting for a free PackJob; its layers are already reserved
+typedef struct {
+    char* paths[MAP_COUNT];
+    PBRMaterial target;
+} PackRequest;
+
+static MaterialArray materialArrays[MATERIAL_CLASS_COUNT];
+static PackJob packJobs[MAX_MATERIALS];
+static JobCounter packCounter;
+static PackRequest* queuedPacks = NULL; // Oldest first
+static int queuedPackCount = 0;
+static int queuedPackCapacity = 0;
+
+static const unsigned char albedoPlaceholder[4] = { 128, 128, 128, 255 };
+static const unsigned char normalPlaceholder[4] = { 128, 128, 255, 255 };
+static const unsigned char ormPlaceholder[4] = { 255, (unsigned char)(MATERIAL_DEFAULT_ROUGHNESS * 255.0f), 0, 255 };
+
+int getMaterialClassSize(int materialClass) {
+    return MATERIAL_MIN_CLASS_SIZE << materialClass;
+}
+
+bool isSameMaterial(PBRMaterial a, PBRMaterial b) {
+    return a.materialClass == b.materialClass && a.layer == b.layer;
+}
+
+static int classForImage(const char* paths[MAP_COUNT]) {
+    int width = 0, height = 0, channels = 0;
+    for (int i = 0; i < MAP_COUNT; i++) {
+        if (paths[i] && stbi_info(paths[i], &width, &height, &channels)) break;
+    }
+    int largest = width > height ? width : height;
+    int materialClass = 0;
+    while (materialClass < MATERIAL_CLASS_COUNT - 1 && getMaterialClassSize(materialClass) < largest) {
+        materialClass++;
+    }
+    return materialClass;
+}
+
+static void createArrayStorage(MaterialArray* array, int capacity) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, array->levels, GL_RGBA8, array->size, array->size, capacity);
+    char owner[64];
+    snprintf(owner, sizeof(owner), "material array %d", array->size);
+    trackMemory(TRACKED_TEXTURE, texture, MEMORY_MATERIAL_ARRAYS, textureMemorySize(array->size, array->size, capacity, array->levels, 4), owner);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // Growing keeps the existing layers (and the layer indices materials hold)
+    if (array->texture) {
+        for (int level = 0; level < array->levels; level++) {
+            int dimension = imageMipDimension(array->size, level);
+            glCopyImageSubData(array->texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+                               texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+                               dimension, dimension, array->layerCount);
+        }
+        untrackMemory(TRACKED_TEXTURE, array->texture);
+        glDeleteTextures(1, &array->texture);
+    }
+    array->texture = texture;
+    array->layerCapacity = capacity;
+}
+
+static int reserveLayers(int materialClass) {
+    MaterialArray* array = &materialArrays[materialClass];
+    if (array->size == 0) {
+        array->size = getMaterialClassSize(materialClass);
+        array->levels = imageMipCount(array->size, array->size);
+    }
+    if (array->layerCount + MATERIAL_LAYERS > array->layerCapacity) {
+        int capacity = array->layerCapacity > 0 ? array->layerCapacity * 2 : MATERIAL_LAYERS * 4;
+        createArrayStorage(array, capacity);
+    }
+
+    int layer = array->layerCount;
+    array->layerCount += MATERIAL_LAYERS;
+
+    // Neutral contents until the packing job has finished
+    const unsigned char* placeholders[MATERIAL_LAYERS] = { albedoPlaceholder, normalPlaceholder, ormPlaceholder };
+    for (int l = 0; l < MATERIAL_LAYERS; l++) {
+        for (int level = 0; level < array->levels; level++) {
+            int dimension = imageMipDimension(array->size, level);
+            glClearTexSubImage(array->texture, level, 0, 0, layer + l, dimension, dimension, 1,
+                               GL_RGBA, GL_UNSIGNED_BYTE, placeholders[l]);
+        }
+    }
+    return layer;
+}
+
+// Loads one map and scales it to the class size; NULL if the map is missing
+static unsigned char* loadMapAtSize(const char* path, int size) {
+    if (!path) return NULL;
+    int width, height, channels;
+    unsigned char* image = SOIL_load_image(path, &width, &height, &channels, SOIL_LOAD_RGBA);
+    if (!image) {
+        LOG_ERROR(LOG_ASSETS, "Failed to load material map %s: %s", path, SOIL_last_result());
+        return NULL;
+    }
+    flipImageRows(image, width, height);
+
+    // Halve while the map is at least twice the target so the final resample does not alias
+    unsigned char* source = image;
+    unsigned char* scratch = NULL;
+    while (width >= size * 2 && height >= size * 2) {
+        unsigned char* next = (unsigned char*)engineMalloc(imageMipBytes(width, height, 1));
+        if (!next) break;
+        downsampleImage(source, width, height, next);
+        engineFree(scratch);
+        scratch = next;
+        source = next;
+        width = imageMipDimension(width, 1);
+        height = imageMipDimension(height, 1);
+    }
+
+    unsigned char* result = (unsigned char*)engineMalloc((size_t)size * size * 4);
+    if (result) {
+        resampleImage(source, width, height, result, size, size);
+    }
+    engineFree(scratch);
+    SOIL_free_image_data(image);
+    return result;
+}
+
+static unsigned char* filledImage(int size, const unsigned char color[4]) {
+    size_t pixels = (size_t)size * size;
+    unsigned char* image = (unsigned char*)engineMalloc(pixels * 4);
+    if (!image) return NULL;
+    for (size_t i = 0; i < pixels; i++) {
+        memcpy(image + i * 4, color, 4);
+    }
+    return image;
+}
+
+static void packMaterialJob(void* data) {
+    PackJob* job = (PackJob*)data;
+    double started = glfwGetTime();
+    int size = job->size;
+    size_t pixels = (size_t)size * size;
+
+    unsigned char* maps[MAP_COUNT];
+    for (int i = 0; i < MAP_COUNT; i++) {
+        maps[i] = loadMapAtSize(job->paths[i], size);
+    }
+
+    unsigned char* albedo = maps[MAP_ALBEDO] ? maps[MAP_ALBEDO] : filledImage(size, albedoPlaceholder);
+    unsigned char* normal = maps[MAP_NORMAL] ? maps[MAP_NORMAL] : filledImage(size, normalPlaceholder);
+    unsigned char* orm = (unsigned char*)engineMalloc(pixels * 4);
+    if (orm) {
+        for (size_t i = 0; i < pixels; i++) {
+            orm[i * 4 + 0] = maps[MAP_AO] ? maps[MAP_AO][i * 4] : ormPlaceholder[0];
+            orm[i * 4 + 1] = maps[MAP_ROUGHNESS] ? maps[MAP_ROUGHNESS][i * 4] : ormPlaceholder[1];
+            orm[i * 4 + 2] = maps[MAP_METALLIC] ? maps[MAP_METALLIC][i * 4] : ormPlaceholder[2];
+            orm[i * 4 + 3] = 255;
+        }
+    }
+    engineFree(maps[MAP_METALLIC]);
+    engineFree(maps[MAP_ROUGHNESS]);
+    engineFree(maps[MAP_AO]);
+
+    unsigned char* bases[MATERIAL_LAYERS] = { albedo, normal, orm };
+    for (int l = 0; l < MATERIAL_LAYERS; l++) {
+        job->layers[l] = bases[l] ? buildMipChain(bases[l], size, size, 0, NULL) : NULL;
+        engineFree(bases[l]);
+    }
+    observeAssetLoad(ASSET_MATERIAL, glfwGetTime() - started);
+    atomic_store(&job->done, 1);
+    requestRedraw(); // The upload happens on the main thread
+}
+
+// Takes ownership of paths
+static void startPackJob(PackJob* job, char* paths[MAP_COUNT], PBRMaterial target) {
+    memset(job, 0, sizeof(PackJob));
+    memcpy(job->paths, paths, sizeof(job->paths));
+    job->target = target;
+    job->size = getMaterialClassSize(target.materialClass);
+    atomic_store(&job->done, 0);
+    job->active = true;
+    // Workers only, so the main thread never packs a material while it waits on frame work
+    runBackgroundJob(packMaterialJob, job, &packCounter);
+    LOG_DEBUG(LOG_ASSETS, "PBR Material queued for packing (%dx%d, layer %d).", job->size, job->size, target.layer);
+}
+
+static PackJob* findFreePackJob() {
+    for (int i = 0; i < MAX_MATERIALS; i++) {
+        if (!packJobs[i].active) return &packJobs[i];
+    }
+    return NULL;
+}
+
+// Queue a material for packing; it renders with neutral maps until the upload
 PBRMaterial loadPBRMaterial(const char* albedo, const char* normal, const char* metallic, const char* roughness, const char* ao) {
-    PBRMaterial material;
+    const char* paths[MAP_COUNT] = { albedo, normal, metallic, roughness, ao };
 
-    material.albedoMap = loadTexture(albedo);
-    material.normalMap = loadTexture(normal);
-    material.metallicMap = loadTexture(metallic);
-    material.roughnessMap = loadTexture(roughness);
-    material.aoMap = loadTexture(ao);
+    // The layers are the material's own from here on, holding neutral maps until packed
+    PBRMaterial material;
+    material.materialClass = classForImage(paths);
+    material.layer = reserveLayers(material.materialClass);
 
-    if (material.albedoMap == 0 || material.normalMap == 0 || material.metallicMap == 0 ||
-        material.roughnessMap == 0 || material.aoMap == 0) {
-        fprintf(stderr, "Failed to load one or more textures for PBR material\n");
+    char* ownedPaths[MAP_COUNT];
+    for (int i = 0; i < MAP_COUNT; i++) {
+        ownedPaths[i] = paths[i] ? engineStrdup(paths[i]) : NULL;
     }
-    else {
-        printf("PBR Material loaded successfully.\n");
+
+    PackJob* job = findFreePackJob();
+    if (job) {
+        startPackJob(job, ownedPaths, material);
+        return material;
     }
 
+    // Every job is busy; packing starts once one has been uploaded
+    if (queuedPackCount == queuedPackCapacity) {
+        int capacity = queuedPackCapacity ? queuedPackCapacity * 2 : 8;
+        PackRequest* grown = (PackRequest*)engineRealloc(queuedPacks, capacity * sizeof(PackRequest));
+        if (!grown) {
+            LOG_ERROR(LOG_ASSETS, "Failed to queue a material for packing; it keeps neutral maps.");
+            for (int i = 0; i < MAP_COUNT; i++) engineFree(ownedPaths[i]);
+            return material;
+        }
+        queuedPacks = grown;
+        queuedPackCapacity = capacity;
+    }
+    PackRequest* request = &queuedPacks[queuedPackCount++];
+    memcpy(request->paths, ownedPaths, sizeof(request->paths));
+    request->target = material;
+    LOG_DEBUG(LOG_ASSETS, "PBR Material waiting for a packing slot (layer %d).", material.layer);
     return material;
 }
 
-void bindPBRMaterial(PBRMaterial material) {
+static void releasePackJob(PackJob* job) {
+    for (int i = 0; i < MAP_COUNT; i++) {
+        engineFree(job->paths[i]);
+    }
+    for (int l = 0; l < MATERIAL_LAYERS; l++) {
+        engineFree(job->layers[l]);
+    }
+    memset(job, 0, sizeof(PackJob));
+}
+
+void updateMaterialPacking() {
+    // One material per call keeps the upload cost of a frame bounded
+    for (int i = 0; i < MAX_MATERIALS; i++) {
+        PackJob* job = &packJobs[i];
+        if (!job->active || !atomic_load(&job->done)) continue;
+
+        const MaterialArray* array = &materialArrays[job->target.materialClass];
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array->texture);
+        for (int l = 0; l < MATERIAL_LAYERS; l++) {
+            if (!job->layers[l]) continue;
+            const unsigned char* level = job->layers[l];
+            for (int m = 0; m < array->levels; m++) {
+                int dimension = imageMipDimension(job->size, m);
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, m, 0, 0, job->target.layer + l, dimension, dimension, 1,
+                                GL_RGBA, GL_UNSIGNED_BYTE, level);
+                level += imageMipBytes(job->size, job->size, m);
+            }
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        LOG_DEBUG(LOG_ASSETS, "PBR Material loaded successfully.");
+        releasePackJob(job);
+        if (queuedPackCount > 0) {
+            startPackJob(job, queuedPacks[0].paths, queuedPacks[0].target);
+            queuedPackCount--;
+            memmove(queuedPacks, queuedPacks + 1, queuedPackCount * sizeof(PackRequest));
+        }
+        requestRedraw(); // Show it, and upload the next finished material
+        break;
+    }
+}
+
+void bindMaterialArrays(GLuint program) {
+    static GLuint cachedProgram = 0;
+    static GLint textureLocation = -1;
+    static GLint arrayLocations[MATERIAL_CLASS_COUNT];
+    if (cachedProgram != program) {
+        cachedProgram = program;
+        textureLocation = glGetUniformLocation(program, "texture1");
+        for (int c = 0; c < MATERIAL_CLASS_COUNT; c++) {
+            char name[32];
+            snprintf(name, sizeof(name), "materialArrays[%d]", c);
+            arrayLocations[c] = glGetUniformLocation(program, name);
+        }
+    }
+
+    glUniform1i(textureLocation, 0);
+    for (int c = 0; c < MATERIAL_CLASS_COUNT; c++) {
+        glUniform1i(arrayLocations[c], MATERIAL_ARRAY_UNIT + c);
+        glActiveTexture(GL_TEXTURE0 + MATERIAL_ARRAY_UNIT + c);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, materialArrays[c].texture);
+    }
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, material.albedoMap);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, material.normalMap);
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, material.metallicMap);
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, material.roughnessMap);
-    glActiveTexture(GL_TEXTURE4);
-    glBindTexture(GL_TEXTURE_2D, material.aoMap);
-}
-
-void cleanupPBRMaterial(PBRMaterial* material) {
-    glDeleteTextures(1, &material->albedoMap);
-    glDeleteTextures(1, &material->normalMap);
-    glDeleteTextures(1, &material->metallicMap);
-    glDeleteTextures(1, &material->roughnessMap);
-    glDeleteTextures(1, &material->aoMap);
-    printf("PBR Material resources cleaned up.\n");
+}
+
+void cleanupMaterialArrays() {
+    waitForCounter(&packCounter);
+    for (int i = 0; i < MAX_MATERIALS; i++) {
+        if (packJobs[i].active) releasePackJob(&packJobs[i]);
+    }
+    for (int q = 0; q < queuedPackCount; q++) {
+        for (int i = 0; i < MAP_COUNT; i++) engineFree(queuedPacks[q].paths[i]);
+    }
+    engineFree(queuedPacks);
+    queuedPacks = NULL;
+    queuedPackCount = 0;
+    queuedPackCapacity = 0;
+    for (int c = 0; c < MATERIAL_CLASS_COUNT; c++) {
+        if (materialArrays[c].texture) {
+            untrackMemory(TRACKED_TEXTURE, materialArrays[c].texture);
+            glDeleteTextures(1, &materialArrays[c].texture);
+        }
+    }
+    memset(materialArrays, 0, sizeof(materialArrays));
+    LOG_DEBUG(LOG_ASSETS, "PBR Material resources cleaned up.");
 }
 
 void loadPBRTextures() {
@@ -60,7 +374,7 @@ void loadPBRTextures() {
         "resources/materials/peacock-ore-unity/peacock-ore_albedo.png",
         "resources/materials/peacock-ore-unity/peacock-ore_normal-ogl.png",
         "resources/materials/peacock-ore-unity/peacock-ore_metallic.psd",
-        "resources/materials/peacock-ore-unity/peacock-ore_height.png",
+        NULL,  // No roughness map, MATERIAL_DEFAULT_ROUGHNESS is packed instead
         "resources/materials/peacock-ore-unity/peacock-ore_ao.png"
     );
     addMaterial("peacockOre", peacockOre);
@@ -69,7 +383,7 @@ void loadPBRTextures() {
         "resources/materials/rocky-asphalt1-unity/rocky_asphalt1_albedo.png",
         "resources/materials/rocky-asphalt1-unity/rocky_asphalt1_Normal-ogl.png",
         "resources/materials/rocky-asphalt1-unity/rocky_asphalt1_Metallic.psd",
-        "resources/materials/rocky-asphalt1-unity/rocky_asphalt1_Height.png",  // Note: Height as roughness is a placeholder
+        NULL,
         "resources/materials/rocky-asphalt1-unity/rocky_asphalt1_ao.png"
     );
     addMaterial("rockyAsphalt", rockyAsphalt);
@@ -78,7 +392,7 @@ void loadPBRTextures() {
         "resources/materials/stylized-chunky-rockface-unity/stylized-chunky-rockface_albedo.png",
         "resources/materials/stylized-chunky-rockface-unity/stylized-chunky-rockface_normal-ogl.png",
         "resources/materials/stylized-chunky-rockface-unity/stylized-chunky-rockface_metallic.psd",
-        "resources/materials/stylized-chunky-rockface-unity/stylized-chunky-rockface_height.png", 
+        NULL,
         "resources/materials/stylized-chunky-rockface-unity/stylized-chunky-rockface_ao.png"
     );
     addMaterial("chunkyRockface", chunkyRockface);
@@ -87,7 +401,7 @@ void loadPBRTextures() {
         "resources/materials/used-stainless-steel2-unity/used-stainless-steel2_albedo.png",
         "resources/materials/used-stainless-steel2-unity/used-stainless-steel2_normal-ogl.png",
         "resources/materials/used-stainless-steel2-unity/used-stainless-steel2_metallic.psd",
-        "resources/materials/used-stainless-steel2-unity/used-stainless-steel2_height.png",  
+        NULL,
         "resources/materials/used-stainless-steel2-unity/used-stainless-steel2_ao.png"
     );
     addMaterial("stainlessSteel", stainlessSteel);
@@ -95,29 +409,33 @@ void loadPBRTextures() {
 
 void addMaterial(const char* name, PBRMaterial material) {
     if (materialCount >= MAX_MATERIALS) {
-        fprintf(stderr, "Max materials limit reached.\n");
+        LOG_ERROR(LOG_ASSETS, "Max materials limit reached.");
+        return;
+    }
+    const char* interned = internString(name);
+    if (!interned || findAsset(ASSET_MATERIAL, interned)) {
+        LOG_ERROR(LOG_ASSETS, "Material %s could not be added.", name);
         return;
     }
-    materialNames[materialCount] = strdup(name);  
+    materialNames[materialCount] = interned;
     materials[materialCount] = material;
     materialCount++;
-    printf("Material %s added successfully.\n", name);
+    // Index + 1 so that slot 0 is distinguishable from no data
+    registerAsset(ASSET_MATERIAL, interned, (void*)(uintptr_t)materialCount, NULL);
+    LOG_DEBUG(LOG_ASSETS, "Material %s added successfully.", name);
 }
 
 
-PBRMaterial* getMaterial(const char* name) {
-    for (int i = 0; i < materialCount; i++) {
-        if (strcmp(materialNames[i], name) == 0) {
-            return &materials[i];
-        }
-    }
-    fprintf(stderr, "Material %s not found. Using default material 'peacockOre'.\n", name);
+static PBRMaterial* findMaterial(const char* name) {
+    AssetHandle handle = findAsset(ASSET_MATERIAL, name);
+    if (!handle) return NULL;
+    return &materials[(uintptr_t)getAssetData(handle) - 1];
+}
 
-    for (int i = 0; i < materialCount; i++) {
-        if (strcmp(materialNames[i], "peacockOre") == 0) {
-            return &materials[i];
-        }
-    }
-    return NULL; 
+PBRMaterial* getMaterial(const char* name) {
+    PBRMaterial* material = findMaterial(name);
+    if (material) return material;
+    LOG_WARN(LOG_ASSETS, "Material %s not found. Using default material 'peacockOre'.", name);
+    return findMaterial("peacockOre");
 }
 
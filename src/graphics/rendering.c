@@ -9,9 +9,20 @@
 #include "globals.h"
 #include "materials.h"
 #include "gui.h"
-
-// Function prototypes
-static Model* model = NULL;
+#include "jobs.h"
+#include "frame_packet.h"
+#include "texture_streaming.h"
+#include "asset_registry.h"
+#include "project_save.h"
+#include "change_journal.h"
+#include "actions.h"
+#include "dynamic_resolution.h"
+#include "logger.h"
+#include "allocators.h"
+#include "memory_accounting.h"
+#include "http_server.h"
+#include "metrics.h"
+#include "frame_stream.h"
 
 // Delta time variables
 static float deltaTime = 0.0f;
@@ -44,10 +55,19 @@ void loadResources(int stage, float* progress) {
 }
 
 void setup() {
+    initLogger(); // Before anything that logs; console output happens on the logger thread
     strncpy(screen.title, "C1ue Engine v1.1.0", sizeof(screen.title) - 1);
 
+    // Shared worker pool for every subsystem that needs background or parallel work
+    initJobSystem(0);
+    initAssetRegistry();
+    initProjectSave();
+    initChangeJournal();
+    initHttpServer();
+    initMetrics(); // Only serves snapshots published by the main loop, so it can start early
+
     if (!glfwInit()) {
-        fprintf(stderr, "Failed to initialize GLFW\n");
+        LOG_ERROR(LOG_RENDER, "Failed to initialize GLFW");
         exit(EXIT_FAILURE);
     }
 
@@ -66,7 +86,7 @@ void setup() {
 
     screen.window = glfwCreateWindow(screen.width, screen.height, screen.title, NULL, NULL);
     if (!screen.window) {
-        fprintf(stderr, "Failed to create window\n");
+        LOG_ERROR(LOG_RENDER, "Failed to create window");
         glfwTerminate();
         exit(EXIT_FAILURE);
     }
@@ -78,29 +98,34 @@ void setup() {
 
     glfwMakeContextCurrent(screen.window);
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        fprintf(stderr, "Failed to initialize GLAD\n");
+        LOG_ERROR(LOG_RENDER, "Failed to initialize GLAD");
         exit(EXIT_FAILURE);
     }
     glfwSwapInterval(1);
     setup_nuklear(screen.window);
 
     // Set up shaders and get uniform locations
-    shaderProgram = loadShader("shaders/objects/vertex.glsl", "shaders/objects/fragment.glsl");
+    shaderProgram = acquireShader("shaders/objects/vertex.glsl", "shaders/objects/fragment.glsl");
     if (shaderProgram == 0) {
-        fprintf(stderr, "Failed to load shaders\n");
+        LOG_ERROR(LOG_RENDER, "Failed to load shaders");
     }
     glUseProgram(shaderProgram);
 
     viewLoc = glGetUniformLocation(shaderProgram, "view");
     if (viewLoc == -1) {
-        fprintf(stderr, "Could not find uniform variable 'view'\n");
+        LOG_WARN(LOG_RENDER, "Could not find uniform variable 'view'");
     }
 
     projLoc = glGetUniformLocation(shaderProgram, "projection");
     if (projLoc == -1) {
-        fprintf(stderr, "Could not find uniform variable 'projection'\n");
+        LOG_WARN(LOG_RENDER, "Could not find uniform variable 'projection'");
     }
 
+    initFramePipeline();
+    initTextureStreaming(0);
+    initDynamicResolution();
+    initFrameStream();
+
     glClearColor(0.0, 0.0, 0.0, 0.0);
     glfwSetInputMode(screen.window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
@@ -114,13 +139,14 @@ void setup() {
     // Disable face culling to ensure all faces are rendered
     glDisable(GL_CULL_FACE);
 
-        printf("OpenGL Version: %s\n", glGetString(GL_VERSION));
-    printf("GLSL Version: %s\n", glGetString(GL_SHADING_LANGUAGE_VERSION));
+        LOG_INFO(LOG_RENDER, "OpenGL Version: %s", (const char*)glGetString(GL_VERSION));
+    LOG_INFO(LOG_RENDER, "GLSL Version: %s", (const char*)glGetString(GL_SHADING_LANGUAGE_VERSION));
 }
 
 void drawMesh(const Mesh* mesh) {
+    applyVertexQuantization(shaderProgram, &mesh->quantization);
     glBindVertexArray(mesh->VAO);
-    glDrawElements(GL_TRIANGLES, mesh->numIndices, GL_UNSIGNED_INT, 0);
+    glDrawElements(GL_TRIANGLES, mesh->numIndices, mesh->indexType, 0);
     glBindVertexArray(0);
 }
 
@@ -149,7 +175,7 @@ void processKeyboardMovements(Camera* camera, float deltaTime) {
 void handleToggleInput(int key, bool* pressedFlag, bool* toggleFlag, const char* toggleName) {
     if (glfwGetKey(screen.window, key) == GLFW_PRESS && !(*pressedFlag)) {
         *toggleFlag = !(*toggleFlag);
-        printf("%s %s.\n", toggleName, *toggleFlag ? "Enabled" : "Disabled");
+        LOG_INFO(LOG_RENDER, "%s %s.", toggleName, *toggleFlag ? "Enabled" : "Disabled");
         *pressedFlag = true;
     }
     else if (glfwGetKey(screen.window, key) == GLFW_RELEASE) {
@@ -169,121 +195,12 @@ void handleObjectCreation(int key, bool* pressedFlag, ObjectType objType) {
 }
 
 
-void render_scene(const Matrix4x4 viewMatrix, const Matrix4x4 projMatrix) {
-    for (int i = 0; i < objectManager.count; i++) {
-        drawObject(&objectManager.objects[i], viewMatrix, projMatrix);
-    }
-}
-
-float distanceFromCamera(SceneObject* obj) {
-    Vector3 diff = vector_sub(camera.Position, obj->position);
-    return vector_length(diff);
-}
-
-int compareObjects(const void* a, const void* b) {
-    SceneObject* objA = *(SceneObject**)a;
-    SceneObject* objB = *(SceneObject**)b;
-    float distanceA = vector_length(vector_sub(camera.Position, objA->position));
-    float distanceB = vector_length(vector_sub(camera.Position, objB->position));
-    return (distanceA < distanceB) - (distanceA > distanceB); // Sort descending
-}
-
-void setShaderUniforms(SceneObject* obj) {
-    glUseProgram(shaderProgram);
-    GLint useTextureLoc = glGetUniformLocation(shaderProgram, "useTexture");
-    GLint usePBRLoc = glGetUniformLocation(shaderProgram, "usePBR");
-    GLint useColorLoc = glGetUniformLocation(shaderProgram, "useColor");
-    GLint colorLoc = glGetUniformLocation(shaderProgram, "inputColor");
-
-    // Set texture usage
-    glUniform1i(useTextureLoc, texturesEnabled && obj->object.useTexture && !obj->object.usePBR);
-    // Set PBR usage
-    glUniform1i(usePBRLoc, usePBR && obj->object.usePBR);
-    // Set color usage
-    glUniform1i(useColorLoc, colorsEnabled && obj->object.useColor);
-    // Set input color
-    glUniform4f(colorLoc, obj->color.x, obj->color.y, obj->color.z, obj->color.w);
-
-    if (obj->object.useTexture && texturesEnabled) {
-        glBindTexture(GL_TEXTURE_2D, obj->object.textureID);
-    }
-
-    if (usePBR && obj->object.usePBR) {
-        bindPBRMaterial(obj->object.material);
-    }
-}
-
+// Submits the latest scene snapshot; the next one is built on a worker meanwhile.
+// The scene is drawn at the dynamic resolution scale and upscaled to the window.
 void render() {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    Matrix4x4 projMatrix = getProjectionMatrix(45.0f, (float)screen.width / screen.height, 0.1f, 100.0f);
-    Matrix4x4 viewMatrix = getViewMatrix(&camera);
-
-    // Draw skybox first if background is enabled
-    if (backgroundEnabled) {
-        glDepthFunc(GL_LEQUAL);
-        drawSkybox(&camera, &projMatrix);
-        glDepthFunc(GL_LESS);
-    }
-
-    // Use shader program once
-    glUseProgram(shaderProgram);
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, &viewMatrix.data[0][0]);
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, &projMatrix.data[0][0]);
-    updateShaderLights();
-    glUniform3fv(glGetUniformLocation(shaderProgram, "viewPos"), 1, (const GLfloat*)&camera.Position);
-    glUniform3fv(glGetUniformLocation(shaderProgram, "lightPos"), 1, (const GLfloat*)&lights[0].position);
-    glUniform3fv(glGetUniformLocation(shaderProgram, "lightColor"), 1, (const GLfloat*)&lights[0].color);
-    glUniform1f(glGetUniformLocation(shaderProgram, "lightIntensity"), lights[0].intensity);
-    glUniform1i(glGetUniformLocation(shaderProgram, "useLighting"), lightingEnabled);
-    glUniform1i(glGetUniformLocation(shaderProgram, "noShading"), !lightingEnabled);
-
-    // Enable depth testing
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
-
-    // Separate objects into opaque and transparent lists
-    SceneObject* opaqueObjects[MAX_OBJECTS];
-    SceneObject* transparentObjects[MAX_OBJECTS];
-    int opaqueCount = 0;
-    int transparentCount = 0;
-
-    for (int i = 0; i < objectManager.count; i++) {
-        SceneObject* obj = &objectManager.objects[i];
-        if (obj->color.w < 1.0f) {
-            transparentObjects[transparentCount++] = obj;
-        }
-        else {
-            opaqueObjects[opaqueCount++] = obj;
-        }
-    }
-
-    // Sort transparent objects by distance from the camera (farthest first)
-    qsort(transparentObjects, transparentCount, sizeof(SceneObject*), compareObjects);
-
-    // Render opaque objects first
-    for (int i = 0; i < opaqueCount; i++) {
-        SceneObject* obj = opaqueObjects[i];
-        setShaderUniforms(obj);
-        drawObject(obj, viewMatrix, projMatrix);
-    }
-
-    // Render transparent objects last
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    for (int i = 0; i < transparentCount; i++) {
-        SceneObject* obj = transparentObjects[i];
-        setShaderUniforms(obj);
-        drawObject(obj, viewMatrix, projMatrix);
-    }
-    glDisable(GL_BLEND);
-
-    // Draw model's meshes if loaded
-    if (model) {
-        for (unsigned int i = 0; i < model->meshCount; i++) {
-            drawMesh(&model->meshes[i]);
-        }
-    }
+    beginSceneRender();
+    submitFramePacket(getRenderFramePacket());
+    endSceneRender();
 }
 
 double calculateDeltaTime() {
@@ -299,7 +216,7 @@ void update(double deltaTime) {
     }
 
     if (glfwGetKey(screen.window, GLFW_KEY_E) == GLFW_PRESS) {
-        printf("\nExiting...\n");
+        LOG_INFO(LOG_CORE, "Exiting...");
         exit(EXIT_SUCCESS);
     }
 
@@ -360,7 +277,24 @@ void handleMouseInput(GLFWwindow* window, Camera* camera) {
 }
 
 void end() {
+    shutdownHttpServer(); // Joins the server thread, so no handler runs while the routes below are torn down
+    shutdownFrameStream();
+    shutdownMetrics();
+    shutdownMemoryAccounting(); // Writes the CLUE_MEMORY_REPORT dump while the scene is still loaded
+    shutdownProjectSave();
+    shutdownChangeJournal();
+    shutdownFramePipeline();
+    shutdownDynamicResolution();
     cleanupObjects();
+    clearActionHistory();
+    cleanupSkybox();
+    releaseShader(shaderProgram);
+    shutdownTextureStreaming();
+    cleanupMaterialArrays();
+    shutdownAssetRegistry();
+    shutdownJobSystem();
     glfwDestroyWindow(screen.window);
     glfwTerminate();
+    shutdownAllocators();
+    shutdownLogger();
 }
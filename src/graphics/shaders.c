@@ -1,4 +1,8 @@
 #include "shaders.h"
+#include "asset_registry.h"
+#include "logger.h"
+#include "allocators.h"
+#include "metrics.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,7 +13,7 @@
 char* readFile(const char* filePath) {
     FILE* file = fopen(filePath, "rb");
     if (!file) {
-        fprintf(stderr, "Failed to open the file: %s\n", filePath);
+        LOG_ERROR(LOG_ASSETS, "Failed to open the file: %s", filePath);
         return NULL;
     }
 
@@ -17,10 +21,10 @@ char* readFile(const char* filePath) {
     long length = ftell(file);
     fseek(file, 0, SEEK_SET);
 
-    char* data = (char*)malloc(length + 1);
+    char* data = (char*)engineMalloc(length + 1);
     if (!data) {
         fclose(file);
-        fprintf(stderr, "Failed to allocate memory\n");
+        LOG_ERROR(LOG_ASSETS, "Failed to allocate memory");
         return NULL;
     }
 
@@ -39,7 +43,7 @@ bool checkCompileErrors(unsigned int shader, const char* type) {
         glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
         if (!success) {
             glGetShaderInfoLog(shader, 512, NULL, infoLog);
-            printf("ERROR::SHADER_COMPILATION_ERROR of type: %s\n%s\n", type, infoLog);
+            LOG_ERROR(LOG_ASSETS, "Failed to compile %s shader:\n%s", type, infoLog);
             return false;
         }
     }
@@ -47,7 +51,7 @@ bool checkCompileErrors(unsigned int shader, const char* type) {
         glGetProgramiv(shader, GL_LINK_STATUS, &success);
         if (!success) {
             glGetProgramInfoLog(shader, 512, NULL, infoLog);
-            printf("ERROR::PROGRAM_LINKING_ERROR of type: %s\n%s\n", type, infoLog);
+            LOG_ERROR(LOG_ASSETS, "Failed to link shader program (%s):\n%s", type, infoLog);
             return false;
         }
     }
@@ -59,8 +63,8 @@ unsigned int loadShader(const char* vertexPath, const char* fragmentPath) {
     char* vShaderCode = readFile(vertexPath);
     char* fShaderCode = readFile(fragmentPath);
     if (!vShaderCode || !fShaderCode) {
-        if (vShaderCode) free(vShaderCode);
-        if (fShaderCode) free(fShaderCode);
+        if (vShaderCode) engineFree(vShaderCode);
+        if (fShaderCode) engineFree(fShaderCode);
         return 0;
     }
 
@@ -68,8 +72,8 @@ unsigned int loadShader(const char* vertexPath, const char* fragmentPath) {
     glShaderSource(vertex, 1, (const GLchar* const*)&vShaderCode, NULL);
     glCompileShader(vertex);
     if (!checkCompileErrors(vertex, "VERTEX")) {
-        free(vShaderCode);
-        free(fShaderCode);
+        engineFree(vShaderCode);
+        engineFree(fShaderCode);
         glDeleteShader(vertex);
         return 0;
     }
@@ -78,8 +82,8 @@ unsigned int loadShader(const char* vertexPath, const char* fragmentPath) {
     glShaderSource(fragment, 1, (const GLchar* const*)&fShaderCode, NULL);
     glCompileShader(fragment);
     if (!checkCompileErrors(fragment, "FRAGMENT")) {
-        free(vShaderCode);
-        free(fShaderCode);
+        engineFree(vShaderCode);
+        engineFree(fShaderCode);
         glDeleteShader(vertex);
         glDeleteShader(fragment);
         return 0;
@@ -93,15 +97,54 @@ unsigned int loadShader(const char* vertexPath, const char* fragmentPath) {
         glDeleteProgram(shaderProgram);
         glDeleteShader(vertex);
         glDeleteShader(fragment);
-        free(vShaderCode);
-        free(fShaderCode);
+        engineFree(vShaderCode);
+        engineFree(fShaderCode);
         return 0;
     }
 
     glDeleteShader(vertex);
     glDeleteShader(fragment);
-    free(vShaderCode);
-    free(fShaderCode);
+    engineFree(vShaderCode);
+    engineFree(fShaderCode);
 
     return shaderProgram;
 }
+
+static void destroyShaderAsset(void* data) {
+    glDeleteProgram((GLuint)(uintptr_t)data);
+}
+
+static void programKey(unsigned int program, char* key, size_t size) {
+    snprintf(key, size, "program:%u", program);
+}
+
+unsigned int acquireShader(const char* vertexPath, const char* fragmentPath) {
+    char key[1024];
+    snprintf(key, sizeof(key), "%s|%s", vertexPath, fragmentPath);
+    AssetHandle handle = findAsset(ASSET_SHADER, key);
+    if (handle) {
+        acquireAsset(handle);
+        return (unsigned int)(uintptr_t)getAssetData(handle);
+    }
+
+    double started = glfwGetTime();
+    unsigned int program = loadShader(vertexPath, fragmentPath);
+    if (program == 0) return 0;
+    observeAssetLoad(ASSET_SHADER, glfwGetTime() - started);
+    handle = registerAsset(ASSET_SHADER, key, (void*)(uintptr_t)program, destroyShaderAsset);
+    if (!handle) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    // Second key so the program can be released by its ID
+    char alias[32];
+    programKey(program, alias, sizeof(alias));
+    addAssetAlias(handle, alias);
+    return program;
+}
+
+void releaseShader(unsigned int program) {
+    char alias[32];
+    programKey(program, alias, sizeof(alias));
+    releaseAsset(findAsset(ASSET_SHADER, alias));
+}
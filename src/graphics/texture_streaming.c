@@ -0,0 +1,454 @@
+#include "texture_streaming.h"
+#include "redraw.h"
+#include "SOIL2/SOIL2.h"
+#include "jobs.h"
+#include "image_utils.h"
+#include "logger.h"
+#include "allocators.h"
+#include "memory_accounting.h"
+#include "metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <math.h>
+
+#define STREAM_PBO_COUNT 3
+#define MAX_UPLOADS_PER_FRAME 64
+#define TEXTURE_LOOKUP_SIZE 2048 // Power of two, at least twice MAX_STREAMED_TEXTURES
+#define MAX_MIP_BIAS 4
+
+typedef enum {
+    STREAM_IDLE,
+    STREAM_DECODING,
+    STREAM_DECODED,
+    STREAM_FAILED
+} StreamState;
+
+typedef struct {
+    char* path;
+    GLuint texture;
+    int width;
+    int height;
+    int levelCount;      // 0 until the first decode finishes
+    int residentLevel;   // Largest resident mip; levelCount while only the placeholder is resident
+    int wantedLevel;
+    size_t residentBytes;
+    unsigned long long lastUsedFrame;
+    atomic_uint screenSize; // Float bits of the largest on-screen size noted since the last update
+    atomic_int state;
+
+    // Written by the decode job, handed to the GL thread by state == STREAM_DECODED
+    float decodeTargetSize;
+    unsigned char* pixels; // Mip chain from decodedLevel to the last level
+    int decodedLevel;
+    int decodedWidth;
+    int decodedHeight;
+} StreamedTexture;
+
+typedef struct {
+    StreamedTexture* entry;
+    int level;
+    size_t offset;
+    size_t bytes;
+} PendingUpload;
+
+static StreamedTexture entries[MAX_STREAMED_TEXTURES];
+static int entryCount = 0;
+static int lookup[TEXTURE_LOOKUP_SIZE]; // Texture name -> entry index + 1
+static bool initialized = false;
+
+static JobCounter decodeCounter;
+static int decodesInFlight = 0;
+
+static GLuint pbos[STREAM_PBO_COUNT];
+static size_t pboCapacity[STREAM_PBO_COUNT];
+static GLsync pboFences[STREAM_PBO_COUNT];
+static int pboCursor = 0;
+
+static size_t vramBudget = DEFAULT_TEXTURE_VRAM_BUDGET;
+static size_t uploadBudget = DEFAULT_TEXTURE_UPLOAD_BUDGET;
+static size_t residentTotal = 0;
+static size_t uploadedLastFrame = 0;
+static int mipBias = 0;
+static unsigned long long streamFrame = 0;
+
+static size_t mipOffset(const StreamedTexture* entry, int level) {
+    size_t offset = 0;
+    for (int l = entry->decodedLevel; l < level; l++) {
+        offset += imageMipBytes(entry->width, entry->height, l);
+    }
+    return offset;
+}
+
+// Mip whose size best matches the pixels the texture covers on screen
+static int levelForScreenSize(int width, int height, float pixels) {
+    int levels = imageMipCount(width, height);
+    if (pixels <= 0.0f) return levels - 1;
+    float ratio = (float)(width > height ? width : height) / pixels;
+    int level = ratio <= 1.0f ? 0 : (int)floorf(log2f(ratio));
+    return level < levels - 1 ? level : levels - 1;
+}
+
+static int findEntry(GLuint texture) {
+    unsigned int slot = (texture * 2654435761u) & (TEXTURE_LOOKUP_SIZE - 1);
+    for (int probe = 0; probe < TEXTURE_LOOKUP_SIZE; probe++) {
+        int index = lookup[slot];
+        if (index == 0) return -1;
+        if (entries[index - 1].texture == texture) return index - 1;
+        slot = (slot + 1) & (TEXTURE_LOOKUP_SIZE - 1);
+    }
+    return -1;
+}
+
+static void insertEntry(GLuint texture, int index) {
+    unsigned int slot = (texture * 2654435761u) & (TEXTURE_LOOKUP_SIZE - 1);
+    while (lookup[slot] != 0) {
+        slot = (slot + 1) & (TEXTURE_LOOKUP_SIZE - 1);
+    }
+    lookup[slot] = index + 1;
+}
+
+static void decodeTextureJob(void* data) {
+    StreamedTexture* entry = (StreamedTexture*)data;
+    double started = glfwGetTime();
+    int width, height, channels;
+    unsigned char* image = SOIL_load_image(entry->path, &width, &height, &channels, SOIL_LOAD_RGBA);
+    if (!image) {
+        LOG_ERROR(LOG_ASSETS, "Failed to load texture file %s: %s", entry->path, SOIL_last_result());
+        atomic_store(&entry->state, STREAM_FAILED);
+        return;
+    }
+
+    // Images are stored top-down, GL expects the first row at the bottom
+    flipImageRows(image, width, height);
+
+    int firstLevel = levelForScreenSize(width, height, entry->decodeTargetSize);
+    unsigned char* chain = buildMipChain(image, width, height, firstLevel, NULL);
+    SOIL_free_image_data(image);
+    if (!chain) {
+        LOG_ERROR(LOG_ASSETS, "Out of memory decoding texture %s", entry->path);
+        atomic_store(&entry->state, STREAM_FAILED);
+        return;
+    }
+
+    entry->decodedWidth = width;
+    entry->decodedHeight = height;
+    entry->pixels = chain;
+    entry->decodedLevel = firstLevel;
+    observeAssetLoad(ASSET_TEXTURE, glfwGetTime() - started);
+    atomic_store(&entry->state, STREAM_DECODED);
+    requestRedraw(); // The upload happens on the main thread
+}
+
+void initTextureStreaming(size_t budget) {
+    if (initialized) return;
+    memset(lookup, 0, sizeof(lookup));
+    entryCount = 0;
+    decodesInFlight = 0;
+    atomic_store(&decodeCounter.pending, 0);
+    vramBudget = budget > 0 ? budget : DEFAULT_TEXTURE_VRAM_BUDGET;
+    const char* budgetEnv = getenv("CLUE_TEXTURE_BUDGET_MB");
+    if (budget == 0 && budgetEnv && atoi(budgetEnv) > 0) {
+        vramBudget = (size_t)atoi(budgetEnv) * 1024 * 1024;
+    }
+    residentTotal = 0;
+    mipBias = 0;
+
+    glGenBuffers(STREAM_PBO_COUNT, pbos);
+    for (int i = 0; i < STREAM_PBO_COUNT; i++) {
+        pboCapacity[i] = 0;
+        pboFences[i] = 0;
+    }
+    initialized = true;
+}
+
+void shutdownTextureStreaming() {
+    if (!initialized) return;
+    waitForCounter(&decodeCounter);
+
+    for (int i = 0; i < entryCount; i++) {
+        untrackMemory(TRACKED_TEXTURE, entries[i].texture);
+        glDeleteTextures(1, &entries[i].texture);
+        engineFree(entries[i].pixels);
+        engineFree(entries[i].path);
+    }
+    for (int i = 0; i < STREAM_PBO_COUNT; i++) {
+        if (pboFences[i]) glDeleteSync(pboFences[i]);
+        untrackMemory(TRACKED_BUFFER, pbos[i]);
+    }
+    glDeleteBuffers(STREAM_PBO_COUNT, pbos);
+
+    memset(entries, 0, sizeof(entries));
+    entryCount = 0;
+    initialized = false;
+}
+
+// The placeholder texel counts until the first mip is resident
+static void accountTexture(const StreamedTexture* entry) {
+    trackMemory(TRACKED_TEXTURE, entry->texture, MEMORY_TEXTURES, entry->residentBytes ? entry->residentBytes : 4, entry->path);
+}
+
+GLuint requestStreamedTexture(const char* path, TextureUsage usage) {
+    if (!initialized) {
+        initTextureStreaming(0);
+    }
+    for (int i = 0; i < entryCount; i++) {
+        if (strcmp(entries[i].path, path) == 0) {
+            return entries[i].texture;
+        }
+    }
+    if (entryCount >= MAX_STREAMED_TEXTURES) {
+        LOG_ERROR(LOG_ASSETS, "Exceeded maximum streamed texture limit of %d", MAX_STREAMED_TEXTURES);
+        return 0;
+    }
+
+    StreamedTexture* entry = &entries[entryCount];
+    memset(entry, 0, sizeof(StreamedTexture));
+    entry->path = engineStrdup(path);
+    atomic_store(&entry->screenSize, 0);
+    atomic_store(&entry->state, STREAM_IDLE);
+
+    // The placeholder keeps the texture name valid for draws until real mips arrive
+    static const unsigned char colorPlaceholder[4] = { 128, 128, 128, 255 };
+    static const unsigned char normalPlaceholder[4] = { 128, 128, 255, 255 };
+    glGenTextures(1, &entry->texture);
+    glBindTexture(GL_TEXTURE_2D, entry->texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                 usage == TEXTURE_USAGE_NORMAL ? normalPlaceholder : colorPlaceholder);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+    accountTexture(entry);
+    insertEntry(entry->texture, entryCount);
+    entryCount++;
+    return entry->texture;
+}
+
+void noteTextureScreenSize(GLuint texture, float pixels) {
+    if (texture == 0 || pixels <= 0.0f) return;
+    int index = findEntry(texture);
+    if (index < 0) return;
+
+    unsigned int bits;
+    memcpy(&bits, &pixels, sizeof(bits));
+    atomic_uint* size = &entries[index].screenSize;
+    unsigned int current = atomic_load(size);
+    while (bits > current && !atomic_compare_exchange_weak(size, &current, bits)) {
+        // Positive floats compare like their bit patterns, so this keeps the maximum
+    }
+}
+
+static void kickDecode(StreamedTexture* entry, float targetSize) {
+    entry->decodeTargetSize = targetSize;
+    atomic_store(&entry->state, STREAM_DECODING);
+    decodesInFlight++;
+    runBackgroundJob(decodeTextureJob, entry, &decodeCounter); // Workers only: a frame wait never runs a decode
+}
+
+static void evictLevel(StreamedTexture* entry) {
+    int level = entry->residentLevel;
+    glBindTexture(GL_TEXTURE_2D, entry->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1);
+    glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    size_t bytes = imageMipBytes(entry->width, entry->height, level);
+    entry->residentBytes -= bytes;
+    residentTotal -= bytes;
+    entry->residentLevel = level + 1;
+    accountTexture(entry);
+}
+
+static bool canEvict(const StreamedTexture* entry) {
+    if (entry->levelCount == 0 || atomic_load(&entry->state) != STREAM_IDLE) return false;
+    if (entry->residentLevel >= entry->levelCount - 1) return false;
+    int width = imageMipDimension(entry->width, entry->residentLevel);
+    int height = imageMipDimension(entry->height, entry->residentLevel);
+    return width > STREAMING_MIN_RESIDENT_SIZE || height > STREAMING_MIN_RESIDENT_SIZE;
+}
+
+static void enforceBudget() {
+    // Mips above what is currently wanted go first
+    for (int i = 0; i < entryCount && residentTotal > vramBudget; i++) {
+        StreamedTexture* entry = &entries[i];
+        while (residentTotal > vramBudget && canEvict(entry) && entry->residentLevel < entry->wantedLevel) {
+            evictLevel(entry);
+        }
+    }
+
+    // Then the largest mip of the least recently used texture, one level at a time
+    while (residentTotal > vramBudget) {
+        StreamedTexture* oldest = NULL;
+        for (int i = 0; i < entryCount; i++) {
+            StreamedTexture* entry = &entries[i];
+            if (entry->lastUsedFrame >= streamFrame || !canEvict(entry)) continue;
+            if (!oldest || entry->lastUsedFrame < oldest->lastUsedFrame) {
+                oldest = entry;
+            }
+        }
+        if (!oldest) break;
+        evictLevel(oldest);
+    }
+
+    // Whatever is left is in view: ask for smaller mips instead of thrashing
+    if (residentTotal > vramBudget) {
+        if (mipBias < MAX_MIP_BIAS) mipBias++;
+    }
+    else if (mipBias > 0 && residentTotal < vramBudget / 4 * 3) {
+        mipBias--;
+    }
+}
+
+static void uploadDecodedMips() {
+    int slot = pboCursor;
+    if (pboFences[slot]) {
+        // The PBO is still being read by an earlier upload; try again next frame
+        if (glClientWaitSync(pboFences[slot], 0, 0) == GL_TIMEOUT_EXPIRED) return;
+        glDeleteSync(pboFences[slot]);
+        pboFences[slot] = 0;
+    }
+
+    PendingUpload uploads[MAX_UPLOADS_PER_FRAME];
+    int uploadCount = 0;
+    size_t total = 0;
+    for (int i = 0; i < entryCount && uploadCount < MAX_UPLOADS_PER_FRAME; i++) {
+        StreamedTexture* entry = &entries[i];
+        if (atomic_load(&entry->state) != STREAM_DECODED) continue;
+
+        // Smallest mips first so the texture sharpens progressively
+        for (int level = entry->residentLevel - 1; level >= entry->decodedLevel && uploadCount < MAX_UPLOADS_PER_FRAME; level--) {
+            size_t bytes = imageMipBytes(entry->width, entry->height, level);
+            if (total > 0 && total + bytes > uploadBudget) break;
+            uploads[uploadCount++] = (PendingUpload){ entry, level, total, bytes };
+            total += bytes;
+        }
+        if (total >= uploadBudget) break;
+    }
+    uploadedLastFrame = total;
+    if (uploadCount == 0) return;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[slot]);
+    if (pboCapacity[slot] < total) {
+        pboCapacity[slot] = total > uploadBudget ? total : uploadBudget;
+    }
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, pboCapacity[slot], NULL, GL_STREAM_DRAW);
+    trackMemory(TRACKED_BUFFER, pbos[slot], MEMORY_STAGING_BUFFERS, pboCapacity[slot], "texture streaming");
+    unsigned char* mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, total,
+                                                             GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!mapped) {
+        LOG_ERROR(LOG_ASSETS, "Failed to map texture upload buffer.");
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return;
+    }
+    for (int i = 0; i < uploadCount; i++) {
+        const StreamedTexture* entry = uploads[i].entry;
+        memcpy(mapped + uploads[i].offset, entry->pixels + mipOffset(entry, uploads[i].level), uploads[i].bytes);
+    }
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    for (int i = 0; i < uploadCount; i++) {
+        StreamedTexture* entry = uploads[i].entry;
+        int level = uploads[i].level;
+        glBindTexture(GL_TEXTURE_2D, entry->texture);
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, imageMipDimension(entry->width, level), imageMipDimension(entry->height, level),
+                     0, GL_RGBA, GL_UNSIGNED_BYTE, (const void*)uploads[i].offset);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, entry->levelCount - 1);
+
+        entry->residentLevel = level;
+        entry->residentBytes += uploads[i].bytes;
+        residentTotal += uploads[i].bytes;
+        accountTexture(entry);
+        if (level == entry->decodedLevel) {
+            engineFree(entry->pixels);
+            entry->pixels = NULL;
+            atomic_store(&entry->state, STREAM_IDLE);
+        }
+    }
+
+    pboFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pboCursor = (pboCursor + 1) % STREAM_PBO_COUNT;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void updateTextureStreaming() {
+    if (!initialized) return;
+    streamFrame++;
+
+    decodesInFlight = 0;
+    for (int i = 0; i < entryCount; i++) {
+        StreamedTexture* entry = &entries[i];
+        int state = atomic_load(&entry->state);
+        if (state == STREAM_DECODED && entry->pixels && entry->levelCount == 0) {
+            // First decode: the real size is known now, only the placeholder is resident
+            entry->width = entry->decodedWidth;
+            entry->height = entry->decodedHeight;
+            entry->levelCount = imageMipCount(entry->width, entry->height);
+            entry->residentLevel = entry->levelCount;
+        }
+        if (state == STREAM_DECODED && entry->decodedLevel >= entry->residentLevel) {
+            // Eviction or a smaller wanted size overtook the decode; nothing left to upload
+            engineFree(entry->pixels);
+            entry->pixels = NULL;
+            atomic_store(&entry->state, STREAM_IDLE);
+            state = STREAM_IDLE;
+        }
+        if (state == STREAM_DECODING || state == STREAM_DECODED) {
+            decodesInFlight++;
+        }
+    }
+
+    for (int i = 0; i < entryCount; i++) {
+        StreamedTexture* entry = &entries[i];
+        int state = atomic_load(&entry->state);
+        unsigned int bits = atomic_exchange(&entry->screenSize, 0);
+        float pixels;
+        memcpy(&pixels, &bits, sizeof(pixels));
+        if (pixels <= 0.0f || state == STREAM_FAILED) continue;
+
+        // Only textures on screen this frame are streamed in
+        entry->lastUsedFrame = streamFrame;
+        if (entry->levelCount == 0) {
+            if (state == STREAM_IDLE && decodesInFlight < MAX_STREAMING_DECODES) {
+                kickDecode(entry, pixels / (float)(1 << mipBias));
+            }
+            continue;
+        }
+
+        int wanted = levelForScreenSize(entry->width, entry->height, pixels) + mipBias;
+        entry->wantedLevel = wanted < entry->levelCount - 1 ? wanted : entry->levelCount - 1;
+        if (state == STREAM_IDLE && entry->wantedLevel < entry->residentLevel && decodesInFlight < MAX_STREAMING_DECODES) {
+            kickDecode(entry, pixels / (float)(1 << mipBias));
+        }
+    }
+
+    uploadDecodedMips();
+    enforceBudget();
+}
+
+void setTextureStreamingBudget(size_t bytes) {
+    vramBudget = bytes > 0 ? bytes : DEFAULT_TEXTURE_VRAM_BUDGET;
+}
+
+void setTextureUploadBudget(size_t bytesPerFrame) {
+    uploadBudget = bytesPerFrame > 0 ? bytesPerFrame : DEFAULT_TEXTURE_UPLOAD_BUDGET;
+}
+
+void getTextureStreamingStats(TextureStreamingStats* stats) {
+    memset(stats, 0, sizeof(TextureStreamingStats));
+    stats->textureCount = entryCount;
+    for (int i = 0; i < entryCount; i++) {
+        int state = atomic_load(&entries[i].state);
+        if (state == STREAM_DECODING) stats->pendingDecodes++;
+        if (state == STREAM_DECODED) stats->pendingUploads++;
+    }
+    stats->residentBytes = residentTotal;
+    stats->vramBudget = vramBudget;
+    stats->uploadedLastFrame = uploadedLastFrame;
+    stats->mipBias = mipBias;
+}
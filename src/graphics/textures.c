@@ -1,5 +1,7 @@
 #include "textures.h"
-#include "SOIL2/SOIL2.h"
+#include "texture_streaming.h"
+#include "asset_registry.h"
+#include "logger.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -15,36 +17,43 @@ const char* textureNames[] = {
 int textureCount = sizeof(textureNames) / sizeof(textureNames[0]); 
 GLuint textures[MAX_TEXTURES];
 GLuint getTexture(const char* name) {
-    for (int i = 0; i < textureCount; i++) {
-        if (strcmp(textureNames[i], name) == 0) {
-            return textures[i];
-        }
+    AssetHandle handle = findAsset(ASSET_TEXTURE, name);
+    if (handle) {
+        return (GLuint)(uintptr_t)getAssetData(handle);
     }
-    fprintf(stderr, "Texture %s not found.\n", name);
+    LOG_WARN(LOG_ASSETS, "Texture %s not found.", name);
     return 0;
 }
 
+const char* getTextureName(GLuint textureID) {
+    for (int i = 0; i < textureCount && i < MAX_TEXTURES; i++) {
+        if (textures[i] == textureID) return textureNames[i];
+    }
+    return NULL;
+}
+
+int findTextureIndex(const char* name) {
+    for (int i = 0; name && i < textureCount; i++) {
+        if (strcmp(textureNames[i], name) == 0) return i;
+    }
+    return -1;
+}
 
+// Returns immediately with a placeholder; the image streams in once it is on screen.
+// Loading the same path again returns the existing texture.
 GLuint loadTexture(const char* filename) {
-    GLuint textureID = SOIL_load_OGL_texture(
-        filename,
-        SOIL_LOAD_AUTO,
-        SOIL_CREATE_NEW_ID,
-        SOIL_FLAG_MIPMAPS | SOIL_FLAG_INVERT_Y | SOIL_FLAG_NTSC_SAFE_RGB | SOIL_FLAG_COMPRESS_TO_DXT
-    );
+    AssetHandle handle = findAsset(ASSET_TEXTURE, filename);
+    if (handle) {
+        return (GLuint)(uintptr_t)getAssetData(handle);
+    }
 
+    GLuint textureID = requestStreamedTexture(filename, TEXTURE_USAGE_COLOR);
     if (textureID == 0) {
-        fprintf(stderr, "Failed to load texture file %s: %s\n", filename, SOIL_last_result());
+        LOG_ERROR(LOG_ASSETS, "Failed to load texture file %s", filename);
         return 0;
     }
-
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    fprintf(stderr, "Loaded texture %s, ID %u\n", filename, textureID);
+    // The streamer owns the GL texture, the registry only deduplicates it
+    registerAsset(ASSET_TEXTURE, filename, (void*)(uintptr_t)textureID, NULL);
     return textureID;
 }
 
@@ -63,11 +72,14 @@ void loadAllTextures() {
         if (i < MAX_TEXTURES) {
             textures[i] = loadTexture(textureFiles[i]);
             if (textures[i] == 0) {
-                fprintf(stderr, "Failed to load texture: %s\n", textureFiles[i]);
+                LOG_ERROR(LOG_ASSETS, "Failed to load texture: %s", textureFiles[i]);
+            }
+            else if (i < textureCount) {
+                addAssetAlias(findAsset(ASSET_TEXTURE, textureFiles[i]), textureNames[i]);
             }
         }
         else {
-            fprintf(stderr, "Exceeded maximum texture limit of %d\n", MAX_TEXTURES);
+            LOG_ERROR(LOG_ASSETS, "Exceeded maximum texture limit of %d", MAX_TEXTURES);
             break;
         }
     }
@@ -0,0 +1,117 @@
+#include "vertex_format.h"
+#include <math.h>
+#include <string.h>
+#include <stddef.h>
+
+// Round-to-nearest float to IEEE half, with denormals, infinities and NaN
+static uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t magnitude = bits & 0x7FFFFFFFu;
+
+    if (magnitude >= 0x7F800000u) { // Infinity or NaN
+        return (uint16_t)(sign | 0x7C00u | (magnitude > 0x7F800000u ? 0x200u : 0u));
+    }
+    if (magnitude >= 0x477FF000u) { // Rounds past the largest half
+        return (uint16_t)(sign | 0x7C00u);
+    }
+    if (magnitude < 0x38800000u) { // Half denormal or zero
+        float scaled = fabsf(value) * 16777216.0f; // 2^24: one unit of the smallest half denormal
+        return (uint16_t)(sign | (uint32_t)lrintf(scaled));
+    }
+    uint32_t rounded = magnitude + 0xFFFu + ((magnitude >> 13) & 1u); // Ties to even
+    return (uint16_t)(sign | ((rounded - 0x38000000u) >> 13));
+}
+
+static int16_t toSnorm16(float value) {
+    if (value > 1.0f) value = 1.0f;
+    if (value < -1.0f) value = -1.0f;
+    return (int16_t)lrintf(value * 32767.0f);
+}
+
+static float signNotZero(float value) {
+    return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+// Projects the unit sphere onto an octahedron and unfolds it into a square
+static void encodeOctahedral(const float* normal, int16_t* encoded) {
+    float sum = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+    if (sum <= 0.0f) {
+        encoded[0] = encoded[1] = 0;
+        return;
+    }
+    float x = normal[0] / sum, y = normal[1] / sum;
+    if (normal[2] < 0.0f) {
+        float foldedX = (1.0f - fabsf(y)) * signNotZero(x);
+        float foldedY = (1.0f - fabsf(x)) * signNotZero(y);
+        x = foldedX;
+        y = foldedY;
+    }
+    encoded[0] = toSnorm16(x);
+    encoded[1] = toSnorm16(y);
+}
+
+VertexQuantization packVertices(PackedVertex* destination, unsigned int count, const float* positions,
+                                const float* normals, const float* texCoords, unsigned int stride) {
+    VertexQuantization quantization = { { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f } };
+    if (count == 0) return quantization;
+
+    float low[3], high[3];
+    for (int axis = 0; axis < 3; axis++) low[axis] = high[axis] = positions[axis];
+    for (unsigned int v = 1; v < count; v++) {
+        const float* p = positions + (size_t)v * stride;
+        for (int axis = 0; axis < 3; axis++) {
+            low[axis] = fminf(low[axis], p[axis]);
+            high[axis] = fmaxf(high[axis], p[axis]);
+        }
+    }
+    float extent[3] = { high[0] - low[0], high[1] - low[1], high[2] - low[2] };
+    quantization.scale = (Vector3){ extent[0], extent[1], extent[2] };
+    quantization.bias = (Vector3){ low[0], low[1], low[2] };
+
+    for (unsigned int v = 0; v < count; v++) {
+        const float* p = positions + (size_t)v * stride;
+        PackedVertex* out = &destination[v];
+        for (int axis = 0; axis < 3; axis++) {
+            // A flat axis keeps scale 0, so every stored value lands on the bias
+            float unit = extent[axis] > 0.0f ? (p[axis] - low[axis]) / extent[axis] : 0.0f;
+            out->position[axis] = (uint16_t)lrintf(fminf(fmaxf(unit, 0.0f), 1.0f) * 65535.0f);
+        }
+        out->position[3] = 0;
+
+        if (texCoords) {
+            const float* uv = texCoords + (size_t)v * stride;
+            out->texCoords[0] = floatToHalf(uv[0]);
+            out->texCoords[1] = floatToHalf(uv[1]);
+        }
+        else {
+            out->texCoords[0] = out->texCoords[1] = 0;
+        }
+
+        if (normals) {
+            encodeOctahedral(normals + (size_t)v * stride, out->normal);
+        }
+        else {
+            out->normal[0] = out->normal[1] = 0;
+        }
+    }
+    return quantization;
+}
+
+void bindPackedVertexAttributes() {
+    glVertexAttribPointer(VERTEX_ATTRIB_POSITION, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex),
+                          (void*)offsetof(PackedVertex, position));
+    glEnableVertexAttribArray(VERTEX_ATTRIB_POSITION);
+    glVertexAttribPointer(VERTEX_ATTRIB_TEXCOORD, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex),
+                          (void*)offsetof(PackedVertex, texCoords));
+    glEnableVertexAttribArray(VERTEX_ATTRIB_TEXCOORD);
+    glVertexAttribPointer(VERTEX_ATTRIB_NORMAL, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex),
+                          (void*)offsetof(PackedVertex, normal));
+    glEnableVertexAttribArray(VERTEX_ATTRIB_NORMAL);
+}
+
+void applyVertexQuantization(GLuint program, const VertexQuantization* quantization) {
+    glUniform3fv(glGetUniformLocation(program, "positionScale"), 1, (const GLfloat*)&quantization->scale);
+    glUniform3fv(glGetUniformLocation(program, "positionBias"), 1, (const GLfloat*)&quantization->bias);
+}
@@ -4,111 +4,319 @@
 #include "globals.h"
 #include "SceneObject.h"
 #include "ModelLoad.h"
+#include "change_journal.h"
+#include "transform_hierarchy.h"
+#include "asset_registry.h"
+#include "logger.h"
+#include "allocators.h"
+#include "memory_accounting.h"
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-// Define the stacks for undo and redo
-Action undoStack[MAX_ACTIONS];
-Action redoStack[MAX_ACTIONS];
-int undoTop = -1;
-int redoTop = -1;
+// Ring buffer of actions; the first appliedCount entries from logStart can be
+// undone and the rest redone
+static Action* actionLog = NULL;
+static int logCapacity = 0;
+static int logStart = 0;
+static int logCount = 0;
+static int appliedCount = 0;
+static size_t historyBytes = 0;
+static Pool objectPool = POOL_INITIALIZER(SceneObject, ACTION_OBJECT_POOL_SIZE, "undo object"); // Copies held by add and remove entries
 
-// Define the action history
-Action actionHistory[MAX_ACTIONS];
-int historyCount = 0;
+static Action* logEntry(int index) {
+    return &actionLog[(logStart + index) % logCapacity];
+}
+
+// Add and remove actions keep a copy of the object, which holds a reference
+// to its shared assets so undo/redo can bring it back
+static size_t actionBytes(const Action* action) {
+    bool ownsObject = action->type == ACTION_ADD || action->type == ACTION_REMOVE;
+    return sizeof(Action) + (ownsObject ? sizeof(SceneObject) : 0);
+}
 
-void pushUndoAction(Action action) {
-    if (undoTop < MAX_ACTIONS - 1) {
-        undoStack[++undoTop] = action;
-        redoTop = -1; // Clear redo stack whenever a new action is performed
+static void releaseAction(Action* action) {
+    if (action->type == ACTION_ADD || action->type == ACTION_REMOVE) {
+        releaseObjectAssets(action->data.object);
+        untrackMemory(TRACKED_HOST, (uintptr_t)action->data.object);
+        poolFree(&objectPool, action->data.object);
+        action->data.object = NULL;
     }
 }
 
-Action popUndoAction() {
-    if (undoTop >= 0) {
-        return undoStack[undoTop--];
+static void discardEntry(Action* action) {
+    historyBytes -= actionBytes(action);
+    releaseAction(action);
+}
+
+static bool growLog() {
+    int newCapacity = logCapacity ? logCapacity * 2 : 64;
+    Action* newLog = (Action*)engineMalloc(newCapacity * sizeof(Action));
+    if (!newLog) {
+        LOG_ERROR(LOG_SCENE, "Failed to grow the undo history.");
+        return false;
+    }
+    for (int i = 0; i < logCount; i++) {
+        newLog[i] = *logEntry(i);
     }
-    return (Action) { .type = -1 };
+    untrackMemory(TRACKED_HOST, (uintptr_t)actionLog);
+    engineFree(actionLog);
+    trackMemory(TRACKED_HOST, (uintptr_t)newLog, MEMORY_UNDO_HISTORY, newCapacity * sizeof(Action), "undo history");
+    actionLog = newLog;
+    logCapacity = newCapacity;
+    logStart = 0;
+    return true;
 }
 
-void pushRedoAction(Action action) {
-    if (redoTop < MAX_ACTIONS - 1) {
-        redoStack[++redoTop] = action;
+// Merges a continuing drag into the newest entry instead of adding another
+static bool coalesceAction(const Action* action) {
+    if (appliedCount == 0 || appliedCount != logCount) return false;
+    Action* top = logEntry(appliedCount - 1);
+    if (top->type != action->type || top->objectId != action->objectId) return false;
+    if (action->time - top->time > ACTION_COALESCE_SECONDS) return false;
+
+    switch (action->type) {
+    case ACTION_TRANSFORM:
+        top->data.transform.after = action->data.transform.after;
+        break;
+    case ACTION_CHANGE_COLOR:
+        top->data.color.after = action->data.color.after;
+        break;
+    default:
+        return false;
     }
+    top->time = action->time;
+    return true;
 }
 
-Action popRedoAction() {
-    if (redoTop >= 0) {
-        return redoStack[redoTop--];
+// Takes ownership of the action, including its object copy
+static void recordAction(Action action) {
+    action.time = glfwGetTime();
+    if (coalesceAction(&action)) return;
+
+    // A new action discards everything that was undone
+    while (logCount > appliedCount) {
+        discardEntry(logEntry(--logCount));
+    }
+    if (logCount == logCapacity && !growLog()) {
+        releaseAction(&action);
+        return;
+    }
+
+    *logEntry(logCount++) = action;
+    appliedCount = logCount;
+    historyBytes += actionBytes(&action);
+
+    // Drop the oldest entries once the history is over budget
+    while (historyBytes > ACTION_HISTORY_BUDGET && logCount > 1) {
+        discardEntry(logEntry(0));
+        logStart = (logStart + 1) % logCapacity;
+        logCount--;
+        appliedCount--;
     }
-    return (Action) { .type = -1 };
 }
 
-void addToHistory(Action action) {
-    if (historyCount < MAX_ACTIONS) {
-        actionHistory[historyCount++] = action;
+static SceneObject* copyObject(const SceneObject* obj) {
+    SceneObject* copy = (SceneObject*)poolAlloc(&objectPool);
+    if (!copy) {
+        LOG_ERROR(LOG_SCENE, "Failed to allocate undo history entry.");
+        return NULL;
     }
+    *copy = *obj;
+    retainObjectAssets(copy);
+    trackMemory(TRACKED_HOST, (uintptr_t)copy, MEMORY_UNDO_HISTORY, sizeof(SceneObject), "undo history");
+    return copy;
+}
+
+// Entries name objects by ID; array slots shift whenever an earlier object is removed
+static void applyTransform(int id, const ActionTransform* transform) {
+    int index = findObjectIndex(id);
+    if (index < 0) return;
+    objectManager.objects[index].position = transform->position;
+    objectManager.objects[index].rotation = transform->rotation;
+    objectManager.objects[index].scale = transform->scale;
+    markTransformDirty(index);
+    journalObjectTransform(index);
+}
+
+static void applyColor(int id, Vector4 color) {
+    int index = findObjectIndex(id);
+    if (index < 0) return;
+    objectManager.objects[index].color = color;
+    journalObjectColor(index);
+}
+
+// A parent that has since been removed leaves the object at the root
+static void applyParent(int id, int parentId) {
+    int index = findObjectIndex(id);
+    if (index < 0) return;
+    int parentIndex = parentId >= 0 ? findObjectIndex(parentId) : -1;
+    if (setObjectParent(index, parentIndex)) {
+        journalObjectParent(index);
+    }
+}
+
+// IDs increase with the index, so a restored object cannot keep its old one;
+// every entry naming it, as the object or as a parent, is moved to the new ID
+static void renameObjectInLog(int oldId, int newId) {
+    for (int i = 0; i < logCount; i++) {
+        Action* action = logEntry(i);
+        if (action->objectId == oldId) action->objectId = newId;
+        if (action->type == ACTION_ADD || action->type == ACTION_REMOVE) {
+            if (action->data.object->id == oldId) action->data.object->id = newId;
+            if (action->data.object->parentId == oldId) action->data.object->parentId = newId;
+        }
+        else if (action->type == ACTION_SET_PARENT) {
+            if (action->data.parent.before == oldId) action->data.parent.before = newId;
+            if (action->data.parent.after == oldId) action->data.parent.after = newId;
+        }
+    }
+}
+
+// Brings an added or removed object back; it is appended with a new ID
+static void restoreObject(Action* action) {
+    retainObjectAssets(action->data.object);
+    if (addObjectToManager(*action->data.object)) {
+        int index = objectManager.count - 1;
+        renameObjectInLog(action->objectId, objectManager.objects[index].id);
+        journalAddObject(index);
+        journalObjectParent(index);
+    }
+    else {
+        releaseObjectAssets(action->data.object);
+    }
+}
+
+static void dropObject(const Action* action) {
+    int index = findObjectIndex(action->objectId);
+    if (index < 0) return;
+    removeObject(index);
+    journalRemoveObject(index);
 }
 
 void undo_last_action() {
-    if (undoTop >= 0) {
-        Action action = popUndoAction();
-        switch (action.type) {
+    // Option toggles are only listed in the history, so undo steps over them
+    while (appliedCount > 0) {
+        Action* action = logEntry(--appliedCount);
+        switch (action->type) {
         case ACTION_ADD:
-            removeObject(action.objectIndex);
-            break;
+            dropObject(action);
+            return;
         case ACTION_REMOVE:
-            addObjectToManager(action.previousState);
-            break;
+            restoreObject(action);
+            return;
         case ACTION_TRANSFORM:
-            objectManager.objects[action.objectIndex] = action.previousState;
-            break;
+            applyTransform(action->objectId, &action->data.transform.before);
+            return;
         case ACTION_CHANGE_COLOR:
-            objectManager.objects[action.objectIndex].color = action.previousState.color;
-            break;
+            applyColor(action->objectId, action->data.color.before);
+            return;
+        case ACTION_SET_PARENT:
+            applyParent(action->objectId, action->data.parent.before);
+            return;
         default:
             break;
         }
-        pushRedoAction(action);
     }
 }
 
 void redo_last_action() {
-    if (redoTop >= 0) {
-        Action action = popRedoAction();
-        switch (action.type) {
+    while (appliedCount < logCount) {
+        Action* action = logEntry(appliedCount++);
+        switch (action->type) {
         case ACTION_ADD:
-            addObjectToManager(action.newState);
-            break;
+            restoreObject(action);
+            return;
         case ACTION_REMOVE:
-            removeObject(action.objectIndex);
-            break;
+            dropObject(action);
+            return;
         case ACTION_TRANSFORM:
-            objectManager.objects[action.objectIndex] = action.newState;
-            break;
+            applyTransform(action->objectId, &action->data.transform.after);
+            return;
         case ACTION_CHANGE_COLOR:
-            objectManager.objects[action.objectIndex].color = action.newState.color;
-            break;
+            applyColor(action->objectId, action->data.color.after);
+            return;
+        case ACTION_SET_PARENT:
+            applyParent(action->objectId, action->data.parent.after);
+            return;
         default:
             break;
         }
-        pushUndoAction(action);
     }
 }
 
+void clearActionHistory() {
+    for (int i = 0; i < logCount; i++) {
+        releaseAction(logEntry(i));
+    }
+    untrackMemory(TRACKED_HOST, (uintptr_t)actionLog);
+    engineFree(actionLog);
+    actionLog = NULL;
+    logCapacity = 0;
+    logStart = 0;
+    logCount = 0;
+    appliedCount = 0;
+    historyBytes = 0;
+}
+
+int getActionCount() {
+    return logCount;
+}
+
+int getAppliedActionCount() {
+    return appliedCount;
+}
+
+const Action* getAction(int index) {
+    if (index < 0 || index >= logCount) return NULL;
+    return logEntry(index);
+}
+
+// Descriptions are only built when the history is displayed
+void describeAction(const Action* action, char* buffer, size_t size) {
+    switch (action->type) {
+    case ACTION_ADD:
+        snprintf(buffer, size, "Added object of type %d", action->data.object->object.type);
+        break;
+    case ACTION_REMOVE:
+        snprintf(buffer, size, "Removed object %d", action->objectId);
+        break;
+    case ACTION_TRANSFORM:
+        snprintf(buffer, size, "Transformed object %d", action->objectId);
+        break;
+    case ACTION_CHANGE_COLOR:
+        snprintf(buffer, size, "Changed color of object %d", action->objectId);
+        break;
+    case ACTION_SET_PARENT:
+        snprintf(buffer, size, "Changed parent of object %d", action->objectId);
+        break;
+    case ACTION_TOGGLE_OPTION:
+        snprintf(buffer, size, "Toggled option %s to %s", action->data.option.name, action->data.option.value ? "true" : "false");
+        break;
+    default:
+        snprintf(buffer, size, "Unknown action");
+        break;
+    }
+}
+
+size_t getActionHistoryBytes() {
+    return historyBytes;
+}
+
 void removeObjectWithAction(int index) {
     if (index < 0 || index >= objectManager.count) return;
 
     Action action = {
         .type = ACTION_REMOVE,
-        .previousState = objectManager.objects[index],
-        .objectIndex = index
+        .objectId = objectManager.objects[index].id,
+        .data.object = copyObject(&objectManager.objects[index])
     };
-
-    pushUndoAction(action);
-    addToHistory(action);
+    if (action.data.object) recordAction(action);
 
     // Remove the object
     removeObject(index);
+    journalRemoveObject(index);
 
     // Adjust selected_object to a valid object if possible
     if (objectManager.count > 0) {
@@ -124,10 +332,10 @@ void removeObjectWithAction(int index) {
     }
 
     if (selected_object) {
-        printf("New selected object: ID=%d, Index=%d\n", selected_object->id, selected_object - objectManager.objects);
+        LOG_DEBUG(LOG_SCENE, "New selected object: ID=%d, Index=%d", selected_object->id, (int)(selected_object - objectManager.objects));
     }
     else {
-        printf("No selected object\n");
+        LOG_DEBUG(LOG_SCENE, "No selected object");
     }
 
     // Hide the relevant windows
@@ -138,57 +346,63 @@ void removeObjectWithAction(int index) {
 }
 
 void addObjectWithAction(ObjectType type, bool useTextures, int textureID, bool useColors, Model* model, PBRMaterial material, bool usePBR) {
+    int previousCount = objectManager.count;
     addObject(&camera, type, useTextures, textureID, useColors, model, material, usePBR);
-    SceneObject* newObject = &objectManager.objects[objectManager.count - 1]; // Get the last added object
+    if (objectManager.count == previousCount) return;
     Action action = {
         .type = ACTION_ADD,
-        .newState = *newObject,
-        .objectIndex = objectManager.count - 1
+        .objectId = objectManager.objects[objectManager.count - 1].id,
+        .data.object = copyObject(&objectManager.objects[objectManager.count - 1])
     };
-    snprintf(action.description, sizeof(action.description), "Added object of type %d", type);
-    pushUndoAction(action);
-    addToHistory(action);
+    if (action.data.object) recordAction(action);
+    journalAddObject(objectManager.count - 1);
 }
 
 void transformObjectWithAction(int index, Vector3 position, Vector3 rotation, Vector3 scale) {
     if (index < 0 || index >= objectManager.count) return;
+    const SceneObject* obj = &objectManager.objects[index];
     Action action = {
         .type = ACTION_TRANSFORM,
-        .previousState = objectManager.objects[index],
-        .objectIndex = index,
-        .newState = objectManager.objects[index]
+        .objectId = obj->id,
+        .data.transform.before = { obj->position, obj->rotation, obj->scale },
+        .data.transform.after = { position, rotation, scale }
     };
-    snprintf(action.description, sizeof(action.description), "Transformed object at index %d", index);
-    action.newState.position = position;
-    action.newState.rotation = rotation;
-    action.newState.scale = scale;
-    pushUndoAction(action);
-    addToHistory(action);
-    objectManager.objects[index].position = position;
-    objectManager.objects[index].rotation = rotation;
-    objectManager.objects[index].scale = scale;
+    recordAction(action);
+    applyTransform(obj->id, &action.data.transform.after);
 }
 
 void changeColorWithAction(int index, Vector4 color) {
     if (index < 0 || index >= objectManager.count) return;
     Action action = {
         .type = ACTION_CHANGE_COLOR,
-        .previousState = objectManager.objects[index],
-        .objectIndex = index,
-        .newState = objectManager.objects[index]
+        .objectId = objectManager.objects[index].id,
+        .data.color.before = objectManager.objects[index].color,
+        .data.color.after = color
     };
-    snprintf(action.description, sizeof(action.description), "Changed color of object at index %d", index);
-    action.newState.color = color;
-    pushUndoAction(action);
-    addToHistory(action);
-    objectManager.objects[index].color = color;
+    recordAction(action);
+    applyColor(action.objectId, color);
+}
+
+void setParentWithAction(int index, int parentIndex) {
+    if (index < 0 || index >= objectManager.count) return;
+    int before = objectManager.objects[index].parentId;
+    if (!setObjectParent(index, parentIndex)) return;
+    Action action = {
+        .type = ACTION_SET_PARENT,
+        .objectId = objectManager.objects[index].id,
+        .data.parent.before = before,
+        .data.parent.after = objectManager.objects[index].parentId
+    };
+    if (action.data.parent.before == action.data.parent.after) return;
+    recordAction(action);
+    journalObjectParent(index);
 }
 
 void toggleOptionWithAction(const char* optionName, bool newValue) {
     Action action = {
         .type = ACTION_TOGGLE_OPTION,
-        .objectIndex = -1
+        .objectId = -1,
+        .data.option = { internString(optionName), newValue }
     };
-    snprintf(action.description, sizeof(action.description), "Toggled option %s to %s", optionName, newValue ? "true" : "false");
-    addToHistory(action);
+    recordAction(action);
 }
@@ -2,7 +2,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <float.h>
+#include <ctype.h>
+#include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
@@ -37,6 +40,14 @@
 #include "file_operations.h"
 #include "background.h"
 #include "actions.h"
+#include "project_save.h"
+#include "change_journal.h"
+#include "redraw.h"
+#include "shaders.h"
+#include "dynamic_resolution.h"
+#include "logger.h"
+#include "allocators.h"
+#include "memory_accounting.h"
 
 extern int textureCount;
 extern int materialCount;
@@ -47,7 +58,8 @@ static SceneObject* material_window_obj = NULL;
 static SceneObject* texture_window_obj = NULL;
 extern SceneObject* selected_object;
 
-SceneObject* clipboard_object = NULL; // Clipboard for cut/copy/paste
+SceneObject* clipboard_object = NULL; // Clipboard for cut/copy/paste; points at clipboard_storage when set
+static SceneObject clipboard_storage;
 GLuint textureColorbuffer; // External linkage to the texture from rendering.c
 GLFWwindow* window;
 bool theme_dark = true;
@@ -92,9 +104,7 @@ void material_picker_window(struct nk_context* ctx) {
             if (nk_button_label(ctx, materialNames[i])) {
                 PBRMaterial* newMaterial = getMaterial(materialNames[i]);
                 if (newMaterial) {
-                    PBRMaterial* clonedMaterial = (PBRMaterial*)malloc(sizeof(PBRMaterial));
-                    *clonedMaterial = *newMaterial;
-                    selected_object->object.material = *clonedMaterial;
+                    selected_object->object.material = *newMaterial; // Copied by value
                     selected_object->object.usePBR = true;
                     selected_object->object.useTexture = false;
                     selected_object->object.useColor = false;
@@ -118,9 +128,7 @@ void texture_picker_window(struct nk_context* ctx) {
             if (nk_button_label(ctx, textureNames[i])) {
                 GLuint newTexture = getTexture(textureNames[i]);
                 if (newTexture != 0) {
-                    GLuint* clonedTextureID = (GLuint*)malloc(sizeof(GLuint));
-                    *clonedTextureID = newTexture;
-                    selected_object->object.textureID = *clonedTextureID;
+                    selected_object->object.textureID = newTexture;
                     selected_object->object.useTexture = true;
                     selected_object->object.usePBR = false;
                     selected_object->object.useColor = false;
@@ -143,28 +151,41 @@ void import_model() {
     char const* filePath = tinyfd_openFileDialog("Import Model", "", 1, filterPatterns, "Object Files", 0);
 
     if (!filePath) {
-        fprintf(stderr, "Import operation cancelled or failed to get a valid path.\n");
+        LOG_WARN(LOG_GUI, "Import operation cancelled or failed to get a valid path.");
         return;
     }
 
-    Model* model = loadModel(filePath);
+    Model* model = acquireModel(filePath);
     if (model) {
         PBRMaterial defaultMaterial = { 0 };
         addObjectWithAction(OBJ_MODEL, false, -1, true, model, defaultMaterial, false);
+        releaseModel(model); // The new object holds its own reference
     }
 }
 
+// The clipboard keeps a reference so a cut object's meshes outlive its removal
+static void set_clipboard_object(const SceneObject* object) {
+    if (clipboard_object) {
+        releaseObjectAssets(clipboard_object);
+        clipboard_object = NULL;
+    }
+    if (!object) return;
+
+    clipboard_storage = *object;
+    retainObjectAssets(&clipboard_storage);
+    clipboard_object = &clipboard_storage;
+}
+
 void cut_object() {
     if (selected_object) {
         int index = find_selected_object_index(selected_object);
         if (index != -1) {
-            clipboard_object = (SceneObject*)malloc(sizeof(SceneObject));
+            set_clipboard_object(selected_object);
             if (clipboard_object) {
-                *clipboard_object = *selected_object;
                 isCutOperation = true;
                 removeObjectWithAction(index);
                 selected_object = NULL;
-                printf("Cut object at index: %d\n", index);
+                LOG_DEBUG(LOG_GUI, "Cut object at index: %d", index);
             }
         }
     }
@@ -172,15 +193,8 @@ void cut_object() {
 
 void copy_object() {
     if (selected_object) {
-        clipboard_object = (SceneObject*)malloc(sizeof(SceneObject));
+        set_clipboard_object(selected_object);
         if (clipboard_object) {
-            *clipboard_object = *selected_object;
-            if (selected_object->object.type == OBJ_MODEL) {
-                clipboard_object->object.data.model.meshes = (Mesh*)malloc(selected_object->object.data.model.meshCount * sizeof(Mesh));
-                for (unsigned int i = 0; i < selected_object->object.data.model.meshCount; i++) {
-                    clipboard_object->object.data.model.meshes[i] = selected_object->object.data.model.meshes[i];
-                }
-            }
             isCutOperation = false;
         }
     }
@@ -189,18 +203,11 @@ void copy_object() {
 void paste_object() {
     if (clipboard_object) {
         SceneObject newObject = *clipboard_object;
-        if (clipboard_object->object.type == OBJ_MODEL) {
-            newObject.object.data.model.meshes = (Mesh*)malloc(clipboard_object->object.data.model.meshCount * sizeof(Mesh));
-            for (unsigned int i = 0; i < clipboard_object->object.data.model.meshCount; i++) {
-                newObject.object.data.model.meshes[i] = clipboard_object->object.data.model.meshes[i];
-            }
-        }
 
         if (isCutOperation) {
             addObjectWithAction(newObject.object.type, newObject.object.useTexture, newObject.object.textureID, newObject.object.useColor,
                 (newObject.object.type == OBJ_MODEL ? &newObject.object.data.model : NULL), newObject.object.material, newObject.object.usePBR);
-            free(clipboard_object);
-            clipboard_object = NULL;
+            set_clipboard_object(NULL);
             isCutOperation = false;
         }
         else {
@@ -271,6 +278,47 @@ void debug_window(struct nk_context* ctx, int x, int y, int width, int height) {
         sprintf(buffer, "Light Shading: %d", lightingEnabled);
         nk_label(ctx, buffer, NK_TEXT_LEFT);
 
+        // Dynamic resolution
+        DynamicResolutionStats resolution;
+        getDynamicResolutionStats(&resolution);
+        sprintf(buffer, "Render Scale: %.0f%% (%dx%d)", resolution.scale * 100.0f, resolution.renderWidth, resolution.renderHeight);
+        nk_label(ctx, buffer, NK_TEXT_LEFT);
+        sprintf(buffer, "Scene GPU Time: %.2f / %.2f ms", resolution.gpuMilliseconds, resolution.targetMilliseconds);
+        nk_label(ctx, buffer, NK_TEXT_LEFT);
+
+        // Heap traffic; zero in a steady frame
+        AllocationStats allocations;
+        getAllocationStats(&allocations);
+        sprintf(buffer, "Heap Allocations: %llu last frame, %llu live", allocations.frameAllocations,
+                allocations.allocations - allocations.frees);
+        nk_label(ctx, buffer, NK_TEXT_LEFT);
+
+        // Memory by category and by owning asset
+        MemoryTotals memory;
+        getMemoryTotals(&memory);
+        sprintf(buffer, "GPU Memory: %.1f MB (peak %.1f MB)", memory.gpu.bytes / 1048576.0, memory.gpu.peakBytes / 1048576.0);
+        nk_label(ctx, buffer, NK_TEXT_LEFT);
+        sprintf(buffer, "Heap Memory: %.1f MB (peak %.1f MB)", memory.heapBytes / 1048576.0, memory.heapPeakBytes / 1048576.0);
+        nk_label(ctx, buffer, NK_TEXT_LEFT);
+        for (int i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+            if (memory.categories[i].peakBytes == 0) continue;
+            sprintf(buffer, "  %s: %.2f MB in %d (peak %.2f MB)", getMemoryCategoryName((MemoryCategory)i),
+                    memory.categories[i].bytes / 1048576.0, memory.categories[i].count, memory.categories[i].peakBytes / 1048576.0);
+            nk_label(ctx, buffer, NK_TEXT_LEFT);
+        }
+        const MemoryOwnerUsage* owners;
+        int ownerCount = getMemoryOwners(&owners);
+        nk_label(ctx, "Largest Owners:", NK_TEXT_LEFT);
+        for (int i = 0; i < ownerCount && i < DEBUG_MEMORY_OWNERS; i++) {
+            sprintf(buffer, "  %.2f MB  %s", owners[i].bytes / 1048576.0, owners[i].owner);
+            nk_label(ctx, buffer, NK_TEXT_LEFT);
+        }
+        nk_layout_row_dynamic(ctx, 25, 1);
+        if (nk_button_label(ctx, "Write Memory Report")) {
+            writeMemoryReport("memory-report.json");
+        }
+        nk_layout_row_dynamic(ctx, 15, 1);
+
         // Light details
         nk_label(ctx, "Light Details:", NK_TEXT_LEFT);
         for (int i = 0; i < lightCount; i++) {
@@ -289,6 +337,43 @@ void debug_window(struct nk_context* ctx, int x, int y, int width, int height) {
 }
 
 // Setup Nuklear GUI
+// The GUI is drawn into an offscreen texture that is composited over the
+// scene. The texture is only redrawn when Nuklear's command list changes, so
+// frames where only the scene moves skip nk_convert and the vertex upload.
+// CLUE_GUI_CACHE=0 draws the GUI straight to the screen every frame.
+static struct {
+    bool enabled;
+    bool valid;
+    GLuint fbo, texture, vao, shader;
+    int width, height;
+    uint64_t hash;
+} gui_layer;
+
+static void release_gui_layer() {
+    untrackMemory(TRACKED_TEXTURE, gui_layer.texture);
+    if (gui_layer.fbo) glDeleteFramebuffers(1, &gui_layer.fbo);
+    if (gui_layer.texture) glDeleteTextures(1, &gui_layer.texture);
+    if (gui_layer.vao) glDeleteVertexArrays(1, &gui_layer.vao);
+    if (gui_layer.shader) releaseShader(gui_layer.shader);
+    gui_layer.fbo = gui_layer.texture = gui_layer.vao = gui_layer.shader = 0;
+    gui_layer.width = gui_layer.height = 0;
+    gui_layer.valid = false;
+}
+
+static void init_gui_layer() {
+    const char* setting = getenv("CLUE_GUI_CACHE");
+    gui_layer.enabled = !(setting && strcmp(setting, "0") == 0);
+    if (!gui_layer.enabled) return;
+
+    gui_layer.shader = acquireShader("shaders/gui/compositeVertex.glsl", "shaders/gui/compositeFragment.glsl");
+    if (!gui_layer.shader) {
+        LOG_WARN(LOG_GUI, "Failed to load the GUI composite shader; drawing the GUI directly");
+        gui_layer.enabled = false;
+        return;
+    }
+    glGenVertexArrays(1, &gui_layer.vao); // Empty; the shader generates the vertices
+}
+
 void setup_nuklear(GLFWwindow* existingWindow) {
     window = existingWindow;
     ctx = nk_glfw3_init(window, NK_GLFW3_INSTALL_CALLBACKS);
@@ -297,7 +382,13 @@ void setup_nuklear(GLFWwindow* existingWindow) {
     roboto_font = nk_font_atlas_add_from_file(atlas, "resources/font/Roboto-Light.ttf", 16, 0);
     nk_glfw3_font_stash_end();
     nk_style_set_font(ctx, &roboto_font->handle);
+    // The streaming buffers are sized on the first render and keep that size
+    trackMemory(TRACKED_TEXTURE, glfw.ogl.font_tex, MEMORY_TEXTURES,
+                textureMemorySize(glfw.atlas.tex_width, glfw.atlas.tex_height, 1, 1, 4), "gui font");
+    trackMemory(TRACKED_BUFFER, glfw.ogl.vbo, MEMORY_STAGING_BUFFERS, MAX_VERTEX_BUFFER, "gui");
+    trackMemory(TRACKED_BUFFER, glfw.ogl.ebo, MEMORY_STAGING_BUFFERS, MAX_ELEMENT_BUFFER, "gui");
     set_theme(theme_dark);
+    init_gui_layer();
 }
 
 void start_engine() {
@@ -408,7 +499,7 @@ void toggle_fullscreen(GLFWwindow* window) {
 
 // Resize callback
 void resize_callback(GLFWwindow* window, int width, int height) {
-    printf("Resizing: width=%d, height=%d\n", width, height);
+    LOG_DEBUG(LOG_GUI, "Resizing: width=%d, height=%d", width, height);
     windowed_width = width;
     windowed_height = height;
     glViewport(0, 0, width, height);
@@ -501,7 +592,7 @@ void run_loading_screen(GLFWwindow* window) {
     float progressIncrement = 1.0f / (float)num_stages;
 
     for (int i = 0; i < num_stages; ++i) {
-        printf("Stage: %s, Progress: %.2f%%\n", stages[i], progress * 100);
+        LOG_DEBUG(LOG_GUI, "Stage: %s, Progress: %.2f%%", stages[i], progress * 100);
         loadResources(i, &progress);
         progress += progressIncrement;
         display_loading_screen(stages[i], progress);  // FIX: Remove `ctx`
@@ -513,87 +604,172 @@ void run_loading_screen(GLFWwindow* window) {
 void select_object(int index) {
     if (index >= 0 && index < objectManager.count) {
         selected_object = &objectManager.objects[index];
-        printf("Selected object: ID=%d, Index=%d\n", selected_object->id, index);
+        LOG_DEBUG(LOG_GUI, "Selected object: ID=%d, Index=%d", selected_object->id, index);
     }
 }
 
 // Hierarchy window function
-void hierarchy_window(struct nk_context* ctx, int hierarchyX, int hierarchyY, int hierarchyWidth, int hierarchyHeight) {
-    if (nk_begin(ctx, "Hierarchy", nk_rect(hierarchyX, hierarchyY, hierarchyWidth, hierarchyHeight), NK_WINDOW_BORDER | NK_WINDOW_TITLE | NK_WINDOW_MOVABLE | NK_WINDOW_SCALABLE)) {
-        nk_layout_row_dynamic(ctx, 20, 1);
-
-        for (int i = 0; i < objectManager.count; i++) {
-            SceneObject* sceneObj = &objectManager.objects[i];
-            char label[128];
+// Hierarchy rows are virtualised: labels are formatted once and cached, the
+// filter keeps an index of matching objects, and only visible rows are laid out
+#define HIERARCHY_ROW_HEIGHT 20
+#define HIERARCHY_FILTER_LENGTH 64
+
+static char hierarchy_labels[MAX_OBJECTS][32];
+static unsigned int hierarchy_label_epoch[MAX_OBJECTS];
+static unsigned int hierarchy_epoch = 1;    // Bumped when objects move, invalidating every label
+static int hierarchy_rows[MAX_OBJECTS];     // Object indices matching the filter
+static int hierarchy_row_count = 0;
+static int hierarchy_object_count = -1;     // Scene state the rows were built for
+static unsigned int hierarchy_generation = 0;
+static char hierarchy_filter[HIERARCHY_FILTER_LENGTH];
+
+static const char* hierarchy_label(int index) {
+    if (hierarchy_label_epoch[index] != hierarchy_epoch) {
+        snprintf(hierarchy_labels[index], sizeof(hierarchy_labels[index]), "%d. %s", index + 1,
+                 objectTypeName(objectManager.objects[index].object.type));
+        hierarchy_label_epoch[index] = hierarchy_epoch;
+    }
+    return hierarchy_labels[index];
+}
 
-            const char* typeName = objectTypeName(sceneObj->object.type);
-            snprintf(label, sizeof(label), "%d. %s", i + 1, typeName);
+static bool contains_ignore_case(const char* text, const char* pattern) {
+    for (; *text; text++) {
+        const char* t = text;
+        const char* p = pattern;
+        while (*t && *p && tolower((unsigned char)*t) == tolower((unsigned char)*p)) {
+            t++;
+            p++;
+        }
+        if (!*p) return true;
+    }
+    return !*pattern;
+}
 
-            if (nk_button_label(ctx, label)) {
-                select_object(i);  // Use the new selection function
+static void update_hierarchy_rows(const char* filter) {
+    bool moved = sceneGeneration != hierarchy_generation; // Removals shift every later index
+    bool grew = objectManager.count > hierarchy_object_count;
+    bool filter_changed = strcmp(filter, hierarchy_filter) != 0;
+    if (!moved && !grew && !filter_changed) return;
+    if (moved) hierarchy_epoch++;
+
+    if (!moved && !grew && strstr(filter, hierarchy_filter)) {
+        // A longer filter can only narrow the previous matches
+        int kept = 0;
+        for (int row = 0; row < hierarchy_row_count; row++) {
+            if (contains_ignore_case(hierarchy_label(hierarchy_rows[row]), filter)) {
+                hierarchy_rows[kept++] = hierarchy_rows[row];
             }
+        }
+        hierarchy_row_count = kept;
+    }
+    else {
+        // New objects are appended, so with an unchanged filter only they need checking
+        int start = (!moved && !filter_changed && hierarchy_object_count >= 0) ? hierarchy_object_count : 0;
+        if (start == 0) hierarchy_row_count = 0;
+        for (int i = start; i < objectManager.count; i++) {
+            if (!filter[0] || contains_ignore_case(hierarchy_label(i), filter)) {
+                hierarchy_rows[hierarchy_row_count++] = i;
+            }
+        }
+    }
 
-            if (nk_contextual_begin(ctx, 0, nk_vec2(150, 300), nk_window_get_bounds(ctx))) {
-                nk_layout_row_dynamic(ctx, 30, 1);
+    hierarchy_object_count = objectManager.count;
+    hierarchy_generation = sceneGeneration;
+    snprintf(hierarchy_filter, sizeof(hierarchy_filter), "%s", filter);
+}
 
-                // Check if a valid object is selected before showing context options
-                if (selected_object) {
-                    if (nk_contextual_item_label(ctx, "Change Color", NK_TEXT_CENTERED)) {
-                        show_color_picker = true;
-                    }
-                    if (nk_contextual_item_label(ctx, "Change Material", NK_TEXT_CENTERED)) {
-                        show_material_window = true;
-                    }
-                    if (nk_contextual_item_label(ctx, "Change Texture", NK_TEXT_CENTERED)) {
-                        show_texture_window = true;
-                    }
-                    if (nk_contextual_item_label(ctx, "Toggle Use PBR", NK_TEXT_CENTERED)) {
-                        selected_object->object.usePBR = !selected_object->object.usePBR;
-                        updateObjectInManager(selected_object);
-                    }
-                    if (nk_contextual_item_label(ctx, "Toggle Use Texture", NK_TEXT_CENTERED)) {
-                        selected_object->object.useTexture = !selected_object->object.useTexture;
-                        updateObjectInManager(selected_object);
-                    }
-                    if (nk_contextual_item_label(ctx, "Toggle Use Color", NK_TEXT_CENTERED)) {
-                        selected_object->object.useColor = !selected_object->object.useColor;
-                        updateObjectInManager(selected_object);
-                    }
-                    if (nk_contextual_item_label(ctx, "Delete", NK_TEXT_CENTERED)) {
-                        removeObject(i);
-                        selected_object = NULL;
-                    }
+void hierarchy_window(struct nk_context* ctx, int hierarchyX, int hierarchyY, int hierarchyWidth, int hierarchyHeight) {
+    static char filter[HIERARCHY_FILTER_LENGTH];
+    if (nk_begin(ctx, "Hierarchy", nk_rect(hierarchyX, hierarchyY, hierarchyWidth, hierarchyHeight), NK_WINDOW_BORDER | NK_WINDOW_TITLE | NK_WINDOW_MOVABLE | NK_WINDOW_SCALABLE)) {
+        nk_layout_row_dynamic(ctx, 25, 1);
+        nk_edit_string_zero_terminated(ctx, NK_EDIT_FIELD, filter, sizeof(filter), nk_filter_default);
+        update_hierarchy_rows(filter);
+
+        int selectedIndex = selected_object ? (int)(selected_object - objectManager.objects) : -1;
+        float detailsHeight = selected_object ? 8 * (HIERARCHY_ROW_HEIGHT + ctx->style.window.spacing.y) : 0.0f;
+        float listHeight = nk_window_get_content_region(ctx).h - 25 - detailsHeight - 3 * ctx->style.window.spacing.y;
+        if (listHeight < 3 * HIERARCHY_ROW_HEIGHT) listHeight = 3 * HIERARCHY_ROW_HEIGHT;
+
+        nk_layout_row_dynamic(ctx, listHeight, 1);
+        struct nk_rect listBounds = nk_widget_bounds(ctx);
+        struct nk_list_view view;
+        if (nk_list_view_begin(ctx, &view, "hierarchy_rows", NK_WINDOW_BORDER, HIERARCHY_ROW_HEIGHT, hierarchy_row_count)) {
+            nk_layout_row_dynamic(ctx, HIERARCHY_ROW_HEIGHT, 1);
+            for (int row = view.begin; row < view.end; row++) {
+                int i = hierarchy_rows[row];
+                if (nk_widget_is_mouse_clicked(ctx, NK_BUTTON_RIGHT)) {
+                    select_object(i); // The context menu acts on the row it was opened on
                 }
-                else {
-                    nk_label(ctx, "No object selected", NK_TEXT_CENTERED);
+                if (nk_select_label(ctx, hierarchy_label(i), NK_TEXT_LEFT, i == selectedIndex) != (i == selectedIndex)) {
+                    select_object(i);
                 }
-
-                nk_contextual_end(ctx);
             }
+            nk_list_view_end(&view);
+        }
 
-            if (selected_object == sceneObj) {
-                nk_layout_row_dynamic(ctx, 20, 1);
-                char buffer[128];
-                snprintf(buffer, sizeof(buffer), "Type: %s", typeName);
-                nk_label(ctx, buffer, NK_TEXT_LEFT);
-                snprintf(buffer, sizeof(buffer), "Position: (%.2f, %.2f, %.2f)", sceneObj->position.x, sceneObj->position.y, sceneObj->position.z);
-                nk_label(ctx, buffer, NK_TEXT_LEFT);
-                snprintf(buffer, sizeof(buffer), "Rotation: (%.2f, %.2f, %.2f)", sceneObj->rotation.x, sceneObj->rotation.y, sceneObj->rotation.z);
-                nk_label(ctx, buffer, NK_TEXT_LEFT);
-                snprintf(buffer, sizeof(buffer), "Scale: (%.2f, %.2f, %.2f)", sceneObj->scale.x, sceneObj->scale.y, sceneObj->scale.z);
-                nk_label(ctx, buffer, NK_TEXT_LEFT);
-
-                snprintf(buffer, sizeof(buffer), "Use Color: %s", sceneObj->object.useColor ? "Yes" : "No");
-                nk_label(ctx, buffer, NK_TEXT_LEFT);
-                snprintf(buffer, sizeof(buffer), "Use Texture: %s", sceneObj->object.useTexture ? "Yes" : "No");
-                nk_label(ctx, buffer, NK_TEXT_LEFT);
-                snprintf(buffer, sizeof(buffer), "Use PBR: %s", sceneObj->object.usePBR ? "Yes" : "No");
-                nk_label(ctx, buffer, NK_TEXT_LEFT);
-                if (nk_button_label(ctx, "Delete Object")) {
-                    removeObject(i);
+        // One context menu for the whole list instead of one per row
+        if (nk_contextual_begin(ctx, 0, nk_vec2(150, 300), listBounds)) {
+            nk_layout_row_dynamic(ctx, 30, 1);
+
+            // Check if a valid object is selected before showing context options
+            if (selected_object) {
+                if (nk_contextual_item_label(ctx, "Change Color", NK_TEXT_CENTERED)) {
+                    show_color_picker = true;
+                }
+                if (nk_contextual_item_label(ctx, "Change Material", NK_TEXT_CENTERED)) {
+                    show_material_window = true;
+                }
+                if (nk_contextual_item_label(ctx, "Change Texture", NK_TEXT_CENTERED)) {
+                    show_texture_window = true;
+                }
+                if (nk_contextual_item_label(ctx, "Toggle Use PBR", NK_TEXT_CENTERED)) {
+                    selected_object->object.usePBR = !selected_object->object.usePBR;
+                    updateObjectInManager(selected_object);
+                }
+                if (nk_contextual_item_label(ctx, "Toggle Use Texture", NK_TEXT_CENTERED)) {
+                    selected_object->object.useTexture = !selected_object->object.useTexture;
+                    updateObjectInManager(selected_object);
+                }
+                if (nk_contextual_item_label(ctx, "Toggle Use Color", NK_TEXT_CENTERED)) {
+                    selected_object->object.useColor = !selected_object->object.useColor;
+                    updateObjectInManager(selected_object);
+                }
+                if (nk_contextual_item_label(ctx, "Delete", NK_TEXT_CENTERED)) {
+                    removeObjectWithAction((int)(selected_object - objectManager.objects));
                     selected_object = NULL;
                 }
             }
+            else {
+                nk_label(ctx, "No object selected", NK_TEXT_CENTERED);
+            }
+
+            nk_contextual_end(ctx);
+        }
+
+        // Details of the selected object below the list
+        if (selected_object) {
+            SceneObject* sceneObj = selected_object;
+            nk_layout_row_dynamic(ctx, HIERARCHY_ROW_HEIGHT, 1);
+            char buffer[128];
+            snprintf(buffer, sizeof(buffer), "Type: %s", objectTypeName(sceneObj->object.type));
+            nk_label(ctx, buffer, NK_TEXT_LEFT);
+            snprintf(buffer, sizeof(buffer), "Position: (%.2f, %.2f, %.2f)", sceneObj->position.x, sceneObj->position.y, sceneObj->position.z);
+            nk_label(ctx, buffer, NK_TEXT_LEFT);
+            snprintf(buffer, sizeof(buffer), "Rotation: (%.2f, %.2f, %.2f)", sceneObj->rotation.x, sceneObj->rotation.y, sceneObj->rotation.z);
+            nk_label(ctx, buffer, NK_TEXT_LEFT);
+            snprintf(buffer, sizeof(buffer), "Scale: (%.2f, %.2f, %.2f)", sceneObj->scale.x, sceneObj->scale.y, sceneObj->scale.z);
+            nk_label(ctx, buffer, NK_TEXT_LEFT);
+
+            snprintf(buffer, sizeof(buffer), "Use Color: %s", sceneObj->object.useColor ? "Yes" : "No");
+            nk_label(ctx, buffer, NK_TEXT_LEFT);
+            snprintf(buffer, sizeof(buffer), "Use Texture: %s", sceneObj->object.useTexture ? "Yes" : "No");
+            nk_label(ctx, buffer, NK_TEXT_LEFT);
+            snprintf(buffer, sizeof(buffer), "Use PBR: %s", sceneObj->object.usePBR ? "Yes" : "No");
+            nk_label(ctx, buffer, NK_TEXT_LEFT);
+            if (nk_button_label(ctx, "Delete Object")) {
+                removeObjectWithAction((int)(sceneObj - objectManager.objects));
+                selected_object = NULL;
+            }
         }
         nk_end(ctx);
     }
@@ -646,26 +822,68 @@ void inspector_window(struct nk_context* ctx, int inspectorX, int inspectorY, in
     if (selected_object != NULL) {
         if (nk_begin(ctx, "Inspector", nk_rect(inspectorX, inspectorY, inspectorWidth, inspectorHeight), NK_WINDOW_BORDER | NK_WINDOW_TITLE | NK_WINDOW_MOVABLE | NK_WINDOW_SCALABLE | NK_WINDOW_CLOSABLE)) {
             nk_layout_row_dynamic(ctx, 25, 1);
+            int index = (int)(selected_object - objectManager.objects);
+            Vector3 position = selected_object->position;
+            Vector3 rotation = selected_object->rotation;
+            Vector3 scale = selected_object->scale;
+            Vector4 color = selected_object->color;
 
             nk_label(ctx, "Position", NK_TEXT_LEFT);
-            nk_property_float(ctx, "#X:", -100.0f, &selected_object->position.x, 100.0f, 0.1f, 0.1f);
-            nk_property_float(ctx, "#Y:", -100.0f, &selected_object->position.y, 100.0f, 0.1f, 0.1f);
-            nk_property_float(ctx, "#Z:", -100.0f, &selected_object->position.z, 100.0f, 0.1f, 0.1f);
+            nk_property_float(ctx, "#X:", -100.0f, &position.x, 100.0f, 0.1f, 0.1f);
+            nk_property_float(ctx, "#Y:", -100.0f, &position.y, 100.0f, 0.1f, 0.1f);
+            nk_property_float(ctx, "#Z:", -100.0f, &position.z, 100.0f, 0.1f, 0.1f);
 
             nk_label(ctx, "Rotation", NK_TEXT_LEFT);
-            nk_property_float(ctx, "#X:", -360.0f, &selected_object->rotation.x, 360.0f, 1.0f, 1.0f);
-            nk_property_float(ctx, "#Y:", -360.0f, &selected_object->rotation.y, 360.0f, 1.0f, 1.0f);
-            nk_property_float(ctx, "#Z:", -360.0f, &selected_object->rotation.z, 360.0f, 1.0f, 1.0f);
+            nk_property_float(ctx, "#X:", -360.0f, &rotation.x, 360.0f, 1.0f, 1.0f);
+            nk_property_float(ctx, "#Y:", -360.0f, &rotation.y, 360.0f, 1.0f, 1.0f);
+            nk_property_float(ctx, "#Z:", -360.0f, &rotation.z, 360.0f, 1.0f, 1.0f);
 
             nk_label(ctx, "Scale", NK_TEXT_LEFT);
-            nk_property_float(ctx, "#X:", 0.1f, &selected_object->scale.x, 10.0f, 0.1f, 0.1f);
-            nk_property_float(ctx, "#Y:", 0.1f, &selected_object->scale.y, 10.0f, 0.1f, 0.1f);
-            nk_property_float(ctx, "#Z:", 0.1f, &selected_object->scale.z, 10.0f, 0.1f, 0.1f);
+            nk_property_float(ctx, "#X:", 0.1f, &scale.x, 10.0f, 0.1f, 0.1f);
+            nk_property_float(ctx, "#Y:", 0.1f, &scale.y, 10.0f, 0.1f, 0.1f);
+            nk_property_float(ctx, "#Z:", 0.1f, &scale.z, 10.0f, 0.1f, 0.1f);
+
+            // Transforms are relative to the parent; reparenting keeps them, so the object moves with its new parent
+            nk_label(ctx, "Parent", NK_TEXT_LEFT);
+            int currentParent = selected_object->parentId >= 0 ? findObjectIndex(selected_object->parentId) : -1;
+            int parentIndex = currentParent;
+            char parentLabel[32];
+            snprintf(parentLabel, sizeof(parentLabel), "None");
+            if (currentParent >= 0) {
+                snprintf(parentLabel, sizeof(parentLabel), "%d. %s", currentParent + 1, objectTypeName(objectManager.objects[currentParent].object.type));
+            }
+            if (nk_combo_begin_label(ctx, parentLabel, nk_vec2(nk_widget_width(ctx), 200))) {
+                nk_layout_row_dynamic(ctx, 20, 1);
+                if (nk_combo_item_label(ctx, "None", NK_TEXT_LEFT)) {
+                    parentIndex = -1;
+                }
+                for (int i = 0; i < objectManager.count; i++) {
+                    if (i == index) continue;
+                    snprintf(parentLabel, sizeof(parentLabel), "%d. %s", i + 1, objectTypeName(objectManager.objects[i].object.type));
+                    if (nk_combo_item_label(ctx, parentLabel, NK_TEXT_LEFT)) {
+                        parentIndex = i;
+                    }
+                }
+                nk_combo_end(ctx);
+            }
 
             nk_label(ctx, "Color", NK_TEXT_LEFT);
-            nk_property_float(ctx, "#R:", 0.0f, &selected_object->color.x, 1.0f, 0.01f, 0.01f);
-            nk_property_float(ctx, "#G:", 0.0f, &selected_object->color.y, 1.0f, 0.01f, 0.01f);
-            nk_property_float(ctx, "#B:", 0.0f, &selected_object->color.z, 1.0f, 0.01f, 0.01f);
+            nk_property_float(ctx, "#R:", 0.0f, &color.x, 1.0f, 0.01f, 0.01f);
+            nk_property_float(ctx, "#G:", 0.0f, &color.y, 1.0f, 0.01f, 0.01f);
+            nk_property_float(ctx, "#B:", 0.0f, &color.z, 1.0f, 0.01f, 0.01f);
+
+            // Edits go through actions so they can be undone; a drag becomes one entry
+            if (memcmp(&position, &selected_object->position, sizeof(Vector3)) != 0 ||
+                memcmp(&rotation, &selected_object->rotation, sizeof(Vector3)) != 0 ||
+                memcmp(&scale, &selected_object->scale, sizeof(Vector3)) != 0) {
+                transformObjectWithAction(index, position, rotation, scale);
+            }
+            if (memcmp(&color, &selected_object->color, sizeof(Vector4)) != 0) {
+                changeColorWithAction(index, color);
+            }
+            if (parentIndex != currentParent) {
+                setParentWithAction(index, parentIndex);
+            }
 
             nk_end(ctx);
         }
@@ -768,9 +986,9 @@ void color_picker_window(struct nk_context* ctx) {
         color.b = nk_propertyf(ctx, "#B:", 0, color.b, 1.0f, 0.01f, 0.005f);
 
         // Update the selected object's color
-        if (selected_object) {
-            selected_object->color = (Vector4){ color.r, color.g, color.b, 1.0f }; 
-            updateObjectInManager(selected_object); 
+        Vector4 newColor = { color.r, color.g, color.b, 1.0f };
+        if (memcmp(&newColor, &selected_object->color, sizeof(Vector4)) != 0) {
+            changeColorWithAction((int)(selected_object - objectManager.objects), newColor);
         }
         nk_end(ctx);
     }
@@ -871,6 +1089,26 @@ void file_menu(struct nk_context* ctx) {
     }
 }
 
+// Save progress shown at the end of the menu bar
+void save_status(struct nk_context* ctx) {
+    ProjectSaveStatus status = getProjectSaveStatus();
+    char buffer[64];
+    if (status.saving) {
+        snprintf(buffer, sizeof(buffer), "%s %d%%", status.autosave ? "Autosave" : "Saving", (int)(status.progress * 100.0f));
+        nk_label(ctx, buffer, NK_TEXT_LEFT);
+    }
+    else if (status.lastFailed) {
+        nk_label_colored(ctx, "Save failed", NK_TEXT_LEFT, nk_rgb(220, 60, 60));
+    }
+    else if (status.lastSaveTime > 0.0 && glfwGetTime() - status.lastSaveTime < 3.0) {
+        nk_label(ctx, "Saved", NK_TEXT_LEFT);
+        scheduleRedraw(status.lastSaveTime + 3.0); // Clear the label even if nothing else changes
+    }
+    else {
+        nk_spacing(ctx, 1);
+    }
+}
+
 // Edit menu function
 void edit_menu(struct nk_context* ctx) {
     if (nk_menu_begin_label(ctx, "Edit", NK_TEXT_LEFT, nk_vec2(120, 200))) {
@@ -905,7 +1143,7 @@ void edit_menu(struct nk_context* ctx) {
 // Change background function
 void change_background(int backgroundIndex) {
     if (backgroundIndex < 1 || backgroundIndex > 8) {
-        fprintf(stderr, "Background index out of range. Please choose from 1 to 8.\n");
+        LOG_WARN(LOG_GUI, "Background index out of range. Please choose from 1 to 8.");
         return;
     }
     initSkybox(backgroundIndex);
@@ -1051,9 +1289,25 @@ void object_menu(struct nk_context* ctx) {
 // History window function
 void history_window(struct nk_context* ctx) {
     if (nk_begin(ctx, "History", nk_rect(50, 50, 400, 600), NK_WINDOW_BORDER | NK_WINDOW_TITLE | NK_WINDOW_MOVABLE | NK_WINDOW_SCALABLE)) {
-        nk_layout_row_dynamic(ctx, 25, 1);
-        for (int i = 0; i < historyCount; i++) {
-            nk_label(ctx, actionHistory[i].description, NK_TEXT_LEFT);
+        char label[128];
+        nk_layout_row_dynamic(ctx, 18, 1);
+        nk_labelf(ctx, NK_TEXT_LEFT, "%d actions, %.1f KB", getActionCount(), getActionHistoryBytes() / 1024.0);
+
+        // The log can be deep, so only visible rows are described
+        struct nk_list_view view;
+        nk_layout_row_dynamic(ctx, nk_window_get_content_region(ctx).h - 30, 1);
+        if (nk_list_view_begin(ctx, &view, "history_list", 0, 25, getActionCount())) {
+            nk_layout_row_dynamic(ctx, 25, 1);
+            for (int i = view.begin; i < view.end; i++) {
+                describeAction(getAction(i), label, sizeof(label));
+                if (i < getAppliedActionCount()) {
+                    nk_label(ctx, label, NK_TEXT_LEFT);
+                }
+                else {
+                    nk_label_colored(ctx, label, NK_TEXT_LEFT, nk_rgb(120, 120, 120)); // Undone
+                }
+            }
+            nk_list_view_end(&view);
         }
         nk_end(ctx);
     }
@@ -1086,7 +1340,7 @@ void main_gui() {
 
     if (nk_begin(ctx, "Menu", nk_rect(0, 0, monitorWidth, menuHeight), NK_WINDOW_NO_SCROLLBAR)) {
         nk_menubar_begin(ctx);
-        nk_layout_row_static(ctx, 25, 80, 6);
+        nk_layout_row_static(ctx, 25, 80, 7);
 
         file_menu(ctx);
         edit_menu(ctx);
@@ -1094,6 +1348,7 @@ void main_gui() {
         object_menu(ctx);
         window_menu(ctx);
         help_menu(ctx);
+        save_status(ctx);
 
         nk_menubar_end(ctx);
     }
@@ -1144,12 +1399,113 @@ void main_gui() {
 
 // Teardown Nuklear function
 void teardown_nuklear() {
+    release_gui_layer();
+    untrackMemory(TRACKED_TEXTURE, glfw.ogl.font_tex);
+    untrackMemory(TRACKED_BUFFER, glfw.ogl.vbo);
+    untrackMemory(TRACKED_BUFFER, glfw.ogl.ebo);
     nk_glfw3_shutdown();
 }
 
+// FNV-1a, as used for the scene snapshot hash
+static uint64_t hash_gui_bytes(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Everything nk_convert would read: the command memory, linked in draw order
+static uint64_t hash_gui_commands(int width, int height) {
+    uint64_t hash = 14695981039346656037ull;
+    hash = hash_gui_bytes(hash, &width, sizeof(width));
+    hash = hash_gui_bytes(hash, &height, sizeof(height));
+
+    const struct nk_command* first = nk__begin(ctx); // Builds the window links, like nk_convert
+    if (!first) return hash;
+    const nk_byte* memory = (const nk_byte*)ctx->memory.memory.ptr;
+    nk_size start = (nk_size)((const nk_byte*)first - memory);
+    hash = hash_gui_bytes(hash, &start, sizeof(start));
+    return hash_gui_bytes(hash, memory, ctx->memory.allocated);
+}
+
+static bool resize_gui_layer(int width, int height) {
+    if (gui_layer.fbo && width == gui_layer.width && height == gui_layer.height) {
+        return true;
+    }
+    if (!gui_layer.fbo) {
+        glGenFramebuffers(1, &gui_layer.fbo);
+        glGenTextures(1, &gui_layer.texture);
+    }
+    glBindTexture(GL_TEXTURE_2D, gui_layer.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    trackMemory(TRACKED_TEXTURE, gui_layer.texture, MEMORY_RENDER_TARGETS, textureMemorySize(width, height, 1, 1, 4), "gui layer");
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, gui_layer.fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gui_layer.texture, 0);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        LOG_WARN(LOG_GUI, "GUI layer framebuffer is incomplete; drawing the GUI directly");
+        release_gui_layer();
+        gui_layer.enabled = false;
+        return false;
+    }
+
+    gui_layer.width = width;
+    gui_layer.height = height;
+    gui_layer.valid = false;
+    return true;
+}
+
+static void composite_gui_layer() {
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glDisable(GL_CULL_FACE);
+    glDisable(GL_DEPTH_TEST);
+    glViewport(0, 0, gui_layer.width, gui_layer.height);
+
+    glUseProgram(gui_layer.shader);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, gui_layer.texture);
+    glUniform1i(glGetUniformLocation(gui_layer.shader, "gui"), 0);
+    glBindVertexArray(gui_layer.vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glDisable(GL_BLEND);
+}
+
 // Render Nuklear function
 void render_nuklear() {
-    nk_glfw3_render(NK_ANTI_ALIASING_ON, MAX_VERTEX_BUFFER, MAX_ELEMENT_BUFFER);
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    if (!gui_layer.enabled || width <= 0 || height <= 0 || !resize_gui_layer(width, height)) {
+        nk_glfw3_render(NK_ANTI_ALIASING_ON, MAX_VERTEX_BUFFER, MAX_ELEMENT_BUFFER);
+        return;
+    }
+
+    uint64_t hash = hash_gui_commands(width, height);
+    if (!gui_layer.valid || hash != gui_layer.hash) {
+        static const GLfloat transparent[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        glBindFramebuffer(GL_FRAMEBUFFER, gui_layer.fbo);
+        glClearBufferfv(GL_COLOR, 0, transparent);
+        nk_glfw3_render(NK_ANTI_ALIASING_ON, MAX_VERTEX_BUFFER, MAX_ELEMENT_BUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        gui_layer.hash = hash;
+        gui_layer.valid = true;
+    }
+    else {
+        nk_clear(ctx); // nk_glfw3_render would have reset the context for the next frame
+    }
+    composite_gui_layer();
 }
 
 